@@ -0,0 +1,540 @@
+/* hyscan-db-cache.c
+ *
+ * Copyright 2015-2020 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanDB.
+ *
+ * HyScanDB is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanDB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanDB имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanDB на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* HyScanDBCache - общий кэш блоков данных и индексов каналов.
+ *
+ * Кэш используется всеми каналами, открытыми через один объект HyScanDBFile.
+ * Объём кэша ограничен параметром max-size, задаваемым при создании объекта.
+ * Размер блока учитывается вместе с накладными расходами на его хранение.
+ * Блоки размером более 1/8 объёма кэша не кэшируются.
+ *
+ * Каждый канал регистрируется в кэше функцией hyscan_db_cache_add_owner и
+ * получает уникальный идентификатор, используемый в ключах его блоков. Для
+ * каждого владельца ведётся статистика обращений к кэшу и объёма его блоков.
+ * При закрытии канала его блоки удаляются функцией hyscan_db_cache_remove_owner.
+ *
+ * Блоки и статистика владельцев распределены по CACHE_SHARDS независимым
+ * сегментам со своими блокировками, сегмент определяется идентификатором
+ * владельца. Поэтому обращения к кэшу разных каналов, как правило, не
+ * блокируют друг друга, а блоки владельца хранятся в его собственном списке и
+ * удаляются без просмотра остальных блоков. Объём кэша учитывается общим
+ * счётчиком, при его превышении вытесняются блоки сегмента, в который
+ * помещается новый блок. Если в сегменте нет других блоков, новый блок
+ * помещается в кэш без вытеснения, поэтому объём кэша может превышать max-size
+ * не более чем на размер блока.
+ *
+ * Вытеснение блоков выполняется по алгоритму CLOCK: блоки сегмента образуют
+ * кольцевую очередь, при обращении к блоку у него устанавливается признак
+ * использования. При вытеснении просматриваются блоки с начала очереди, блок
+ * с признаком использования получает второй шанс - признак сбрасывается и блок
+ * переносится в конец очереди, первый блок без признака удаляется.
+ *
+ * Блоки хранятся в виде GBytes, функция hyscan_db_cache_get возвращает ссылку
+ * на блок, поэтому данные можно использовать после вытеснения блока из кэша.
+ * Функция hyscan_db_cache_set копирует данные блока, а функция
+ * hyscan_db_cache_set_bytes сохраняет ссылку на переданный GBytes без
+ * копирования. Все функции класса потокобезопасны.
+ */
+
+#include "hyscan-db-cache.h"
+
+#include <string.h>
+
+#define CACHE_SHARDS           16                                      /* Число сегментов кэша. */
+#define ENTRY_OVERHEAD         (sizeof (HyScanDBCacheEntry) + 64)      /* Накладные расходы на хранение блока. */
+
+enum
+{
+  PROP_O,
+  PROP_MAX_SIZE
+};
+
+/* Блок в кэше. */
+typedef struct
+{
+  HyScanDBCacheKey             key;                    /* Ключ блока. */
+  GBytes                      *data;                   /* Данные блока. */
+  gsize                        size;                   /* Размер блока с учётом накладных расходов. */
+  gboolean                     referenced;             /* Признак использования блока. */
+  GList                        link;                   /* Элемент очереди вытеснения. */
+  GList                        owner_link;             /* Элемент списка блоков владельца. */
+} HyScanDBCacheEntry;
+
+/* Статистика и блоки владельца. */
+typedef struct
+{
+  guint64                      hits;                   /* Число обращений, обслуженных из кэша. */
+  guint64                      misses;                 /* Число обращений, не обслуженных из кэша. */
+  guint64                      size;                   /* Объём блоков владельца. */
+  GQueue                       entries;                /* Блоки владельца. */
+} HyScanDBCacheOwner;
+
+/* Сегмент кэша. */
+typedef struct
+{
+  GHashTable                  *entries;                /* Блоки в сегменте. */
+  GQueue                       clock;                  /* Очередь вытеснения блоков. */
+  GHashTable                  *owners;                 /* Владельцы блоков сегмента. */
+  GMutex                       lock;                   /* Блокировка доступа к сегменту. */
+} HyScanDBCacheShard;
+
+struct _HyScanDBCachePrivate
+{
+  guint64                      max_size;               /* Максимальный объём кэша. */
+  volatile gsize               size;                   /* Текущий объём кэша. */
+
+  HyScanDBCacheShard           shards[CACHE_SHARDS];   /* Сегменты кэша. */
+
+  guint64                      last_owner;             /* Последний выданный идентификатор владельца. */
+  GMutex                       owner_lock;             /* Блокировка выдачи идентификаторов владельцев. */
+};
+
+static void                    hyscan_db_cache_set_property            (GObject                 *object,
+                                                                        guint                    prop_id,
+                                                                        const GValue            *value,
+                                                                        GParamSpec              *pspec);
+static void                    hyscan_db_cache_object_constructed      (GObject                 *object);
+static void                    hyscan_db_cache_object_finalize         (GObject                 *object);
+
+static guint                   hyscan_db_cache_key_hash                (gconstpointer            key);
+static gboolean                hyscan_db_cache_key_equal               (gconstpointer            key1,
+                                                                        gconstpointer            key2);
+static void                    hyscan_db_cache_free_entry              (gpointer                 data);
+static void                    hyscan_db_cache_free_owner              (gpointer                 data);
+static HyScanDBCacheShard     *hyscan_db_cache_get_shard               (HyScanDBCachePrivate    *priv,
+                                                                        guint64                  owner);
+static void                    hyscan_db_cache_remove_entry            (HyScanDBCachePrivate    *priv,
+                                                                        HyScanDBCacheShard      *shard,
+                                                                        HyScanDBCacheOwner      *owner,
+                                                                        HyScanDBCacheEntry      *entry);
+
+G_DEFINE_TYPE_WITH_PRIVATE (HyScanDBCache, hyscan_db_cache, G_TYPE_OBJECT)
+
+static void
+hyscan_db_cache_class_init (HyScanDBCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->set_property = hyscan_db_cache_set_property;
+
+  object_class->constructed = hyscan_db_cache_object_constructed;
+  object_class->finalize = hyscan_db_cache_object_finalize;
+
+  g_object_class_install_property (object_class, PROP_MAX_SIZE,
+                                   g_param_spec_uint64 ("max-size", "MaxSize", "Maximum cache size",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+}
+
+static void
+hyscan_db_cache_init (HyScanDBCache *cache)
+{
+  cache->priv = hyscan_db_cache_get_instance_private (cache);
+}
+
+static void
+hyscan_db_cache_set_property (GObject      *object,
+                              guint         prop_id,
+                              const GValue *value,
+                              GParamSpec   *pspec)
+{
+  HyScanDBCache *cache = HYSCAN_DB_CACHE (object);
+  HyScanDBCachePrivate *priv = cache->priv;
+
+  switch (prop_id)
+    {
+    case PROP_MAX_SIZE:
+      priv->max_size = MIN (g_value_get_uint64 (value), G_MAXSIZE);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+hyscan_db_cache_object_constructed (GObject *object)
+{
+  HyScanDBCache *cache = HYSCAN_DB_CACHE (object);
+  HyScanDBCachePrivate *priv = cache->priv;
+  guint i;
+
+  for (i = 0; i < CACHE_SHARDS; i++)
+    {
+      HyScanDBCacheShard *shard = &priv->shards[i];
+
+      shard->entries = g_hash_table_new_full (hyscan_db_cache_key_hash, hyscan_db_cache_key_equal,
+                                              NULL, hyscan_db_cache_free_entry);
+      shard->owners = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, hyscan_db_cache_free_owner);
+      g_queue_init (&shard->clock);
+
+      g_mutex_init (&shard->lock);
+    }
+
+  g_mutex_init (&priv->owner_lock);
+}
+
+static void
+hyscan_db_cache_object_finalize (GObject *object)
+{
+  HyScanDBCache *cache = HYSCAN_DB_CACHE (object);
+  HyScanDBCachePrivate *priv = cache->priv;
+  guint i;
+
+  for (i = 0; i < CACHE_SHARDS; i++)
+    {
+      HyScanDBCacheShard *shard = &priv->shards[i];
+
+      g_hash_table_unref (shard->owners);
+      g_hash_table_unref (shard->entries);
+
+      g_mutex_clear (&shard->lock);
+    }
+
+  g_mutex_clear (&priv->owner_lock);
+
+  G_OBJECT_CLASS (hyscan_db_cache_parent_class)->finalize (object);
+}
+
+/* Функция вычисляет хэш ключа блока. */
+static guint
+hyscan_db_cache_key_hash (gconstpointer key)
+{
+  const HyScanDBCacheKey *cache_key = key;
+  guint hash;
+
+  hash = (guint) cache_key->owner;
+  hash = 31 * hash + cache_key->type;
+  hash = 31 * hash + cache_key->part;
+  hash = 31 * hash + cache_key->block;
+
+  return hash;
+}
+
+/* Функция сравнивает ключи блоков. */
+static gboolean
+hyscan_db_cache_key_equal (gconstpointer key1,
+                           gconstpointer key2)
+{
+  const HyScanDBCacheKey *cache_key1 = key1;
+  const HyScanDBCacheKey *cache_key2 = key2;
+
+  return (cache_key1->owner == cache_key2->owner) &&
+         (cache_key1->type == cache_key2->type) &&
+         (cache_key1->part == cache_key2->part) &&
+         (cache_key1->block == cache_key2->block);
+}
+
+/* Функция освобождает блок. */
+static void
+hyscan_db_cache_free_entry (gpointer data)
+{
+  HyScanDBCacheEntry *entry = data;
+
+  g_bytes_unref (entry->data);
+  g_slice_free (HyScanDBCacheEntry, entry);
+}
+
+/* Функция освобождает статистику владельца. Блоки владельца к этому моменту
+   удалены или освобождаются вместе с таблицей блоков сегмента. */
+static void
+hyscan_db_cache_free_owner (gpointer data)
+{
+  HyScanDBCacheOwner *owner = data;
+
+  g_slice_free (HyScanDBCacheOwner, owner);
+}
+
+/* Функция возвращает сегмент кэша владельца блоков. */
+static HyScanDBCacheShard *
+hyscan_db_cache_get_shard (HyScanDBCachePrivate *priv,
+                           guint64               owner)
+{
+  return &priv->shards[owner % CACHE_SHARDS];
+}
+
+/* Функция удаляет блок из кэша. Функция должна вызываться при захваченной
+   блокировке сегмента. */
+static void
+hyscan_db_cache_remove_entry (HyScanDBCachePrivate *priv,
+                              HyScanDBCacheShard   *shard,
+                              HyScanDBCacheOwner   *owner,
+                              HyScanDBCacheEntry   *entry)
+{
+  owner->size -= entry->size;
+  g_queue_unlink (&owner->entries, &entry->owner_link);
+
+  g_atomic_pointer_add (&priv->size, -(gssize) entry->size);
+
+  g_queue_unlink (&shard->clock, &entry->link);
+  g_hash_table_remove (shard->entries, &entry->key);
+}
+
+/* Функция создаёт новый объект HyScanDBCache. */
+HyScanDBCache *
+hyscan_db_cache_new (guint64 max_size)
+{
+  return g_object_new (HYSCAN_TYPE_DB_CACHE, "max-size", max_size, NULL);
+}
+
+/* Функция регистрирует нового владельца блоков и возвращает его идентификатор. */
+guint64
+hyscan_db_cache_add_owner (HyScanDBCache *cache)
+{
+  HyScanDBCachePrivate *priv;
+  HyScanDBCacheShard *shard;
+  HyScanDBCacheOwner *owner;
+  guint64 *owner_id;
+
+  g_return_val_if_fail (HYSCAN_IS_DB_CACHE (cache), 0);
+
+  priv = cache->priv;
+
+  owner_id = g_new (guint64, 1);
+  owner = g_slice_new0 (HyScanDBCacheOwner);
+  g_queue_init (&owner->entries);
+
+  g_mutex_lock (&priv->owner_lock);
+  *owner_id = ++priv->last_owner;
+  g_mutex_unlock (&priv->owner_lock);
+
+  shard = hyscan_db_cache_get_shard (priv, *owner_id);
+
+  g_mutex_lock (&shard->lock);
+  g_hash_table_insert (shard->owners, owner_id, owner);
+  g_mutex_unlock (&shard->lock);
+
+  return *owner_id;
+}
+
+/* Функция удаляет все блоки владельца и его статистику. */
+void
+hyscan_db_cache_remove_owner (HyScanDBCache *cache,
+                              guint64        owner)
+{
+  HyScanDBCachePrivate *priv;
+  HyScanDBCacheShard *shard;
+  HyScanDBCacheOwner *stats;
+
+  g_return_if_fail (HYSCAN_IS_DB_CACHE (cache));
+
+  priv = cache->priv;
+  shard = hyscan_db_cache_get_shard (priv, owner);
+
+  g_mutex_lock (&shard->lock);
+
+  stats = g_hash_table_lookup (shard->owners, &owner);
+  if (stats != NULL)
+    {
+      while (stats->entries.head != NULL)
+        hyscan_db_cache_remove_entry (priv, shard, stats, stats->entries.head->data);
+
+      g_hash_table_remove (shard->owners, &owner);
+    }
+
+  g_mutex_unlock (&shard->lock);
+}
+
+/* Функция ищет блок в кэше. Функция возвращает ссылку на данные блока или
+   NULL, если блок не найден. */
+GBytes *
+hyscan_db_cache_get (HyScanDBCache          *cache,
+                     const HyScanDBCacheKey *key)
+{
+  HyScanDBCacheShard *shard;
+  HyScanDBCacheEntry *entry;
+  HyScanDBCacheOwner *owner;
+  GBytes *data = NULL;
+
+  g_return_val_if_fail (HYSCAN_IS_DB_CACHE (cache), NULL);
+
+  shard = hyscan_db_cache_get_shard (cache->priv, key->owner);
+
+  g_mutex_lock (&shard->lock);
+
+  entry = g_hash_table_lookup (shard->entries, key);
+  if (entry != NULL)
+    {
+      entry->referenced = TRUE;
+      data = g_bytes_ref (entry->data);
+    }
+
+  owner = g_hash_table_lookup (shard->owners, &key->owner);
+  if (owner != NULL)
+    {
+      if (data != NULL)
+        owner->hits += 1;
+      else
+        owner->misses += 1;
+    }
+
+  g_mutex_unlock (&shard->lock);
+
+  return data;
+}
+
+/* Функция помещает блок в кэш, копируя его данные. Если блок с таким ключом
+   уже есть в кэше, он заменяется. */
+void
+hyscan_db_cache_set (HyScanDBCache          *cache,
+                     const HyScanDBCacheKey *key,
+                     gconstpointer           data,
+                     gsize                   size)
+{
+  GBytes *bytes;
+
+  g_return_if_fail (HYSCAN_IS_DB_CACHE (cache));
+
+  /* Слишком большие блоки не кэшируются. */
+  if (size + ENTRY_OVERHEAD > cache->priv->max_size / 8)
+    return;
+
+  bytes = g_bytes_new (data, size);
+  hyscan_db_cache_set_bytes (cache, key, bytes);
+  g_bytes_unref (bytes);
+}
+
+/* Функция помещает блок в кэш без копирования данных, кэш хранит ссылку на
+   data. Если блок с таким ключом уже есть в кэше, он заменяется. Для
+   освобождения места вытесняются блоки сегмента владельца. */
+void
+hyscan_db_cache_set_bytes (HyScanDBCache          *cache,
+                           const HyScanDBCacheKey *key,
+                           GBytes                 *data)
+{
+  HyScanDBCachePrivate *priv;
+  HyScanDBCacheShard *shard;
+  HyScanDBCacheEntry *entry;
+  HyScanDBCacheEntry *prev_entry;
+  HyScanDBCacheOwner *owner;
+  gsize size;
+
+  g_return_if_fail (HYSCAN_IS_DB_CACHE (cache));
+
+  priv = cache->priv;
+  size = g_bytes_get_size (data);
+
+  /* Слишком большие блоки не кэшируются. */
+  if (size + ENTRY_OVERHEAD > priv->max_size / 8)
+    return;
+
+  entry = g_slice_new (HyScanDBCacheEntry);
+  entry->key = *key;
+  entry->data = g_bytes_ref (data);
+  entry->size = size + ENTRY_OVERHEAD;
+  entry->referenced = FALSE;
+  entry->link.data = entry;
+  entry->link.prev = NULL;
+  entry->link.next = NULL;
+  entry->owner_link.data = entry;
+  entry->owner_link.prev = NULL;
+  entry->owner_link.next = NULL;
+
+  shard = hyscan_db_cache_get_shard (priv, key->owner);
+
+  g_mutex_lock (&shard->lock);
+
+  /* Владелец уже удалён. */
+  owner = g_hash_table_lookup (shard->owners, &key->owner);
+  if (owner == NULL)
+    {
+      g_mutex_unlock (&shard->lock);
+      hyscan_db_cache_free_entry (entry);
+      return;
+    }
+
+  /* Удаляем предыдущий блок с таким же ключом. */
+  prev_entry = g_hash_table_lookup (shard->entries, key);
+  if (prev_entry != NULL)
+    hyscan_db_cache_remove_entry (priv, shard, owner, prev_entry);
+
+  /* Вытесняем блоки сегмента. */
+  while (((gsize) g_atomic_pointer_get (&priv->size) + entry->size > priv->max_size) && (shard->clock.head != NULL))
+    {
+      GList *link = g_queue_pop_head_link (&shard->clock);
+      HyScanDBCacheEntry *old_entry = link->data;
+
+      /* Второй шанс для использованного блока. */
+      if (old_entry->referenced)
+        {
+          old_entry->referenced = FALSE;
+          g_queue_push_tail_link (&shard->clock, link);
+          continue;
+        }
+
+      g_queue_push_head_link (&shard->clock, link);
+      hyscan_db_cache_remove_entry (priv, shard,
+                                    g_hash_table_lookup (shard->owners, &old_entry->key.owner),
+                                    old_entry);
+    }
+
+  g_hash_table_insert (shard->entries, &entry->key, entry);
+  g_queue_push_tail_link (&shard->clock, &entry->link);
+  g_queue_push_tail_link (&owner->entries, &entry->owner_link);
+
+  g_atomic_pointer_add (&priv->size, entry->size);
+  owner->size += entry->size;
+
+  g_mutex_unlock (&shard->lock);
+}
+
+/* Функция возвращает статистику кэша для владельца блоков. */
+void
+hyscan_db_cache_get_stats (HyScanDBCache *cache,
+                           guint64        owner,
+                           guint64       *n_hits,
+                           guint64       *n_misses,
+                           guint64       *size)
+{
+  HyScanDBCacheShard *shard;
+  HyScanDBCacheOwner *stats;
+
+  g_return_if_fail (HYSCAN_IS_DB_CACHE (cache));
+
+  shard = hyscan_db_cache_get_shard (cache->priv, owner);
+
+  g_mutex_lock (&shard->lock);
+
+  stats = g_hash_table_lookup (shard->owners, &owner);
+
+  if (n_hits != NULL)
+    *n_hits = (stats != NULL) ? stats->hits : 0;
+  if (n_misses != NULL)
+    *n_misses = (stats != NULL) ? stats->misses : 0;
+  if (size != NULL)
+    *size = (stats != NULL) ? stats->size : 0;
+
+  g_mutex_unlock (&shard->lock);
+}
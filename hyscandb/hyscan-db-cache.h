@@ -0,0 +1,110 @@
+/* hyscan-db-cache.h
+ *
+ * Copyright 2015-2020 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanDB.
+ *
+ * HyScanDB is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanDB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanDB имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanDB на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+#ifndef __HYSCAN_DB_CACHE_H__
+#define __HYSCAN_DB_CACHE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define HYSCAN_TYPE_DB_CACHE             (hyscan_db_cache_get_type ())
+#define HYSCAN_DB_CACHE(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), HYSCAN_TYPE_DB_CACHE, HyScanDBCache))
+#define HYSCAN_IS_DB_CACHE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HYSCAN_TYPE_DB_CACHE))
+#define HYSCAN_DB_CACHE_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), HYSCAN_TYPE_DB_CACHE, HyScanDBCacheClass))
+#define HYSCAN_IS_DB_CACHE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), HYSCAN_TYPE_DB_CACHE))
+#define HYSCAN_DB_CACHE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), HYSCAN_TYPE_DB_CACHE, HyScanDBCacheClass))
+
+typedef struct _HyScanDBCache HyScanDBCache;
+typedef struct _HyScanDBCachePrivate HyScanDBCachePrivate;
+typedef struct _HyScanDBCacheClass HyScanDBCacheClass;
+
+/* Типы кэшируемых блоков. */
+typedef enum
+{
+  HYSCAN_DB_CACHE_INDEX,
+  HYSCAN_DB_CACHE_DATA
+} HyScanDBCacheType;
+
+/* Ключ блока в кэше. */
+typedef struct
+{
+  guint64              owner;          /* Идентификатор владельца блока. */
+  HyScanDBCacheType    type;           /* Тип блока. */
+  guint32              part;           /* Идентификатор части данных. */
+  guint32              block;          /* Номер блока. */
+} HyScanDBCacheKey;
+
+struct _HyScanDBCache
+{
+  GObject parent_instance;
+
+  HyScanDBCachePrivate *priv;
+};
+
+struct _HyScanDBCacheClass
+{
+  GObjectClass parent_class;
+};
+
+GType          hyscan_db_cache_get_type        (void);
+
+HyScanDBCache *hyscan_db_cache_new             (guint64                 max_size);
+
+guint64        hyscan_db_cache_add_owner       (HyScanDBCache          *cache);
+
+void           hyscan_db_cache_remove_owner    (HyScanDBCache          *cache,
+                                                guint64                 owner);
+
+GBytes        *hyscan_db_cache_get             (HyScanDBCache          *cache,
+                                                const HyScanDBCacheKey *key);
+
+void           hyscan_db_cache_set             (HyScanDBCache          *cache,
+                                                const HyScanDBCacheKey *key,
+                                                gconstpointer           data,
+                                                gsize                   size);
+
+void           hyscan_db_cache_set_bytes       (HyScanDBCache          *cache,
+                                                const HyScanDBCacheKey *key,
+                                                GBytes                 *data);
+
+void           hyscan_db_cache_get_stats       (HyScanDBCache          *cache,
+                                                guint64                 owner,
+                                                guint64                *n_hits,
+                                                guint64                *n_misses,
+                                                guint64                *size);
+
+G_END_DECLS
+
+#endif /* __HYSCAN_DB_CACHE_H__ */
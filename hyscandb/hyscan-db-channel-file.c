@@ -38,11 +38,27 @@
  *
  * Создание объекта класса осуществляется при помощи функции g_object_new.
  *
- * Конструктор класса имеет три параметра:
+ * Конструктор класса имеет следующие параметры:
  *
  * - path - путь к каталогу с файлами данных. (string);
  * - name - название канала данных (string);
- * - readonly - признак работы в режиме только для чтения (boolean).
+ * - readonly - признак работы в режиме только для чтения (boolean);
+ * - mmap-index - признак отображения файлов индексов в память (boolean). Вне
+ *   UNIX систем индексы активной части считываются из файла, при ошибке
+ *   отображения режим отключается и все индексы считываются из файлов;
+ * - write-buffer-size - размер буфера отложенной записи, 0 - запись без буферизации (uint);
+ * - write-buffer-time - максимальное время нахождения данных в буфере отложенной записи (int64);
+ * - index-cache-size - число кэшируемых индексов, 0 - без кэширования (uint);
+ * - memory-index - признак загрузки всех индексов в память (boolean);
+ * - memory-index-prefetch - признак загрузки индексов в память фоновым потоком (boolean);
+ * - io-uring - признак использования io_uring для записи и пакетного чтения данных (boolean);
+ * - read-ahead - число записей упреждающего чтения, 0 - без упреждающего чтения (uint);
+ * - cache - общий кэш блоков данных и индексов (HyScanDBCache);
+ * - pack-compression - алгоритм фонового сжатия завершённых частей (HyScanDBCompression);
+ * - preallocate-size - максимальный размер области предварительного выделения места
+ *   в файлах частей, 0 - без предварительного выделения (uint64);
+ * - max-open-parts - максимальное число частей с открытыми дескрипторами файлов,
+ *   0 - без ограничения (uint).
  *
  * Данные хранятся в двух основыных типах фалов: данных и индексов. Максимальный
  * размер одного файла ограничен константой MAX_DATA_FILE_SIZE и по умолчанию
@@ -51,7 +67,7 @@
  *
  * Файлы данных и индексов имеют следующий формат имени: "<name>.XXXXXX.Y", где:
  * - name - название канала данных;
- * - XXXXXX - номер части данных от 0 до MAX_PARTS;
+ * - XXXXXX - номер части данных, не менее шести цифр;
  * - Y - расширение имени файла, i - для файла индексов, d - для файла данных.
  *
  * Все служебные поля файла записываются в формате LITTLE ENDIAN.
@@ -61,7 +77,10 @@
  * - INDEX_FILE_MAGIC - для файлов индексов ("HSIX");
  * - DATA_FILE_MAGIC - для файлов данных ("HSDT").
  *
- * Следующие 4 байта занимает версия файла, константа FILE_VERSION ("1507").
+ * Следующие 4 байта занимает версия файла, константа FILE_VERSION_COMPACT
+ * ("1705") для новых частей. Части версий FILE_VERSION ("1701") и
+ * FILE_VERSION_COMPRESSED ("1702"), созданные предыдущими версиями
+ * библиотеки, открываются только для чтения.
  *
  * Константы определены как 32-х битное целое число таким образом, что бы при
  * записи их в файл как LITTLE ENDIAN 32-х битные значения и чтения их в виде строки,
@@ -70,8 +89,21 @@
  * Каждый файл индексов после идентификатора и версии файла содержит номер
  * первого индекса - 32-х битное целое со знаком.
  *
- * Далее в файл индексов записываются индексы блоков данных, индекс описывается
- * структурой HyScanDBChannelFileIndexRec.
+ * В частях версий FILE_VERSION и FILE_VERSION_COMPRESSED далее в файл индексов
+ * записываются индексы блоков данных, индекс описывается структурой
+ * HyScanDBChannelFileIndexRec.
+ *
+ * В частях версии FILE_VERSION_COMPACT индексы записываются блоками по
+ * COMPACT_BLOCK_RECORDS записей. Блок начинается с времени первой записи
+ * (64-х битное целое со знаком) и смещения её данных (64-х битное целое без
+ * знака), за которыми для каждой записи следуют смещение времени относительно
+ * предыдущей записи, размер данных и поле pad в виде целых чисел переменной
+ * длины (по 7 бит в байте, начиная с младших). Смещение данных записи
+ * вычисляется как сумма смещения блока и размеров данных предыдущих записей
+ * блока. На каждую запись обычно приходится 4-7 байт индекса вместо 24. При открытии
+ * части файл индексов просматривается и смещения блоков в нём запоминаются,
+ * при чтении индекса декодируется содержащий его блок, а все индексы блока
+ * помещаются в кэш индексов.
  *
  * Для каждого индекса, в файл данных записывается информация размером
  * соответствующим указанному в индексе. Смещение до каждого записанного
@@ -80,6 +112,58 @@
  * Сами данные записываются без преобразований. Клиент должен знать формат
  * записываемых данных.
  *
+ * Если для канала задан алгоритм сжатия функцией
+ * hyscan_db_channel_file_set_channel_compression, данные каждой записи
+ * сжимаются независимо от других. В этом случае поле size индекса содержит
+ * исходный размер данных записи, а поле pad - алгоритм сжатия в старших
+ * четырёх битах и размер сжатых данных в остальных. Нулевое значение pad
+ * означает запись без сжатия, в частях версии FILE_VERSION поле pad не
+ * используется. Записи, которые не удалось сжать или сжатый размер которых
+ * не меньше исходного, хранятся без сжатия. Данные распаковываются при
+ * чтении, в том числе перед помещением в общий кэш и буфер упреждающего
+ * чтения. Объём данных до и после сжатия можно узнать функцией
+ * hyscan_db_channel_file_get_compression_stats.
+ *
+ * Для каналов, записи которых имеют одинаковый небольшой размер (навигация,
+ * ориентация), функцией hyscan_db_channel_file_set_channel_record_size можно
+ * задать фиксированный размер записей. Такие части данных создаются с версией
+ * FILE_VERSION_FIXED ("1704"). Записи в файле данных следуют друг за другом,
+ * смещение записи вычисляется по её номеру. Файл индексов после номера первого
+ * индекса содержит размер записей (32-х битное целое без знака) и далее только
+ * метки времени, блоками по FIXED_TIME_RECORDS записей. Блок начинается с
+ * базового времени записи - 64-х битного целого, за которым следуют смещения
+ * времени записей блока относительно базового - 32-х битные целые без знака.
+ * Таким образом на каждую запись приходится немногим более 4 байт индекса
+ * вместо 24. Если смещение времени не помещается в 32 бита, создаётся новая
+ * часть. Сжатие записей (hyscan_db_channel_file_set_channel_compression) и
+ * фиксированный размер записей несовместимы: функция, включающая один из этих
+ * режимов при включенном другом, возвращает FALSE. При фоновом сжатии части
+ * байты записей блока переставляются по столбцам (все первые байты записей,
+ * затем все вторые и т.д.), что улучшает сжатие медленно меняющихся значений.
+ * Изменение размера записей или переключение между режимами приводит к
+ * созданию новой части.
+ *
+ * Если задан алгоритм pack-compression, завершённые части данных сжимаются
+ * целиком отдельным потоком с пониженным приоритетом, не замедляя запись.
+ * Часть помещается в очередь сжатия при создании следующей части и при
+ * завершении записи в канал. При освобождении объекта сжатие прерывается,
+ * чтобы не задерживать закрытие канала. Несжатые части, оставшиеся после
+ * этого или после аварийного завершения записи, помещаются в очередь при
+ * следующем открытии канала с заданным алгоритмом pack-compression, в том
+ * числе только для чтения. Данные части группируются в блоки из целых
+ * записей размером не менее PACK_BLOCK_SIZE, каждый блок сжимается отдельно.
+ * Сжатый файл данных имеет версию FILE_VERSION_PACKED ("1703") и содержит
+ * после заголовка сжатые блоки, таблицу блоков из структур
+ * HyScanDBChannelFileBlockRec и окончание HyScanDBChannelFilePackTail.
+ * Блок, который не удалось сжать, хранится без изменений, в этом случае его
+ * сжатый размер совпадает с исходным. Файл индексов не изменяется: смещения
+ * записей относятся к исходному файлу данных и пересчитываются по таблице
+ * блоков при чтении. Сжатый файл записывается во временный файл
+ * "<name>.pack" и заменяет файл данных переименованием, после чего читающие
+ * потоки переключаются на него. Последний распакованный блок каждой части
+ * хранится в памяти. Число сжатых и ожидающих сжатия частей, объём данных до
+ * и после сжатия можно узнать функцией hyscan_db_channel_file_get_pack_stats.
+ *
  * По достижении файлом данных определённого размера, создаётся новая часть
  * данных, состоящая из пары файлов: индексов и данных.
  *
@@ -87,38 +171,282 @@
  * новая часть данных будет также создаваться если запись в текущую часть
  * длится дольше чем (время хранения / 5) или размер текущей части превысил
  * 1/5 часть от сохраняемого объёма. Старые части данных (по времени или по
- * объёму) будут периодически удаляться, а оставшиеся файлы переименовываться,
- * чтобы номер части данных всегда начинался с нуля.
+ * объёму) будут периодически удаляться. Файлы оставшихся частей при этом не
+ * переименовываются, удаление части сводится к удалению двух её файлов.
+ * Номер первой части канала без удалённых частей равен нулю, иначе при
+ * открытии канала он определяется по наименьшему номеру файла индексов в
+ * каталоге функцией hyscan_db_channel_get_first_part. Номер каждой следующей
+ * части на единицу больше номера предыдущей. Каналы, части которых
+ * переименовывались предыдущими версиями библиотеки, открываются так же.
+ *
+ * Работа с файловой системой при смене частей вынесена из записывающего потока
+ * в поток обслуживания. Это один поток, общий для всех каналов процесса: он
+ * выполняет задания каналов по очереди, по одному заданию за обращение к
+ * каналу. Удаляемая часть исключается из списка частей сразу, а её файлы
+ * закрываются и удаляются потоком обслуживания. Когда текущая часть заполнена
+ * более чем на три четверти по объёму или по времени, поток обслуживания
+ * заранее создаёт файлы следующей части с временными именами
+ * "<name>.spare.i" и "<name>.spare.d". При смене части эти файлы
+ * переименовываются и в них записываются только заголовки. Записывающий поток
+ * не ожидает создания файлов: если они ещё не готовы, часть создаётся сразу,
+ * а заранее создаваемые файлы удаляются потоком обслуживания. Если заранее
+ * созданная часть не понадобилась, её файлы удаляются при завершении записи.
+ * При закрытии канала он исключается из очереди потока обслуживания, а
+ * оставшиеся задания выполняются сразу. Временные файлы, а также пустые файлы
+ * последней части, оставшиеся после аварийного завершения, удаляются при
+ * открытии канала на запись или пропускаются и удаляются вместе с каналом.
+ *
+ * Чтобы при открытии канала не считывать заголовки и индексы каждой части,
+ * поток обслуживания записывает файл описания частей "<name>.manifest" при
+ * завершении очередной части, после её фонового сжатия и при завершении записи
+ * в канал. Файл начинается с заголовка с идентификатором MANIFEST_FILE_MAGIC
+ * ("HSMF") и версией MANIFEST_VERSION ("1707"), за которым следуют число
+ * частей и их описания (структура HyScanDBChannelFileManifestRec) со
+ * смещениями блоков компактных индексов. Описание каждой части содержит
+ * контрольную сумму MD5 всего её файла индексов и первых и последних
+ * MANIFEST_TAIL_SIZE байт файла данных. Файл заканчивается контрольной суммой
+ * MD5 всего его содержимого и заменяется целиком. Файл описания частей
+ * обновляется и после удаления старых частей.
+ *
+ * При открытии канала части, описанные в файле описания частей, создаются
+ * без обращения к их файлам. Проверяются только размеры и контрольная сумма
+ * файлов последней из них; если они не совпадают, файл описания частей
+ * считается устаревшим и части проверяются чтением их файлов. Контрольная
+ * сумма файлов остальных частей проверяется при первом открытии их файлов,
+ * тогда же считывается таблица блоков сжатой части. Если файлы части не
+ * соответствуют описанию, канал переводится в состояние ошибки. Части,
+ * отсутствующие в файле описания частей, а также все части при его отсутствии
+ * или повреждении, проверяются чтением их файлов.
+ *
+ * Запись данных производится только одним потоком одновременно, для этого
+ * используется блокировка write_lock. Чтение данных может выполняться
+ * параллельно из нескольких потоков, в том числе одновременно с записью.
+ * Чтение производится по смещению в файле (pread), без перемещения текущей
+ * позиции, через отдельные для каждой части дескрипторы файлов. Информация о
+ * частях данных защищена блокировкой чтения/записи lock. Записывающий поток
+ * захватывает её на запись только для публикации новой записи или изменения
+ * списка частей. Кэш индексов защищён собственной блокировкой cache_lock.
+ *
+ * Если включен режим mmap-index, файлы индексов отображаются в память и
+ * индексы считываются из отображения без обращения к файлу и кэшу индексов.
+ * Файлы индексов завершённых частей отображаются целиком. Отображение
+ * активной части создаётся с запасом и пересоздаётся записывающим потоком
+ * при захваченной на запись блокировке lock, когда записанные индексы
+ * перестают в него помещаться. Для активной части это возможно только в
+ * UNIX системах, в остальных случаях её индексы считываются из файла.
+ *
+ * Для каналов, открытых только для чтения, данные могут быть получены без
+ * копирования функцией hyscan_db_channel_file_map_channel_data. Файл данных
+ * части отображается в память при первом обращении и остаётся отображённым,
+ * пока существуют ссылки на возвращённые данные.
+ *
+ * Если задан размер буфера отложенной записи, индексы и данные новых записей
+ * накапливаются в памяти и записываются в файлы одной операцией для каждого
+ * файла, когда объём буфера превысит write-buffer-size или когда с момента
+ * помещения в буфер первой записи пройдёт write-buffer-time микросекунд.
+ * Запись по времени выполняет отдельный поток. Буферизуются только записи
+ * последней части данных, перед созданием новой части буфер записывается в
+ * файлы. Ещё не записанные в файлы данные доступны читающим потокам из буфера.
+ *
+ * Режим сохранности данных задаётся функцией hyscan_db_channel_file_set_channel_durability.
+ * В режимах HYSCAN_DB_DURABILITY_FLUSH и выше буфер отложенной записи
+ * записывается в файлы после каждой записи. В режимах HYSCAN_DB_DURABILITY_SYNC
+ * и HYSCAN_DB_DURABILITY_GROUP_COMMIT файлы последней части синхронизируются с
+ * диском отдельным потоком: периодически или сразу, при этом в последнем
+ * случае записывающий поток ожидает завершения синхронизации. Файлы
+ * предыдущей части синхронизируются при создании новой части.
+ *
+ * Если включен режим memory-index, индексы всех частей данных загружаются в
+ * память при открытии канала и хранятся в массивах, по одному на каждую
+ * часть. Индексы новых записей добавляются в массив записывающим потоком при
+ * захваченной на запись блокировке lock. Поиск индексов при этом выполняется
+ * без обращения к файлам и кэшу индексов. Если дополнительно включен режим
+ * memory-index-prefetch, индексы загружаются отдельным потоком, а до
+ * завершения загрузки части её индексы считываются обычным образом.
+ *
+ * Поиск данных по метке времени выполняется интерполяционным методом: так
+ * как данные записываются с почти постоянной частотой, положение искомой
+ * записи оценивается по времени начала и конца интервала поиска. Если шаг
+ * интерполяции сократил интервал поиска менее чем вдвое, следующий шаг
+ * выполняется делением интервала пополам. Число поисков и прочитанных при
+ * этом индексов можно узнать функцией hyscan_db_channel_file_get_find_stats.
+ *
+ * Если библиотека собрана с поддержкой io_uring (HYSCAN_DB_IO_URING) и включен
+ * режим io-uring, индексы и данные записываются в файлы части одним обращением
+ * к ядру по явно заданным смещениям, а при пакетном чтении запросы на чтение
+ * всех групп записей передаются ядру одновременно. Каждый читающий поток
+ * использует собственную очередь io_uring, до MAX_IDLE_READ_URINGS
+ * неиспользуемых очередей хранятся для повторного использования. Если
+ * io_uring недоступен, используются обычные функции ввода/вывода. При ошибке
+ * io_uring во время чтения очередь освобождается, а данные считываются
+ * обычными функциями.
+ *
+ * Если задан размер preallocate-size, место в файлах записываемой части
+ * выделяется заранее (fallocate с флагом FALLOC_FL_KEEP_SIZE) крупными
+ * областями, что уменьшает фрагментацию файлов и число изменений метаданных
+ * файловой системы. Размер следующей области данных равен объёму, записываемому
+ * в часть за PREALLOCATE_TIME, но не менее PREALLOCATE_MIN_SIZE и не более
+ * preallocate-size, и не выходит за максимальный размер части. Область файла
+ * индексов пропорциональна области данных. Видимый размер файлов при этом не
+ * изменяется, а неиспользованное место освобождается по завершении записи
+ * в часть. Если файловая система не поддерживает предварительное выделение,
+ * оно отключается.
+ *
+ * Дескрипторы файлов завершённых частей открываются при первом обращении к
+ * ним. Если задано число max-open-parts, части с открытыми дескрипторами
+ * упорядочиваются по времени последнего обращения, и при превышении этого
+ * числа дескрипторы давно не использованных частей закрываются. Дескрипторы
+ * части, из которой в данный момент выполняется чтение, и части, в которую
+ * производится запись, не закрываются. Отображения файлов в память при
+ * закрытии дескрипторов сохраняются.
+ *
+ * Если задано число записей упреждающего чтения, функция
+ * hyscan_db_channel_file_get_channel_data отслеживает до READAHEAD_STREAMS
+ * потоков последовательного чтения записей, поэтому несколько читателей,
+ * последовательно читающих разные участки канала, не мешают друг другу.
+ * Когда запрашиваемая запись следует за предыдущей записью одного из потоков,
+ * данные этой и следующих за ней записей, но не более read-ahead записей и
+ * READAHEAD_MAX_SIZE байт, считываются одной операцией в новое окно
+ * упреждающего чтения, а ядру передаётся рекомендация заранее считать данные
+ * следующего окна. Окно заполняется без блокировки остальных читателей и
+ * затем заменяет предыдущее окно потока. Последующие записи окна копируются
+ * из него. Поток, к которому дольше всего не обращались, переназначается при
+ * непоследовательном обращении. Число обращений, обслуженных из окон, и
+ * остальных обращений можно узнать функцией hyscan_db_channel_file_get_readahead_stats.
+ *
+ * Если задан общий кэш, индексы, не найденные в памяти и в кэше индексов
+ * канала, считываются из файла страницами по INDEX_PAGE_RECORDS индексов и
+ * помещаются в общий кэш. Страница содержит только записанные в файл индексы,
+ * поэтому страница активной части может быть неполной и перечитывается при
+ * обращении к отсутствующему в ней индексу. Для частей с записями
+ * фиксированного размера в общий кэш помещаются заполненные блоки меток
+ * времени по FIXED_TIME_RECORDS записей. Данные записей, считываемых
+ * функцией hyscan_db_channel_file_get_channel_data, также помещаются в общий
+ * кэш. Пакетное и упреждающее чтение выполняется мимо кэша, чтобы
+ * последовательный просмотр канала не вытеснял из него часто используемые
+ * данные. Статистику обращений канала к общему кэшу можно узнать функцией
+ * hyscan_db_channel_file_get_cache_stats.
  */
 
+/* Функция fallocate объявлена только при _GNU_SOURCE. */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include "hyscan-db-channel-file.h"
+#include "hyscan-db-uring.h"
+#include "hyscan-db-cache.h"
+#include "hyscan-db-codec.h"
 
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <linux/falloc.h>
+#endif
+
+#ifdef G_OS_WIN32
+#include <windows.h>
+#include <io.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY               0
+#endif
+
+/* В Windows синхронизировать файл с диском можно только через дескриптор с
+   правами на запись, поэтому файлы новых частей открываются на чтение и запись. */
+#ifdef G_OS_WIN32
+#define NEW_PART_OPEN_FLAGS    (O_RDWR | O_BINARY)
+#else
+#define NEW_PART_OPEN_FLAGS    (O_RDONLY | O_BINARY)
+#endif
 
 #define INDEX_FILE_MAGIC       0x58495348              /* HSIX в виде строки. */
 #define DATA_FILE_MAGIC        0x54445348              /* HSDT в виде строки. */
 #define FILE_VERSION           0x31303731              /* 1701 в виде строки. */
+#define FILE_VERSION_COMPRESSED 0x32303731             /* 1702 в виде строки. */
+#define FILE_VERSION_PACKED    0x33303731              /* 1703 в виде строки. */
+#define FILE_VERSION_FIXED     0x34303731              /* 1704 в виде строки. */
+#define FILE_VERSION_COMPACT   0x35303731              /* 1705 в виде строки. */
+#define PACK_FILE_EXT          "pack"                  /* Расширение временного файла сжатия части. */
+#define SPARE_FILE_EXT         "spare"                 /* Расширение временных файлов заранее созданной части. */
+#define MANIFEST_FILE_MAGIC    0x464d5348              /* HSMF в виде строки. */
+#define MANIFEST_VERSION       0x37303731              /* 1707 в виде строки. */
+#define MANIFEST_FILE_EXT      "manifest"              /* Расширение файла описания частей канала. */
 
 #define MAX_PARTS              999999                  /* Максимальное число частей данных. */
-#define CACHED_INDEXES         2048                    /* Число кэшированных индексов. */
+#define CACHED_INDEXES         2048                    /* Число кэшированных индексов по умолчанию. */
+#define MAX_CACHED_INDEXES     16*1024*1024            /* Максимальное число кэшированных индексов. */
 
 #define INDEX_FILE_HEADER_SIZE (sizeof (HyScanDBChannelFileID) + sizeof (guint32)) /* Размер заголовка файла индексов. */
 #define DATA_FILE_HEADER_SIZE  (sizeof (HyScanDBChannelFileID))                    /* Размер заголовка файла данных. */
 #define FILE_HEADER_SIZE       (sizeof (HyScanDBChannelFileID))                    /* Размер общего заголовка файлов. */
 #define INDEX_RECORD_SIZE      (sizeof (HyScanDBChannelFileIndexRec))              /* Размер индекса. */
+#define FIXED_INDEX_HEADER_SIZE (INDEX_FILE_HEADER_SIZE + sizeof (guint32))        /* Размер заголовка файла индексов части с записями фиксированного размера. */
+#define FIXED_TIME_BLOCK_SIZE  (sizeof (gint64) + FIXED_TIME_RECORDS * sizeof (guint32)) /* Размер блока меток времени. */
+#define BLOCK_RECORD_SIZE      (sizeof (HyScanDBChannelFileBlockRec))              /* Размер записи таблицы блоков. */
+#define PACK_TAIL_SIZE         (sizeof (HyScanDBChannelFilePackTail))              /* Размер окончания сжатого файла данных. */
+#define MANIFEST_HEADER_SIZE   (sizeof (HyScanDBChannelFileID) + 2 * sizeof (guint32)) /* Размер заголовка файла описания частей. */
+#define MANIFEST_RECORD_SIZE   (sizeof (HyScanDBChannelFileManifestRec))           /* Размер описания части. */
+#define MANIFEST_CHECKSUM_SIZE 16                                                  /* Размер контрольной суммы MD5. */
+#define MANIFEST_TAIL_SIZE     64                                                  /* Размер начала и окончания файла данных в контрольной сумме части. */
+#define MANIFEST_READ_SIZE     64*1024                                             /* Размер блока чтения файла индексов при вычислении контрольной суммы части. */
+#define COMPACT_BLOCK_HEADER_SIZE (sizeof (gint64) + sizeof (guint64))             /* Размер заголовка блока компактных индексов. */
+#define COMPACT_BLOCK_MAX_SIZE (COMPACT_BLOCK_HEADER_SIZE + COMPACT_BLOCK_RECORDS * COMPACT_RECORD_MAX_SIZE) /* Максимальный размер блока компактных индексов. */
 
 #define MIN_DATA_FILE_SIZE     1*1024*1024             /* Минимально возможный размер файла части данных. */
 #define MAX_DATA_FILE_SIZE     1024*1024*1024*1024LL   /* Максимально возможный размер файла части данных. */
 #define DEFAULT_DATA_FILE_SIZE 1024*1024*1024          /* Размер файла части данных по умолчанию. */
+#define MIN_INDEX_MAP_SIZE     1024*1024               /* Минимальный размер отображения файла индексов активной части. */
+#define DEFAULT_WRITE_BUFFER_TIME 100000               /* Время нахождения данных в буфере отложенной записи по умолчанию. */
+#define SYNC_INTERVAL          1000000                 /* Интервал синхронизации файлов с диском в режиме SYNC. */
+#define URING_DEPTH            64                      /* Размер очереди операций io_uring. */
+#define MAX_IDLE_READ_URINGS   4                       /* Максимальное число неиспользуемых очередей операций чтения io_uring. */
+#define MAX_READAHEAD          65536                   /* Максимальное число записей упреждающего чтения. */
+#define READAHEAD_MAX_SIZE     16*1024*1024            /* Максимальный объём данных упреждающего чтения. */
+#define READAHEAD_STREAMS      4                       /* Число отслеживаемых потоков последовательного чтения. */
+#define INDEX_PAGE_RECORDS     64                      /* Число индексов в странице общего кэша. */
+#define INDEX_COMPRESSION_SHIFT 28                     /* Сдвиг алгоритма сжатия в поле pad индекса. */
+#define INDEX_STORED_SIZE_MASK 0x0fffffff              /* Маска размера сжатых данных в поле pad индекса. */
+#define PACK_BLOCK_SIZE        256*1024                /* Минимальный размер блока сжатой части. */
+#define PACK_INDEX_RECORDS     4096                    /* Число индексов, считываемых за раз при сжатии части. */
+#define PACK_THREAD_NICE       19                      /* Приоритет потока сжатия частей. */
+#define FIXED_TIME_RECORDS     64                      /* Число меток времени в блоке части с записями фиксированного размера. */
+#define MAX_FIXED_RECORD_SIZE  65536                   /* Максимальный фиксированный размер записи. */
+#define COMPACT_BLOCK_RECORDS  64                      /* Число индексов в блоке компактного файла индексов. */
+#define COMPACT_RECORD_MAX_SIZE 20                     /* Максимальный размер индекса в компактном формате. */
+#define PREALLOCATE_TIME       1000000                 /* Интервал записи, на который выделяется место в файле данных. */
+#define PREALLOCATE_MIN_SIZE   256*1024                /* Минимальный размер области выделения места в файле данных. */
+#define PREALLOCATE_MIN_INDEX_SIZE 16*1024             /* Минимальный размер области выделения места в файле индексов. */
 
 enum
 {
   PROP_O,
   PROP_PATH,
   PROP_NAME,
-  PROP_READONLY
+  PROP_READONLY,
+  PROP_MMAP_INDEX,
+  PROP_WRITE_BUFFER_SIZE,
+  PROP_WRITE_BUFFER_TIME,
+  PROP_INDEX_CACHE_SIZE,
+  PROP_MEMORY_INDEX,
+  PROP_MEMORY_INDEX_PREFETCH,
+  PROP_IO_URING,
+  PROP_READ_AHEAD,
+  PROP_CACHE,
+  PROP_PACK_COMPRESSION,
+  PROP_PREALLOCATE_SIZE,
+  PROP_MAX_OPEN_PARTS
 };
 
 /* Заголовок файлов данных и индексов. */
@@ -129,13 +457,66 @@ typedef struct
   gint64               ctime;                  /* Дата создания. */
 } HyScanDBChannelFileID;
 
+/* Запись таблицы блоков сжатого файла данных. */
+typedef struct
+{
+  guint64                      raw_offset;             /* Смещение блока в исходном файле данных. */
+  guint64                      offset;                 /* Смещение блока в сжатом файле данных. */
+  guint32                      raw_size;               /* Исходный размер блока. */
+  guint32                      size;                   /* Размер блока в сжатом файле. */
+} HyScanDBChannelFileBlockRec;
+
+/* Описание части в файле описания частей канала. */
+typedef struct
+{
+  guint32                      number;                 /* Номер части в именах файлов. */
+  guint32                      version;                /* Версия файла индексов. */
+  guint32                      data_version;           /* Версия файла данных. */
+  guint32                      record_size;            /* Фиксированный размер записей. */
+  guint32                      begin_index;            /* Начальный индекс части. */
+  guint32                      end_index;              /* Конечный индекс части. */
+  gint64                       begin_time;             /* Время первой записи части. */
+  gint64                       end_time;               /* Время последней записи части. */
+  gint64                       ctime;                  /* Дата создания части. */
+  guint64                      index_size;             /* Размер файла индексов. */
+  guint64                      data_size;              /* Размер файла данных. */
+  guint32                      n_compact_blocks;       /* Число блоков компактных индексов. */
+  guint32                      reserved;               /* Зарезервировано. */
+  guint8                       digest[MANIFEST_CHECKSUM_SIZE]; /* Контрольная сумма файлов части. */
+} HyScanDBChannelFileManifestRec;
+
+/* Описание части, считанное из файла описания частей канала. */
+typedef struct
+{
+  HyScanDBChannelFileManifestRec rec;                  /* Описание части. */
+  GArray                      *compact_blocks;         /* Смещения блоков компактных индексов. */
+} HyScanDBChannelFileManifestPart;
+
+/* Окончание сжатого файла данных. */
+typedef struct
+{
+  guint64                      raw_size;               /* Размер исходного файла данных. */
+  guint32                      n_blocks;               /* Число блоков. */
+  guint32                      compression;            /* Алгоритм сжатия блоков. */
+} HyScanDBChannelFilePackTail;
+
 /* Информация о части списка данных. */
 typedef struct
 {
+  guint32                      version;                /* Версия формата файлов части. */
+  guint32                      number;                 /* Номер части в именах файлов. */
   guint64                      data_size;              /* Размер файла данных этой части. */
-
+  guint32                      record_size;            /* Фиксированный размер записей, 0 - размер записей не фиксирован. */
+  gint64                       base_time;              /* Базовое время последнего блока меток времени. */
+  guint64                      index_size;             /* Размер файла индексов с учётом буфера отложенной записи. */
+  GArray                      *compact_blocks;         /* Смещения блоков компактных индексов в файле индексов. */
+  guint64                      index_alloc_size;       /* Размер выделенного места в файле индексов. */
+  guint64                      data_alloc_size;        /* Размер выделенного места в файле данных. */
+
+  gint64                       ctime;                  /* Дата создания части из заголовка файла. */
   gint64                       create_time;            /* Время создания этой части данных. */
   gint64                       last_append_time;       /* Время последней записи данных в эту часть. */
+  gboolean                     spare_requested;        /* Запрошено заранее создание следующей части. */
 
   guint32                      begin_index;            /* Начальный индекс данных в этой части. */
   guint32                      end_index;              /* Конечный индекс данных в этой части. */
@@ -144,12 +525,33 @@ typedef struct
   gint64                       end_time;               /* Конечное время данных в этой части. */
 
   GFile                       *fdi;                    /* Объект работы с файлом индексов. */
-  GInputStream                *ifdi;                   /* Поток чтения файла индексов. */
+  gint                         ifdi;                   /* Дескриптор чтения файла индексов. */
   GOutputStream               *ofdi;                   /* Поток записи файла индексов. */
+  guint8                      *index_map;              /* Отображение файла индексов в память. */
+  gsize                        index_map_size;         /* Размер отображения файла индексов. */
 
   GFile                       *fdd;                    /* Объект работы с файлом данных. */
-  GInputStream                *ifdd;                   /* Поток чтения файла данных. */
+  gint                         ifdd;                   /* Дескриптор чтения файла данных. */
   GOutputStream               *ofdd;                   /* Поток записи файла данных. */
+  GMappedFile                 *data_map;               /* Отображение файла данных в память. */
+
+  GArray                      *index_array;            /* Загруженные в память индексы части. */
+
+  gboolean                     packed;                 /* Файл данных части сжат. */
+  HyScanDBChannelFileBlockRec *blocks;                 /* Таблица блоков сжатой части. */
+  guint                        n_blocks;               /* Число блоков сжатой части. */
+  HyScanDBCompression          pack_compression;       /* Алгоритм сжатия блоков. */
+  GBytes                      *block_data;             /* Последний распакованный блок. */
+  guint                        block_index;            /* Номер последнего распакованного блока. */
+
+  gboolean                     fd_lazy;                /* Дескрипторы открываются при обращении к части. */
+  gint                         fd_open;                /* Признак открытых дескрипторов. */
+  guint                        fd_users;               /* Число обращений, использующих дескрипторы. */
+  GList                        fd_link;                /* Элемент списка частей с открытыми дескрипторами. */
+
+  guint8                       digest[MANIFEST_CHECKSUM_SIZE]; /* Контрольная сумма файлов части. */
+  gboolean                     digest_valid;           /* Контрольная сумма файлов части вычислена. */
+  gboolean                     digest_check;           /* Проверить контрольную сумму при открытии файлов. */
 } HyScanDBChannelFilePart;
 
 /* Структура индексной записи в файле. */
@@ -158,25 +560,49 @@ typedef struct
   gint64                       time;                   /* Время приёма данных, в микросекундах. */
   guint64                      offset;                 /* Смещение до начала данных. */
   guint32                      size;                   /* Размер данных. */
-  guint32                      pad;                    /* Выравнивание. */
+  guint32                      pad;                    /* Алгоритм сжатия и размер сжатых данных. */
 } HyScanDBChannelFileIndexRec;
 
 /* Информация о записи. */
-typedef struct _HyScanDBChannelFileIndex HyScanDBChannelFileIndex;
-struct _HyScanDBChannelFileIndex
+typedef struct
 {
   HyScanDBChannelFilePart     *part;                   /* Номер части с данными. */
   guint32                      index;                  /* Значение индекса. */
 
   gint64                       time;                   /* Время приёма данных, в микросекундах. */
   guint64                      offset;                 /* Смещение до начала данных. */
-  guint32                      size;                   /* Размер данных. */
+  guint32                      size;                   /* Размер данных в файле. */
+  guint32                      data_size;              /* Исходный размер данных. */
+  HyScanDBCompression          compression;            /* Алгоритм сжатия данных. */
+} HyScanDBChannelFileIndex;
 
-                                                       /* Структуры индексов связаны между собой
-                                                          не в порядке их номеров.*/
-  HyScanDBChannelFileIndex    *prev;                   /* Указатель на предыдущий индекс. */
-  HyScanDBChannelFileIndex    *next;                   /* Указатель на следующий индекс.*/
-};
+/* Окно упреждающего чтения. После заполнения окно не изменяется, читающие
+   потоки копируют из него данные, удерживая ссылку на окно. */
+typedef struct
+{
+  gint                         ref_count;              /* Число ссылок на окно. */
+  guint32                      first;                  /* Индекс первой записи окна. */
+  guint32                      n_indexes;              /* Число записей окна. */
+  HyScanDBChannelFileIndex    *indexes;                /* Индексы записей, смещения относительно начала данных окна. */
+  guint8                      *data;                   /* Данные записей. */
+} HyScanDBChannelFileWindow;
+
+/* Поток последовательного чтения. */
+typedef struct
+{
+  guint32                      next;                   /* Индекс записи, следующей за последней считанной. */
+  guint64                      used;                   /* Время последнего обращения к потоку. */
+  gboolean                     filling;                /* Окно потока заполняется. */
+  HyScanDBChannelFileWindow   *window;                 /* Окно упреждающего чтения. */
+} HyScanDBChannelFileStream;
+
+/* Поток обслуживания частей, общий для всех каналов. */
+typedef struct
+{
+  GMutex                       lock;                   /* Блокировка очереди каналов. */
+  GCond                        cond;                   /* Сигнал изменения очереди каналов. */
+  GQueue                       channels;               /* Каналы с невыполненными заданиями. */
+} HyScanDBChannelFileMaint;
 
 /* Внутренние данные объекта. */
 struct _HyScanDBChannelFilePrivate
@@ -190,6 +616,10 @@ struct _HyScanDBChannelFilePrivate
   gint64                       save_time;              /* Интервал времени для которого хранятся записываемые данные. */
 
   gboolean                     readonly;               /* Создавать или нет файлы при открытии канала. */
+  gboolean                     mmap_index;             /* Отображать файлы индексов в память. */
+  gboolean                     memory_index;           /* Загружать все индексы в память. */
+  gboolean                     memory_index_prefetch;  /* Загружать индексы в память фоновым потоком. */
+  gboolean                     io_uring;               /* Использовать io_uring. */
   gboolean                     fail;                   /* Признак ошибки в объекте. */
 
   guint64                      data_size;              /* Текущий объём хранимых данных. */
@@ -203,11 +633,87 @@ struct _HyScanDBChannelFilePrivate
   HyScanDBChannelFilePart    **parts;                  /* Массив указателей на структуры с описанием части данных. */
   guint                        n_parts;                /* Число частей данных. */
 
-  GHashTable                  *cached_indexes;         /* Таблица кэшированных индексов. */
-  HyScanDBChannelFileIndex    *first_cached_index;     /* Первый индекс (недавно использовался). */
-  HyScanDBChannelFileIndex    *last_cached_index;      /* Последний индекс (давно использовался). */
-
-  GMutex                       lock;                   /* Блокировка многопоточного доступа. */
+  HyScanDBChannelFileIndex    *cache;                  /* Кэш индексов. */
+  guint                        cache_size;             /* Число ячеек кэша индексов. */
+  GMutex                       cache_lock;             /* Блокировка доступа к кэшу индексов. */
+
+  guint                        write_buffer_size;      /* Размер буфера отложенной записи. */
+  gint64                       write_buffer_time;      /* Максимальное время нахождения данных в буфере. */
+  GByteArray                  *index_buffer;           /* Буфер отложенной записи индексов. */
+  GByteArray                  *data_buffer;            /* Буфер отложенной записи данных. */
+  gint64                       buffer_time;            /* Время помещения в буфер первой записи. */
+
+  GThread                     *flush_thread;           /* Поток записи буфера по времени. */
+  GCond                        flush_cond;             /* Сигнал потоку записи буфера. */
+  gboolean                     flush_shutdown;         /* Признак завершения потока записи буфера. */
+
+  HyScanDBDurability           durability;             /* Режим сохранности данных. */
+  GThread                     *sync_thread;            /* Поток синхронизации файлов с диском. */
+  GMutex                       sync_lock;              /* Блокировка состояния синхронизации. */
+  GCond                        sync_cond;              /* Сигнал изменения состояния синхронизации. */
+  guint64                      sync_request;           /* Номер последней записи, ожидающей синхронизации. */
+  guint64                      sync_done;              /* Номер последней синхронизированной записи. */
+  gint64                       sync_time;              /* Время последней синхронизации. */
+  gboolean                     sync_shutdown;          /* Признак завершения потока синхронизации. */
+
+  GThread                     *prefetch_thread;        /* Поток загрузки индексов в память. */
+  gint                         prefetch_shutdown;      /* Признак завершения потока загрузки индексов. */
+
+  volatile gsize               find_count;             /* Число поисков данных по метке времени. */
+  volatile gsize               find_probes;            /* Число индексов, прочитанных при поиске данных. */
+
+  HyScanDBUring               *write_uring;            /* Очередь операций записи io_uring. */
+  gboolean                     read_uring;             /* Использовать io_uring для пакетного чтения. */
+  GQueue                       read_urings;            /* Неиспользуемые очереди операций чтения io_uring. */
+  GMutex                       read_uring_lock;        /* Блокировка списка очередей операций чтения. */
+
+  guint                        readahead_size;         /* Число записей упреждающего чтения. */
+  GMutex                       readahead_lock;         /* Блокировка потоков последовательного чтения. */
+  HyScanDBChannelFileStream    readahead_streams[READAHEAD_STREAMS]; /* Потоки последовательного чтения. */
+  guint64                      readahead_clock;        /* Счётчик обращений к потокам. */
+  guint64                      readahead_hits;         /* Число обращений, обслуженных из окон. */
+  guint64                      readahead_misses;       /* Число обращений, не обслуженных из окон. */
+
+  HyScanDBCache               *shared_cache;           /* Общий кэш блоков данных и индексов. */
+  guint64                      cache_owner;            /* Идентификатор канала в общем кэше. */
+
+  HyScanDBCodec               *codec;                  /* Объект сжатия данных. */
+  GByteArray                  *compress_buffer;        /* Буфер сжатых данных записей. */
+  guint64                      compress_in;            /* Объём данных до сжатия. */
+  guint64                      compress_out;           /* Объём данных после сжатия. */
+  guint32                      record_size;            /* Фиксированный размер записываемых записей. */
+
+  HyScanDBCompression          pack_compression;       /* Алгоритм фонового сжатия частей. */
+  GThread                     *pack_thread;            /* Поток сжатия завершённых частей. */
+  GMutex                       pack_lock;              /* Блокировка очереди сжатия. */
+  GCond                        pack_cond;              /* Сигнал потоку сжатия. */
+  GQueue                       pack_queue;             /* Начальные индексы частей, ожидающих сжатия. */
+  gint                         pack_shutdown;          /* Признак завершения потока сжатия. */
+  guint64                      pack_in;                /* Объём сжатых частей до сжатия. */
+  guint64                      pack_out;               /* Объём сжатых частей после сжатия. */
+  guint64                      n_packed;               /* Число сжатых частей. */
+  GMutex                       block_lock;             /* Блокировка распакованных блоков частей. */
+
+  guint64                      preallocate_size;       /* Максимальный размер области выделения места в файлах. */
+
+  guint                        max_open_parts;         /* Максимальное число частей с открытыми дескрипторами. */
+  GMutex                       fd_lock;                /* Блокировка открытия и закрытия дескрипторов частей. */
+  GQueue                       fd_lru;                 /* Части с открытыми дескрипторами, недавно использованные в начале. */
+
+  gboolean                     maint;                  /* Канал обслуживается потоком обслуживания. */
+  gboolean                     maint_queued;           /* Канал находится в очереди потока обслуживания. */
+  gboolean                     maint_busy;             /* Поток обслуживания выполняет задание канала. */
+  GMutex                       maint_lock;             /* Блокировка заданий потока обслуживания. */
+  GQueue                       remove_queue;           /* Части, файлы которых требуется удалить. */
+  HyScanDBChannelFilePart     *spare_part;             /* Заранее созданная следующая часть. */
+  gint64                       spare_number;           /* Номер части, которую требуется создать, -1 - нет запроса. */
+  gboolean                     spare_pending;          /* Признак создания следующей части. */
+  gboolean                     spare_stale;            /* Создаваемая следующая часть больше не нужна. */
+  gboolean                     manifest_request;       /* Запрос записи файла описания частей. */
+  gboolean                     manifest_final;         /* Запись в канал завершена, описывается и последняя часть. */
+
+  GRWLock                      lock;                   /* Блокировка доступа к информации о частях данных. */
+  GMutex                       write_lock;             /* Блокировка записи данных. */
 };
 
 static void                      hyscan_db_channel_file_set_property        (GObject                     *object,
@@ -217,10 +723,273 @@ static void                      hyscan_db_channel_file_set_property        (GOb
 static void                      hyscan_db_channel_file_object_constructed  (GObject                     *object);
 static void                      hyscan_db_channel_file_object_finalize     (GObject                     *object);
 
-static gboolean                  hyscan_db_channel_file_add_part            (HyScanDBChannelFilePrivate  *priv);
+static gboolean                  hyscan_db_channel_file_pread               (gint                         fd,
+                                                                             gpointer                     buffer,
+                                                                             gsize                        size,
+                                                                             guint64                      offset);
+static void                      hyscan_db_channel_file_index_from_le       (HyScanDBChannelFileIndexRec *rec_indexes,
+                                                                             guint32                      n_indexes);
+static guint32                   hyscan_db_channel_file_stored_size         (guint32                      version,
+                                                                             HyScanDBChannelFileIndexRec *rec_index);
+static void                      hyscan_db_channel_file_put_varint          (GByteArray                  *buffer,
+                                                                             guint64                      value);
+static gsize                     hyscan_db_channel_file_get_varint          (const guint8                *data,
+                                                                             gsize                        size,
+                                                                             guint64                     *value);
+static gboolean                  hyscan_db_channel_file_decode_block        (const guint8                *data,
+                                                                             gsize                        size,
+                                                                             HyScanDBChannelFileIndexRec *rec_indexes,
+                                                                             guint32                     *n_indexes,
+                                                                             gsize                       *block_size);
+static gboolean                  hyscan_db_channel_file_read_compact_block  (gint                         ifdi,
+                                                                             guint64                      position,
+                                                                             guint64                      index_file_size,
+                                                                             HyScanDBChannelFileIndexRec *rec_indexes,
+                                                                             guint32                     *n_indexes,
+                                                                             gsize                       *block_size);
+static GArray                   *hyscan_db_channel_file_open_compact_part   (gint                         ifdi,
+                                                                             guint64                      index_file_size,
+                                                                             guint64                     *n_records,
+                                                                             HyScanDBChannelFileIndexRec *first_index,
+                                                                             HyScanDBChannelFileIndexRec *last_index);
+static gboolean                  hyscan_db_channel_file_fixed_n_records     (guint64                      index_file_size,
+                                                                             guint64                     *n_records);
+static gboolean                  hyscan_db_channel_file_read_fixed_time     (gint                         ifdi,
+                                                                             guint64                      position,
+                                                                             gint64                      *time);
+static gboolean                  hyscan_db_channel_file_open_fixed_part     (gint                         ifdi,
+                                                                             guint64                      n_records,
+                                                                             guint32                     *record_size,
+                                                                             gint64                      *begin_time,
+                                                                             gint64                      *end_time);
+static void                      hyscan_db_channel_file_free_part           (HyScanDBChannelFilePart     *fpart);
+
+static gboolean                  hyscan_db_channel_file_map_index           (HyScanDBChannelFilePart     *fpart,
+                                                                             gsize                        size);
+static void                      hyscan_db_channel_file_unmap_index         (HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_update_index_map    (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             gboolean                     sealed);
+static GMappedFile              *hyscan_db_channel_file_map_data            (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_close_part_fds      (HyScanDBChannelFilePart     *fpart);
+static gboolean                  hyscan_db_channel_file_part_digest         (gint                         ifdi,
+                                                                             gint                         ifdd,
+                                                                             guint64                      index_size,
+                                                                             guint64                      data_size,
+                                                                             guint8                      *digest);
+static gboolean                  hyscan_db_channel_file_open_part_fds       (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_evict_parts         (HyScanDBChannelFilePrivate  *priv);
+static void                      hyscan_db_channel_file_seal_part_fds       (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             gboolean                     keep_open);
+static gboolean                  hyscan_db_channel_file_acquire_part        (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_release_part        (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static gboolean                  hyscan_db_channel_file_pread_index         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             gpointer                     data,
+                                                                             gsize                        size,
+                                                                             guint64                      offset);
+static gboolean                  hyscan_db_channel_file_pread_data          (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             gpointer                     data,
+                                                                             gsize                        size,
+                                                                             guint64                      offset);
+
+static GArray                   *hyscan_db_channel_file_load_index          (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static gpointer                  hyscan_db_channel_file_prefetch_thread     (gpointer                     data);
+static void                      hyscan_db_channel_file_stop_prefetch_thread (HyScanDBChannelFilePrivate *priv);
+
+static gboolean                  hyscan_db_channel_file_write_part          (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             gconstpointer                index_data,
+                                                                             gsize                        index_size,
+                                                                             guint64                      index_offset,
+                                                                             gconstpointer                data,
+                                                                             gsize                        data_size,
+                                                                             guint64                      data_offset);
+static gboolean                  hyscan_db_channel_file_flush_buffers       (HyScanDBChannelFilePrivate  *priv);
+static gpointer                  hyscan_db_channel_file_flush_thread        (gpointer                     data);
+static void                      hyscan_db_channel_file_stop_flush_thread   (HyScanDBChannelFilePrivate  *priv);
+
+static gboolean                  hyscan_db_channel_file_sync_part           (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static gpointer                  hyscan_db_channel_file_sync_thread         (gpointer                     data);
+static void                      hyscan_db_channel_file_stop_sync_thread    (HyScanDBChannelFilePrivate  *priv);
+
+static HyScanDBChannelFilePart  *hyscan_db_channel_file_create_part_files   (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      number,
+                                                                             gboolean                     spare);
+static void                      hyscan_db_channel_file_delete_part         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static gboolean                  hyscan_db_channel_file_init_part           (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint32                      begin_index);
+static HyScanDBChannelFilePart  *hyscan_db_channel_file_create_part         (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      begin_index);
+static void                      hyscan_db_channel_file_add_part            (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
 static gboolean                  hyscan_db_channel_file_remove_old_part     (HyScanDBChannelFilePrivate  *priv);
-static HyScanDBChannelFileIndex *hyscan_db_channel_file_read_index          (HyScanDBChannelFilePrivate  *priv,
+static HyScanDBChannelFileMaint *hyscan_db_channel_file_get_maint          (void);
+static gpointer                  hyscan_db_channel_file_maint_thread        (gpointer                     data);
+static gboolean                  hyscan_db_channel_file_maint_run           (HyScanDBChannelFilePrivate  *priv);
+static void                      hyscan_db_channel_file_maint_schedule      (HyScanDBChannelFilePrivate  *priv);
+static void                      hyscan_db_channel_file_preallocate         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint64                      index_end,
+                                                                             guint64                      data_end);
+static void                      hyscan_db_channel_file_trim_part           (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_queue_remove        (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static HyScanDBChannelFilePart  *hyscan_db_channel_file_take_spare          (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      number);
+static void                      hyscan_db_channel_file_request_spare       (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static gboolean                  hyscan_db_channel_file_rename_spare        (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_stop_maint          (HyScanDBChannelFilePrivate  *priv);
+static gboolean                  hyscan_db_channel_file_remove_spare_files  (const gchar                 *path,
+                                                                             const gchar                 *name);
+static gchar                    *hyscan_db_channel_file_manifest_name       (HyScanDBChannelFilePrivate  *priv);
+static GArray                   *hyscan_db_channel_file_load_manifest       (HyScanDBChannelFilePrivate  *priv);
+static HyScanDBChannelFileManifestPart *
+                                 hyscan_db_channel_file_find_manifest_part  (GArray                      *manifest,
+                                                                             guint                       *position,
+                                                                             guint32                      number);
+static void                      hyscan_db_channel_file_append_part         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_open_manifest_parts (HyScanDBChannelFilePrivate  *priv,
+                                                                             GArray                      *manifest,
+                                                                             guint32                      first_part);
+static void                      hyscan_db_channel_file_save_manifest       (HyScanDBChannelFilePrivate  *priv,
+                                                                             gboolean                     final);
+static void                      hyscan_db_channel_file_request_manifest    (HyScanDBChannelFilePrivate  *priv,
+                                                                             gboolean                     final);
+static HyScanDBChannelFilePart  *hyscan_db_channel_file_find_part           (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      index);
+static guint                     hyscan_db_channel_file_find_part_by_time   (HyScanDBChannelFilePrivate  *priv,
+                                                                             gint64                       time);
+static void                      hyscan_db_channel_file_cache_index         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFileIndex    *db_index);
+static void                      hyscan_db_channel_file_set_index           (HyScanDBChannelFilePart     *fpart,
+                                                                             guint32                      index,
+                                                                             HyScanDBChannelFileIndexRec *rec_index,
+                                                                             HyScanDBChannelFileIndex    *db_index);
+static gboolean                  hyscan_db_channel_file_read_index_page     (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint32                      index,
+                                                                             HyScanDBChannelFileIndexRec *rec_index);
+static gboolean                  hyscan_db_channel_file_read_index_data     (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             gpointer                     data,
+                                                                             gsize                        size,
+                                                                             guint64                      offset);
+static gboolean                  hyscan_db_channel_file_lookup_index        (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint32                      index,
+                                                                             HyScanDBChannelFileIndex    *db_index);
+static gboolean                  hyscan_db_channel_file_read_fixed_block    (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint32                      index,
+                                                                             gint64                      *base_time,
+                                                                             guint32                     *delta_time);
+static gboolean                  hyscan_db_channel_file_read_fixed_index    (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint32                      index,
+                                                                             HyScanDBChannelFileIndex    *db_index);
+static gboolean                  hyscan_db_channel_file_read_compact_index  (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint32                      index,
+                                                                             HyScanDBChannelFileIndex    *db_index);
+static gboolean                  hyscan_db_channel_file_read_index          (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      index,
+                                                                             HyScanDBChannelFileIndex    *db_index);
+static void                      hyscan_db_channel_file_compress_records    (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      n_records,
+                                                                             gconstpointer                data,
+                                                                             const guint32               *sizes,
+                                                                             guint32                     *stored_sizes,
+                                                                             guint32                     *pads);
+static gboolean                  hyscan_db_channel_file_add_records         (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      n_records,
+                                                                             const gint64                *times,
+                                                                             gconstpointer                data,
+                                                                             const guint32               *sizes,
+                                                                             guint32                     *first_index);
+static gboolean                  hyscan_db_channel_file_read_data           (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFileIndex    *db_index,
+                                                                             gpointer                     data,
+                                                                             HyScanDBUring               *uring);
+static gboolean                  hyscan_db_channel_file_unpack_data         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFileIndex    *db_index,
+                                                                             gconstpointer                stored_data,
+                                                                             gpointer                     data);
+static gboolean                  hyscan_db_channel_file_read_record         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFileIndex    *db_index,
+                                                                             gpointer                     data);
+static HyScanDBUring            *hyscan_db_channel_file_take_read_uring     (HyScanDBChannelFilePrivate  *priv);
+static void                      hyscan_db_channel_file_return_read_uring   (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBUring               *uring);
+static void                      hyscan_db_channel_file_release_pinned      (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFileIndex    *db_indexes,
+                                                                             guint32                      n_pinned);
+static gboolean                  hyscan_db_channel_file_read_records        (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFileIndex    *db_indexes,
+                                                                             guint32                      n_indexes,
+                                                                             guint8                      *data);
+static gboolean                  hyscan_db_channel_file_read_cached_data    (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFileIndex    *db_index,
+                                                                             gpointer                     data);
+static gboolean                  hyscan_db_channel_file_write_fd            (gint                         fd,
+                                                                             gconstpointer                buffer,
+                                                                             gsize                        size);
+static HyScanDBChannelFileBlockRec *hyscan_db_channel_file_load_blocks      (gint                         fd,
+                                                                             guint64                      file_size,
+                                                                             guint                       *n_blocks,
+                                                                             guint64                     *raw_size,
+                                                                             HyScanDBCompression         *compression);
+static void                      hyscan_db_channel_file_transpose           (const guint8                *input,
+                                                                             guint8                      *output,
+                                                                             gsize                        size,
+                                                                             guint32                      record_size,
+                                                                             gboolean                     inverse);
+static GBytes                   *hyscan_db_channel_file_get_block           (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             guint                        n_block);
+static gboolean                  hyscan_db_channel_file_read_packed         (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart,
+                                                                             gpointer                     data,
+                                                                             guint32                      size,
+                                                                             guint64                      offset);
+static gboolean                  hyscan_db_channel_file_pack_block          (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBCodec               *codec,
+                                                                             gint                         ifdd,
+                                                                             gint                         ofdp,
+                                                                             GByteArray                  *raw_data,
+                                                                             GByteArray                  *packed_data,
+                                                                             GArray                      *blocks,
+                                                                             guint64                      raw_offset,
+                                                                             guint64                      raw_size,
+                                                                             guint32                      record_size);
+static gboolean                  hyscan_db_channel_file_pack_part           (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      begin_index);
+static gpointer                  hyscan_db_channel_file_pack_thread         (gpointer                     data);
+static void                      hyscan_db_channel_file_queue_pack          (HyScanDBChannelFilePrivate  *priv,
+                                                                             HyScanDBChannelFilePart     *fpart);
+static void                      hyscan_db_channel_file_stop_pack_thread    (HyScanDBChannelFilePrivate  *priv);
+
+static void                      hyscan_db_channel_file_window_unref        (HyScanDBChannelFileWindow   *window);
+static HyScanDBChannelFileWindow *hyscan_db_channel_file_fill_window        (HyScanDBChannelFilePrivate  *priv,
                                                                              guint32                      index);
+static gboolean                  hyscan_db_channel_file_readahead           (HyScanDBChannelFilePrivate  *priv,
+                                                                             guint32                      index,
+                                                                             HyScanBuffer                *buffer,
+                                                                             gint64                      *time);
 
 G_DEFINE_TYPE_WITH_PRIVATE (HyScanDBChannelFile, hyscan_db_channel_file, G_TYPE_OBJECT);
 
@@ -245,6 +1014,67 @@ hyscan_db_channel_file_class_init (HyScanDBChannelFileClass *klass)
   g_object_class_install_property (object_class, PROP_READONLY,
                                    g_param_spec_boolean ("readonly", "ReadOnly", "Read only mode", FALSE,
                                                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_MMAP_INDEX,
+                                   g_param_spec_boolean ("mmap-index", "MMapIndex", "Map index files into memory", FALSE,
+                                                         G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_WRITE_BUFFER_SIZE,
+                                   g_param_spec_uint ("write-buffer-size", "WriteBufferSize", "Write-behind buffer size",
+                                                      0, G_MAXINT32, 0,
+                                                      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_WRITE_BUFFER_TIME,
+                                   g_param_spec_int64 ("write-buffer-time", "WriteBufferTime", "Write-behind buffer time limit",
+                                                       0, G_MAXINT64, DEFAULT_WRITE_BUFFER_TIME,
+                                                       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_INDEX_CACHE_SIZE,
+                                   g_param_spec_uint ("index-cache-size", "IndexCacheSize", "Number of cached indexes",
+                                                      0, MAX_CACHED_INDEXES, CACHED_INDEXES,
+                                                      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_MEMORY_INDEX,
+                                   g_param_spec_boolean ("memory-index", "MemoryIndex", "Load all indexes into memory", FALSE,
+                                                         G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_MEMORY_INDEX_PREFETCH,
+                                   g_param_spec_boolean ("memory-index-prefetch", "MemoryIndexPrefetch",
+                                                         "Load indexes into memory in background", FALSE,
+                                                         G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_IO_URING,
+                                   g_param_spec_boolean ("io-uring", "IOURing", "Use io_uring for data I/O", FALSE,
+                                                         G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_READ_AHEAD,
+                                   g_param_spec_uint ("read-ahead", "ReadAhead", "Number of records read ahead",
+                                                      0, MAX_READAHEAD, 0,
+                                                      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_CACHE,
+                                   g_param_spec_object ("cache", "Cache", "Shared data and index cache",
+                                                        HYSCAN_TYPE_DB_CACHE,
+                                                        G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_PACK_COMPRESSION,
+                                   g_param_spec_uint ("pack-compression", "PackCompression",
+                                                      "Background compression of completed parts",
+                                                      HYSCAN_DB_COMPRESSION_NONE, HYSCAN_DB_COMPRESSION_LZ4,
+                                                      HYSCAN_DB_COMPRESSION_NONE,
+                                                      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_PREALLOCATE_SIZE,
+                                   g_param_spec_uint64 ("preallocate-size", "PreallocateSize",
+                                                        "Maximum size of preallocated file extents",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_MAX_OPEN_PARTS,
+                                   g_param_spec_uint ("max-open-parts", "MaxOpenParts",
+                                                      "Maximum number of parts with open file descriptors",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
@@ -276,6 +1106,54 @@ hyscan_db_channel_file_set_property (GObject      *object,
       priv->readonly = g_value_get_boolean (value);
       break;
 
+    case PROP_MMAP_INDEX:
+      priv->mmap_index = g_value_get_boolean (value);
+      break;
+
+    case PROP_WRITE_BUFFER_SIZE:
+      priv->write_buffer_size = g_value_get_uint (value);
+      break;
+
+    case PROP_WRITE_BUFFER_TIME:
+      priv->write_buffer_time = g_value_get_int64 (value);
+      break;
+
+    case PROP_INDEX_CACHE_SIZE:
+      priv->cache_size = g_value_get_uint (value);
+      break;
+
+    case PROP_MEMORY_INDEX:
+      priv->memory_index = g_value_get_boolean (value);
+      break;
+
+    case PROP_MEMORY_INDEX_PREFETCH:
+      priv->memory_index_prefetch = g_value_get_boolean (value);
+      break;
+
+    case PROP_IO_URING:
+      priv->io_uring = g_value_get_boolean (value);
+      break;
+
+    case PROP_READ_AHEAD:
+      priv->readahead_size = g_value_get_uint (value);
+      break;
+
+    case PROP_CACHE:
+      priv->shared_cache = g_value_dup_object (value);
+      break;
+
+    case PROP_PACK_COMPRESSION:
+      priv->pack_compression = g_value_get_uint (value);
+      break;
+
+    case PROP_PREALLOCATE_SIZE:
+      priv->preallocate_size = g_value_get_uint64 (value);
+      break;
+
+    case PROP_MAX_OPEN_PARTS:
+      priv->max_open_parts = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -287,8 +1165,10 @@ hyscan_db_channel_file_object_constructed (GObject *object)
 {
   HyScanDBChannelFile *channel = HYSCAN_DB_CHANNEL_FILE (object);
   HyScanDBChannelFilePrivate *priv = channel->priv;
-
-  gint i;
+  GArray *manifest;
+  guint manifest_pos = 0;
+  guint first_part;
+  guint i;
 
   /* Начальные значения. */
   priv->max_data_file_size = DEFAULT_DATA_FILE_SIZE;
@@ -304,112 +1184,139 @@ hyscan_db_channel_file_object_constructed (GObject *object)
   priv->parts = NULL;
   priv->n_parts = 0;
 
-  g_mutex_init (&priv->lock);
+  priv->index_buffer = g_byte_array_new ();
+  priv->data_buffer = g_byte_array_new ();
+  priv->compress_buffer = g_byte_array_new ();
+
+  g_rw_lock_init (&priv->lock);
+  g_mutex_init (&priv->write_lock);
+  g_mutex_init (&priv->cache_lock);
+  g_cond_init (&priv->flush_cond);
+  g_mutex_init (&priv->sync_lock);
+  g_cond_init (&priv->sync_cond);
+  g_mutex_init (&priv->read_uring_lock);
+  g_queue_init (&priv->read_urings);
+  g_mutex_init (&priv->readahead_lock);
+  g_mutex_init (&priv->pack_lock);
+  g_cond_init (&priv->pack_cond);
+  g_queue_init (&priv->pack_queue);
+  g_mutex_init (&priv->block_lock);
+  g_mutex_init (&priv->fd_lock);
+  g_queue_init (&priv->fd_lru);
+  g_mutex_init (&priv->maint_lock);
+  g_queue_init (&priv->remove_queue);
+  priv->spare_number = -1;
+
+  /* Регистрируем канал в общем кэше. */
+  if (priv->shared_cache != NULL)
+    priv->cache_owner = hyscan_db_cache_add_owner (priv->shared_cache);
+
+  /* Потоки последовательного чтения. */
+  for (i = 0; i < READAHEAD_STREAMS; i++)
+    priv->readahead_streams[i].next = G_MAXUINT32;
 
   /* Кэш индексов.
-     Кэш организован в виде hash таблицы, где номер индекса используется как ключ поиска.
-     Всего возможно кэширование CACHED_INDEXES индексов. Информация об индексе хранится в
-     структурах HyScanDBChannelFileIndex. Эти структуры связаны друг с другом в цепочку.
-     При каждом доступе к индексу происходит поиск в hash таблице и если элемент находится
-     в ней он переносится в начало цепочки. Если поиск в таблице не дал результата происходит
-     чтение индекса с диска, запись в последний элемент цепочки и перенос этого элемента в
-     начало цепочки. */
-  {
-    HyScanDBChannelFileIndex *prev_index = NULL;
-
-    priv->cached_indexes = g_hash_table_new (g_direct_hash, g_direct_equal);
-    for (i = 0; i < CACHED_INDEXES; i++)
-      {
-        HyScanDBChannelFileIndex *db_index = g_slice_new (HyScanDBChannelFileIndex);
-
-        db_index->part = NULL;
-        db_index->index = 0xffffffff;
-        db_index->offset = 0;
-        db_index->time = 0;
-        db_index->size = 0;
-        db_index->prev = NULL;
-        db_index->next = NULL;
-
-        if (prev_index != NULL)
-          {
-            prev_index->next = db_index;
-            db_index->prev = prev_index;
-          }
-
-        if (i == 0)
-          priv->first_cached_index = db_index;
-        if (i == CACHED_INDEXES - 1)
-          priv->last_cached_index = db_index;
-
-        prev_index = db_index;
-      }
-  }
+     Кэш организован в виде массива с прямым отображением: индекс с номером N
+     может находиться только в ячейке N & (cache_size - 1), поэтому поиск и
+     замена индекса в кэше сводятся к обращению к одной ячейке массива. Число
+     ячеек округляется вверх до степени двойки. Пустые ячейки не ссылаются
+     на часть данных. */
+  if (priv->cache_size > 0)
+    {
+      priv->cache_size = 1 << g_bit_storage (priv->cache_size - 1);
+      priv->cache = g_new0 (HyScanDBChannelFileIndex, priv->cache_size);
+    }
+
+  /* Номер первой части. Файлы частей не переименовываются после удаления
+     старых частей, поэтому нумерация может начинаться не с нуля. */
+  first_part = MAX (hyscan_db_channel_get_first_part (priv->path, priv->name), 0);
+
+  /* Описание частей, сохранённое при записи канала. Части, описанные в нём,
+     создаются без обращения к их файлам. */
+  manifest = hyscan_db_channel_file_load_manifest (priv);
+  if (manifest != NULL)
+    hyscan_db_channel_file_open_manifest_parts (priv, manifest, first_part);
 
   /* Проверяем существующие данные и открываем их на чтение в случае существования. */
-  while (TRUE)
+  while (priv->n_parts < MAX_PARTS)
     {
       HyScanDBChannelFilePart *fpart;
+      HyScanDBChannelFileManifestPart *mpart;
       HyScanDBChannelFileID id;
+      guint8 digest[MANIFEST_CHECKSUM_SIZE];
+      gboolean digest_valid = FALSE;
 
-      gchar *fname;
+      gchar *fname_i;
+      gchar *fname_d;
       GFileInfo *finfo = NULL;
 
       GFile *fdi = NULL;
-      GInputStream *ifdi = NULL;
+      gint ifdi = -1;
       guint64 index_file_size;
 
       GFile *fdd = NULL;
-      GInputStream *ifdd = NULL;
+      gint ifdd = -1;
       guint64 data_file_size;
 
-      guint64 begin_time;
-      guint64 end_time;
+      HyScanDBChannelFileBlockRec *blocks = NULL;
+      GArray *compact_blocks = NULL;
+      HyScanDBCompression pack_compression = HYSCAN_DB_COMPRESSION_NONE;
+      guint n_blocks = 0;
+      guint64 raw_size;
 
+      gint64 begin_time;
+      gint64 end_time;
+      gint64 ctime;
+
+      HyScanDBChannelFileIndexRec first_index;
       HyScanDBChannelFileIndexRec rec_index;
       guint32 begin_index;
       guint32 end_index;
+      guint32 stored_size;
+      guint32 record_size = 0;
+      guint64 n_records;
+      guint32 version;
 
       goffset offset;
-      gssize iosize;
 
       /* Файл индексов. */
-      fname = g_strdup_printf ("%s%s%s.%06d.i", priv->path, G_DIR_SEPARATOR_S, priv->name, priv->n_parts);
-      fdi = g_file_new_for_path (fname);
-      g_free (fname);
+      fname_i = g_strdup_printf ("%s%s%s.%06u.i", priv->path, G_DIR_SEPARATOR_S, priv->name, first_part + priv->n_parts);
+      fdi = g_file_new_for_path (fname_i);
 
       /* Файл данных. */
-      fname = g_strdup_printf ("%s%s%s.%06d.d", priv->path, G_DIR_SEPARATOR_S, priv->name, priv->n_parts);
-      fdd = g_file_new_for_path (fname);
-      g_free (fname);
+      fname_d = g_strdup_printf ("%s%s%s.%06u.d", priv->path, G_DIR_SEPARATOR_S, priv->name, first_part + priv->n_parts);
+      fdd = g_file_new_for_path (fname_d);
 
       /* Если файлов нет - завершаем проверку. */
       if (!g_file_query_exists (fdi, NULL) && !g_file_query_exists (fdd, NULL))
         {
           g_object_unref (fdi);
           g_object_unref (fdd);
+          g_free (fname_i);
+          g_free (fname_d);
           break;
         }
 
       priv->readonly = TRUE;
 
-      /* Поток чтения индексов. */
-      ifdi = G_INPUT_STREAM (g_file_read (fdi, NULL, NULL));
-      if (ifdi == NULL)
+      /* Дескриптор чтения индексов. */
+      ifdi = g_open (fname_i, O_RDONLY | O_BINARY, 0);
+      if (ifdi < 0)
         {
           g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't open index file",
                       priv->name, priv->n_parts);
         }
 
-      /* Поток чтения данных. */
-      ifdd = G_INPUT_STREAM (g_file_read (fdd, NULL, NULL));
-      if (ifdd == NULL)
+      /* Дескриптор чтения данных. */
+      ifdd = g_open (fname_d, O_RDONLY | O_BINARY, 0);
+      if (ifdd < 0)
         {
           g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't open data file",
                       priv->name, priv->n_parts);
         }
 
       /* Ошибка чтения существующих файлов. */
-      if (ifdi == NULL || ifdd == NULL)
+      if (ifdi < 0 || ifdd < 0)
         goto break_open;
 
       /* Размер файла индексов. */
@@ -423,16 +1330,6 @@ hyscan_db_channel_file_object_constructed (GObject *object)
       index_file_size = g_file_info_get_size (finfo);
       g_object_unref (finfo);
 
-      /* Проверяем размер файла с индексами - должна быть как минимум одна запись и
-       * размер должен быть кратен размеру структуры индекса. */
-      if ((index_file_size < (INDEX_FILE_HEADER_SIZE + INDEX_RECORD_SIZE)) ||
-          ((index_file_size - INDEX_FILE_HEADER_SIZE) % INDEX_RECORD_SIZE))
-        {
-          g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid index file size",
-                      priv->name, priv->n_parts);
-          goto break_open;
-        }
-
       /* Размер файла данных. */
       finfo = g_file_query_info (fdd, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
       if (finfo == NULL)
@@ -444,9 +1341,54 @@ hyscan_db_channel_file_object_constructed (GObject *object)
       data_file_size = g_file_info_get_size (finfo);
       g_object_unref (finfo);
 
+      /* Пустые файлы последней части - это заранее созданная часть, в
+         которую не было записано данных. Она остаётся после аварийного
+         завершения записи и не считается ошибкой. Канал с существующими
+         частями открывается только на чтение, поэтому её файлы не удаляются
+         здесь, а удаляются вместе с каналом. */
+      if ((index_file_size == 0) && (data_file_size == 0))
+        goto break_open;
+
+      /* Если размеры и контрольная сумма файлов части совпадают с сохранёнными
+         в файле описания частей, информация о части берётся из него без
+         просмотра индексов. Файл данных сжатой части содержит таблицу блоков,
+         она считывается. */
+      mpart = hyscan_db_channel_file_find_manifest_part (manifest, &manifest_pos, first_part + priv->n_parts);
+      if ((mpart != NULL) &&
+          (mpart->rec.index_size == index_file_size) &&
+          (mpart->rec.data_size == data_file_size) &&
+          ((priv->n_parts == 0) || (mpart->rec.begin_index == priv->parts[priv->n_parts - 1]->end_index + 1)) &&
+          hyscan_db_channel_file_part_digest (ifdi, ifdd, index_file_size, data_file_size, digest) &&
+          (memcmp (digest, mpart->rec.digest, MANIFEST_CHECKSUM_SIZE) == 0))
+        {
+          digest_valid = TRUE;
+          version = mpart->rec.version;
+          record_size = mpart->rec.record_size;
+          begin_index = mpart->rec.begin_index;
+          end_index = mpart->rec.end_index;
+          begin_time = mpart->rec.begin_time;
+          end_time = mpart->rec.end_time;
+          ctime = mpart->rec.ctime;
+
+          if (mpart->rec.data_version == FILE_VERSION_PACKED)
+            {
+              blocks = hyscan_db_channel_file_load_blocks (ifdd, data_file_size, &n_blocks, &raw_size, &pack_compression);
+              if (blocks == NULL)
+                {
+                  g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid packed data file",
+                              priv->name, priv->n_parts);
+                  goto break_open;
+                }
+            }
+
+          if (mpart->compact_blocks != NULL)
+            compact_blocks = g_array_ref (mpart->compact_blocks);
+
+          goto part_ready;
+        }
+
       /* Считываем заголовок файла индексов. */
-      iosize = FILE_HEADER_SIZE;
-      if (g_input_stream_read (ifdi, &id, iosize, NULL, NULL) != iosize)
+      if (!hyscan_db_channel_file_pread (ifdi, &id, FILE_HEADER_SIZE, 0))
         {
           g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't read index file header",
                       priv->name, priv->n_parts);
@@ -454,35 +1396,86 @@ hyscan_db_channel_file_object_constructed (GObject *object)
         }
 
       /* Проверяем заголовок файла индексов. */
+      version = GUINT32_FROM_LE (id.version);
       if ((GUINT32_FROM_LE (id.magic) != INDEX_FILE_MAGIC) ||
-          (GUINT32_FROM_LE (id.version) != FILE_VERSION))
+          ((version != FILE_VERSION) && (version != FILE_VERSION_COMPRESSED) &&
+           (version != FILE_VERSION_FIXED) && (version != FILE_VERSION_COMPACT)))
         {
           g_warning ("HyScanDBChannelFile: channel '%s': part %d: unknown index file format",
                       priv->name, priv->n_parts);
           goto break_open;
         }
 
+      /* Проверяем размер файла с индексами - должна быть как минимум одна запись и
+       * размер должен быть кратен размеру структуры индекса. Для частей с записями
+       * фиксированного размера размер файла должен соответствовать целому числу
+       * записей в блоках меток времени. Файл индексов компактного формата
+       * просматривается целиком, при этом запоминаются смещения его блоков. */
+      if (version == FILE_VERSION_FIXED)
+        {
+          if (!hyscan_db_channel_file_fixed_n_records (index_file_size, &n_records))
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid index file size",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
+        }
+      else if (version == FILE_VERSION_COMPACT)
+        {
+          compact_blocks = hyscan_db_channel_file_open_compact_part (ifdi, index_file_size, &n_records,
+                                                                     &first_index, &rec_index);
+          if (compact_blocks == NULL)
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid index file",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
+        }
+      else if ((index_file_size < (INDEX_FILE_HEADER_SIZE + INDEX_RECORD_SIZE)) ||
+               ((index_file_size - INDEX_FILE_HEADER_SIZE) % INDEX_RECORD_SIZE))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid index file size",
+                      priv->name, priv->n_parts);
+          goto break_open;
+        }
+      else
+        {
+          n_records = (index_file_size - INDEX_FILE_HEADER_SIZE) / INDEX_RECORD_SIZE;
+        }
+
       /* Считываем заголовок файла данных. */
-      iosize = FILE_HEADER_SIZE;
-      if (g_input_stream_read (ifdd, &id, iosize, NULL, NULL) != iosize)
+      if (!hyscan_db_channel_file_pread (ifdd, &id, FILE_HEADER_SIZE, 0))
         {
           g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't read data file header",
                       priv->name, priv->n_parts);
           goto break_open;
         }
 
-      /* Проверяем заголовок файла данных. */
+      /* Проверяем заголовок файла данных. Файл данных сжатой части имеет
+         собственную версию, файл индексов при сжатии не изменяется. */
       if ((GUINT32_FROM_LE (id.magic) != DATA_FILE_MAGIC) ||
-          (GUINT32_FROM_LE (id.version) != FILE_VERSION))
+          ((GUINT32_FROM_LE (id.version) != version) && (GUINT32_FROM_LE (id.version) != FILE_VERSION_PACKED)))
         {
           g_warning ("HyScanDBChannelFile: channel '%s': part %d: unknown data file format",
                       priv->name, priv->n_parts);
           goto break_open;
         }
 
+      /* Таблица блоков сжатой части. */
+      raw_size = data_file_size;
+      if (GUINT32_FROM_LE (id.version) == FILE_VERSION_PACKED)
+        {
+          blocks = hyscan_db_channel_file_load_blocks (ifdd, data_file_size, &n_blocks, &raw_size, &pack_compression);
+          if (blocks == NULL)
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid packed data file",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
+        }
+
       /* Считываем начальный номер индекса части данных. */
-      iosize = sizeof (guint32);
-      if (g_input_stream_read (ifdi, &begin_index, iosize, NULL, NULL) != iosize)
+      if (!hyscan_db_channel_file_pread (ifdi, &begin_index, sizeof (guint32), FILE_HEADER_SIZE))
         {
           g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't query start index",
                       priv->name, priv->n_parts);
@@ -498,86 +1491,116 @@ hyscan_db_channel_file_object_constructed (GObject *object)
           goto break_open;
         }
 
-      end_index = begin_index + ((index_file_size - INDEX_FILE_HEADER_SIZE) / INDEX_RECORD_SIZE) - 1;
+      end_index = begin_index + n_records - 1;
 
-      /* Считываем первый индекс части данных. */
-      offset = INDEX_FILE_HEADER_SIZE;
-      if (!g_seekable_seek (G_SEEKABLE (ifdi), offset, G_SEEK_SET, NULL, NULL))
+      /* Время первой и последней записи части с записями фиксированного размера
+         и проверка размера файла данных. */
+      if (version == FILE_VERSION_FIXED)
         {
-          g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't seek to start index",
-                      priv->name, priv->n_parts);
-          goto break_open;
-        }
+          if (!hyscan_db_channel_file_open_fixed_part (ifdi, n_records, &record_size, &begin_time, &end_time))
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't read fixed size indexes",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
 
-      iosize = INDEX_RECORD_SIZE;
-      if (g_input_stream_read (ifdi, &rec_index, iosize, NULL, NULL) != iosize)
-        {
-          g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't read start index",
-                      priv->name, priv->n_parts);
-          goto break_open;
+          if (raw_size != DATA_FILE_HEADER_SIZE + n_records * record_size)
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid data file size",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
         }
-
-      begin_time = GINT64_FROM_LE (rec_index.time);
-
-      /* Считываем последний индекс части данных. */
-      offset = end_index - begin_index;
-      offset *= INDEX_RECORD_SIZE;
-      offset += INDEX_FILE_HEADER_SIZE;
-      if (!g_seekable_seek (G_SEEKABLE (ifdi), offset, G_SEEK_SET, NULL, NULL))
+      /* Первый и последний индексы части компактного формата считаны при
+         просмотре файла индексов. */
+      else if (version == FILE_VERSION_COMPACT)
         {
-          g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't seek to end index",
-                      priv->name, priv->n_parts);
-          goto break_open;
-        }
+          begin_time = first_index.time;
+          end_time = rec_index.time;
 
-      iosize = INDEX_RECORD_SIZE;
-      if (g_input_stream_read (ifdi, &rec_index, iosize, NULL, NULL) != iosize)
-        {
-          g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't read end index",
-                      priv->name, priv->n_parts);
-          goto break_open;
+          if (raw_size != rec_index.offset + hyscan_db_channel_file_stored_size (version, &rec_index))
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid data file size",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
         }
+      else
+        {
+          /* Считываем первый индекс части данных. */
+          offset = INDEX_FILE_HEADER_SIZE;
+          if (!hyscan_db_channel_file_pread (ifdi, &rec_index, INDEX_RECORD_SIZE, offset))
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't read start index",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
 
-      end_time = GINT64_FROM_LE (rec_index.time);
+          begin_time = GINT64_FROM_LE (rec_index.time);
 
-      /* Проверяем размер файла с данными - он должен быть равен смещению до данных
-         по последнему индексу + размер данных. */
-      if (data_file_size != (GUINT64_FROM_LE (rec_index.offset) + GUINT32_FROM_LE (rec_index.size)))
-        {
-          g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid data file size",
-                      priv->name, priv->n_parts);
-          goto break_open;
-        }
+          /* Считываем последний индекс части данных. */
+          offset = end_index - begin_index;
+          offset *= INDEX_RECORD_SIZE;
+          offset += INDEX_FILE_HEADER_SIZE;
+          if (!hyscan_db_channel_file_pread (ifdi, &rec_index, INDEX_RECORD_SIZE, offset))
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't read end index",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
 
-      /* Считываем информацию о части данных. */
-      priv->n_parts += 1;
-      priv->parts = g_realloc (priv->parts,
-                               32 * (((priv->n_parts + 1) / 32) + 1) * sizeof (HyScanDBChannelFilePart *));
+          end_time = GINT64_FROM_LE (rec_index.time);
 
-      fpart = g_new (HyScanDBChannelFilePart, 1);
-      priv->parts[priv->n_parts - 1] = fpart;
-      priv->parts[priv->n_parts] = NULL;
+          /* Размер данных последней записи в файле. */
+          stored_size = GUINT32_FROM_LE (rec_index.size);
+          if ((version == FILE_VERSION_COMPRESSED) && (rec_index.pad != 0))
+            stored_size = GUINT32_FROM_LE (rec_index.pad) & INDEX_STORED_SIZE_MASK;
+
+          /* Проверяем размер файла с данными - он должен быть равен смещению до данных
+             по последнему индексу + размер данных. Для сжатой части проверяется
+             размер исходного файла. */
+          if (raw_size != (GUINT64_FROM_LE (rec_index.offset) + stored_size))
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': part %d: invalid data file size",
+                          priv->name, priv->n_parts);
+              goto break_open;
+            }
+        }
 
-      if (priv->ctime == 0)
-        priv->ctime = GUINT64_FROM_LE (id.ctime);
+      /* Дата создания части из заголовка файла данных. */
+      ctime = GINT64_FROM_LE (id.ctime);
 
+    part_ready:
+      /* Считываем информацию о части данных. */
+      fpart = g_new0 (HyScanDBChannelFilePart, 1);
       fpart->fdi = fdi;
       fpart->fdd = fdd;
       fpart->ifdi = ifdi;
       fpart->ifdd = ifdd;
-      fpart->ofdi = NULL;
-      fpart->ofdd = NULL;
-
-      fpart->create_time = 0;
-      fpart->last_append_time = 0;
+      fpart->version = version;
+      fpart->ctime = ctime;
+      fpart->number = first_part + priv->n_parts;
+      fpart->record_size = record_size;
+      fpart->packed = (blocks != NULL);
+      fpart->blocks = blocks;
+      fpart->n_blocks = n_blocks;
+      fpart->pack_compression = pack_compression;
+      fpart->compact_blocks = compact_blocks;
+      fpart->index_size = index_file_size;
+      fpart->data_size = data_file_size;
 
       fpart->begin_index = begin_index;
       fpart->end_index = end_index;
       fpart->begin_time = begin_time;
       fpart->end_time = end_time;
 
-      fpart->data_size = data_file_size;
-      priv->data_size += (data_file_size - DATA_FILE_HEADER_SIZE);
+      memcpy (fpart->digest, digest, MANIFEST_CHECKSUM_SIZE);
+      fpart->digest_valid = digest_valid;
+
+      hyscan_db_channel_file_append_part (priv, fpart);
+
+      g_free (fname_i);
+      g_free (fname_d);
 
       /* Загружаем следующую часть. */
       if (priv->n_parts == MAX_PARTS)
@@ -590,16 +1613,96 @@ hyscan_db_channel_file_object_constructed (GObject *object)
       /* Если не прочитали ни одной части - печалька... */
       if (priv->n_parts == 0)
         priv->fail = TRUE;
-      g_clear_object (&ifdi);
-      g_clear_object (&ifdd);
+      if (ifdi >= 0)
+        g_close (ifdi, NULL);
+      if (ifdd >= 0)
+        g_close (ifdd, NULL);
+      g_free (blocks);
+      if (compact_blocks != NULL)
+        g_array_unref (compact_blocks);
       g_clear_object (&fdi);
       g_clear_object (&fdd);
+      g_free (fname_i);
+      g_free (fname_d);
       break;
     }
 
+  if (manifest != NULL)
+    g_array_unref (manifest);
+
   /* Если включен режим только чтения, а данных нет - ошибка. */
   if (priv->readonly && priv->n_parts == 0)
     priv->fail = TRUE;
+
+  /* Очереди операций io_uring. Запись выполняется только в новые части,
+     поэтому очередь записи нужна только если канал открыт на запись. */
+  if (priv->io_uring && !priv->fail)
+    {
+      HyScanDBUring *uring = hyscan_db_uring_new (URING_DEPTH);
+
+      if ((uring != NULL) && !priv->readonly)
+        priv->write_uring = hyscan_db_uring_new (URING_DEPTH);
+
+      if ((uring == NULL) || (!priv->readonly && (priv->write_uring == NULL)))
+        {
+          g_info ("HyScanDBChannelFile: channel '%s': io_uring is not available", priv->name);
+          g_clear_pointer (&uring, hyscan_db_uring_free);
+          g_clear_pointer (&priv->write_uring, hyscan_db_uring_free);
+        }
+      else
+        {
+          g_queue_push_head (&priv->read_urings, uring);
+          priv->read_uring = TRUE;
+        }
+    }
+
+  /* Предварительное выделение места в файлах доступно только в Linux. */
+#if !defined (__linux__) || !defined (FALLOC_FL_KEEP_SIZE)
+  priv->preallocate_size = 0;
+#endif
+
+  /* Задания обслуживания частей канала выполняются общим потоком обслуживания.
+     Временные файлы заранее созданной части, оставшиеся после аварийного
+     завершения, удаляются. */
+  if (!priv->fail)
+    {
+      if (!priv->readonly)
+        hyscan_db_channel_file_remove_spare_files (priv->path, priv->name);
+
+      hyscan_db_channel_file_get_maint ();
+      priv->maint = TRUE;
+    }
+
+  /* Поток записи буфера отложенной записи по времени. */
+  if (!priv->readonly && !priv->fail && (priv->write_buffer_size > 0) && (priv->write_buffer_time > 0))
+    priv->flush_thread = g_thread_new ("channel-flush", hyscan_db_channel_file_flush_thread, priv);
+
+  /* Поток загрузки индексов существующих частей в память. */
+  if (priv->memory_index && priv->memory_index_prefetch && !priv->fail && (priv->n_parts > 0))
+    priv->prefetch_thread = g_thread_new ("channel-prefetch", hyscan_db_channel_file_prefetch_thread, priv);
+
+  /* Поток сжатия завершённых частей. В канале, открытом только для чтения,
+     поток запускается, если в нём есть несжатые части. */
+  if (!priv->fail && (priv->pack_compression != HYSCAN_DB_COMPRESSION_NONE))
+    {
+      gboolean has_raw_parts = FALSE;
+
+      for (i = 0; i < priv->n_parts; i++)
+        has_raw_parts |= !priv->parts[i]->packed;
+
+      if (!hyscan_db_codec_is_supported (priv->pack_compression))
+        g_warning ("HyScanDBChannelFile: channel '%s': unsupported pack compression", priv->name);
+      else if (!priv->readonly || has_raw_parts)
+        priv->pack_thread = g_thread_new ("channel-pack", hyscan_db_channel_file_pack_thread, priv);
+
+      /* Части канала, открытого только для чтения, завершены. */
+      if (priv->readonly)
+        {
+          for (i = 0; i < priv->n_parts; i++)
+            if (!priv->parts[i]->packed)
+              hyscan_db_channel_file_queue_pack (priv, priv->parts[i]);
+        }
+    }
 }
 
 static void
@@ -610,29 +1713,73 @@ hyscan_db_channel_file_object_finalize (GObject *object)
 
   guint i;
 
-  /* Освобождаем структуры кэша индексов. */
-  while (priv->first_cached_index != NULL)
+  /* Сжатие текущей части прерывается, несжатые части будут помещены в очередь
+     сжатия при следующем открытии канала. */
+  hyscan_db_channel_file_stop_pack_thread (priv);
+  g_queue_clear (&priv->pack_queue);
+
+  hyscan_db_channel_file_stop_prefetch_thread (priv);
+
+  /* Записываем данные из буфера отложенной записи и синхронизируем их с диском. */
+  hyscan_db_channel_file_stop_flush_thread (priv);
+  hyscan_db_channel_file_stop_sync_thread (priv);
+  if (!priv->readonly)
     {
-      HyScanDBChannelFileIndex *db_index = priv->first_cached_index;
-      priv->first_cached_index = priv->first_cached_index->next;
-      g_slice_free (HyScanDBChannelFileIndex, db_index);
+      g_mutex_lock (&priv->write_lock);
+      hyscan_db_channel_file_flush_buffers (priv);
+      if (priv->n_parts > 0)
+        hyscan_db_channel_file_trim_part (priv, priv->parts[priv->n_parts - 1]);
+      if ((priv->durability >= HYSCAN_DB_DURABILITY_SYNC) && (priv->n_parts > 0))
+        hyscan_db_channel_file_sync_part (priv, priv->parts[priv->n_parts - 1]);
+      g_mutex_unlock (&priv->write_lock);
     }
-  g_hash_table_destroy (priv->cached_indexes);
 
-  /* Освобождаем структуры с информацией о частях данных. */
-  for (i = 0; i < priv->n_parts; i++)
+  /* Удаляем файлы старых частей и неиспользованной заранее созданной части. */
+  hyscan_db_channel_file_stop_maint (priv);
+
+  if (!priv->readonly && !priv->fail && (priv->n_parts > 0))
+    hyscan_db_channel_file_save_manifest (priv, TRUE);
+
+  g_byte_array_unref (priv->index_buffer);
+  g_byte_array_unref (priv->data_buffer);
+  g_byte_array_unref (priv->compress_buffer);
+  hyscan_db_codec_free (priv->codec);
+
+  hyscan_db_uring_free (priv->write_uring);
+  while (!g_queue_is_empty (&priv->read_urings))
+    hyscan_db_uring_free (g_queue_pop_head (&priv->read_urings));
+
+  for (i = 0; i < READAHEAD_STREAMS; i++)
+    hyscan_db_channel_file_window_unref (priv->readahead_streams[i].window);
+
+  /* Удаляем блоки канала из общего кэша. */
+  if (priv->shared_cache != NULL)
     {
-      g_clear_object (&priv->parts[i]->ofdi);
-      g_clear_object (&priv->parts[i]->ofdd);
-      g_clear_object (&priv->parts[i]->ifdi);
-      g_clear_object (&priv->parts[i]->ifdd);
-      g_clear_object (&priv->parts[i]->fdi);
-      g_clear_object (&priv->parts[i]->fdd);
-      g_free (priv->parts[i]);
+      hyscan_db_cache_remove_owner (priv->shared_cache, priv->cache_owner);
+      g_object_unref (priv->shared_cache);
     }
+
+  /* Освобождаем кэш индексов. */
+  g_free (priv->cache);
+
+  /* Освобождаем структуры с информацией о частях данных. */
+  for (i = 0; i < priv->n_parts; i++)
+    hyscan_db_channel_file_free_part (priv->parts[i]);
   g_free (priv->parts);
 
-  g_mutex_clear (&priv->lock);
+  g_rw_lock_clear (&priv->lock);
+  g_mutex_clear (&priv->write_lock);
+  g_mutex_clear (&priv->cache_lock);
+  g_cond_clear (&priv->flush_cond);
+  g_mutex_clear (&priv->sync_lock);
+  g_cond_clear (&priv->sync_cond);
+  g_mutex_clear (&priv->read_uring_lock);
+  g_mutex_clear (&priv->readahead_lock);
+  g_mutex_clear (&priv->pack_lock);
+  g_cond_clear (&priv->pack_cond);
+  g_mutex_clear (&priv->block_lock);
+  g_mutex_clear (&priv->fd_lock);
+  g_mutex_clear (&priv->maint_lock);
 
   g_free (priv->name);
   g_free (priv->path);
@@ -640,401 +1787,4775 @@ hyscan_db_channel_file_object_finalize (GObject *object)
   G_OBJECT_CLASS (hyscan_db_channel_file_parent_class)->finalize (object);
 }
 
-/* Функция добавления новой части данных. */
+/* Функция считывает данные из файла по указанному смещению. Текущая позиция
+   в файле не используется, поэтому из одного дескриптора можно читать
+   одновременно в нескольких потоках. */
 static gboolean
-hyscan_db_channel_file_add_part (HyScanDBChannelFilePrivate *priv)
+hyscan_db_channel_file_pread (gint     fd,
+                              gpointer buffer,
+                              gsize    size,
+                              guint64  offset)
 {
-  gchar *fname;
-  HyScanDBChannelFilePart *fpart;
-  HyScanDBChannelFileID id;
-
-  guint32 begin_index = 0;
-  gint64 ctime;
-
-  gssize iosize;
+  guint8 *data = buffer;
 
-  if (priv->readonly)
+  while (size > 0)
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': read only mode", priv->name);
-      return FALSE;
+#ifdef G_OS_WIN32
+      OVERLAPPED overlapped = {0};
+      DWORD nread;
+
+      overlapped.Offset = (DWORD) (offset & 0xffffffff);
+      overlapped.OffsetHigh = (DWORD) (offset >> 32);
+      if (!ReadFile ((HANDLE) _get_osfhandle (fd), data, (DWORD) MIN (size, G_MAXINT32), &nread, &overlapped))
+        return FALSE;
+#else
+      gssize nread;
+
+      nread = pread (fd, data, size, offset);
+      if ((nread < 0) && (errno == EINTR))
+        continue;
+      if (nread < 0)
+        return FALSE;
+#endif
+
+      /* Файл закончился раньше, чем ожидалось. */
+      if (nread == 0)
+        return FALSE;
+
+      data += nread;
+      size -= nread;
+      offset += nread;
     }
 
-  /* Закрываем потоки вывода текущей части. */
-  if (priv->n_parts > 0)
-    {
-      g_clear_object (&priv->parts[priv->n_parts - 1]->ofdi);
-      g_clear_object (&priv->parts[priv->n_parts - 1]->ofdd);
-    }
+  return TRUE;
+}
 
-  /* Всего частей может быть не более MAX_PARTS. */
-  if (priv->n_parts == MAX_PARTS)
+/* Функция преобразует индексы в файловом формате к порядку байт процессора. */
+static void
+hyscan_db_channel_file_index_from_le (HyScanDBChannelFileIndexRec *rec_indexes,
+                                      guint32                      n_indexes)
+{
+  guint32 i;
+
+  for (i = 0; i < n_indexes; i++)
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': too many parts", priv->name);
-      return FALSE;
+      rec_indexes[i].time = GINT64_FROM_LE (rec_indexes[i].time);
+      rec_indexes[i].offset = GUINT64_FROM_LE (rec_indexes[i].offset);
+      rec_indexes[i].size = GUINT32_FROM_LE (rec_indexes[i].size);
+      rec_indexes[i].pad = GUINT32_FROM_LE (rec_indexes[i].pad);
     }
+}
 
-  priv->n_parts += 1;
-  priv->parts = g_realloc (priv->parts,
-                           32 * (((priv->n_parts + 1) / 32) + 1) * sizeof (HyScanDBChannelFilePart *));
+/* Функция возвращает размер данных записи в файле данных. Поля индекса
+   должны быть заданы в порядке байт процессора. */
+static guint32
+hyscan_db_channel_file_stored_size (guint32                      version,
+                                    HyScanDBChannelFileIndexRec *rec_index)
+{
+  if ((version != FILE_VERSION) && (rec_index->pad != 0))
+    return rec_index->pad & INDEX_STORED_SIZE_MASK;
 
-  fpart = g_new (HyScanDBChannelFilePart, 1);
-  priv->parts[priv->n_parts - 1] = fpart;
-  priv->parts[priv->n_parts] = NULL;
+  return rec_index->size;
+}
 
-  /* Имя файла индексов. */
-  fname = g_strdup_printf ("%s%s%s.%06d.i", priv->path, G_DIR_SEPARATOR_S, priv->name, priv->n_parts - 1);
-  fpart->fdi = g_file_new_for_path (fname);
-  g_free (fname);
+/* Функция добавляет в буфер целое число переменной длины: по 7 бит в байте,
+   начиная с младших, старший бит байта указывает на наличие следующего. */
+static void
+hyscan_db_channel_file_put_varint (GByteArray *buffer,
+                                   guint64     value)
+{
+  guint8 byte;
 
-  /* Имя файла данных. */
-  fname = g_strdup_printf ("%s%s%s.%06d.d", priv->path, G_DIR_SEPARATOR_S, priv->name, priv->n_parts - 1);
-  fpart->fdd = g_file_new_for_path (fname);
-  g_free (fname);
+  while (value >= 0x80)
+    {
+      byte = (value & 0x7f) | 0x80;
+      g_byte_array_append (buffer, &byte, 1);
+      value >>= 7;
+    }
 
-  /* Создаём файл индексов и открываем его на запись. */
-  fpart->ofdi = G_OUTPUT_STREAM (g_file_create (fpart->fdi, G_FILE_CREATE_NONE, NULL, NULL));
-  if (fpart->ofdi == NULL)
-    g_warning ("HyScanDBChannelFile: channel '%s': can't create index file", priv->name);
+  byte = value;
+  g_byte_array_append (buffer, &byte, 1);
+}
 
-  /* Создаём файл данных и открываем его на запись. */
-  fpart->ofdd = G_OUTPUT_STREAM (g_file_create (fpart->fdd, G_FILE_CREATE_NONE, NULL, NULL));
-  if (fpart->ofdd == NULL)
-    g_warning ("HyScanDBChannelFile: channel '%s': can't create data file", priv->name);
+/* Функция считывает целое число переменной длины. Функция возвращает число
+   считанных байт или 0, если число не помещается в буфер. */
+static gsize
+hyscan_db_channel_file_get_varint (const guint8 *data,
+                                   gsize         size,
+                                   guint64      *value)
+{
+  guint64 result = 0;
+  gsize i;
 
-  /* Открываем файл индексов на чтение. */
-  fpart->ifdi = G_INPUT_STREAM (g_file_read (fpart->fdi, NULL, NULL));
-  if (fpart->ifdi == NULL)
-    g_warning ("HyScanDBChannelFile: channel '%s': can't open index file", priv->name);
+  for (i = 0; (i < size) && (i < 10); i++)
+    {
+      result |= (guint64) (data[i] & 0x7f) << (7 * i);
 
-  /* Открываем файл данных на чтение. */
-  fpart->ifdd = G_INPUT_STREAM (g_file_read (fpart->fdd, NULL, NULL));
-  if (fpart->ifdd == NULL)
-    g_warning ("HyScanDBChannelFile: channel '%s': can't open data file", priv->name);
+      if ((data[i] & 0x80) == 0)
+        {
+          *value = result;
+          return i + 1;
+        }
+    }
+
+  return 0;
+}
+
+/* Функция декодирует блок индексов компактного формата. Блок начинается с
+   базового времени и смещения данных первой записи, за которыми для каждой
+   записи следуют числа переменной длины: смещение времени относительно
+   предыдущей записи, размер данных и поле pad. Смещение данных записи равно
+   сумме базового смещения и размеров данных предыдущих записей блока.
+   Декодируется не более COMPACT_BLOCK_RECORDS записей, но не дальше конца
+   буфера. Индексы возвращаются в порядке байт процессора. */
+static gboolean
+hyscan_db_channel_file_decode_block (const guint8                *data,
+                                     gsize                        size,
+                                     HyScanDBChannelFileIndexRec *rec_indexes,
+                                     guint32                     *n_indexes,
+                                     gsize                       *block_size)
+{
+  gint64 time;
+  guint64 offset;
+  gsize position;
+  guint32 n;
+
+  if (size < COMPACT_BLOCK_HEADER_SIZE)
+    return FALSE;
+
+  memcpy (&time, data, sizeof (gint64));
+  memcpy (&offset, data + sizeof (gint64), sizeof (guint64));
+  time = GINT64_FROM_LE (time);
+  offset = GUINT64_FROM_LE (offset);
 
-  /* Ошибка при создании нового списка данных. */
-  if (fpart->ofdi == NULL || fpart->ofdd == NULL || fpart->ifdi == NULL || fpart->ifdd == NULL)
+  position = COMPACT_BLOCK_HEADER_SIZE;
+  for (n = 0; (n < COMPACT_BLOCK_RECORDS) && (position < size); n++)
     {
-      priv->fail = TRUE;
-      return FALSE;
+      guint64 delta_time;
+      guint64 record_size;
+      guint64 pad;
+      gsize length;
+
+      length = hyscan_db_channel_file_get_varint (data + position, size - position, &delta_time);
+      if (length == 0)
+        return FALSE;
+      position += length;
+
+      length = hyscan_db_channel_file_get_varint (data + position, size - position, &record_size);
+      if ((length == 0) || (record_size > G_MAXUINT32))
+        return FALSE;
+      position += length;
+
+      length = hyscan_db_channel_file_get_varint (data + position, size - position, &pad);
+      if ((length == 0) || (pad > G_MAXUINT32))
+        return FALSE;
+      position += length;
+
+      time += delta_time;
+
+      rec_indexes[n].time = time;
+      rec_indexes[n].offset = offset;
+      rec_indexes[n].size = record_size;
+      rec_indexes[n].pad = pad;
+
+      offset += hyscan_db_channel_file_stored_size (FILE_VERSION_COMPACT, &rec_indexes[n]);
     }
 
-  if (priv->n_parts == 1)
-    begin_index = 0;
-  else
-    begin_index = priv->parts[priv->n_parts - 2]->end_index + 1;
+  if (n == 0)
+    return FALSE;
 
-  fpart->create_time = g_get_monotonic_time ();
+  *n_indexes = n;
+  *block_size = position;
 
-  fpart->begin_index = begin_index;
-  fpart->end_index = begin_index;
+  return TRUE;
+}
 
-  fpart->begin_time = 0;
-  fpart->end_time = 0;
+/* Функция считывает из файла индексов и декодирует блок индексов
+   компактного формата, начинающийся по смещению position. */
+static gboolean
+hyscan_db_channel_file_read_compact_block (gint                         ifdi,
+                                           guint64                      position,
+                                           guint64                      index_file_size,
+                                           HyScanDBChannelFileIndexRec *rec_indexes,
+                                           guint32                     *n_indexes,
+                                           gsize                       *block_size)
+{
+  guint8 data[COMPACT_BLOCK_MAX_SIZE];
+  gsize size;
 
-  /* Запись заголовка файла индексов. */
-  ctime = g_get_real_time () / G_USEC_PER_SEC;
-  id.magic = GUINT32_TO_LE (INDEX_FILE_MAGIC);
-  id.version = GUINT32_TO_LE (FILE_VERSION);
-  id.ctime = GUINT64_TO_LE (ctime);
+  if (position >= index_file_size)
+    return FALSE;
 
-  iosize = FILE_HEADER_SIZE;
-  if (g_output_stream_write (fpart->ofdi, &id, iosize, NULL, NULL) != iosize)
+  size = MIN (COMPACT_BLOCK_MAX_SIZE, index_file_size - position);
+  if (!hyscan_db_channel_file_pread (ifdi, data, size, position))
+    return FALSE;
+
+  return hyscan_db_channel_file_decode_block (data, size, rec_indexes, n_indexes, block_size);
+}
+
+/* Функция просматривает файл индексов компактного формата, проверяет
+   непрерывность смещений данных и возвращает массив смещений блоков в файле,
+   число записей, первый и последний индексы части. Неполным может быть
+   только последний блок. Функция возвращает NULL при ошибке. */
+static GArray *
+hyscan_db_channel_file_open_compact_part (gint                         ifdi,
+                                          guint64                      index_file_size,
+                                          guint64                     *n_records,
+                                          HyScanDBChannelFileIndexRec *first_index,
+                                          HyScanDBChannelFileIndexRec *last_index)
+{
+  HyScanDBChannelFileIndexRec rec_indexes[COMPACT_BLOCK_RECORDS];
+  GArray *compact_blocks;
+  guint64 position;
+  guint64 offset;
+
+  compact_blocks = g_array_new (FALSE, FALSE, sizeof (guint64));
+  position = INDEX_FILE_HEADER_SIZE;
+  offset = DATA_FILE_HEADER_SIZE;
+  *n_records = 0;
+
+  while (position < index_file_size)
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't write index header", priv->name);
-      priv->fail = TRUE;
-      return FALSE;
+      guint32 n_indexes;
+      gsize block_size;
+
+      if (!hyscan_db_channel_file_read_compact_block (ifdi, position, index_file_size,
+                                                      rec_indexes, &n_indexes, &block_size))
+        {
+          goto fail;
+        }
+
+      if ((rec_indexes[0].offset != offset) ||
+          ((n_indexes < COMPACT_BLOCK_RECORDS) && (position + block_size < index_file_size)))
+        {
+          goto fail;
+        }
+
+      if (*n_records == 0)
+        *first_index = rec_indexes[0];
+      *last_index = rec_indexes[n_indexes - 1];
+
+      g_array_append_val (compact_blocks, position);
+      offset = last_index->offset + hyscan_db_channel_file_stored_size (FILE_VERSION_COMPACT, last_index);
+      position += block_size;
+      *n_records += n_indexes;
     }
 
-  /* Запись значения начального индекса. */
-  begin_index = GUINT32_TO_LE (begin_index);
+  if (*n_records > 0)
+    return compact_blocks;
 
-  iosize = sizeof (guint32);
-  if (g_output_stream_write (fpart->ofdi, &begin_index, iosize, NULL, NULL) != iosize)
+fail:
+  g_array_unref (compact_blocks);
+
+  return NULL;
+}
+
+/* Функция определяет число записей части с записями фиксированного размера
+   по размеру файла индексов. Функция возвращает FALSE, если размер файла
+   не соответствует целому числу записей. */
+static gboolean
+hyscan_db_channel_file_fixed_n_records (guint64  index_file_size,
+                                        guint64 *n_records)
+{
+  guint64 tail_size;
+
+  if (index_file_size < FIXED_INDEX_HEADER_SIZE)
+    return FALSE;
+
+  index_file_size -= FIXED_INDEX_HEADER_SIZE;
+  tail_size = index_file_size % FIXED_TIME_BLOCK_SIZE;
+
+  *n_records = (index_file_size / FIXED_TIME_BLOCK_SIZE) * FIXED_TIME_RECORDS;
+  if (tail_size > 0)
+    {
+      if ((tail_size < sizeof (gint64) + sizeof (guint32)) ||
+          ((tail_size - sizeof (gint64)) % sizeof (guint32)))
+        {
+          return FALSE;
+        }
+
+      *n_records += (tail_size - sizeof (gint64)) / sizeof (guint32);
+    }
+
+  return (*n_records > 0);
+}
+
+/* Функция считывает время записи части с записями фиксированного размера
+   из файла индексов. */
+static gboolean
+hyscan_db_channel_file_read_fixed_time (gint     ifdi,
+                                        guint64  position,
+                                        gint64  *time)
+{
+  guint64 block_offset;
+  gint64 base_time;
+  guint32 delta_time;
+
+  block_offset = FIXED_INDEX_HEADER_SIZE + (position / FIXED_TIME_RECORDS) * FIXED_TIME_BLOCK_SIZE;
+
+  if (!hyscan_db_channel_file_pread (ifdi, &base_time, sizeof (gint64), block_offset) ||
+      !hyscan_db_channel_file_pread (ifdi, &delta_time, sizeof (guint32),
+                                     block_offset + sizeof (gint64) + (position % FIXED_TIME_RECORDS) * sizeof (guint32)))
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't write start index", priv->name);
-      priv->fail = TRUE;
       return FALSE;
     }
 
-  /* Запись заголовка файла данных. */
-  ctime = g_get_real_time () / G_USEC_PER_SEC;
-  id.magic = GUINT32_TO_LE (DATA_FILE_MAGIC);
-  id.version = GUINT32_TO_LE (FILE_VERSION);
-  id.ctime = GUINT64_TO_LE (ctime);
+  *time = GINT64_FROM_LE (base_time) + GUINT32_FROM_LE (delta_time);
 
-  iosize = FILE_HEADER_SIZE;
-  if (g_output_stream_write (fpart->ofdd, &id, iosize, NULL, NULL) != iosize)
+  return TRUE;
+}
+
+/* Функция считывает из файла индексов части с записями фиксированного размера
+   размер записей, время первой и последней записи. */
+static gboolean
+hyscan_db_channel_file_open_fixed_part (gint     ifdi,
+                                        guint64  n_records,
+                                        guint32 *record_size,
+                                        gint64  *begin_time,
+                                        gint64  *end_time)
+{
+  if (!hyscan_db_channel_file_pread (ifdi, record_size, sizeof (guint32), INDEX_FILE_HEADER_SIZE))
+    return FALSE;
+
+  *record_size = GUINT32_FROM_LE (*record_size);
+  if ((*record_size == 0) || (*record_size > MAX_FIXED_RECORD_SIZE))
+    return FALSE;
+
+  return hyscan_db_channel_file_read_fixed_time (ifdi, 0, begin_time) &&
+         hyscan_db_channel_file_read_fixed_time (ifdi, n_records - 1, end_time);
+}
+
+/* Функция освобождает структуру с информацией о части данных. */
+static void
+hyscan_db_channel_file_free_part (HyScanDBChannelFilePart *fpart)
+{
+  g_clear_object (&fpart->ofdi);
+  g_clear_object (&fpart->ofdd);
+  hyscan_db_channel_file_unmap_index (fpart);
+  g_clear_pointer (&fpart->data_map, g_mapped_file_unref);
+  g_clear_pointer (&fpart->index_array, g_array_unref);
+  g_clear_pointer (&fpart->block_data, g_bytes_unref);
+  g_clear_pointer (&fpart->compact_blocks, g_array_unref);
+  g_free (fpart->blocks);
+  if (fpart->ifdi >= 0)
+    g_close (fpart->ifdi, NULL);
+  if (fpart->ifdd >= 0)
+    g_close (fpart->ifdd, NULL);
+  g_clear_object (&fpart->fdi);
+  g_clear_object (&fpart->fdd);
+  g_free (fpart);
+}
+
+/* Функция закрывает дескрипторы файлов части. Функция должна вызываться
+   при захваченной блокировке fd_lock. */
+static void
+hyscan_db_channel_file_close_part_fds (HyScanDBChannelFilePart *fpart)
+{
+  if (fpart->ifdi >= 0)
+    g_close (fpart->ifdi, NULL);
+  if (fpart->ifdd >= 0)
+    g_close (fpart->ifdd, NULL);
+
+  fpart->ifdi = -1;
+  fpart->ifdd = -1;
+  g_atomic_int_set (&fpart->fd_open, FALSE);
+}
+
+/* Функция вычисляет контрольную сумму файлов части для файла описания частей.
+   В неё входят весь файл индексов, а также начало и окончание файла данных,
+   по которым проверяется, что файлы части не изменились после записи описания.
+   Файл индексов небольшой по сравнению с файлом данных и определяет
+   расположение всех записей, поэтому он проверяется целиком. */
+static gboolean
+hyscan_db_channel_file_part_digest (gint     ifdi,
+                                    gint     ifdd,
+                                    guint64  index_size,
+                                    guint64  data_size,
+                                    guint8  *digest)
+{
+  gsize digest_size = MANIFEST_CHECKSUM_SIZE;
+  GChecksum *checksum;
+  guint8 *buffer;
+  guint64 offset;
+  gsize size;
+  gboolean status = TRUE;
+
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  buffer = g_malloc (MANIFEST_READ_SIZE);
+
+  /* Файл индексов. */
+  for (offset = 0; status && (offset < index_size); offset += size)
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't write data header", priv->name);
-      priv->fail = TRUE;
+      size = MIN (MANIFEST_READ_SIZE, index_size - offset);
+      status = hyscan_db_channel_file_pread (ifdi, buffer, size, offset);
+      if (status)
+        g_checksum_update (checksum, buffer, size);
+    }
+
+  /* Начало и окончание файла данных. */
+  size = MIN (MANIFEST_TAIL_SIZE, data_size);
+
+  status = status && hyscan_db_channel_file_pread (ifdd, buffer, size, 0);
+  if (status)
+    g_checksum_update (checksum, buffer, size);
+
+  status = status && hyscan_db_channel_file_pread (ifdd, buffer, size, data_size - size);
+  if (status)
+    g_checksum_update (checksum, buffer, size);
+
+  if (status)
+    g_checksum_get_digest (checksum, digest, &digest_size);
+
+  g_free (buffer);
+  g_checksum_free (checksum);
+
+  return status;
+}
+
+/* Функция открывает дескрипторы файлов части. При первом открытии части,
+   созданной по файлу описания частей, проверяется контрольная сумма её
+   файлов, а для сжатой части считывается таблица блоков. Несовпадение
+   контрольной суммы переводит канал в состояние ошибки. Функция должна
+   вызываться при захваченной блокировке fd_lock или до добавления части
+   в список частей. */
+static gboolean
+hyscan_db_channel_file_open_part_fds (HyScanDBChannelFilePrivate *priv,
+                                      HyScanDBChannelFilePart    *fpart)
+{
+  gchar *fname;
+
+  if ((fpart->ifdi >= 0) && (fpart->ifdd >= 0))
+    return TRUE;
+
+  fname = g_file_get_path (fpart->fdi);
+  fpart->ifdi = g_open (fname, O_RDONLY | O_BINARY, 0);
+  g_free (fname);
+
+  fname = g_file_get_path (fpart->fdd);
+  fpart->ifdd = g_open (fname, O_RDONLY | O_BINARY, 0);
+  g_free (fname);
+
+  if ((fpart->ifdi < 0) || (fpart->ifdd < 0))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't open part files", priv->name);
+      hyscan_db_channel_file_close_part_fds (fpart);
       return FALSE;
     }
 
-  fpart->data_size = DATA_FILE_HEADER_SIZE;
+  if (fpart->digest_check)
+    {
+      guint8 digest[MANIFEST_CHECKSUM_SIZE];
+
+      if (!hyscan_db_channel_file_part_digest (fpart->ifdi, fpart->ifdd, fpart->index_size, fpart->data_size, digest) ||
+          (memcmp (digest, fpart->digest, MANIFEST_CHECKSUM_SIZE) != 0))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': part %u: files don't match manifest",
+                     priv->name, fpart->number);
+          priv->fail = TRUE;
+          hyscan_db_channel_file_close_part_fds (fpart);
+          return FALSE;
+        }
+
+      fpart->digest_check = FALSE;
+    }
+
+  if (fpart->packed && (fpart->blocks == NULL))
+    {
+      guint64 raw_size;
+
+      fpart->blocks = hyscan_db_channel_file_load_blocks (fpart->ifdd, fpart->data_size, &fpart->n_blocks,
+                                                          &raw_size, &fpart->pack_compression);
+      if (fpart->blocks == NULL)
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': part %u: invalid packed data file",
+                     priv->name, fpart->number);
+          priv->fail = TRUE;
+          hyscan_db_channel_file_close_part_fds (fpart);
+          return FALSE;
+        }
+    }
 
   return TRUE;
 }
 
-/* Функция удаляет старые части данных. */
+/* Функция закрывает дескрипторы давно не использованных частей так, чтобы
+   число частей с открытыми дескрипторами не превышало max-open-parts.
+   Дескрипторы частей, которые используются в данный момент, не закрываются.
+   Функция должна вызываться при захваченной блокировке fd_lock. */
+static void
+hyscan_db_channel_file_evict_parts (HyScanDBChannelFilePrivate *priv)
+{
+  GList *link = priv->fd_lru.tail;
+
+  if (priv->max_open_parts == 0)
+    return;
+
+  while ((priv->fd_lru.length > priv->max_open_parts) && (link != NULL))
+    {
+      HyScanDBChannelFilePart *fpart = link->data;
+      GList *prev = link->prev;
+
+      if (fpart->fd_users == 0)
+        {
+          g_queue_unlink (&priv->fd_lru, link);
+          hyscan_db_channel_file_close_part_fds (fpart);
+        }
+
+      link = prev;
+    }
+}
+
+/* Функция переводит завершённую часть в режим открытия дескрипторов при
+   обращении. Открытые дескрипторы части либо закрываются, либо часть
+   помещается в начало списка частей с открытыми дескрипторами. Функция
+   должна вызываться при захваченной на запись блокировке lock или для части,
+   ещё не добавленной в список частей. */
+static void
+hyscan_db_channel_file_seal_part_fds (HyScanDBChannelFilePrivate *priv,
+                                      HyScanDBChannelFilePart    *fpart,
+                                      gboolean                    keep_open)
+{
+  g_mutex_lock (&priv->fd_lock);
+
+  fpart->fd_lazy = TRUE;
+  fpart->fd_link.data = fpart;
+
+  if (keep_open)
+    {
+      g_atomic_int_set (&fpart->fd_open, TRUE);
+      g_queue_push_head_link (&priv->fd_lru, &fpart->fd_link);
+      hyscan_db_channel_file_evict_parts (priv);
+    }
+  else
+    {
+      hyscan_db_channel_file_close_part_fds (fpart);
+    }
+
+  g_mutex_unlock (&priv->fd_lock);
+}
+
+/* Функция открывает при необходимости дескрипторы файлов части и
+   запрещает их закрытие до вызова функции hyscan_db_channel_file_release_part.
+   Дескрипторы части, в которую производится запись, открыты всегда. */
 static gboolean
-hyscan_db_channel_file_remove_old_part (HyScanDBChannelFilePrivate *priv)
+hyscan_db_channel_file_acquire_part (HyScanDBChannelFilePrivate *priv,
+                                     HyScanDBChannelFilePart    *fpart)
 {
-  HyScanDBChannelFilePart *fpart;
-  guint i;
+  gboolean status = TRUE;
 
-  if (priv->readonly)
+  if (!fpart->fd_lazy)
     return TRUE;
-  if (priv->n_parts < 2)
+
+  /* Без ограничения числа частей открытые дескрипторы не закрываются. */
+  if ((priv->max_open_parts == 0) && g_atomic_int_get (&fpart->fd_open))
     return TRUE;
 
-  fpart = priv->parts[0];
+  g_mutex_lock (&priv->fd_lock);
 
-  /* Если с момента последней записи в первую часть прошло больше чем save_time времени или
-     общий объём записанных данных без первой части больше чем save_size,
-     удаляем эту часть. */
-  if ((g_get_monotonic_time () - fpart->last_append_time > priv->save_time) ||
-      ((priv->data_size - (fpart->data_size - DATA_FILE_HEADER_SIZE)) > priv->save_size))
+  if (!fpart->fd_open)
     {
-      /* Удаляем информацию о данных из списка. */
-      priv->n_parts -= 1;
-      for (i = 0; i < priv->n_parts; i++)
-        priv->parts[i] = priv->parts[i + 1];
-      priv->parts[priv->n_parts] = NULL;
+      if (hyscan_db_channel_file_open_part_fds (priv, fpart))
+        {
+          g_queue_push_head_link (&priv->fd_lru, &fpart->fd_link);
+          g_atomic_int_set (&fpart->fd_open, TRUE);
+        }
+      else
+        {
+          status = FALSE;
+        }
+    }
+  else if (priv->max_open_parts > 0)
+    {
+      g_queue_unlink (&priv->fd_lru, &fpart->fd_link);
+      g_queue_push_head_link (&priv->fd_lru, &fpart->fd_link);
+    }
+
+  if (status && (priv->max_open_parts > 0))
+    {
+      fpart->fd_users += 1;
+      hyscan_db_channel_file_evict_parts (priv);
+    }
+
+  g_mutex_unlock (&priv->fd_lock);
+
+  return status;
+}
 
-      /* Закрываем потоки ввода, потоки вывода закрываются при добавлении новой части. */
-      g_object_unref (fpart->ifdi);
-      g_object_unref (fpart->ifdd);
+/* Функция разрешает закрытие дескрипторов части, открытых функцией
+   hyscan_db_channel_file_acquire_part. */
+static void
+hyscan_db_channel_file_release_part (HyScanDBChannelFilePrivate *priv,
+                                     HyScanDBChannelFilePart    *fpart)
+{
+  if (!fpart->fd_lazy || (priv->max_open_parts == 0))
+    return;
+
+  g_mutex_lock (&priv->fd_lock);
+  fpart->fd_users -= 1;
+  hyscan_db_channel_file_evict_parts (priv);
+  g_mutex_unlock (&priv->fd_lock);
+}
+
+/* Функция считывает данные из файла индексов части по смещению. Ошибка
+   открытия файлов части может быть временной (например, исчерпан лимит
+   дескрипторов), поэтому она прерывает только текущее чтение. Ошибка чтения
+   открытого файла переводит канал в состояние ошибки. */
+static gboolean
+hyscan_db_channel_file_pread_index (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFilePart    *fpart,
+                                    gpointer                    data,
+                                    gsize                       size,
+                                    guint64                     offset)
+{
+  gboolean status;
+
+  if (!hyscan_db_channel_file_acquire_part (priv, fpart))
+    return FALSE;
+
+  status = hyscan_db_channel_file_pread (fpart->ifdi, data, size, offset);
+  hyscan_db_channel_file_release_part (priv, fpart);
+
+  if (!status)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't read index", priv->name);
+      priv->fail = TRUE;
+    }
+
+  return status;
+}
+
+/* Функция считывает данные из файла данных части по смещению. Ошибки
+   обрабатываются так же, как в функции hyscan_db_channel_file_pread_index. */
+static gboolean
+hyscan_db_channel_file_pread_data (HyScanDBChannelFilePrivate *priv,
+                                   HyScanDBChannelFilePart    *fpart,
+                                   gpointer                    data,
+                                   gsize                       size,
+                                   guint64                     offset)
+{
+  gboolean status;
+
+  if (!hyscan_db_channel_file_acquire_part (priv, fpart))
+    return FALSE;
+
+  status = hyscan_db_channel_file_pread (fpart->ifdd, data, size, offset);
+  hyscan_db_channel_file_release_part (priv, fpart);
+
+  if (!status)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't read data", priv->name);
+      priv->fail = TRUE;
+    }
+
+  return status;
+}
+
+/* Функция отображает в память первые size байт файла индексов части данных,
+   предыдущее отображение при этом освобождается. Читающие потоки обращаются
+   к отображению при захваченной на чтение блокировке lock, поэтому функция
+   должна вызываться при захваченной на запись блокировке lock или для части,
+   ещё не добавленной в список частей. */
+static gboolean
+hyscan_db_channel_file_map_index (HyScanDBChannelFilePart *fpart,
+                                  gsize                    size)
+{
+  guint8 *index_map;
+
+#ifdef G_OS_WIN32
+  HANDLE mapping;
+
+  /* В Windows размер отображения не может превышать размер файла. */
+  mapping = CreateFileMapping ((HANDLE) _get_osfhandle (fpart->ifdi), NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL)
+    return FALSE;
+
+  index_map = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, size);
+  CloseHandle (mapping);
+  if (index_map == NULL)
+    return FALSE;
+#else
+  /* Отображение может быть больше файла, обращаться можно только к записанной части. */
+  index_map = mmap (NULL, size, PROT_READ, MAP_SHARED, fpart->ifdi, 0);
+  if (index_map == MAP_FAILED)
+    return FALSE;
+#endif
+
+  hyscan_db_channel_file_unmap_index (fpart);
+
+  fpart->index_map = index_map;
+  fpart->index_map_size = size;
+
+  return TRUE;
+}
+
+/* Функция освобождает отображение файла индексов части данных. Требования
+   к блокировкам такие же, как у функции hyscan_db_channel_file_map_index. */
+static void
+hyscan_db_channel_file_unmap_index (HyScanDBChannelFilePart *fpart)
+{
+  if (fpart->index_map == NULL)
+    return;
+
+#ifdef G_OS_WIN32
+  UnmapViewOfFile (fpart->index_map);
+#else
+  munmap (fpart->index_map, fpart->index_map_size);
+#endif
+
+  fpart->index_map = NULL;
+  fpart->index_map_size = 0;
+}
+
+/* Функция обновляет отображение файла индексов части данных так, чтобы в него
+   входили все записанные индексы. Завершённые части (sealed) отображаются
+   целиком, отображение активной части создаётся с запасом. При ошибке
+   отображения режим mmap-index отключается и индексы считываются из файлов.
+   Требования к блокировкам такие же, как у функции hyscan_db_channel_file_map_index. */
+static void
+hyscan_db_channel_file_update_index_map (HyScanDBChannelFilePrivate *priv,
+                                         HyScanDBChannelFilePart    *fpart,
+                                         gboolean                    sealed)
+{
+  guint64 size;
+
+  if (!priv->mmap_index)
+    return;
+
+  size = fpart->index_size;
+
+  /* Индексы из буфера отложенной записи ещё не записаны в файл. */
+  if (fpart == priv->parts[priv->n_parts - 1])
+    size -= priv->index_buffer->len;
+
+  /* Все индексы уже отображены. */
+  if (size <= fpart->index_map_size)
+    return;
+
+  if (!sealed)
+    {
+#ifdef G_OS_UNIX
+      size = MAX (2 * size, MIN_INDEX_MAP_SIZE);
+#else
+      return;
+#endif
+    }
+
+  if ((size > G_MAXSIZE) || !hyscan_db_channel_file_map_index (fpart, size))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't map index file, mmap disabled", priv->name);
+      priv->mmap_index = FALSE;
+    }
+}
+
+/* Функция возвращает отображение файла данных части в память, создавая его
+   при первом обращении. Отображение может быть создано одновременно
+   несколькими читающими потоками, при этом сохраняется только одно из них.
+   Функция должна вызываться при захваченной на чтение блокировке lock. */
+static GMappedFile *
+hyscan_db_channel_file_map_data (HyScanDBChannelFilePrivate *priv,
+                                 HyScanDBChannelFilePart    *fpart)
+{
+  GMappedFile *data_map;
+
+  data_map = g_atomic_pointer_get (&fpart->data_map);
+  if (data_map != NULL)
+    return data_map;
+
+  /* Отображение сохраняется и после закрытия дескриптора. */
+  if (!hyscan_db_channel_file_acquire_part (priv, fpart))
+    return NULL;
+
+  data_map = g_mapped_file_new_from_fd (fpart->ifdd, FALSE, NULL);
+  hyscan_db_channel_file_release_part (priv, fpart);
+  if (data_map == NULL)
+    return NULL;
+
+  if (!g_atomic_pointer_compare_and_exchange (&fpart->data_map, NULL, data_map))
+    {
+      g_mapped_file_unref (data_map);
+      data_map = g_atomic_pointer_get (&fpart->data_map);
+    }
+
+  return data_map;
+}
+
+/* Функция загружает в память все индексы части данных. Индексы в массиве
+   хранятся в порядке байт процессора. Для частей, в которые производится
+   запись, функция не используется. */
+static GArray *
+hyscan_db_channel_file_load_index (HyScanDBChannelFilePrivate *priv,
+                                   HyScanDBChannelFilePart    *fpart)
+{
+  HyScanDBChannelFileIndexRec *rec_index;
+  GArray *index_array;
+  guint n_indexes;
+  guint i;
+
+  /* Блоки меток времени загружаются без изменений. */
+  if (fpart->record_size > 0)
+    {
+      guint64 size = fpart->index_size - FIXED_INDEX_HEADER_SIZE;
+
+      index_array = g_array_sized_new (FALSE, FALSE, 1, size);
+      g_array_set_size (index_array, size);
+
+      if (!hyscan_db_channel_file_pread (fpart->ifdi, index_array->data, size, FIXED_INDEX_HEADER_SIZE))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': can't load indexes into memory", priv->name);
+          g_array_unref (index_array);
+          return NULL;
+        }
+
+      return index_array;
+    }
+
+  n_indexes = fpart->end_index - fpart->begin_index + 1;
+  index_array = g_array_sized_new (FALSE, FALSE, INDEX_RECORD_SIZE, n_indexes);
+  g_array_set_size (index_array, n_indexes);
+  rec_index = (HyScanDBChannelFileIndexRec *) index_array->data;
+
+  /* Компактные индексы декодируются поблочно. */
+  if (fpart->version == FILE_VERSION_COMPACT)
+    {
+      guint32 n_decoded = 0;
+
+      for (i = 0; i < fpart->compact_blocks->len; i++)
+        {
+          guint64 position = g_array_index (fpart->compact_blocks, guint64, i);
+          guint32 n_block;
+          gsize block_size;
+
+          if (!hyscan_db_channel_file_read_compact_block (fpart->ifdi, position, fpart->index_size,
+                                                          rec_index + n_decoded, &n_block, &block_size) ||
+              (n_decoded + n_block > n_indexes))
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': can't load indexes into memory", priv->name);
+              g_array_unref (index_array);
+              return NULL;
+            }
+
+          n_decoded += n_block;
+        }
+
+      return index_array;
+    }
+
+  if (!hyscan_db_channel_file_pread (fpart->ifdi, rec_index,
+                                     (gsize) n_indexes * INDEX_RECORD_SIZE, INDEX_FILE_HEADER_SIZE))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't load indexes into memory", priv->name);
+      g_array_unref (index_array);
+      return NULL;
+    }
+
+  hyscan_db_channel_file_index_from_le (rec_index, n_indexes);
+
+  return index_array;
+}
+
+/* Поток загрузки индексов существующих частей данных в память. Такие части
+   есть только у каналов, открытых только для чтения, поэтому список частей
+   не изменяется до завершения потока. */
+static gpointer
+hyscan_db_channel_file_prefetch_thread (gpointer data)
+{
+  HyScanDBChannelFilePrivate *priv = data;
+  guint i;
+
+  for (i = 0; i < priv->n_parts; i++)
+    {
+      HyScanDBChannelFilePart *fpart = priv->parts[i];
+      GArray *index_array;
+
+      if (g_atomic_int_get (&priv->prefetch_shutdown))
+        break;
+
+      if (!hyscan_db_channel_file_acquire_part (priv, fpart))
+        continue;
+
+      index_array = hyscan_db_channel_file_load_index (priv, fpart);
+      hyscan_db_channel_file_release_part (priv, fpart);
+      if (index_array == NULL)
+        continue;
+
+      /* Читающие потоки обращаются к массиву индексов при захваченной на чтение блокировке. */
+      g_rw_lock_writer_lock (&priv->lock);
+      fpart->index_array = index_array;
+      g_rw_lock_writer_unlock (&priv->lock);
+    }
+
+  return NULL;
+}
+
+/* Функция завершает поток загрузки индексов в память. */
+static void
+hyscan_db_channel_file_stop_prefetch_thread (HyScanDBChannelFilePrivate *priv)
+{
+  if (priv->prefetch_thread == NULL)
+    return;
+
+  g_atomic_int_set (&priv->prefetch_shutdown, TRUE);
+
+  g_thread_join (priv->prefetch_thread);
+  priv->prefetch_thread = NULL;
+}
+
+/* Функция создаёт файлы части данных с указанным номером и открывает их на
+   запись и чтение. Заголовки файлов не записываются, это выполняет функция
+   hyscan_db_channel_file_init_part. Файлы заранее создаваемой части (spare)
+   создаются с временными именами "<name>.spare.i" и "<name>.spare.d" и
+   переименовываются функцией hyscan_db_channel_file_rename_spare. Функция
+   вызывается как записывающим потоком, так и потоком обслуживания, поэтому
+   не изменяет состояние канала. */
+static HyScanDBChannelFilePart *
+hyscan_db_channel_file_create_part_files (HyScanDBChannelFilePrivate *priv,
+                                          guint32                     number,
+                                          gboolean                    spare)
+{
+  gchar *fname;
+  HyScanDBChannelFilePart *fpart;
+  gint open_flags;
+
+  /* Для выделения места в файлах нужны дескрипторы с правами на запись. */
+  if ((priv->write_uring != NULL) || (priv->preallocate_size > 0))
+    open_flags = O_RDWR | O_BINARY;
+  else
+    open_flags = NEW_PART_OPEN_FLAGS;
+
+  fpart = g_new0 (HyScanDBChannelFilePart, 1);
+  fpart->ifdi = -1;
+  fpart->ifdd = -1;
+  fpart->number = number;
+
+  /* Имя файла индексов. */
+  if (spare)
+    fname = g_strdup_printf ("%s%s%s.%s.i", priv->path, G_DIR_SEPARATOR_S, priv->name, SPARE_FILE_EXT);
+  else
+    fname = g_strdup_printf ("%s%s%s.%06u.i", priv->path, G_DIR_SEPARATOR_S, priv->name, fpart->number);
+  fpart->fdi = g_file_new_for_path (fname);
+  g_free (fname);
+
+  /* Имя файла данных. */
+  if (spare)
+    fname = g_strdup_printf ("%s%s%s.%s.d", priv->path, G_DIR_SEPARATOR_S, priv->name, SPARE_FILE_EXT);
+  else
+    fname = g_strdup_printf ("%s%s%s.%06u.d", priv->path, G_DIR_SEPARATOR_S, priv->name, fpart->number);
+  fpart->fdd = g_file_new_for_path (fname);
+  g_free (fname);
+
+  /* Создаём файл индексов и открываем его на запись. */
+  fpart->ofdi = G_OUTPUT_STREAM (g_file_create (fpart->fdi, G_FILE_CREATE_NONE, NULL, NULL));
+  if (fpart->ofdi == NULL)
+    g_warning ("HyScanDBChannelFile: channel '%s': can't create index file", priv->name);
+
+  /* Создаём файл данных и открываем его на запись. */
+  fpart->ofdd = G_OUTPUT_STREAM (g_file_create (fpart->fdd, G_FILE_CREATE_NONE, NULL, NULL));
+  if (fpart->ofdd == NULL)
+    g_warning ("HyScanDBChannelFile: channel '%s': can't create data file", priv->name);
+
+  /* Открываем файл индексов на чтение. При использовании io_uring запись
+     выполняется через этот же дескриптор. */
+  if (fpart->ofdi != NULL)
+    {
+      fname = g_file_get_path (fpart->fdi);
+      fpart->ifdi = g_open (fname, open_flags, 0);
+      g_free (fname);
+    }
+  if (fpart->ifdi < 0)
+    g_warning ("HyScanDBChannelFile: channel '%s': can't open index file", priv->name);
+
+  /* Открываем файл данных на чтение. */
+  if (fpart->ofdd != NULL)
+    {
+      fname = g_file_get_path (fpart->fdd);
+      fpart->ifdd = g_open (fname, open_flags, 0);
+      g_free (fname);
+    }
+  if (fpart->ifdd < 0)
+    g_warning ("HyScanDBChannelFile: channel '%s': can't open data file", priv->name);
+
+  /* Ошибка при создании файлов части. Частично созданные файлы удаляются,
+     иначе они помешают созданию части с этим номером. */
+  if (fpart->ofdi == NULL || fpart->ofdd == NULL || fpart->ifdi < 0 || fpart->ifdd < 0)
+    {
+      if (fpart->ofdi != NULL)
+        g_file_delete (fpart->fdi, NULL, NULL);
+      if (fpart->ofdd != NULL)
+        g_file_delete (fpart->fdd, NULL, NULL);
+
+      hyscan_db_channel_file_free_part (fpart);
+
+      return NULL;
+    }
+
+  return fpart;
+}
+
+/* Функция удаляет файлы части данных и освобождает её. Часть не должна
+   находиться в списке частей. */
+static void
+hyscan_db_channel_file_delete_part (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFilePart    *fpart)
+{
+  /* Исключаем часть из списка частей с открытыми дескрипторами. */
+  g_mutex_lock (&priv->fd_lock);
+  if (fpart->fd_lazy && fpart->fd_open)
+    g_queue_unlink (&priv->fd_lru, &fpart->fd_link);
+  fpart->fd_lazy = FALSE;
+  g_mutex_unlock (&priv->fd_lock);
+
+  /* Закрываем дескрипторы чтения. Потоки вывода закрываются при
+     освобождении части. */
+  hyscan_db_channel_file_unmap_index (fpart);
+  if (fpart->ifdi >= 0)
+    g_close (fpart->ifdi, NULL);
+  if (fpart->ifdd >= 0)
+    g_close (fpart->ifdd, NULL);
+  fpart->ifdi = -1;
+  fpart->ifdd = -1;
+
+  /* Удаляем файл индексов. Он удаляется первым, так как часть без файла
+     индексов не считывается при открытии канала. */
+  if (!g_file_delete (fpart->fdi, NULL, NULL))
+    g_warning ("HyScanDBChannelFile: channel '%s': can't remove index file", priv->name);
+
+  /* Удаляем файл данных. */
+  if (!g_file_delete (fpart->fdd, NULL, NULL))
+    g_warning ("HyScanDBChannelFile: channel '%s': can't remove data file", priv->name);
+
+  hyscan_db_channel_file_free_part (fpart);
+}
+
+/* Функция записывает заголовки файлов новой части данных и подготавливает
+   её к записи. Функция должна вызываться при захваченной блокировке
+   write_lock. */
+static gboolean
+hyscan_db_channel_file_init_part (HyScanDBChannelFilePrivate *priv,
+                                  HyScanDBChannelFilePart    *fpart,
+                                  guint32                     begin_index)
+{
+  HyScanDBChannelFileID id;
+
+  gint64 ctime;
+
+  gssize iosize;
+
+  fpart->create_time = g_get_monotonic_time ();
+
+  fpart->begin_index = begin_index;
+  fpart->end_index = begin_index;
+
+  fpart->begin_time = 0;
+  fpart->end_time = 0;
+
+  /* Части с записями фиксированного размера создаются с версией
+     FILE_VERSION_FIXED, остальные части - с компактными индексами, в которых
+     могут храниться и сжатые записи. Части версий FILE_VERSION и
+     FILE_VERSION_COMPRESSED только считываются. */
+  fpart->record_size = priv->record_size;
+  if (fpart->record_size > 0)
+    {
+      fpart->version = FILE_VERSION_FIXED;
+      fpart->index_size = FIXED_INDEX_HEADER_SIZE;
+    }
+  else
+    {
+      fpart->version = FILE_VERSION_COMPACT;
+      fpart->index_size = INDEX_FILE_HEADER_SIZE;
+      fpart->compact_blocks = g_array_new (FALSE, FALSE, sizeof (guint64));
+    }
+
+  /* Запись заголовка файла индексов. */
+  ctime = g_get_real_time () / G_USEC_PER_SEC;
+  id.magic = GUINT32_TO_LE (INDEX_FILE_MAGIC);
+  id.version = GUINT32_TO_LE (fpart->version);
+  id.ctime = GUINT64_TO_LE (ctime);
+
+  iosize = FILE_HEADER_SIZE;
+  if (g_output_stream_write (fpart->ofdi, &id, iosize, NULL, NULL) != iosize)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write index header", priv->name);
+      return FALSE;
+    }
+
+  /* Запись значения начального индекса. */
+  begin_index = GUINT32_TO_LE (begin_index);
+
+  iosize = sizeof (guint32);
+  if (g_output_stream_write (fpart->ofdi, &begin_index, iosize, NULL, NULL) != iosize)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write start index", priv->name);
+      return FALSE;
+    }
+
+  /* Запись фиксированного размера записей. */
+  if (fpart->record_size > 0)
+    {
+      guint32 record_size = GUINT32_TO_LE (fpart->record_size);
+
+      iosize = sizeof (guint32);
+      if (g_output_stream_write (fpart->ofdi, &record_size, iosize, NULL, NULL) != iosize)
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': can't write record size", priv->name);
+          return FALSE;
+        }
+    }
+
+  /* Запись заголовка файла данных. */
+  ctime = g_get_real_time () / G_USEC_PER_SEC;
+  fpart->ctime = ctime;
+  id.magic = GUINT32_TO_LE (DATA_FILE_MAGIC);
+  id.version = GUINT32_TO_LE (fpart->version);
+  id.ctime = GUINT64_TO_LE (ctime);
+
+  iosize = FILE_HEADER_SIZE;
+  if (g_output_stream_write (fpart->ofdd, &id, iosize, NULL, NULL) != iosize)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write data header", priv->name);
+      return FALSE;
+    }
+
+  fpart->data_size = DATA_FILE_HEADER_SIZE;
+
+  /* Индексы новой части добавляются в массив при записи. Для частей с
+     записями фиксированного размера массив содержит блоки меток времени
+     в том же виде, что и в файле. */
+  if (priv->memory_index)
+    fpart->index_array = g_array_new (FALSE, FALSE, (fpart->record_size > 0) ? 1 : INDEX_RECORD_SIZE);
+
+  return TRUE;
+}
+
+/* Функция создаёт новую часть данных. Если поток обслуживания заранее
+   создал файлы следующей части, используются они, иначе файлы создаются
+   здесь же. Часть не добавляется в список частей, поэтому она не видна
+   читающим потокам до вызова функции hyscan_db_channel_file_add_part.
+   Функция должна вызываться при захваченной блокировке write_lock. */
+static HyScanDBChannelFilePart *
+hyscan_db_channel_file_create_part (HyScanDBChannelFilePrivate *priv,
+                                    guint32                     begin_index)
+{
+  HyScanDBChannelFilePart *fpart;
+  guint32 number = 0;
+
+  if (priv->readonly)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': read only mode", priv->name);
+      return NULL;
+    }
+
+  /* Всего частей может быть не более MAX_PARTS. */
+  if (priv->n_parts == MAX_PARTS)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': too many parts", priv->name);
+      return NULL;
+    }
+
+  /* Номер новой части следует за номером последней. */
+  if (priv->n_parts > 0)
+    number = priv->parts[priv->n_parts - 1]->number + 1;
+
+  fpart = hyscan_db_channel_file_take_spare (priv, number);
+  if (fpart == NULL)
+    fpart = hyscan_db_channel_file_create_part_files (priv, number, FALSE);
+
+  if (fpart == NULL)
+    {
+      priv->fail = TRUE;
+      return NULL;
+    }
+
+  if (!hyscan_db_channel_file_init_part (priv, fpart, begin_index))
+    {
+      priv->fail = TRUE;
+      hyscan_db_channel_file_delete_part (priv, fpart);
+      return NULL;
+    }
+
+  return fpart;
+}
+
+/* Функция добавляет часть данных в список частей. После этого часть
+   становится доступной для чтения. Функция должна вызываться при
+   захваченной блокировке write_lock и захваченной на запись блокировке lock. */
+static void
+hyscan_db_channel_file_add_part (HyScanDBChannelFilePrivate *priv,
+                                 HyScanDBChannelFilePart    *fpart)
+{
+  HyScanDBChannelFilePart *prev_part = NULL;
+
+  if (priv->n_parts > 0)
+    prev_part = priv->parts[priv->n_parts - 1];
+
+  priv->n_parts += 1;
+  priv->parts = g_realloc (priv->parts,
+                           32 * (((priv->n_parts + 1) / 32) + 1) * sizeof (HyScanDBChannelFilePart *));
+
+  priv->parts[priv->n_parts - 1] = fpart;
+  priv->parts[priv->n_parts] = NULL;
+
+  /* Запись в предыдущую часть завершена. */
+  if (prev_part != NULL)
+    hyscan_db_channel_file_update_index_map (priv, prev_part, TRUE);
+
+  /* Закрываем потоки вывода предыдущей части, они используются только
+     записывающим потоком. */
+  if (prev_part != NULL)
+    {
+      g_clear_object (&prev_part->ofdi);
+      g_clear_object (&prev_part->ofdd);
+
+      hyscan_db_channel_file_seal_part_fds (priv, prev_part, TRUE);
+    }
+
+  /* Завершённая часть сжимается в фоне и добавляется в файл описания частей. */
+  if (prev_part != NULL)
+    {
+      hyscan_db_channel_file_queue_pack (priv, prev_part);
+      hyscan_db_channel_file_request_manifest (priv, FALSE);
+    }
+}
+
+/* Функция удаляет старые части данных. Функция должна вызываться при
+   захваченной блокировке write_lock. */
+static gboolean
+hyscan_db_channel_file_remove_old_part (HyScanDBChannelFilePrivate *priv)
+{
+  HyScanDBChannelFilePart *fpart;
+  guint i;
+
+  if (priv->readonly)
+    return TRUE;
+  if (priv->n_parts < 2)
+    return TRUE;
+
+  fpart = priv->parts[0];
+
+  /* Если с момента последней записи в первую часть прошло больше чем save_time времени или
+     общий объём записанных данных без первой части больше чем save_size,
+     удаляем эту часть. */
+  if ((g_get_monotonic_time () - fpart->last_append_time > priv->save_time) ||
+      ((priv->data_size - (fpart->data_size - DATA_FILE_HEADER_SIZE)) > priv->save_size))
+    {
+      /* Удаляем информацию о данных из списка. После освобождения блокировки
+         читающие потоки не могут получить доступ к удаляемой части. */
+      g_rw_lock_writer_lock (&priv->lock);
+
+      priv->n_parts -= 1;
+      for (i = 0; i < priv->n_parts; i++)
+        priv->parts[i] = priv->parts[i + 1];
+      priv->parts[priv->n_parts] = NULL;
+
+      /* Удаляем из кэша индексы, относящиеся к этой части. */
+      g_mutex_lock (&priv->cache_lock);
+      for (i = 0; i < priv->cache_size; i++)
+        {
+          if (priv->cache[i].part == fpart)
+            priv->cache[i].part = NULL;
+        }
+      g_mutex_unlock (&priv->cache_lock);
+
+      g_rw_lock_writer_unlock (&priv->lock);
+
+      /* Уменьшаем общий объём данных на размер удалённой части. */
+      priv->data_size -= (fpart->data_size - DATA_FILE_HEADER_SIZE);
+
+      /* Файлы части удаляются потоком обслуживания, после чего он
+         записывает файл описания оставшихся частей. */
+      hyscan_db_channel_file_queue_remove (priv, fpart);
+      hyscan_db_channel_file_request_manifest (priv, FALSE);
+    }
+  return TRUE;
+}
+
+/* Функция возвращает поток обслуживания частей, общий для всех каналов.
+   Поток запускается при первом обращении и работает до завершения процесса. */
+static HyScanDBChannelFileMaint *
+hyscan_db_channel_file_get_maint (void)
+{
+  static HyScanDBChannelFileMaint maint;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      g_mutex_init (&maint.lock);
+      g_cond_init (&maint.cond);
+      g_queue_init (&maint.channels);
+
+      g_thread_unref (g_thread_new ("channel-maint", hyscan_db_channel_file_maint_thread, &maint));
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return &maint;
+}
+
+/* Поток обслуживания частей данных. Поток удаляет файлы старых частей,
+   заранее создаёт файлы следующих частей и записывает файлы описания частей
+   всех каналов, чтобы эти операции с файловой системой не выполнялись при
+   записи данных. За одно обращение к каналу выполняется одно задание, после
+   чего канал с оставшимися заданиями помещается в конец очереди. */
+static gpointer
+hyscan_db_channel_file_maint_thread (gpointer data)
+{
+  HyScanDBChannelFileMaint *maint = data;
+
+  g_mutex_lock (&maint->lock);
+
+  while (TRUE)
+    {
+      HyScanDBChannelFilePrivate *priv;
+      gboolean more;
+
+      priv = g_queue_pop_head (&maint->channels);
+      if (priv == NULL)
+        {
+          g_cond_wait (&maint->cond, &maint->lock);
+          continue;
+        }
+
+      priv->maint_queued = FALSE;
+      priv->maint_busy = TRUE;
+      g_mutex_unlock (&maint->lock);
+
+      more = hyscan_db_channel_file_maint_run (priv);
+
+      g_mutex_lock (&maint->lock);
+      priv->maint_busy = FALSE;
+      if (more && priv->maint && !priv->maint_queued)
+        {
+          g_queue_push_tail (&maint->channels, priv);
+          priv->maint_queued = TRUE;
+        }
+
+      g_cond_broadcast (&maint->cond);
+    }
+
+  g_mutex_unlock (&maint->lock);
+
+  return NULL;
+}
+
+/* Функция выполняет одно задание обслуживания канала. Функция возвращает
+   FALSE, если заданий нет. */
+static gboolean
+hyscan_db_channel_file_maint_run (HyScanDBChannelFilePrivate *priv)
+{
+  HyScanDBChannelFilePart *fpart;
+
+  g_mutex_lock (&priv->maint_lock);
+
+  /* Удаляем файлы старых частей. */
+  fpart = g_queue_pop_head (&priv->remove_queue);
+  if (fpart != NULL)
+    {
+      g_mutex_unlock (&priv->maint_lock);
+      hyscan_db_channel_file_delete_part (priv, fpart);
+
+      return TRUE;
+    }
+
+  /* Записываем файл описания частей. */
+  if (priv->manifest_request)
+    {
+      gboolean final = priv->manifest_final;
+
+      priv->manifest_request = FALSE;
+      g_mutex_unlock (&priv->maint_lock);
+      hyscan_db_channel_file_save_manifest (priv, final);
+
+      return TRUE;
+    }
+
+  /* Создаём файлы следующей части. Если за время их создания записывающий
+     поток создал часть сам, файлы удаляются. */
+  if (priv->spare_number >= 0)
+    {
+      guint32 number = priv->spare_number;
+
+      priv->spare_number = -1;
+      priv->spare_pending = TRUE;
+      priv->spare_stale = FALSE;
+      g_mutex_unlock (&priv->maint_lock);
+
+      fpart = hyscan_db_channel_file_create_part_files (priv, number, TRUE);
+
+      g_mutex_lock (&priv->maint_lock);
+      priv->spare_pending = FALSE;
+      if ((fpart != NULL) && priv->spare_stale)
+        g_queue_push_tail (&priv->remove_queue, fpart);
+      else
+        priv->spare_part = fpart;
+      g_mutex_unlock (&priv->maint_lock);
+
+      return TRUE;
+    }
+
+  g_mutex_unlock (&priv->maint_lock);
+
+  return FALSE;
+}
+
+/* Функция помещает канал в очередь потока обслуживания. */
+static void
+hyscan_db_channel_file_maint_schedule (HyScanDBChannelFilePrivate *priv)
+{
+  HyScanDBChannelFileMaint *maint = hyscan_db_channel_file_get_maint ();
+
+  g_mutex_lock (&maint->lock);
+
+  if (priv->maint && !priv->maint_queued)
+    {
+      g_queue_push_tail (&maint->channels, priv);
+      priv->maint_queued = TRUE;
+      g_cond_broadcast (&maint->cond);
+    }
+
+  g_mutex_unlock (&maint->lock);
+}
+
+/* Функция помещает часть данных в очередь удаления. Если канал не
+   обслуживается потоком обслуживания, файлы части удаляются сразу. */
+static void
+hyscan_db_channel_file_queue_remove (HyScanDBChannelFilePrivate *priv,
+                                     HyScanDBChannelFilePart    *fpart)
+{
+  if (!priv->maint)
+    {
+      hyscan_db_channel_file_delete_part (priv, fpart);
+      return;
+    }
+
+  g_mutex_lock (&priv->maint_lock);
+  g_queue_push_tail (&priv->remove_queue, fpart);
+  g_mutex_unlock (&priv->maint_lock);
+
+  hyscan_db_channel_file_maint_schedule (priv);
+}
+
+/* Функция возвращает заранее созданную часть данных с указанным номером.
+   Функция не ожидает создания части: если часть ещё создаётся, она
+   помечается как ненужная и будет удалена потоком обслуживания, а функция
+   возвращает NULL и часть создаётся вызывающей функцией. Файлы заранее
+   созданной части переименовываются в файлы части с указанным номером.
+   Заранее созданная часть с другим номером удаляется. Функция должна
+   вызываться при захваченной блокировке write_lock. */
+static HyScanDBChannelFilePart *
+hyscan_db_channel_file_take_spare (HyScanDBChannelFilePrivate *priv,
+                                   guint32                     number)
+{
+  HyScanDBChannelFilePart *fpart;
+
+  if (!priv->maint)
+    return NULL;
+
+  g_mutex_lock (&priv->maint_lock);
+
+  fpart = priv->spare_part;
+  priv->spare_part = NULL;
+  priv->spare_number = -1;
+  priv->spare_stale = priv->spare_pending;
+
+  g_mutex_unlock (&priv->maint_lock);
+
+  if ((fpart != NULL) &&
+      ((fpart->number != number) || !hyscan_db_channel_file_rename_spare (priv, fpart)))
+    {
+      hyscan_db_channel_file_queue_remove (priv, fpart);
+      fpart = NULL;
+    }
+
+  return fpart;
+}
+
+/* Функция переименовывает временные файлы заранее созданной части в файлы
+   части с её номером. Открытые дескрипторы файлов при этом не изменяются. */
+static gboolean
+hyscan_db_channel_file_rename_spare (HyScanDBChannelFilePrivate *priv,
+                                     HyScanDBChannelFilePart    *fpart)
+{
+  gchar *spare_name;
+  gchar *fname;
+  gint status;
+
+  /* Файл данных. */
+  spare_name = g_file_get_path (fpart->fdd);
+  fname = g_strdup_printf ("%s%s%s.%06u.d", priv->path, G_DIR_SEPARATOR_S, priv->name, fpart->number);
+  status = g_rename (spare_name, fname);
+  if (status == 0)
+    {
+      g_object_unref (fpart->fdd);
+      fpart->fdd = g_file_new_for_path (fname);
+    }
+  g_free (spare_name);
+  g_free (fname);
+
+  if (status != 0)
+    return FALSE;
+
+  /* Файл индексов переименовывается последним, так как часть без файла
+     индексов не считывается при открытии канала. */
+  spare_name = g_file_get_path (fpart->fdi);
+  fname = g_strdup_printf ("%s%s%s.%06u.i", priv->path, G_DIR_SEPARATOR_S, priv->name, fpart->number);
+  status = g_rename (spare_name, fname);
+  if (status == 0)
+    {
+      g_object_unref (fpart->fdi);
+      fpart->fdi = g_file_new_for_path (fname);
+    }
+  g_free (spare_name);
+  g_free (fname);
+
+  return (status == 0);
+}
+
+/* Функция запрашивает у потока обслуживания создание следующей части, если
+   текущая часть заполнена более чем на три четверти по объёму или по
+   времени. Функция должна вызываться при захваченной блокировке write_lock. */
+static void
+hyscan_db_channel_file_request_spare (HyScanDBChannelFilePrivate *priv,
+                                      HyScanDBChannelFilePart    *fpart)
+{
+  guint64 max_part_size;
+  gint64 max_part_time;
+
+  if (!priv->maint || priv->readonly || fpart->spare_requested)
+    return;
+
+  max_part_size = MIN (priv->max_data_file_size, priv->save_size / 5);
+  max_part_time = priv->save_time / 5;
+
+  if ((fpart->data_size < (max_part_size / 4) * 3) &&
+      (g_get_monotonic_time () - fpart->create_time < (max_part_time / 4) * 3))
+    {
+      return;
+    }
+
+  fpart->spare_requested = TRUE;
+
+  g_mutex_lock (&priv->maint_lock);
+  priv->spare_number = fpart->number + 1;
+  g_mutex_unlock (&priv->maint_lock);
+
+  hyscan_db_channel_file_maint_schedule (priv);
+}
+
+/* Функция исключает канал из очереди потока обслуживания, дожидается
+   завершения выполняемого задания канала и выполняет оставшиеся задания.
+   Неиспользованная заранее созданная часть удаляется. */
+static void
+hyscan_db_channel_file_stop_maint (HyScanDBChannelFilePrivate *priv)
+{
+  HyScanDBChannelFileMaint *maint;
+
+  if (!priv->maint)
+    return;
+
+  maint = hyscan_db_channel_file_get_maint ();
+
+  g_mutex_lock (&maint->lock);
+
+  priv->maint = FALSE;
+  if (priv->maint_queued)
+    g_queue_remove (&maint->channels, priv);
+  priv->maint_queued = FALSE;
+
+  while (priv->maint_busy)
+    g_cond_wait (&maint->cond, &maint->lock);
+
+  g_mutex_unlock (&maint->lock);
+
+  /* Следующая часть больше не понадобится. */
+  priv->spare_number = -1;
+  while (hyscan_db_channel_file_maint_run (priv));
+
+  if (priv->spare_part != NULL)
+    hyscan_db_channel_file_delete_part (priv, priv->spare_part);
+  priv->spare_part = NULL;
+}
+
+/* Функция удаляет временные файлы заранее созданной части канала name в
+   каталоге path. */
+static gboolean
+hyscan_db_channel_file_remove_spare_files (const gchar *path,
+                                           const gchar *name)
+{
+  const gchar *exts[] = { "i", "d" };
+  gboolean status = TRUE;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (exts); i++)
+    {
+      gchar *spare_file = g_strdup_printf ("%s%s%s.%s.%s", path, G_DIR_SEPARATOR_S, name, SPARE_FILE_EXT, exts[i]);
+
+      if (g_file_test (spare_file, G_FILE_TEST_IS_REGULAR) && (g_unlink (spare_file) != 0))
+        {
+          g_warning ("HyScanDBFile: can't remove file %s", spare_file);
+          status = FALSE;
+        }
+
+      g_free (spare_file);
+    }
+
+  return status;
+}
+
+/* Функция возвращает имя файла описания частей канала. */
+static gchar *
+hyscan_db_channel_file_manifest_name (HyScanDBChannelFilePrivate *priv)
+{
+  return g_strdup_printf ("%s%s%s.%s", priv->path, G_DIR_SEPARATOR_S, priv->name, MANIFEST_FILE_EXT);
+}
+
+/* Функция освобождает описание части, считанное из файла описания частей. */
+static void
+hyscan_db_channel_file_clear_manifest_part (gpointer data)
+{
+  HyScanDBChannelFileManifestPart *mpart = data;
+
+  if (mpart->compact_blocks != NULL)
+    g_array_unref (mpart->compact_blocks);
+}
+
+/* Функция считывает файл описания частей канала. Если файла нет, он
+   повреждён или не соответствует формату, функция возвращает NULL. */
+static GArray *
+hyscan_db_channel_file_load_manifest (HyScanDBChannelFilePrivate *priv)
+{
+  GArray *manifest = NULL;
+  GChecksum *checksum;
+  guint8 digest[MANIFEST_CHECKSUM_SIZE];
+  gsize digest_size = MANIFEST_CHECKSUM_SIZE;
+
+  HyScanDBChannelFileID id;
+  gchar *manifest_name;
+  gchar *data = NULL;
+  gsize size;
+  gsize offset;
+  guint32 n_parts;
+  guint32 i;
+
+  manifest_name = hyscan_db_channel_file_manifest_name (priv);
+  if (!g_file_get_contents (manifest_name, &data, &size, NULL))
+    goto exit;
+
+  if (size < MANIFEST_HEADER_SIZE + MANIFEST_CHECKSUM_SIZE)
+    goto fail;
+
+  /* Проверяем контрольную сумму. */
+  size -= MANIFEST_CHECKSUM_SIZE;
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  g_checksum_update (checksum, (const guchar *) data, size);
+  g_checksum_get_digest (checksum, digest, &digest_size);
+  g_checksum_free (checksum);
+
+  if (memcmp (digest, data + size, MANIFEST_CHECKSUM_SIZE) != 0)
+    goto fail;
+
+  /* Проверяем заголовок. */
+  memcpy (&id, data, FILE_HEADER_SIZE);
+  memcpy (&n_parts, data + FILE_HEADER_SIZE, sizeof (guint32));
+  n_parts = GUINT32_FROM_LE (n_parts);
+  if ((GUINT32_FROM_LE (id.magic) != MANIFEST_FILE_MAGIC) ||
+      (GUINT32_FROM_LE (id.version) != MANIFEST_VERSION) ||
+      (n_parts > MAX_PARTS))
+    {
+      goto fail;
+    }
+
+  manifest = g_array_sized_new (FALSE, TRUE, sizeof (HyScanDBChannelFileManifestPart), n_parts);
+  g_array_set_clear_func (manifest, hyscan_db_channel_file_clear_manifest_part);
+
+  /* Описания частей упорядочены по номерам частей. */
+  offset = MANIFEST_HEADER_SIZE;
+  for (i = 0; i < n_parts; i++)
+    {
+      HyScanDBChannelFileManifestPart mpart;
+      HyScanDBChannelFileManifestRec *rec = &mpart.rec;
+      guint32 j;
+
+      if (size - offset < MANIFEST_RECORD_SIZE)
+        goto fail;
+
+      memcpy (rec, data + offset, MANIFEST_RECORD_SIZE);
+      offset += MANIFEST_RECORD_SIZE;
+
+      rec->number = GUINT32_FROM_LE (rec->number);
+      rec->version = GUINT32_FROM_LE (rec->version);
+      rec->data_version = GUINT32_FROM_LE (rec->data_version);
+      rec->record_size = GUINT32_FROM_LE (rec->record_size);
+      rec->begin_index = GUINT32_FROM_LE (rec->begin_index);
+      rec->end_index = GUINT32_FROM_LE (rec->end_index);
+      rec->begin_time = GINT64_FROM_LE (rec->begin_time);
+      rec->end_time = GINT64_FROM_LE (rec->end_time);
+      rec->ctime = GINT64_FROM_LE (rec->ctime);
+      rec->index_size = GUINT64_FROM_LE (rec->index_size);
+      rec->data_size = GUINT64_FROM_LE (rec->data_size);
+      rec->n_compact_blocks = GUINT32_FROM_LE (rec->n_compact_blocks);
+
+      if ((rec->end_index < rec->begin_index) ||
+          ((size - offset) / sizeof (guint64) < rec->n_compact_blocks) ||
+          ((i > 0) && (rec->number <= g_array_index (manifest, HyScanDBChannelFileManifestPart, i - 1).rec.number)))
+        {
+          goto fail;
+        }
+
+      mpart.compact_blocks = NULL;
+      if (rec->version == FILE_VERSION_COMPACT)
+        {
+          mpart.compact_blocks = g_array_sized_new (FALSE, FALSE, sizeof (guint64), rec->n_compact_blocks);
+          g_array_set_size (mpart.compact_blocks, rec->n_compact_blocks);
+          memcpy (mpart.compact_blocks->data, data + offset, rec->n_compact_blocks * sizeof (guint64));
+
+          for (j = 0; j < rec->n_compact_blocks; j++)
+            {
+              guint64 *block = &g_array_index (mpart.compact_blocks, guint64, j);
+              *block = GUINT64_FROM_LE (*block);
+            }
+        }
+      offset += rec->n_compact_blocks * sizeof (guint64);
+
+      g_array_append_val (manifest, mpart);
+    }
+
+  if (offset != size)
+    goto fail;
+
+  goto exit;
+
+fail:
+  g_info ("HyScanDBChannelFile: channel '%s': invalid manifest file", priv->name);
+  g_clear_pointer (&manifest, g_array_unref);
+
+exit:
+  g_free (manifest_name);
+  g_free (data);
+
+  return manifest;
+}
+
+/* Функция ищет описание части с указанным номером. Части открываются по
+   порядку, поэтому поиск продолжается с позиции предыдущей найденной части. */
+static HyScanDBChannelFileManifestPart *
+hyscan_db_channel_file_find_manifest_part (GArray  *manifest,
+                                           guint   *position,
+                                           guint32  number)
+{
+  if (manifest == NULL)
+    return NULL;
+
+  while ((*position < manifest->len) &&
+         (g_array_index (manifest, HyScanDBChannelFileManifestPart, *position).rec.number < number))
+    {
+      *position += 1;
+    }
+
+  if ((*position < manifest->len) &&
+      (g_array_index (manifest, HyScanDBChannelFileManifestPart, *position).rec.number == number))
+    {
+      return &g_array_index (manifest, HyScanDBChannelFileManifestPart, *position);
+    }
+
+  return NULL;
+}
+
+/* Функция добавляет существующую часть в список частей при открытии канала.
+   Индексы части при необходимости отображаются или загружаются в память,
+   после чего файлы части закрываются и открываются при обращении к ней. */
+static void
+hyscan_db_channel_file_append_part (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFilePart    *fpart)
+{
+  priv->n_parts += 1;
+  priv->parts = g_realloc (priv->parts,
+                           32 * (((priv->n_parts + 1) / 32) + 1) * sizeof (HyScanDBChannelFilePart *));
+
+  priv->parts[priv->n_parts - 1] = fpart;
+  priv->parts[priv->n_parts] = NULL;
+
+  if (priv->ctime == 0)
+    priv->ctime = fpart->ctime;
+
+  priv->data_size += (fpart->data_size - DATA_FILE_HEADER_SIZE);
+
+  /* Существующие части данных не изменяются, отображаем их целиком и
+     загружаем индексы части в память. */
+  if ((priv->mmap_index || (priv->memory_index && !priv->memory_index_prefetch)) &&
+      hyscan_db_channel_file_open_part_fds (priv, fpart))
+    {
+      hyscan_db_channel_file_update_index_map (priv, fpart, TRUE);
+
+      if (priv->memory_index && !priv->memory_index_prefetch)
+        fpart->index_array = hyscan_db_channel_file_load_index (priv, fpart);
+    }
+
+  /* Файлы существующей части открываются по мере обращения к ним. */
+  hyscan_db_channel_file_seal_part_fds (priv, fpart, FALSE);
+}
+
+/* Функция создаёт части канала по файлу описания частей, не обращаясь к их
+   файлам. Используются описания, начиная с первой существующей части, с
+   непрерывными номерами частей и индексами. При открытии канала проверяются
+   только файлы последней из этих частей: если их размеры или контрольная
+   сумма не совпадают с описанием, файл описания частей считается устаревшим
+   и части проверяются чтением их файлов. Контрольные суммы файлов остальных
+   частей проверяются при первом обращении к ним. */
+static void
+hyscan_db_channel_file_open_manifest_parts (HyScanDBChannelFilePrivate *priv,
+                                            GArray                     *manifest,
+                                            guint32                     first_part)
+{
+  HyScanDBChannelFileManifestPart *mpart;
+  HyScanDBChannelFilePart *last_part = NULL;
+  GFileInfo *index_info;
+  GFileInfo *data_info;
+  GPtrArray *parts;
+  guint position = 0;
+  gboolean valid;
+  guint i;
+
+  mpart = hyscan_db_channel_file_find_manifest_part (manifest, &position, first_part);
+  if (mpart == NULL)
+    return;
+
+  parts = g_ptr_array_new ();
+
+  for (i = position; (i < manifest->len) && (parts->len < MAX_PARTS); i++)
+    {
+      HyScanDBChannelFilePart *fpart;
+      gchar *fname;
+
+      mpart = &g_array_index (manifest, HyScanDBChannelFileManifestPart, i);
+      if ((last_part != NULL) &&
+          ((mpart->rec.number != last_part->number + 1) || (mpart->rec.begin_index != last_part->end_index + 1)))
+        {
+          break;
+        }
+
+      fpart = g_new0 (HyScanDBChannelFilePart, 1);
+      fpart->number = mpart->rec.number;
+      fpart->version = mpart->rec.version;
+      fpart->record_size = mpart->rec.record_size;
+      fpart->begin_index = mpart->rec.begin_index;
+      fpart->end_index = mpart->rec.end_index;
+      fpart->begin_time = mpart->rec.begin_time;
+      fpart->end_time = mpart->rec.end_time;
+      fpart->ctime = mpart->rec.ctime;
+      fpart->index_size = mpart->rec.index_size;
+      fpart->data_size = mpart->rec.data_size;
+      fpart->packed = (mpart->rec.data_version == FILE_VERSION_PACKED);
+      if (mpart->compact_blocks != NULL)
+        fpart->compact_blocks = g_array_ref (mpart->compact_blocks);
+
+      memcpy (fpart->digest, mpart->rec.digest, MANIFEST_CHECKSUM_SIZE);
+      fpart->digest_valid = TRUE;
+      fpart->digest_check = TRUE;
+
+      fpart->ifdi = -1;
+      fpart->ifdd = -1;
+
+      fname = g_strdup_printf ("%s%s%s.%06u.i", priv->path, G_DIR_SEPARATOR_S, priv->name, fpart->number);
+      fpart->fdi = g_file_new_for_path (fname);
+      g_free (fname);
+
+      fname = g_strdup_printf ("%s%s%s.%06u.d", priv->path, G_DIR_SEPARATOR_S, priv->name, fpart->number);
+      fpart->fdd = g_file_new_for_path (fname);
+      g_free (fname);
+
+      g_ptr_array_add (parts, fpart);
+      last_part = fpart;
+    }
+
+  /* Проверяем размеры и контрольную сумму файлов последней части. */
+  index_info = g_file_query_info (last_part->fdi, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  data_info = g_file_query_info (last_part->fdd, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+  valid = (index_info != NULL) && (data_info != NULL) &&
+          ((guint64) g_file_info_get_size (index_info) == last_part->index_size) &&
+          ((guint64) g_file_info_get_size (data_info) == last_part->data_size);
+
+  g_clear_object (&index_info);
+  g_clear_object (&data_info);
+
+  /* При несовпадении контрольной суммы функция открытия файлов части
+     переводит канал в состояние ошибки. Здесь это означает только, что файл
+     описания частей устарел, а части будут проверены чтением файлов. */
+  if (valid)
+    {
+      valid = hyscan_db_channel_file_open_part_fds (priv, last_part);
+      priv->fail = FALSE;
+    }
+
+  if (!valid)
+    {
+      g_info ("HyScanDBChannelFile: channel '%s': manifest file is out of date", priv->name);
+      for (i = 0; i < parts->len; i++)
+        hyscan_db_channel_file_free_part (g_ptr_array_index (parts, i));
+      g_ptr_array_unref (parts);
+      return;
+    }
+
+  priv->readonly = TRUE;
+
+  for (i = 0; i < parts->len; i++)
+    hyscan_db_channel_file_append_part (priv, g_ptr_array_index (parts, i));
+
+  g_ptr_array_unref (parts);
+}
+
+/* Функция записывает файл описания частей канала. В файл записываются
+   завершённые части, а после завершения записи в канал и последняя часть.
+   Файл заменяется целиком, поэтому он всегда находится в согласованном
+   состоянии. */
+static void
+hyscan_db_channel_file_save_manifest (HyScanDBChannelFilePrivate *priv,
+                                      gboolean                    final)
+{
+  GByteArray *manifest;
+  GChecksum *checksum;
+  guint8 digest[MANIFEST_CHECKSUM_SIZE];
+  gsize digest_size = MANIFEST_CHECKSUM_SIZE;
+
+  HyScanDBChannelFileID id;
+  gchar *manifest_name;
+  guint32 n_parts;
+  guint32 reserved = 0;
+  guint i;
+
+  manifest = g_byte_array_new ();
+
+  id.magic = GUINT32_TO_LE (MANIFEST_FILE_MAGIC);
+  id.version = GUINT32_TO_LE (MANIFEST_VERSION);
+  id.ctime = GINT64_TO_LE (g_get_real_time () / G_USEC_PER_SEC);
+  g_byte_array_append (manifest, (const guint8 *) &id, FILE_HEADER_SIZE);
+  g_byte_array_set_size (manifest, MANIFEST_HEADER_SIZE);
+
+  /* Поля завершённых частей изменяются только при захваченной на запись
+     блокировке lock. */
+  g_rw_lock_reader_lock (&priv->lock);
+
+  n_parts = priv->n_parts;
+  if (!final && (n_parts > 0))
+    n_parts -= 1;
+
+  for (i = 0; i < n_parts; i++)
+    {
+      HyScanDBChannelFilePart *fpart = priv->parts[i];
+      HyScanDBChannelFileManifestRec rec;
+      guint32 n_compact_blocks;
+      guint j;
+
+      n_compact_blocks = (fpart->compact_blocks != NULL) ? fpart->compact_blocks->len : 0;
+
+      /* Контрольная сумма вычисляется один раз для каждой части и после её
+         сжатия. Без неё файл описания частей не записывается. */
+      if (!fpart->digest_valid)
+        {
+          if (!hyscan_db_channel_file_acquire_part (priv, fpart))
+            goto fail;
+
+          fpart->digest_valid = hyscan_db_channel_file_part_digest (fpart->ifdi, fpart->ifdd,
+                                                                    fpart->index_size, fpart->data_size,
+                                                                    fpart->digest);
+          hyscan_db_channel_file_release_part (priv, fpart);
+
+          if (!fpart->digest_valid)
+            goto fail;
+        }
+
+      rec.number = GUINT32_TO_LE (fpart->number);
+      rec.version = GUINT32_TO_LE (fpart->version);
+      rec.data_version = GUINT32_TO_LE (fpart->packed ? FILE_VERSION_PACKED : fpart->version);
+      rec.record_size = GUINT32_TO_LE (fpart->record_size);
+      rec.begin_index = GUINT32_TO_LE (fpart->begin_index);
+      rec.end_index = GUINT32_TO_LE (fpart->end_index);
+      rec.begin_time = GINT64_TO_LE (fpart->begin_time);
+      rec.end_time = GINT64_TO_LE (fpart->end_time);
+      rec.ctime = GINT64_TO_LE (fpart->ctime);
+      rec.index_size = GUINT64_TO_LE (fpart->index_size);
+      rec.data_size = GUINT64_TO_LE (fpart->data_size);
+      rec.n_compact_blocks = GUINT32_TO_LE (n_compact_blocks);
+      rec.reserved = 0;
+      memcpy (rec.digest, fpart->digest, MANIFEST_CHECKSUM_SIZE);
+      g_byte_array_append (manifest, (const guint8 *) &rec, MANIFEST_RECORD_SIZE);
+
+      for (j = 0; j < n_compact_blocks; j++)
+        {
+          guint64 block = GUINT64_TO_LE (g_array_index (fpart->compact_blocks, guint64, j));
+          g_byte_array_append (manifest, (const guint8 *) &block, sizeof (guint64));
+        }
+    }
+
+  g_rw_lock_reader_unlock (&priv->lock);
+
+  n_parts = GUINT32_TO_LE (n_parts);
+  memcpy (manifest->data + FILE_HEADER_SIZE, &n_parts, sizeof (guint32));
+  memcpy (manifest->data + FILE_HEADER_SIZE + sizeof (guint32), &reserved, sizeof (guint32));
+
+  /* Контрольная сумма содержимого файла. */
+  checksum = g_checksum_new (G_CHECKSUM_MD5);
+  g_checksum_update (checksum, manifest->data, manifest->len);
+  g_checksum_get_digest (checksum, digest, &digest_size);
+  g_checksum_free (checksum);
+  g_byte_array_append (manifest, digest, MANIFEST_CHECKSUM_SIZE);
+
+  manifest_name = hyscan_db_channel_file_manifest_name (priv);
+  if (!g_file_set_contents (manifest_name, (const gchar *) manifest->data, manifest->len, NULL))
+    g_warning ("HyScanDBChannelFile: channel '%s': can't write manifest file", priv->name);
+
+  g_free (manifest_name);
+  g_byte_array_unref (manifest);
+
+  return;
+
+fail:
+  g_rw_lock_reader_unlock (&priv->lock);
+  g_warning ("HyScanDBChannelFile: channel '%s': can't compute part checksum", priv->name);
+  g_byte_array_unref (manifest);
+}
+
+/* Функция запрашивает у потока обслуживания запись файла описания частей.
+   Признак завершения записи в канал сохраняется до отключения канала от
+   потока обслуживания. В канале, открытом только для чтения, все части
+   завершены. */
+static void
+hyscan_db_channel_file_request_manifest (HyScanDBChannelFilePrivate *priv,
+                                         gboolean                    final)
+{
+  if (!priv->maint)
+    return;
+
+  g_mutex_lock (&priv->maint_lock);
+  priv->manifest_request = TRUE;
+  priv->manifest_final |= final || priv->readonly;
+  g_mutex_unlock (&priv->maint_lock);
+
+  hyscan_db_channel_file_maint_schedule (priv);
+}
+
+/* Функция выделяет место в файлах части, если записываемые индексы и данные
+   выходят за пределы ранее выделенного места. Размер области выделения
+   определяется скоростью записи в часть. Функция должна вызываться при
+   захваченной блокировке write_lock. */
+static void
+hyscan_db_channel_file_preallocate (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFilePart    *fpart,
+                                    guint64                     index_end,
+                                    guint64                     data_end)
+{
+#if defined (__linux__) && defined (FALLOC_FL_KEEP_SIZE)
+  guint64 max_part_size;
+  guint64 data_extent;
+  guint64 index_extent;
+  gint64 elapsed;
+
+  if (priv->preallocate_size == 0)
+    return;
+  if ((data_end <= fpart->data_alloc_size) && (index_end <= fpart->index_alloc_size))
+    return;
+
+  /* Объём данных, записываемых в часть за PREALLOCATE_TIME. */
+  elapsed = MAX (g_get_monotonic_time () - fpart->create_time, PREALLOCATE_TIME);
+  data_extent = (data_end - DATA_FILE_HEADER_SIZE) * PREALLOCATE_TIME / elapsed;
+  data_extent = CLAMP (data_extent, PREALLOCATE_MIN_SIZE, MAX (priv->preallocate_size, PREALLOCATE_MIN_SIZE));
+
+  /* Область индексов пропорциональна области данных. */
+  index_extent = data_extent * index_end / MAX (data_end, 1);
+  index_extent = MAX (index_extent, PREALLOCATE_MIN_INDEX_SIZE);
+
+  /* Место выделяется не далее максимального размера части. */
+  max_part_size = MIN (priv->max_data_file_size, priv->save_size / 5);
+
+  if (data_end > fpart->data_alloc_size)
+    {
+      guint64 alloc_size = MAX (MIN (data_end + data_extent, max_part_size), data_end);
+
+      if (fallocate (fpart->ifdd, FALLOC_FL_KEEP_SIZE, fpart->data_alloc_size,
+                     alloc_size - fpart->data_alloc_size) != 0)
+        {
+          goto fail;
+        }
+
+      fpart->data_alloc_size = alloc_size;
+    }
+
+  if (index_end > fpart->index_alloc_size)
+    {
+      guint64 alloc_size = index_end + index_extent;
+
+      if (fallocate (fpart->ifdi, FALLOC_FL_KEEP_SIZE, fpart->index_alloc_size,
+                     alloc_size - fpart->index_alloc_size) != 0)
+        {
+          goto fail;
+        }
+
+      fpart->index_alloc_size = alloc_size;
+    }
+
+  return;
+
+fail:
+  /* Файловая система не поддерживает выделение места или место закончилось,
+     в последнем случае ошибку вернёт запись данных. */
+  g_info ("HyScanDBChannelFile: channel '%s': can't preallocate file space: %s",
+          priv->name, g_strerror (errno));
+  priv->preallocate_size = 0;
+#endif
+}
+
+/* Функция освобождает выделенное, но не использованное место в файлах части.
+   Функция должна вызываться при захваченной блокировке write_lock после
+   записи буфера отложенной записи. */
+static void
+hyscan_db_channel_file_trim_part (HyScanDBChannelFilePrivate *priv,
+                                  HyScanDBChannelFilePart    *fpart)
+{
+#if defined (__linux__) && defined (FALLOC_FL_KEEP_SIZE)
+  /* Усечение файла до его текущего размера освобождает блоки за концом файла. */
+  if ((fpart->data_alloc_size > fpart->data_size) && (ftruncate (fpart->ifdd, fpart->data_size) != 0))
+    g_warning ("HyScanDBChannelFile: channel '%s': can't trim data file", priv->name);
+
+  if ((fpart->index_alloc_size > fpart->index_size) && (ftruncate (fpart->ifdi, fpart->index_size) != 0))
+    g_warning ("HyScanDBChannelFile: channel '%s': can't trim index file", priv->name);
+
+  fpart->data_alloc_size = 0;
+  fpart->index_alloc_size = 0;
+#endif
+}
+
+/* Функция записывает индексы и данные в файлы части. Смещения задают
+   положение записываемых индексов и данных в файлах и используются при
+   записи через io_uring, в этом случае обе операции передаются ядру
+   одновременно. Иначе индексы и данные дописываются в конец файлов потоками
+   записи. Функция должна вызываться при захваченной блокировке write_lock. */
+static gboolean
+hyscan_db_channel_file_write_part (HyScanDBChannelFilePrivate *priv,
+                                   HyScanDBChannelFilePart    *fpart,
+                                   gconstpointer               index_data,
+                                   gsize                       index_size,
+                                   guint64                     index_offset,
+                                   gconstpointer               data,
+                                   gsize                       data_size,
+                                   guint64                     data_offset)
+{
+  hyscan_db_channel_file_preallocate (priv, fpart, index_offset + index_size, data_offset + data_size);
+
+  if (priv->write_uring != NULL)
+    {
+      hyscan_db_uring_write (priv->write_uring, fpart->ifdi, index_data, index_size, index_offset);
+      hyscan_db_uring_write (priv->write_uring, fpart->ifdd, data, data_size, data_offset);
+
+      if (!hyscan_db_uring_submit (priv->write_uring))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': can't write index or data", priv->name);
+          priv->fail = TRUE;
+          return FALSE;
+        }
+
+      return TRUE;
+    }
+
+  /* Записываем индексы. */
+  if (!g_output_stream_write_all (fpart->ofdi, index_data, index_size, NULL, NULL, NULL))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write index", priv->name);
+      priv->fail = TRUE;
+      return FALSE;
+    }
+
+  if (!g_output_stream_flush (fpart->ofdi, NULL, NULL))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't flush index", priv->name);
+      priv->fail = TRUE;
+      return FALSE;
+    }
+
+  /* Записываем данные. */
+  if (!g_output_stream_write_all (fpart->ofdd, data, data_size, NULL, NULL, NULL))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write data", priv->name);
+      priv->fail = TRUE;
+      return FALSE;
+    }
+
+  if (!g_output_stream_flush (fpart->ofdd, NULL, NULL))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't flush data", priv->name);
+      priv->fail = TRUE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Функция записывает в файлы индексы и данные из буфера отложенной записи.
+   Буфер очищается после записи, до этого читающие потоки используют данные
+   из буфера. Функция должна вызываться при захваченной блокировке write_lock. */
+static gboolean
+hyscan_db_channel_file_flush_buffers (HyScanDBChannelFilePrivate *priv)
+{
+  HyScanDBChannelFilePart *fpart;
+  guint64 index_offset;
+  guint64 data_offset;
+
+  if (priv->index_buffer->len == 0)
+    return TRUE;
+
+  fpart = priv->parts[priv->n_parts - 1];
+
+  /* Буфер содержит последние записи части. */
+  index_offset = fpart->index_size - priv->index_buffer->len;
+  data_offset = fpart->data_size - priv->data_buffer->len;
+
+  /* Записываем индексы и данные. */
+  if (!hyscan_db_channel_file_write_part (priv, fpart,
+                                          priv->index_buffer->data, priv->index_buffer->len, index_offset,
+                                          priv->data_buffer->data, priv->data_buffer->len, data_offset))
+    return FALSE;
+
+  /* Очищаем буфер, теперь данные считываются из файлов. */
+  g_rw_lock_writer_lock (&priv->lock);
+  g_byte_array_set_size (priv->index_buffer, 0);
+  g_byte_array_set_size (priv->data_buffer, 0);
+  hyscan_db_channel_file_update_index_map (priv, fpart, FALSE);
+  g_rw_lock_writer_unlock (&priv->lock);
+
+  return TRUE;
+}
+
+/* Поток записи буфера отложенной записи по истечении времени write_buffer_time. */
+static gpointer
+hyscan_db_channel_file_flush_thread (gpointer data)
+{
+  HyScanDBChannelFilePrivate *priv = data;
+
+  g_mutex_lock (&priv->write_lock);
+
+  while (!priv->flush_shutdown)
+    {
+      gint64 flush_time;
+
+      /* Буфер пуст, ждём записи данных. */
+      if (priv->index_buffer->len == 0)
+        {
+          g_cond_wait (&priv->flush_cond, &priv->write_lock);
+          continue;
+        }
+
+      /* Время нахождения данных в буфере истекло. */
+      flush_time = priv->buffer_time + priv->write_buffer_time;
+      if (g_get_monotonic_time () >= flush_time)
+        {
+          if (!priv->fail)
+            hyscan_db_channel_file_flush_buffers (priv);
+          else
+            g_cond_wait (&priv->flush_cond, &priv->write_lock);
+
+          continue;
+        }
+
+      g_cond_wait_until (&priv->flush_cond, &priv->write_lock, flush_time);
+    }
+
+  g_mutex_unlock (&priv->write_lock);
+
+  return NULL;
+}
+
+/* Функция завершает поток записи буфера. */
+static void
+hyscan_db_channel_file_stop_flush_thread (HyScanDBChannelFilePrivate *priv)
+{
+  if (priv->flush_thread == NULL)
+    return;
+
+  g_mutex_lock (&priv->write_lock);
+  priv->flush_shutdown = TRUE;
+  g_cond_signal (&priv->flush_cond);
+  g_mutex_unlock (&priv->write_lock);
+
+  g_thread_join (priv->flush_thread);
+  priv->flush_thread = NULL;
+}
+
+/* Функция синхронизирует файлы части данных с диском. Сначала синхронизируется
+   файл данных, затем файл индексов, чтобы индекс не ссылался на отсутствующие
+   на диске данные. */
+static gboolean
+hyscan_db_channel_file_sync_part (HyScanDBChannelFilePrivate *priv,
+                                  HyScanDBChannelFilePart    *fpart)
+{
+  gint fds[2];
+  guint i;
+
+  fds[0] = fpart->ifdd;
+  fds[1] = fpart->ifdi;
+
+  for (i = 0; i < G_N_ELEMENTS (fds); i++)
+    {
+#ifdef G_OS_WIN32
+      if (!FlushFileBuffers ((HANDLE) _get_osfhandle (fds[i])))
+#elif defined (__linux__)
+      if (fdatasync (fds[i]) != 0)
+#else
+      if (fsync (fds[i]) != 0)
+#endif
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': can't sync files", priv->name);
+          priv->fail = TRUE;
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+/* Поток синхронизации файлов последней части данных с диском. */
+static gpointer
+hyscan_db_channel_file_sync_thread (gpointer data)
+{
+  HyScanDBChannelFilePrivate *priv = data;
+
+  g_mutex_lock (&priv->sync_lock);
+
+  while (!priv->sync_shutdown)
+    {
+      guint64 sync_request;
+
+      /* Нет записей, ожидающих синхронизации. */
+      if (priv->sync_request == priv->sync_done)
+        {
+          g_cond_wait (&priv->sync_cond, &priv->sync_lock);
+          continue;
+        }
+
+      /* В режиме периодической синхронизации ждём истечения интервала. */
+      if (priv->durability == HYSCAN_DB_DURABILITY_SYNC)
+        {
+          gint64 sync_time = priv->sync_time + SYNC_INTERVAL;
+
+          if (g_get_monotonic_time () < sync_time)
+            {
+              g_cond_wait_until (&priv->sync_cond, &priv->sync_lock, sync_time);
+              continue;
+            }
+        }
+
+      /* Все записи, поступившие до этого момента, будут синхронизированы. */
+      sync_request = priv->sync_request;
+      g_mutex_unlock (&priv->sync_lock);
+
+      /* Предыдущие части синхронизируются записывающим потоком при создании новой. */
+      g_rw_lock_reader_lock (&priv->lock);
+      hyscan_db_channel_file_sync_part (priv, priv->parts[priv->n_parts - 1]);
+      g_rw_lock_reader_unlock (&priv->lock);
+
+      g_mutex_lock (&priv->sync_lock);
+      priv->sync_done = sync_request;
+      priv->sync_time = g_get_monotonic_time ();
+      g_cond_broadcast (&priv->sync_cond);
+    }
+
+  g_mutex_unlock (&priv->sync_lock);
+
+  return NULL;
+}
+
+/* Функция завершает поток синхронизации. Ожидающие синхронизации
+   записывающие потоки при этом освобождаются. */
+static void
+hyscan_db_channel_file_stop_sync_thread (HyScanDBChannelFilePrivate *priv)
+{
+  if (priv->sync_thread == NULL)
+    return;
+
+  g_mutex_lock (&priv->sync_lock);
+  priv->sync_shutdown = TRUE;
+  g_cond_broadcast (&priv->sync_cond);
+  g_mutex_unlock (&priv->sync_lock);
+
+  g_thread_join (priv->sync_thread);
+  priv->sync_thread = NULL;
+}
+
+/* Функция записывает данные в файл по текущей позиции. */
+static gboolean
+hyscan_db_channel_file_write_fd (gint          fd,
+                                 gconstpointer buffer,
+                                 gsize         size)
+{
+  const guint8 *data = buffer;
+
+  while (size > 0)
+    {
+      gssize nwritten;
+
+      nwritten = write (fd, data, MIN (size, G_MAXINT32));
+      if ((nwritten < 0) && (errno == EINTR))
+        continue;
+      if (nwritten <= 0)
+        return FALSE;
+
+      data += nwritten;
+      size -= nwritten;
+    }
+
+  return TRUE;
+}
+
+/* Функция считывает таблицу блоков сжатой части из окончания файла данных и
+   проверяет её. Функция возвращает таблицу блоков в порядке байт системы или
+   NULL в случае ошибки. */
+static HyScanDBChannelFileBlockRec *
+hyscan_db_channel_file_load_blocks (gint                 fd,
+                                    guint64              file_size,
+                                    guint               *n_blocks,
+                                    guint64             *raw_size,
+                                    HyScanDBCompression *compression)
+{
+  HyScanDBChannelFileBlockRec *blocks;
+  HyScanDBChannelFilePackTail tail;
+  guint64 table_offset;
+  guint64 raw_offset;
+  guint64 offset;
+  guint i;
+
+  if (file_size < DATA_FILE_HEADER_SIZE + PACK_TAIL_SIZE)
+    return NULL;
+
+  if (!hyscan_db_channel_file_pread (fd, &tail, PACK_TAIL_SIZE, file_size - PACK_TAIL_SIZE))
+    return NULL;
+
+  *n_blocks = GUINT32_FROM_LE (tail.n_blocks);
+  *raw_size = GUINT64_FROM_LE (tail.raw_size);
+  *compression = GUINT32_FROM_LE (tail.compression);
+
+  if ((*n_blocks == 0) || !hyscan_db_codec_is_supported (*compression))
+    return NULL;
+
+  /* Таблица блоков расположена перед окончанием файла. */
+  if ((guint64) *n_blocks * BLOCK_RECORD_SIZE > file_size - DATA_FILE_HEADER_SIZE - PACK_TAIL_SIZE)
+    return NULL;
+
+  table_offset = file_size - PACK_TAIL_SIZE - (guint64) *n_blocks * BLOCK_RECORD_SIZE;
+
+  blocks = g_new (HyScanDBChannelFileBlockRec, *n_blocks);
+  if (!hyscan_db_channel_file_pread (fd, blocks, (gsize) *n_blocks * BLOCK_RECORD_SIZE, table_offset))
+    goto fail;
+
+  /* Блоки должны следовать друг за другом и в исходном, и в сжатом файле. */
+  raw_offset = DATA_FILE_HEADER_SIZE;
+  offset = DATA_FILE_HEADER_SIZE;
+  for (i = 0; i < *n_blocks; i++)
+    {
+      blocks[i].raw_offset = GUINT64_FROM_LE (blocks[i].raw_offset);
+      blocks[i].offset = GUINT64_FROM_LE (blocks[i].offset);
+      blocks[i].raw_size = GUINT32_FROM_LE (blocks[i].raw_size);
+      blocks[i].size = GUINT32_FROM_LE (blocks[i].size);
+
+      if ((blocks[i].raw_offset != raw_offset) || (blocks[i].offset != offset) ||
+          (blocks[i].size > blocks[i].raw_size))
+        {
+          goto fail;
+        }
+
+      raw_offset += blocks[i].raw_size;
+      offset += blocks[i].size;
+    }
+
+  if ((raw_offset != *raw_size) || (offset != table_offset))
+    goto fail;
+
+  return blocks;
+
+fail:
+  g_free (blocks);
+
+  return NULL;
+}
+
+/* Функция переставляет байты записей фиксированного размера так, чтобы
+   одноимённые байты всех записей блока располагались подряд, по столбцам.
+   Соседние записи таких каналов близки по значению, поэтому столбцы
+   сжимаются значительно лучше. Если inverse равен TRUE, выполняется обратная
+   перестановка. */
+static void
+hyscan_db_channel_file_transpose (const guint8 *input,
+                                  guint8       *output,
+                                  gsize         size,
+                                  guint32       record_size,
+                                  gboolean      inverse)
+{
+  gsize n_records = size / record_size;
+  gsize i;
+  guint32 j;
+
+  for (i = 0; i < n_records; i++)
+    {
+      for (j = 0; j < record_size; j++)
+        {
+          if (inverse)
+            output[i * record_size + j] = input[j * n_records + i];
+          else
+            output[j * n_records + i] = input[i * record_size + j];
+        }
+    }
+}
+
+/* Функция возвращает распакованные данные блока сжатой части. Последний
+   распакованный блок каждой части хранится в памяти, поэтому при
+   последовательном чтении каждый блок распаковывается один раз. Функция
+   должна вызываться при захваченной на чтение блокировке lock. */
+static GBytes *
+hyscan_db_channel_file_get_block (HyScanDBChannelFilePrivate *priv,
+                                  HyScanDBChannelFilePart    *fpart,
+                                  guint                       n_block)
+{
+  HyScanDBChannelFileBlockRec *block = &fpart->blocks[n_block];
+  GBytes *block_data = NULL;
+  gpointer stored_data;
+  gpointer raw_data;
+
+  g_mutex_lock (&priv->block_lock);
+  if ((fpart->block_data != NULL) && (fpart->block_index == n_block))
+    block_data = g_bytes_ref (fpart->block_data);
+  g_mutex_unlock (&priv->block_lock);
+
+  if (block_data != NULL)
+    return block_data;
+
+  /* Считываем блок из файла. */
+  stored_data = g_malloc (block->size);
+  if (!hyscan_db_channel_file_pread_data (priv, fpart, stored_data, block->size, block->offset))
+    {
+      g_free (stored_data);
+      return NULL;
+    }
+
+  /* Блок, который не удалось сжать, хранится без изменений. */
+  if (block->size == block->raw_size)
+    {
+      raw_data = stored_data;
+    }
+  else
+    {
+      raw_data = g_malloc (block->raw_size);
+      if (!hyscan_db_codec_decompress (fpart->pack_compression, stored_data, block->size,
+                                       raw_data, block->raw_size))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': can't decompress data block", priv->name);
+          priv->fail = TRUE;
+          g_free (stored_data);
+          g_free (raw_data);
+          return NULL;
+        }
+      g_free (stored_data);
+    }
+
+  /* Блоки частей с записями фиксированного размера хранятся по столбцам. */
+  if (fpart->record_size > 1)
+    {
+      gpointer column_data = raw_data;
+
+      raw_data = g_malloc (block->raw_size);
+      hyscan_db_channel_file_transpose (column_data, raw_data, block->raw_size, fpart->record_size, TRUE);
+      g_free (column_data);
+    }
+
+  block_data = g_bytes_new_take (raw_data, block->raw_size);
+
+  g_mutex_lock (&priv->block_lock);
+  g_clear_pointer (&fpart->block_data, g_bytes_unref);
+  fpart->block_data = g_bytes_ref (block_data);
+  fpart->block_index = n_block;
+  g_mutex_unlock (&priv->block_lock);
+
+  return block_data;
+}
+
+/* Функция считывает данные сжатой части. Смещение и размер данных задаются
+   в исходном файле данных, данные могут занимать несколько блоков. Функция
+   должна вызываться при захваченной на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_packed (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFilePart    *fpart,
+                                    gpointer                    data,
+                                    guint32                     size,
+                                    guint64                     offset)
+{
+  guint8 *output = data;
+  guint64 end = offset + size;
+  guint begin = 0;
+  guint last = fpart->n_blocks;
+  guint i;
+
+  /* Ищем блок, содержащий начало данных. */
+  while (last - begin > 1)
+    {
+      guint middle = begin + (last - begin) / 2;
+
+      if (fpart->blocks[middle].raw_offset <= offset)
+        begin = middle;
+      else
+        last = middle;
+    }
+
+  for (i = begin; offset < end; i++)
+    {
+      HyScanDBChannelFileBlockRec *block = &fpart->blocks[i];
+      GBytes *block_data;
+      guint64 copy_size;
+
+      if ((i == fpart->n_blocks) || (offset < block->raw_offset))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': data is out of packed blocks", priv->name);
+          priv->fail = TRUE;
+          return FALSE;
+        }
+
+      block_data = hyscan_db_channel_file_get_block (priv, fpart, i);
+      if (block_data == NULL)
+        return FALSE;
+
+      copy_size = MIN (end, block->raw_offset + block->raw_size) - offset;
+      memcpy (output, (const guint8 *) g_bytes_get_data (block_data, NULL) + (offset - block->raw_offset), copy_size);
+      g_bytes_unref (block_data);
+
+      output += copy_size;
+      offset += copy_size;
+    }
+
+  return TRUE;
+}
+
+/* Функция сжимает блок исходных данных части и записывает его в файл. */
+static gboolean
+hyscan_db_channel_file_pack_block (HyScanDBChannelFilePrivate  *priv,
+                                   HyScanDBCodec               *codec,
+                                   gint                         ifdd,
+                                   gint                         ofdp,
+                                   GByteArray                  *raw_data,
+                                   GByteArray                  *packed_data,
+                                   GArray                      *blocks,
+                                   guint64                      raw_offset,
+                                   guint64                      raw_size,
+                                   guint32                      record_size)
+{
+  HyScanDBChannelFileBlockRec block;
+  guint8 *stored_data;
+  gsize stored_size;
+
+  g_byte_array_set_size (raw_data, raw_size);
+  if (!hyscan_db_channel_file_pread (ifdd, raw_data->data, raw_size, raw_offset))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't read data for packing", priv->name);
+      return FALSE;
+    }
+
+  /* Записи фиксированного размера сжимаются по столбцам. */
+  if (record_size > 1)
+    {
+      guint8 *column_data = g_malloc (raw_size);
+
+      hyscan_db_channel_file_transpose (raw_data->data, column_data, raw_size, record_size, FALSE);
+      memcpy (raw_data->data, column_data, raw_size);
+      g_free (column_data);
+    }
+
+  /* Сжатый блок должен быть меньше исходного, иначе блок хранится без сжатия. */
+  g_byte_array_set_size (packed_data, raw_size);
+  stored_size = hyscan_db_codec_compress (codec, raw_data->data, raw_size, packed_data->data, raw_size - 1);
+  stored_data = packed_data->data;
+  if (stored_size == 0)
+    {
+      stored_size = raw_size;
+      stored_data = raw_data->data;
+    }
+
+  if (!hyscan_db_channel_file_write_fd (ofdp, stored_data, stored_size))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write packed data", priv->name);
+      return FALSE;
+    }
+
+  block.raw_offset = raw_offset;
+  block.offset = DATA_FILE_HEADER_SIZE;
+  if (blocks->len > 0)
+    {
+      HyScanDBChannelFileBlockRec *prev = &g_array_index (blocks, HyScanDBChannelFileBlockRec, blocks->len - 1);
+      block.offset = prev->offset + prev->size;
+    }
+  block.raw_size = raw_size;
+  block.size = stored_size;
+  g_array_append_val (blocks, block);
+
+  return TRUE;
+}
+
+/* Функция сжимает завершённую часть данных. Данные части группируются в
+   блоки из целых записей размером не менее PACK_BLOCK_SIZE, каждый блок
+   сжимается отдельно. Сжатые данные, таблица блоков и окончание файла
+   записываются во временный файл, который затем заменяет файл данных части.
+   Файл индексов не изменяется: смещения в нём относятся к исходному файлу
+   данных и пересчитываются по таблице блоков при чтении. Запись в канал
+   блокируется только на время поиска части и замены файла. */
+static gboolean
+hyscan_db_channel_file_pack_part (HyScanDBChannelFilePrivate *priv,
+                                  guint32                     begin_index)
+{
+  HyScanDBChannelFilePart *fpart;
+  HyScanDBChannelFileIndexRec *rec_indexes = NULL;
+  HyScanDBChannelFileBlockRec *block_table;
+  HyScanDBChannelFilePackTail tail;
+  HyScanDBChannelFileID id;
+  HyScanDBCodec *codec = NULL;
+  GByteArray *raw_data = NULL;
+  GByteArray *packed_data = NULL;
+  GArray *blocks = NULL;
+  GFile *fdd = NULL;
+
+  gchar *pack_name = NULL;
+  gchar *data_name = NULL;
+  gint ifdi = -1;
+  gint ifdd = -1;
+  gint ofdp = -1;
+  gint new_ifdd = -1;
+
+  guint32 version = 0;
+  guint32 record_size = 0;
+  guint32 n_records = 0;
+  guint32 n_indexes = 0;
+  guint64 index_size = 0;
+  guint64 index_position;
+  guint64 raw_size = 0;
+  guint64 pack_size;
+  guint64 block_begin;
+  guint64 block_end;
+  guint32 i;
+
+  gboolean status = FALSE;
+
+  /* Ищем завершённую и ещё не сжатую часть. Список частей и имена файлов
+     изменяет только записывающий поток при захваченной блокировке write_lock. */
+  g_mutex_lock (&priv->write_lock);
+
+  fpart = hyscan_db_channel_file_find_part (priv, begin_index);
+  if ((fpart != NULL) && (fpart->begin_index == begin_index) &&
+      (fpart->ofdd == NULL) && !fpart->packed)
+    {
+      gchar *index_name = g_file_get_path (fpart->fdi);
+
+      data_name = g_file_get_path (fpart->fdd);
+      fdd = g_object_ref (fpart->fdd);
+      ifdi = g_open (index_name, O_RDONLY | O_BINARY, 0);
+      ifdd = g_open (data_name, O_RDONLY | O_BINARY, 0);
+      g_free (index_name);
+
+      version = fpart->version;
+      record_size = fpart->record_size;
+      n_records = fpart->end_index - fpart->begin_index + 1;
+      index_size = fpart->index_size;
+      raw_size = fpart->data_size;
+    }
+
+  g_mutex_unlock (&priv->write_lock);
+
+  /* Часть удалена или уже сжата. */
+  if (fdd == NULL)
+    return TRUE;
+
+  pack_name = g_strdup_printf ("%s%s%s.%s", priv->path, G_DIR_SEPARATOR_S, priv->name, PACK_FILE_EXT);
+  ofdp = g_open (pack_name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+
+  if ((ifdi < 0) || (ifdd < 0) || (ofdp < 0))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't open files for packing", priv->name);
+      goto exit;
+    }
+
+  /* Заголовок файла данных сохраняется, изменяется только версия. */
+  if (!hyscan_db_channel_file_pread (ifdd, &id, FILE_HEADER_SIZE, 0))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't read data file header", priv->name);
+      goto exit;
+    }
+
+  id.version = GUINT32_TO_LE (FILE_VERSION_PACKED);
+  if (!hyscan_db_channel_file_write_fd (ofdp, &id, FILE_HEADER_SIZE))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write packed data", priv->name);
+      goto exit;
+    }
+
+  codec = hyscan_db_codec_new (priv->pack_compression);
+  raw_data = g_byte_array_new ();
+  packed_data = g_byte_array_new ();
+  blocks = g_array_new (FALSE, FALSE, BLOCK_RECORD_SIZE);
+  rec_indexes = g_new (HyScanDBChannelFileIndexRec, PACK_INDEX_RECORDS);
+
+  /* Группируем записи в блоки. Смещения записей фиксированного размера
+     вычисляются по их номерам, индексы при этом не считываются. Компактные
+     индексы считываются поблочно. */
+  block_begin = DATA_FILE_HEADER_SIZE;
+  block_end = DATA_FILE_HEADER_SIZE;
+  index_position = INDEX_FILE_HEADER_SIZE;
+  for (i = 0; i < n_records; i += n_indexes)
+    {
+      gboolean index_status = TRUE;
+      guint32 j;
+
+      if (g_atomic_int_get (&priv->pack_shutdown))
+        goto exit;
+
+      if (version == FILE_VERSION_COMPACT)
+        {
+          gsize block_size;
+
+          index_status = hyscan_db_channel_file_read_compact_block (ifdi, index_position, index_size,
+                                                                   rec_indexes, &n_indexes, &block_size);
+          index_position += block_size;
+        }
+      else
+        {
+          n_indexes = MIN (PACK_INDEX_RECORDS, n_records - i);
+
+          if (record_size == 0)
+            {
+              index_status = hyscan_db_channel_file_pread (ifdi, rec_indexes, (gsize) n_indexes * INDEX_RECORD_SIZE,
+                                                          INDEX_FILE_HEADER_SIZE + (guint64) i * INDEX_RECORD_SIZE);
+              hyscan_db_channel_file_index_from_le (rec_indexes, n_indexes);
+            }
+        }
+
+      if (!index_status)
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': can't read index for packing", priv->name);
+          goto exit;
+        }
+
+      for (j = 0; j < n_indexes; j++)
+        {
+          guint64 offset;
+          guint32 size;
+
+          if (record_size > 0)
+            {
+              offset = DATA_FILE_HEADER_SIZE + (guint64) (i + j) * record_size;
+              size = record_size;
+            }
+          else
+            {
+              offset = rec_indexes[j].offset;
+              size = hyscan_db_channel_file_stored_size (version, &rec_indexes[j]);
+            }
+
+          if (offset != block_end)
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': invalid record offset", priv->name);
+              goto exit;
+            }
+
+          /* Блок заполнен, новая запись начинает следующий. */
+          if (block_end - block_begin >= PACK_BLOCK_SIZE)
+            {
+              if (!hyscan_db_channel_file_pack_block (priv, codec, ifdd, ofdp, raw_data, packed_data,
+                                                      blocks, block_begin, block_end - block_begin, record_size))
+                {
+                  goto exit;
+                }
+
+              block_begin = block_end;
+            }
+
+          block_end += size;
+        }
+    }
+
+  if ((block_end != raw_size) ||
+      !hyscan_db_channel_file_pack_block (priv, codec, ifdd, ofdp, raw_data, packed_data,
+                                          blocks, block_begin, block_end - block_begin, record_size))
+    {
+      goto exit;
+    }
+
+  /* Таблица блоков и окончание файла. */
+  block_table = (HyScanDBChannelFileBlockRec *) blocks->data;
+  pack_size = block_table[blocks->len - 1].offset + block_table[blocks->len - 1].size;
+  pack_size += (guint64) blocks->len * BLOCK_RECORD_SIZE + PACK_TAIL_SIZE;
+
+  for (i = 0; i < blocks->len; i++)
+    {
+      HyScanDBChannelFileBlockRec block;
+
+      block.raw_offset = GUINT64_TO_LE (block_table[i].raw_offset);
+      block.offset = GUINT64_TO_LE (block_table[i].offset);
+      block.raw_size = GUINT32_TO_LE (block_table[i].raw_size);
+      block.size = GUINT32_TO_LE (block_table[i].size);
+
+      if (!hyscan_db_channel_file_write_fd (ofdp, &block, BLOCK_RECORD_SIZE))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': can't write packed data", priv->name);
+          goto exit;
+        }
+    }
+
+  tail.raw_size = GUINT64_TO_LE (raw_size);
+  tail.n_blocks = GUINT32_TO_LE (blocks->len);
+  tail.compression = GUINT32_TO_LE (priv->pack_compression);
+  if (!hyscan_db_channel_file_write_fd (ofdp, &tail, PACK_TAIL_SIZE))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't write packed data", priv->name);
+      goto exit;
+    }
+
+  /* Сжатый файл должен быть записан на диск до замены им исходного. */
+#ifdef G_OS_WIN32
+  if (!FlushFileBuffers ((HANDLE) _get_osfhandle (ofdp)))
+#else
+  if (fsync (ofdp) != 0)
+#endif
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't sync packed data", priv->name);
+      goto exit;
+    }
+
+  g_close (ofdp, NULL);
+  ofdp = -1;
+
+  /* Сжатие не уменьшило размер части. */
+  if (pack_size >= raw_size)
+    goto exit;
+
+  /* Заменяем файл данных, если часть не была удалена. */
+  g_mutex_lock (&priv->write_lock);
+
+  fpart = hyscan_db_channel_file_find_part (priv, begin_index);
+  if ((fpart == NULL) || (fpart->begin_index != begin_index))
+    {
+      g_mutex_unlock (&priv->write_lock);
+      status = TRUE;
+      goto exit;
+    }
+
+  if (g_rename (pack_name, data_name) != 0)
+    {
+      g_mutex_unlock (&priv->write_lock);
+      g_warning ("HyScanDBChannelFile: channel '%s': can't replace data file", priv->name);
+      goto exit;
+    }
+
+  new_ifdd = g_open (data_name, O_RDONLY | O_BINARY, 0);
+  if (new_ifdd < 0)
+    {
+      /* Файл уже заменён, читать данные через старый дескриптор нельзя. */
+      g_mutex_unlock (&priv->write_lock);
+      g_warning ("HyScanDBChannelFile: channel '%s': can't open packed data file", priv->name);
+      priv->fail = TRUE;
+      goto exit;
+    }
+
+  /* Читающие потоки переключаются на сжатый файл. Старый дескриптор
+     закрывается после освобождения блокировки. Если дескрипторы части
+     закрыты, сжатый файл будет открыт при следующем обращении. */
+  g_rw_lock_writer_lock (&priv->lock);
+
+  g_close (ifdd, NULL);
+  ifdd = -1;
+
+  g_mutex_lock (&priv->fd_lock);
+  if (fpart->ifdd >= 0)
+    {
+      ifdd = fpart->ifdd;
+      fpart->ifdd = new_ifdd;
+    }
+  else
+    {
+      g_close (new_ifdd, NULL);
+    }
+  g_mutex_unlock (&priv->fd_lock);
+  fpart->packed = TRUE;
+  fpart->n_blocks = blocks->len;
+  fpart->blocks = (HyScanDBChannelFileBlockRec *) g_array_free (blocks, FALSE);
+  fpart->pack_compression = priv->pack_compression;
+  fpart->digest_valid = FALSE;
+  blocks = NULL;
+
+  priv->data_size -= fpart->data_size - pack_size;
+  fpart->data_size = pack_size;
+
+  g_rw_lock_writer_unlock (&priv->lock);
+
+  g_mutex_unlock (&priv->write_lock);
+
+  g_mutex_lock (&priv->pack_lock);
+  priv->pack_in += raw_size;
+  priv->pack_out += pack_size;
+  priv->n_packed += 1;
+  g_mutex_unlock (&priv->pack_lock);
+
+  /* Размер и версия файла данных части изменились. */
+  hyscan_db_channel_file_request_manifest (priv, FALSE);
+
+  status = TRUE;
+
+exit:
+  if (ifdi >= 0)
+    g_close (ifdi, NULL);
+  if (ifdd >= 0)
+    g_close (ifdd, NULL);
+  if (ofdp >= 0)
+    g_close (ofdp, NULL);
+
+  /* Временный файл остаётся только при ошибке или отмене. */
+  if (pack_name != NULL)
+    g_unlink (pack_name);
+
+  hyscan_db_codec_free (codec);
+  if (raw_data != NULL)
+    g_byte_array_unref (raw_data);
+  if (packed_data != NULL)
+    g_byte_array_unref (packed_data);
+  if (blocks != NULL)
+    g_array_unref (blocks);
+  g_free (rec_indexes);
+  g_free (pack_name);
+  g_free (data_name);
+  g_object_unref (fdd);
+
+  return status;
+}
+
+/* Поток сжатия завершённых частей данных. Поток работает с пониженным
+   приоритетом, чтобы не мешать записи и чтению данных. */
+static gpointer
+hyscan_db_channel_file_pack_thread (gpointer data)
+{
+  HyScanDBChannelFilePrivate *priv = data;
+
+#ifdef __linux__
+  /* В Linux приоритет задаётся для каждого потока отдельно. */
+  setpriority (PRIO_PROCESS, 0, PACK_THREAD_NICE);
+#endif
+
+  g_mutex_lock (&priv->pack_lock);
+
+  while (!priv->pack_shutdown)
+    {
+      guint32 begin_index;
+
+      if (g_queue_is_empty (&priv->pack_queue))
+        {
+          g_cond_wait (&priv->pack_cond, &priv->pack_lock);
+          continue;
+        }
+
+      /* Часть остаётся в очереди до завершения сжатия. */
+      begin_index = GPOINTER_TO_UINT (g_queue_peek_head (&priv->pack_queue));
+      g_mutex_unlock (&priv->pack_lock);
+
+      hyscan_db_channel_file_pack_part (priv, begin_index);
+
+      g_mutex_lock (&priv->pack_lock);
+      g_queue_pop_head (&priv->pack_queue);
+    }
+
+  g_mutex_unlock (&priv->pack_lock);
+
+  return NULL;
+}
+
+/* Функция помещает часть данных в очередь сжатия. */
+static void
+hyscan_db_channel_file_queue_pack (HyScanDBChannelFilePrivate *priv,
+                                   HyScanDBChannelFilePart    *fpart)
+{
+  if (priv->pack_thread == NULL)
+    return;
+
+  g_mutex_lock (&priv->pack_lock);
+  g_queue_push_tail (&priv->pack_queue, GUINT_TO_POINTER (fpart->begin_index));
+  g_cond_signal (&priv->pack_cond);
+  g_mutex_unlock (&priv->pack_lock);
+}
+
+/* Функция завершает поток сжатия частей. Сжатие текущей части прерывается,
+   её файл данных остаётся без изменений. */
+static void
+hyscan_db_channel_file_stop_pack_thread (HyScanDBChannelFilePrivate *priv)
+{
+  if (priv->pack_thread == NULL)
+    return;
+
+  g_mutex_lock (&priv->pack_lock);
+  g_atomic_int_set (&priv->pack_shutdown, TRUE);
+  g_cond_broadcast (&priv->pack_cond);
+  g_mutex_unlock (&priv->pack_lock);
+
+  g_thread_join (priv->pack_thread);
+  priv->pack_thread = NULL;
+}
+
+/* Функция ищет часть данных, содержащую указанный индекс. Части данных
+   упорядочены по индексам, поэтому поиск выполняется делением пополам.
+   Функция должна вызываться при захваченной на чтение блокировке lock. */
+static HyScanDBChannelFilePart *
+hyscan_db_channel_file_find_part (HyScanDBChannelFilePrivate *priv,
+                                  guint32                     index)
+{
+  guint begin = 0;
+  guint end = priv->n_parts;
+
+  while (begin < end)
+    {
+      guint middle = begin + (end - begin) / 2;
+      HyScanDBChannelFilePart *fpart = priv->parts[middle];
+
+      if (index < fpart->begin_index)
+        end = middle;
+      else if (index > fpart->end_index)
+        begin = middle + 1;
+      else
+        return fpart;
+    }
+
+  return NULL;
+}
+
+/* Функция возвращает номер первой части данных, конечное время которой не
+   меньше указанного. Если такой части нет, возвращается число частей.
+   Функция должна вызываться при захваченной на чтение блокировке lock. */
+static guint
+hyscan_db_channel_file_find_part_by_time (HyScanDBChannelFilePrivate *priv,
+                                          gint64                      time)
+{
+  guint begin = 0;
+  guint end = priv->n_parts;
+
+  while (begin < end)
+    {
+      guint middle = begin + (end - begin) / 2;
+
+      if (priv->parts[middle]->end_time < time)
+        begin = middle + 1;
+      else
+        end = middle;
+    }
+
+  return begin;
+}
+
+/* Функция помещает индекс в кэш, замещая индекс, находившийся в той же ячейке. */
+static void
+hyscan_db_channel_file_cache_index (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFileIndex   *db_index)
+{
+  if (priv->cache == NULL)
+    return;
+
+  g_mutex_lock (&priv->cache_lock);
+  priv->cache[db_index->index & (priv->cache_size - 1)] = *db_index;
+  g_mutex_unlock (&priv->cache_lock);
+}
+
+/* Функция считывает индекс через общий кэш. Индексы считываются из файла
+   страницами по INDEX_PAGE_RECORDS индексов, страница содержит только
+   записанные в файл индексы. Функция должна вызываться при захваченной на
+   чтение блокировке lock для индексов, отсутствующих в буфере отложенной записи. */
+static gboolean
+hyscan_db_channel_file_read_index_page (HyScanDBChannelFilePrivate  *priv,
+                                        HyScanDBChannelFilePart     *fpart,
+                                        guint32                      index,
+                                        HyScanDBChannelFileIndexRec *rec_index)
+{
+  HyScanDBChannelFileIndexRec *page;
+  HyScanDBCacheKey key;
+  GBytes *cached_page;
+
+  guint32 page_begin;
+  guint32 page_offset;
+  guint64 n_records;
+
+  page_offset = (index - fpart->begin_index) % INDEX_PAGE_RECORDS;
+  page_begin = index - page_offset;
+
+  key.owner = priv->cache_owner;
+  key.type = HYSCAN_DB_CACHE_INDEX;
+  key.part = fpart->begin_index;
+  key.block = (index - fpart->begin_index) / INDEX_PAGE_RECORDS;
+
+  /* Страница найдена в кэше и содержит требуемый индекс. */
+  cached_page = hyscan_db_cache_get (priv->shared_cache, &key);
+  if (cached_page != NULL)
+    {
+      const guint8 *page_data;
+      gsize page_size;
+      gboolean found;
+
+      page_data = g_bytes_get_data (cached_page, &page_size);
+      found = (page_size >= (page_offset + 1) * INDEX_RECORD_SIZE);
+      if (found)
+        memcpy (rec_index, page_data + page_offset * INDEX_RECORD_SIZE, INDEX_RECORD_SIZE);
+
+      g_bytes_unref (cached_page);
+
+      if (found)
+        return TRUE;
+    }
+
+  /* Число записанных в файл индексов страницы. */
+  n_records = (guint64) fpart->end_index - page_begin + 1;
+  if (fpart == priv->parts[priv->n_parts - 1])
+    n_records -= priv->index_buffer->len / INDEX_RECORD_SIZE;
+  n_records = MIN (n_records, INDEX_PAGE_RECORDS);
+
+  /* Считываем страницу из файла. Буфер страницы передаётся в кэш без копирования. */
+  page = g_malloc (n_records * INDEX_RECORD_SIZE);
+  if (!hyscan_db_channel_file_pread_index (priv, fpart, page, n_records * INDEX_RECORD_SIZE,
+                                           INDEX_FILE_HEADER_SIZE + (guint64) (page_begin - fpart->begin_index) * INDEX_RECORD_SIZE))
+    {
+      g_free (page);
+      return FALSE;
+    }
+
+  *rec_index = page[page_offset];
+
+  cached_page = g_bytes_new_take (page, n_records * INDEX_RECORD_SIZE);
+  hyscan_db_cache_set_bytes (priv->shared_cache, &key, cached_page);
+  g_bytes_unref (cached_page);
+
+  return TRUE;
+}
+
+/* Функция заполняет информацию о записи по индексу в файловом формате,
+   значения полей которого заданы в порядке байт системы. */
+static void
+hyscan_db_channel_file_set_index (HyScanDBChannelFilePart     *fpart,
+                                  guint32                      index,
+                                  HyScanDBChannelFileIndexRec *rec_index,
+                                  HyScanDBChannelFileIndex    *db_index)
+{
+  db_index->part = fpart;
+  db_index->index = index;
+  db_index->time = rec_index->time;
+  db_index->offset = rec_index->offset;
+  db_index->size = rec_index->size;
+  db_index->data_size = rec_index->size;
+  db_index->compression = HYSCAN_DB_COMPRESSION_NONE;
+
+  /* Сжатая запись. */
+  if ((fpart->version != FILE_VERSION) && (rec_index->pad != 0))
+    {
+      db_index->size = rec_index->pad & INDEX_STORED_SIZE_MASK;
+      db_index->compression = rec_index->pad >> INDEX_COMPRESSION_SHIFT;
+    }
+}
+
+/* Функция считывает служебные данные файла индексов части по смещению в
+   файле. Данные считываются из загруженных в память блоков меток времени,
+   буфера отложенной записи, отображения файла индексов или из файла.
+   Считываемые данные могут пересекать границу между файлом и буфером
+   отложенной записи. Функция должна вызываться при захваченной на чтение
+   блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_index_data (HyScanDBChannelFilePrivate *priv,
+                                        HyScanDBChannelFilePart    *fpart,
+                                        gpointer                    data,
+                                        gsize                       size,
+                                        guint64                     offset)
+{
+  /* Блоки меток времени части загружены в память. */
+  if ((fpart->index_array != NULL) && (fpart->record_size > 0))
+    {
+      memcpy (data, fpart->index_array->data + (offset - FIXED_INDEX_HEADER_SIZE), size);
+      return TRUE;
+    }
+
+  /* Данные ещё не записаны в файл и находятся в буфере отложенной записи,
+     из файла считывается только их начало. */
+  if (fpart == priv->parts[priv->n_parts - 1])
+    {
+      guint64 buffer_offset = fpart->index_size - priv->index_buffer->len;
+
+      if (offset + size > buffer_offset)
+        {
+          guint64 from = MAX (offset, buffer_offset);
+
+          memcpy ((guint8 *) data + (from - offset),
+                  priv->index_buffer->data + (from - buffer_offset),
+                  offset + size - from);
+
+          size = from - offset;
+          if (size == 0)
+            return TRUE;
+        }
+    }
+
+  /* Данные находятся в отображённой в память части файла. */
+  if (offset + size <= fpart->index_map_size)
+    {
+      memcpy (data, fpart->index_map + offset, size);
+      return TRUE;
+    }
+
+  if (!hyscan_db_channel_file_pread_index (priv, fpart, data, size, offset))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Функция ищет индекс в кэше индексов канала. */
+static gboolean
+hyscan_db_channel_file_lookup_index (HyScanDBChannelFilePrivate *priv,
+                                     HyScanDBChannelFilePart    *fpart,
+                                     guint32                     index,
+                                     HyScanDBChannelFileIndex   *db_index)
+{
+  HyScanDBChannelFileIndex *cached_index;
+  gboolean found;
+
+  if (priv->cache == NULL)
+    return FALSE;
+
+  cached_index = &priv->cache[index & (priv->cache_size - 1)];
+
+  g_mutex_lock (&priv->cache_lock);
+  found = (cached_index->part == fpart) && (cached_index->index == index);
+  if (found)
+    *db_index = *cached_index;
+  g_mutex_unlock (&priv->cache_lock);
+
+  return found;
+}
+
+/* Функция считывает метки времени записи части с записями фиксированного
+   размера через общий кэш. Блок меток времени считывается целиком, в кэш
+   помещаются только заполненные блоки. Метки времени возвращаются в формате
+   файла. Функция должна вызываться при захваченной на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_fixed_block (HyScanDBChannelFilePrivate *priv,
+                                         HyScanDBChannelFilePart    *fpart,
+                                         guint32                     index,
+                                         gint64                     *base_time,
+                                         guint32                    *delta_time)
+{
+  HyScanDBCacheKey key;
+  GBytes *cached_block;
+  guint8 *block;
+
+  guint32 position = index - fpart->begin_index;
+  guint32 block_begin = position - position % FIXED_TIME_RECORDS;
+  guint32 n_records;
+  gsize block_size;
+
+  key.owner = priv->cache_owner;
+  key.type = HYSCAN_DB_CACHE_INDEX;
+  key.part = fpart->begin_index;
+  key.block = position / FIXED_TIME_RECORDS;
+
+  cached_block = hyscan_db_cache_get (priv->shared_cache, &key);
+  if (cached_block != NULL)
+    {
+      const guint8 *block_data = g_bytes_get_data (cached_block, NULL);
+
+      memcpy (base_time, block_data, sizeof (gint64));
+      memcpy (delta_time, block_data + sizeof (gint64) + (position % FIXED_TIME_RECORDS) * sizeof (guint32),
+              sizeof (guint32));
+      g_bytes_unref (cached_block);
+
+      return TRUE;
+    }
+
+  /* Число записей блока, метки времени которых уже записаны. */
+  n_records = MIN (fpart->end_index - fpart->begin_index + 1 - block_begin, FIXED_TIME_RECORDS);
+  block_size = sizeof (gint64) + n_records * sizeof (guint32);
+
+  block = g_malloc (block_size);
+  if (!hyscan_db_channel_file_read_index_data (priv, fpart, block, block_size,
+                                               FIXED_INDEX_HEADER_SIZE + (guint64) key.block * FIXED_TIME_BLOCK_SIZE))
+    {
+      g_free (block);
+      return FALSE;
+    }
+
+  memcpy (base_time, block, sizeof (gint64));
+  memcpy (delta_time, block + sizeof (gint64) + (position % FIXED_TIME_RECORDS) * sizeof (guint32),
+          sizeof (guint32));
+
+  /* Блок активной части дополняется новыми записями. */
+  if (n_records < FIXED_TIME_RECORDS)
+    {
+      g_free (block);
+      return TRUE;
+    }
+
+  cached_block = g_bytes_new_take (block, block_size);
+  hyscan_db_cache_set_bytes (priv->shared_cache, &key, cached_block);
+  g_bytes_unref (cached_block);
+
+  return TRUE;
+}
+
+/* Функция чтения индексов части с записями фиксированного размера. Смещение
+   данных записи вычисляется по её номеру в части, время записи - по базовому
+   времени блока и смещению времени записи. Функция должна вызываться при
+   захваченной на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_fixed_index (HyScanDBChannelFilePrivate *priv,
+                                         HyScanDBChannelFilePart    *fpart,
+                                         guint32                     index,
+                                         HyScanDBChannelFileIndex   *db_index)
+{
+  guint32 position = index - fpart->begin_index;
+  guint64 block_offset;
+  gint64 base_time;
+  guint32 delta_time;
+
+  /* Ищем индекс в кэше. */
+  if ((fpart->index_map == NULL) && (fpart->index_array == NULL) &&
+      hyscan_db_channel_file_lookup_index (priv, fpart, index, db_index))
+    {
+      return TRUE;
+    }
+
+  /* Базовое время блока и смещение времени записи. */
+  block_offset = FIXED_INDEX_HEADER_SIZE + (guint64) (position / FIXED_TIME_RECORDS) * FIXED_TIME_BLOCK_SIZE;
+  if ((priv->shared_cache != NULL) && (fpart->index_map == NULL) && (fpart->index_array == NULL))
+    {
+      if (!hyscan_db_channel_file_read_fixed_block (priv, fpart, index, &base_time, &delta_time))
+        return FALSE;
+    }
+  else if (!hyscan_db_channel_file_read_index_data (priv, fpart, &base_time, sizeof (gint64), block_offset) ||
+           !hyscan_db_channel_file_read_index_data (priv, fpart, &delta_time, sizeof (guint32),
+                                                    block_offset + sizeof (gint64) +
+                                                    (position % FIXED_TIME_RECORDS) * sizeof (guint32)))
+    {
+      return FALSE;
+    }
+
+  db_index->part = fpart;
+  db_index->index = index;
+  db_index->time = GINT64_FROM_LE (base_time) + GUINT32_FROM_LE (delta_time);
+  db_index->offset = DATA_FILE_HEADER_SIZE + (guint64) position * fpart->record_size;
+  db_index->size = fpart->record_size;
+  db_index->data_size = fpart->record_size;
+  db_index->compression = HYSCAN_DB_COMPRESSION_NONE;
+
+  /* Запоминаем прочитанный из файла индекс в кэше. */
+  if ((fpart->index_map == NULL) && (fpart->index_array == NULL))
+    hyscan_db_channel_file_cache_index (priv, db_index);
+
+  return TRUE;
+}
+
+/* Функция чтения индексов части компактного формата. Блок индексов,
+   содержащий запись, считывается целиком и декодируется, а все его индексы
+   помещаются в кэш индексов канала, поэтому последовательное чтение
+   декодирует каждый блок один раз. Если задан общий кэш, декодированный
+   блок помещается в него как страница индексов. Функция должна вызываться
+   при захваченной на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_compact_index (HyScanDBChannelFilePrivate *priv,
+                                           HyScanDBChannelFilePart    *fpart,
+                                           guint32                     index,
+                                           HyScanDBChannelFileIndex   *db_index)
+{
+  HyScanDBChannelFileIndexRec rec_indexes[COMPACT_BLOCK_RECORDS];
+  HyScanDBCacheKey key;
+
+  guint32 position = index - fpart->begin_index;
+  guint32 n_block = position / COMPACT_BLOCK_RECORDS;
+  guint32 n_indexes = 0;
+  guint32 i;
+
+  /* Ищем индекс в кэше. */
+  if (hyscan_db_channel_file_lookup_index (priv, fpart, index, db_index))
+    return TRUE;
+
+  key.owner = priv->cache_owner;
+  key.type = HYSCAN_DB_CACHE_INDEX;
+  key.part = fpart->begin_index;
+  key.block = n_block;
+
+  /* Ищем декодированный блок в общем кэше. Блок активной части может быть
+     неполным и декодируется заново при обращении к отсутствующему в нём индексу. */
+  if (priv->shared_cache != NULL)
+    {
+      GBytes *cached_block;
+
+      cached_block = hyscan_db_cache_get (priv->shared_cache, &key);
+      if (cached_block != NULL)
+        {
+          gsize block_size;
+          gconstpointer block_data;
+
+          block_data = g_bytes_get_data (cached_block, &block_size);
+          n_indexes = MIN (block_size / INDEX_RECORD_SIZE, COMPACT_BLOCK_RECORDS);
+          memcpy (rec_indexes, block_data, n_indexes * INDEX_RECORD_SIZE);
+          g_bytes_unref (cached_block);
+        }
+    }
+
+  /* Считываем блок из файла, буфера отложенной записи или отображения. */
+  if (n_indexes <= position % COMPACT_BLOCK_RECORDS)
+    {
+      guint8 block_data[COMPACT_BLOCK_MAX_SIZE];
+      guint64 block_begin;
+      guint64 block_end;
+      gsize block_size;
+
+      block_begin = g_array_index (fpart->compact_blocks, guint64, n_block);
+      if (n_block + 1 < fpart->compact_blocks->len)
+        block_end = g_array_index (fpart->compact_blocks, guint64, n_block + 1);
+      else
+        block_end = fpart->index_size;
+
+      if ((block_end - block_begin > COMPACT_BLOCK_MAX_SIZE) ||
+          !hyscan_db_channel_file_read_index_data (priv, fpart, block_data, block_end - block_begin, block_begin))
+        {
+          return FALSE;
+        }
+
+      if (!hyscan_db_channel_file_decode_block (block_data, block_end - block_begin,
+                                                rec_indexes, &n_indexes, &block_size) ||
+          (n_indexes <= position % COMPACT_BLOCK_RECORDS))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': invalid compact index block", priv->name);
+          priv->fail = TRUE;
+          return FALSE;
+        }
+
+      if (priv->shared_cache != NULL)
+        hyscan_db_cache_set (priv->shared_cache, &key, rec_indexes, n_indexes * INDEX_RECORD_SIZE);
+    }
+
+  hyscan_db_channel_file_set_index (fpart, index, &rec_indexes[position % COMPACT_BLOCK_RECORDS], db_index);
+
+  /* Запоминаем индексы всех записей блока в кэше. */
+  if (priv->cache != NULL)
+    {
+      guint32 first_index = index - position % COMPACT_BLOCK_RECORDS;
+
+      for (i = 0; i < n_indexes; i++)
+        {
+          HyScanDBChannelFileIndex block_db_index;
+
+          hyscan_db_channel_file_set_index (fpart, first_index + i, &rec_indexes[i], &block_db_index);
+          hyscan_db_channel_file_cache_index (priv, &block_db_index);
+        }
+    }
+
+  return TRUE;
+}
+
+/* Функция чтения индексов. Если индексы части загружены в память, индекс
+   берётся из массива индексов. Если индекс находится в буфере отложенной записи
+   или в отображённой в память части файла индексов, он считывается оттуда. Иначе функция
+   осуществляет поиск индекса в кэше и если не находит его производит
+   чтение из файла или из общего кэша. Информация об индексе
+   копируется в структуру db_index. Функция должна вызываться при захваченной
+   на чтение блокировке lock, указатель на часть данных действителен до её
+   освобождения. */
+static gboolean
+hyscan_db_channel_file_read_index (HyScanDBChannelFilePrivate *priv,
+                                   guint32                     index,
+                                   HyScanDBChannelFileIndex   *db_index)
+{
+  HyScanDBChannelFilePart *fpart;
+  HyScanDBChannelFileIndexRec rec_index;
+
+  goffset offset;
+
+  /* Ищем часть содержащую требуемый индекс. */
+  fpart = hyscan_db_channel_file_find_part (priv, index);
+
+  /* Такого индекса нет. */
+  if (fpart == NULL)
+    return FALSE;
+
+  /* Часть с записями фиксированного размера. */
+  if (fpart->record_size > 0)
+    return hyscan_db_channel_file_read_fixed_index (priv, fpart, index, db_index);
+
+  /* Индексы части загружены в память. */
+  if (fpart->index_array != NULL)
+    {
+      HyScanDBChannelFileIndexRec *mem_index;
+
+      mem_index = &g_array_index (fpart->index_array, HyScanDBChannelFileIndexRec, index - fpart->begin_index);
+      hyscan_db_channel_file_set_index (fpart, index, mem_index, db_index);
+
+      return TRUE;
+    }
+
+  /* Часть с компактными индексами. */
+  if (fpart->version == FILE_VERSION_COMPACT)
+    return hyscan_db_channel_file_read_compact_index (priv, fpart, index, db_index);
+
+  /* Смещение до индекса в файле. */
+  offset = index - fpart->begin_index;
+  offset *= INDEX_RECORD_SIZE;
+  offset += INDEX_FILE_HEADER_SIZE;
+
+  /* Индекс ещё не записан в файл и находится в буфере отложенной записи. */
+  if (fpart == priv->parts[priv->n_parts - 1])
+    {
+      goffset buffer_offset;
+
+      buffer_offset = fpart->end_index - fpart->begin_index + 1;
+      buffer_offset *= INDEX_RECORD_SIZE;
+      buffer_offset += INDEX_FILE_HEADER_SIZE;
+      buffer_offset -= priv->index_buffer->len;
+
+      if (offset >= buffer_offset)
+        {
+          memcpy (&rec_index, priv->index_buffer->data + (offset - buffer_offset), INDEX_RECORD_SIZE);
+          goto exit;
+        }
+    }
+
+  /* Индекс находится в отображённой в память части файла. */
+  if (offset + INDEX_RECORD_SIZE <= fpart->index_map_size)
+    {
+      memcpy (&rec_index, fpart->index_map + offset, INDEX_RECORD_SIZE);
+      goto exit;
+    }
+
+  /* Ищем индекс в кэше. */
+  if (hyscan_db_channel_file_lookup_index (priv, fpart, index, db_index))
+    return TRUE;
+
+  /* Индекс не найден в кэше канала, ищем его в общем кэше. */
+  if (priv->shared_cache != NULL)
+    {
+      if (!hyscan_db_channel_file_read_index_page (priv, fpart, index, &rec_index))
+        return FALSE;
+
+      goto exit;
+    }
+
+  /* Индекс не найден в кэше, считываем его из файла. */
+  if (!hyscan_db_channel_file_pread_index (priv, fpart, &rec_index, INDEX_RECORD_SIZE, offset))
+    return FALSE;
+
+exit:
+  hyscan_db_channel_file_index_from_le (&rec_index, 1);
+  hyscan_db_channel_file_set_index (fpart, index, &rec_index, db_index);
+
+  /* Запоминаем прочитанный из файла индекс в кэше. */
+  if (fpart->index_map == NULL)
+    hyscan_db_channel_file_cache_index (priv, db_index);
+
+  return TRUE;
+}
+
+/* Функция считывает данные записи или нескольких последовательных записей
+   одной части. Ещё не записанные в файл данные считываются из буфера
+   отложенной записи. Если задана очередь io_uring, чтение из файла помещается
+   в неё и выполняется функцией hyscan_db_uring_submit. Функция должна
+   вызываться при захваченной на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_data (HyScanDBChannelFilePrivate *priv,
+                                  HyScanDBChannelFileIndex   *db_index,
+                                  gpointer                    data,
+                                  HyScanDBUring              *uring)
+{
+  HyScanDBChannelFilePart *fpart = db_index->part;
+  guint32 file_size = db_index->size;
+
+  /* Данные сжатой части считываются из блоков. */
+  if (fpart->packed)
+    {
+      gboolean status;
+
+      /* Таблица блоков загружается при открытии файлов части. */
+      if (!hyscan_db_channel_file_acquire_part (priv, fpart))
+        return FALSE;
+
+      status = hyscan_db_channel_file_read_packed (priv, fpart, data, db_index->size, db_index->offset);
+      hyscan_db_channel_file_release_part (priv, fpart);
+
+      return status;
+    }
+
+  /* Данные, находящиеся в буфере отложенной записи. */
+  if (fpart == priv->parts[priv->n_parts - 1])
+    {
+      guint64 buffer_offset = fpart->data_size - priv->data_buffer->len;
+
+      if (db_index->offset + db_index->size > buffer_offset)
+        {
+          guint64 offset = MAX (db_index->offset, buffer_offset);
+
+          file_size = offset - db_index->offset;
+          memcpy ((guint8 *) data + file_size,
+                  priv->data_buffer->data + (offset - buffer_offset),
+                  db_index->size - file_size);
+        }
+    }
+
+  if (file_size == 0)
+    return TRUE;
+
+  /* Дескриптор части используется до выполнения операций очереди io_uring,
+     поэтому вызывающая функция запрещает его закрытие до этого момента. */
+  if (uring != NULL)
+    {
+      hyscan_db_uring_read (uring, fpart->ifdd, data, file_size, db_index->offset);
+      return TRUE;
+    }
+
+  return hyscan_db_channel_file_pread_data (priv, fpart, data, file_size, db_index->offset);
+}
+
+/* Функция распаковывает считанные из файла данные записи. Размер буфера
+   data должен быть не меньше исходного размера данных записи. */
+static gboolean
+hyscan_db_channel_file_unpack_data (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFileIndex   *db_index,
+                                    gconstpointer               stored_data,
+                                    gpointer                    data)
+{
+  if (db_index->compression == HYSCAN_DB_COMPRESSION_NONE)
+    {
+      memcpy (data, stored_data, db_index->size);
+      return TRUE;
+    }
+
+  if (!hyscan_db_codec_decompress (db_index->compression, stored_data, db_index->size,
+                                   data, db_index->data_size))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': can't decompress record %u",
+                 priv->name, db_index->index);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Функция считывает данные записи и при необходимости распаковывает их.
+   Функция должна вызываться при захваченной на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_record (HyScanDBChannelFilePrivate *priv,
+                                    HyScanDBChannelFileIndex   *db_index,
+                                    gpointer                    data)
+{
+  gpointer stored_data;
+  gboolean status;
+
+  if (db_index->compression == HYSCAN_DB_COMPRESSION_NONE)
+    return hyscan_db_channel_file_read_data (priv, db_index, data, NULL);
+
+  stored_data = g_malloc (db_index->size);
+  status = hyscan_db_channel_file_read_data (priv, db_index, stored_data, NULL) &&
+           hyscan_db_channel_file_unpack_data (priv, db_index, stored_data, data);
+  g_free (stored_data);
+
+  return status;
+}
+
+/* Функция возвращает очередь операций чтения io_uring для пакетного чтения.
+   Каждый читающий поток использует собственную очередь, неиспользуемые
+   очереди хранятся в списке канала. Функция возвращает NULL, если io_uring
+   не используется или очередь не удалось создать. */
+static HyScanDBUring *
+hyscan_db_channel_file_take_read_uring (HyScanDBChannelFilePrivate *priv)
+{
+  HyScanDBUring *uring;
+
+  if (!priv->read_uring)
+    return NULL;
+
+  g_mutex_lock (&priv->read_uring_lock);
+  uring = g_queue_pop_head (&priv->read_urings);
+  g_mutex_unlock (&priv->read_uring_lock);
+
+  if (uring == NULL)
+    uring = hyscan_db_uring_new (URING_DEPTH);
+
+  return uring;
+}
+
+/* Функция возвращает очередь операций чтения io_uring в список канала.
+   Лишние очереди освобождаются. */
+static void
+hyscan_db_channel_file_return_read_uring (HyScanDBChannelFilePrivate *priv,
+                                          HyScanDBUring              *uring)
+{
+  g_mutex_lock (&priv->read_uring_lock);
+
+  if (g_queue_get_length (&priv->read_urings) < MAX_IDLE_READ_URINGS)
+    {
+      g_queue_push_head (&priv->read_urings, uring);
+      uring = NULL;
+    }
+
+  g_mutex_unlock (&priv->read_uring_lock);
+
+  hyscan_db_uring_free (uring);
+}
+
+/* Функция освобождает части, захваченные для первых n_pinned записей. */
+static void
+hyscan_db_channel_file_release_pinned (HyScanDBChannelFilePrivate *priv,
+                                       HyScanDBChannelFileIndex   *db_indexes,
+                                       guint32                     n_pinned)
+{
+  HyScanDBChannelFilePart *pinned = NULL;
+  guint32 i;
+
+  for (i = 0; i < n_pinned; i++)
+    {
+      if (db_indexes[i].part == pinned)
+        continue;
+
+      pinned = db_indexes[i].part;
+      hyscan_db_channel_file_release_part (priv, pinned);
+    }
+}
+
+/* Функция считывает данные нескольких записей в один буфер. Данные
+   последовательных записей одной части считываются одной операцией, а при
+   использовании io_uring запросы на чтение всех групп записей передаются
+   ядру одновременно. Сжатые данные считываются во временный буфер и
+   распаковываются после чтения. Функция должна вызываться при захваченной
+   на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_records (HyScanDBChannelFilePrivate *priv,
+                                     HyScanDBChannelFileIndex   *db_indexes,
+                                     guint32                     n_indexes,
+                                     guint8                     *data)
+{
+  HyScanDBChannelFileIndex db_group;
+  HyScanDBChannelFilePart *pinned = NULL;
+  HyScanDBUring *uring = hyscan_db_channel_file_take_read_uring (priv);
+  guint8 *stored_data = data;
+  guint8 *read_data;
+  guint64 stored_size = 0;
+  guint32 n_pinned = 0;
+
+  gboolean status = FALSE;
+  guint32 i;
+
+  /* Для сжатых записей нужен буфер размером с данные в файле. */
+  for (i = 0; i < n_indexes; i++)
+    {
+      if (db_indexes[i].compression != HYSCAN_DB_COMPRESSION_NONE)
+        stored_data = NULL;
+
+      stored_size += db_indexes[i].size;
+    }
+
+  if (stored_data == NULL)
+    stored_data = g_malloc (stored_size);
+
+retry:
+  read_data = stored_data;
+
+  /* Считываем данные группами последовательных записей одной части. */
+  db_group = db_indexes[0];
+  for (i = 1; i <= n_indexes; i++)
+    {
+      if ((i < n_indexes) && (db_indexes[i].part == db_group.part) &&
+          (db_indexes[i].offset == db_group.offset + db_group.size))
+        {
+          db_group.size += db_indexes[i].size;
+          continue;
+        }
+
+      /* Файлы части не должны закрываться до выполнения операций очереди.
+         Записи идут подряд, поэтому каждая часть захватывается один раз. */
+      if ((uring != NULL) && (db_group.part != pinned))
+        {
+          if (!hyscan_db_channel_file_acquire_part (priv, db_group.part))
+            goto exit;
+
+          pinned = db_group.part;
+        }
+      if (uring != NULL)
+        n_pinned = i;
+
+      if (!hyscan_db_channel_file_read_data (priv, &db_group, read_data, uring))
+        goto exit;
+
+      read_data += db_group.size;
+
+      if (i < n_indexes)
+        db_group = db_indexes[i];
+    }
+
+  /* При ошибке io_uring очередь не используется повторно, а данные
+     считываются обычным образом. */
+  if ((uring != NULL) && !hyscan_db_uring_submit (uring))
+    {
+      g_info ("HyScanDBChannelFile: channel '%s': io_uring read failed, using pread", priv->name);
+      g_clear_pointer (&uring, hyscan_db_uring_free);
+      hyscan_db_channel_file_release_pinned (priv, db_indexes, n_pinned);
+      pinned = NULL;
+      n_pinned = 0;
+
+      goto retry;
+    }
+
+  status = TRUE;
+
+exit:
+  /* Освобождаем захваченные для очереди io_uring части. При чтении без
+     io_uring части захватываются на время каждой операции. */
+  hyscan_db_channel_file_release_pinned (priv, db_indexes, n_pinned);
+
+  /* Очередь с невыполненными после ошибки операциями не используется повторно. */
+  if ((uring != NULL) && status)
+    hyscan_db_channel_file_return_read_uring (priv, uring);
+  else
+    hyscan_db_uring_free (uring);
+
+  /* Распаковываем данные записей. */
+  if (stored_data != data)
+    {
+      read_data = stored_data;
+      for (i = 0; status && (i < n_indexes); i++)
+        {
+          status = hyscan_db_channel_file_unpack_data (priv, &db_indexes[i], read_data, data);
+          read_data += db_indexes[i].size;
+          data += db_indexes[i].data_size;
+        }
+
+      g_free (stored_data);
+    }
+
+  return status;
+}
+
+/* Функция считывает данные записи через общий кэш. Считанные из файла
+   и распакованные данные помещаются в кэш. Функция должна вызываться при захваченной на
+   чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_read_cached_data (HyScanDBChannelFilePrivate *priv,
+                                         HyScanDBChannelFileIndex   *db_index,
+                                         gpointer                    data)
+{
+  HyScanDBCacheKey key;
+  GBytes *cached_data;
+
+  key.owner = priv->cache_owner;
+  key.type = HYSCAN_DB_CACHE_DATA;
+  key.part = db_index->part->begin_index;
+  key.block = db_index->index;
+
+  cached_data = hyscan_db_cache_get (priv->shared_cache, &key);
+  if (cached_data != NULL)
+    {
+      memcpy (data, g_bytes_get_data (cached_data, NULL), db_index->data_size);
+      g_bytes_unref (cached_data);
+
+      return TRUE;
+    }
+
+  if (!hyscan_db_channel_file_read_record (priv, db_index, data))
+    return FALSE;
+
+  hyscan_db_cache_set (priv->shared_cache, &key, data, db_index->data_size);
+
+  return TRUE;
+}
+
+/* Функция освобождает ссылку на окно упреждающего чтения. */
+static void
+hyscan_db_channel_file_window_unref (HyScanDBChannelFileWindow *window)
+{
+  if ((window == NULL) || !g_atomic_int_dec_and_test (&window->ref_count))
+    return;
+
+  g_free (window->indexes);
+  g_free (window->data);
+  g_free (window);
+}
+
+/* Функция создаёт окно упреждающего чтения, начинающееся с записи index.
+   Функция должна вызываться при захваченной на чтение блокировке lock. */
+static HyScanDBChannelFileWindow *
+hyscan_db_channel_file_fill_window (HyScanDBChannelFilePrivate *priv,
+                                    guint32                     index)
+{
+  HyScanDBChannelFileWindow *window;
+  HyScanDBChannelFileIndex *db_index;
+  guint64 total_size = 0;
+  guint64 stored_size = 0;
+  guint32 n_indexes;
+  guint32 offset;
+  guint32 i;
+
+  window = g_new0 (HyScanDBChannelFileWindow, 1);
+  window->ref_count = 1;
+  window->first = index;
+  window->indexes = g_new (HyScanDBChannelFileIndex, priv->readahead_size);
+
+  /* Ищем записи окна упреждающего чтения. */
+  for (n_indexes = 0; n_indexes < priv->readahead_size; n_indexes++)
+    {
+      db_index = &window->indexes[n_indexes];
+
+      if ((index + n_indexes < index) || (total_size >= READAHEAD_MAX_SIZE))
+        break;
+
+      if (!hyscan_db_channel_file_read_index (priv, index + n_indexes, db_index))
+        break;
+
+      if (total_size + db_index->data_size > G_MAXUINT32)
+        break;
+
+      total_size += db_index->data_size;
+      stored_size += db_index->size;
+    }
+
+  if (n_indexes == 0)
+    goto fail;
+
+  /* Считываем данные окна. */
+  window->data = g_malloc (MAX (total_size, 1));
+  if (!hyscan_db_channel_file_read_records (priv, window->indexes, n_indexes, window->data))
+    goto fail;
+
+  /* Рекомендуем ядру заранее считать данные следующего окна. Его размер в
+     файле оценивается по размеру в файле данных этого окна. */
+#if defined (G_OS_UNIX) && defined (POSIX_FADV_WILLNEED)
+  db_index = &window->indexes[n_indexes - 1];
+  if (!db_index->part->packed && hyscan_db_channel_file_acquire_part (priv, db_index->part))
+    {
+      posix_fadvise (db_index->part->ifdd, db_index->offset + db_index->size, stored_size, POSIX_FADV_WILLNEED);
+      hyscan_db_channel_file_release_part (priv, db_index->part);
+    }
+#endif
+
+  /* Смещения данных записей относительно начала данных окна. */
+  for (i = 0, offset = 0; i < n_indexes; i++)
+    {
+      window->indexes[i].offset = offset;
+      offset += window->indexes[i].data_size;
+    }
+
+  window->n_indexes = n_indexes;
+
+  return window;
+
+fail:
+  hyscan_db_channel_file_window_unref (window);
+
+  return NULL;
+}
+
+/* Функция считывает данные записи через окна упреждающего чтения. Если
+   запись находится в окне одного из потоков последовательного чтения, данные
+   копируются из него. Если запись следует за последней считанной записью
+   потока, окно потока заполняется данными этой и следующих за ней записей.
+   Окно заполняется без блокировки readahead_lock, поэтому чтение другими
+   потоками не приостанавливается. Функция возвращает FALSE, если запись
+   необходимо считать обычным образом. Функция должна вызываться при
+   захваченной на чтение блокировке lock. */
+static gboolean
+hyscan_db_channel_file_readahead (HyScanDBChannelFilePrivate *priv,
+                                  guint32                     index,
+                                  HyScanBuffer               *buffer,
+                                  gint64                     *time)
+{
+  HyScanDBChannelFileStream *stream = NULL;
+  HyScanDBChannelFileWindow *window = NULL;
+  HyScanDBChannelFileIndex *db_index;
+  gboolean status = FALSE;
+  guint32 size;
+  guint i;
+
+  /* Записи удалённых частей данных недоступны. */
+  if ((priv->n_parts == 0) || (index < priv->parts[0]->begin_index))
+    return FALSE;
+
+  g_mutex_lock (&priv->readahead_lock);
+
+  priv->readahead_clock += 1;
+
+  /* Запись находится в окне одного из потоков. */
+  for (i = 0; i < READAHEAD_STREAMS; i++)
+    {
+      window = priv->readahead_streams[i].window;
+      if ((window != NULL) && (index >= window->first) && (index - window->first < window->n_indexes))
+        {
+          stream = &priv->readahead_streams[i];
+          stream->next = index + 1;
+          stream->used = priv->readahead_clock;
+          priv->readahead_hits += 1;
+          g_atomic_int_inc (&window->ref_count);
+          g_mutex_unlock (&priv->readahead_lock);
+
+          goto copy;
+        }
+    }
+
+  priv->readahead_misses += 1;
+  window = NULL;
+
+  /* Поток, продолжением которого является запись. */
+  for (i = 0; i < READAHEAD_STREAMS; i++)
+    if (priv->readahead_streams[i].next == index)
+      stream = &priv->readahead_streams[i];
+
+  /* Непоследовательное обращение начинает новый поток вместо того, к
+     которому дольше всего не обращались. */
+  if (stream == NULL)
+    {
+      HyScanDBChannelFileStream *lru = NULL;
+
+      for (i = 0; i < READAHEAD_STREAMS; i++)
+        {
+          HyScanDBChannelFileStream *cur = &priv->readahead_streams[i];
+
+          if (!cur->filling && ((lru == NULL) || (cur->used < lru->used)))
+            lru = cur;
+        }
+
+      if (lru != NULL)
+        {
+          hyscan_db_channel_file_window_unref (lru->window);
+          lru->window = NULL;
+          lru->next = index + 1;
+          lru->used = priv->readahead_clock;
+        }
+
+      g_mutex_unlock (&priv->readahead_lock);
+
+      return FALSE;
+    }
+
+  stream->next = index + 1;
+  stream->used = priv->readahead_clock;
+
+  /* Окно потока уже заполняется другим читателем. */
+  if (stream->filling)
+    {
+      g_mutex_unlock (&priv->readahead_lock);
+      return FALSE;
+    }
+
+  stream->filling = TRUE;
+  g_mutex_unlock (&priv->readahead_lock);
+
+  window = hyscan_db_channel_file_fill_window (priv, index);
+
+  /* Заменяем окно потока. */
+  g_mutex_lock (&priv->readahead_lock);
+  hyscan_db_channel_file_window_unref (stream->window);
+  stream->window = window;
+  stream->filling = FALSE;
+  if (window != NULL)
+    g_atomic_int_inc (&window->ref_count);
+  g_mutex_unlock (&priv->readahead_lock);
+
+  if (window == NULL)
+    return FALSE;
+
+copy:
+  db_index = &window->indexes[index - window->first];
+
+  if (!hyscan_buffer_set_data_size (buffer, db_index->data_size))
+    goto exit;
+
+  memcpy (hyscan_buffer_get (buffer, NULL, &size),
+          window->data + db_index->offset, db_index->data_size);
+
+  if (time != NULL)
+    *time = db_index->time;
+
+  status = TRUE;
+
+exit:
+  hyscan_db_channel_file_window_unref (window);
+
+  return status;
+}
+
+/* Функция создаёт новый объект HyScanDBChannelFile. */
+HyScanDBChannelFile *
+hyscan_db_channel_file_new (const gchar *path,
+                            const gchar *name,
+                            gboolean     readonly)
+{
+  return g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                       "path", path,
+                       "name", name,
+                       "readonly", readonly,
+                       NULL);
+}
+
+/* Функция возвращает дату и время создания канала данных. */
+gint64
+hyscan_db_channel_file_get_ctime (HyScanDBChannelFile *channel)
+{
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), 0);
+
+  return channel->priv->ctime;
+}
+
+/* Функция возвращает диапазон текущих значений индексов данных. */
+gboolean
+hyscan_db_channel_file_get_channel_data_range (HyScanDBChannelFile *channel,
+                                               guint32             *first_index,
+                                               guint32             *last_index)
+{
+  HyScanDBChannelFilePrivate *priv;
+  gboolean status = FALSE;
+
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
+
+  priv = channel->priv;
+
+  if (priv->fail)
+    return FALSE;
+
+  g_rw_lock_reader_lock (&priv->lock);
+
+  /* Нет данных. */
+  if (priv->n_parts == 0)
+    goto exit;
+
+  if (first_index != NULL)
+    *first_index = priv->parts[0]->begin_index;
+  if (last_index != NULL)
+    *last_index = priv->parts[priv->n_parts - 1]->end_index;
+
+  status = TRUE;
+
+exit:
+  g_rw_lock_reader_unlock (&priv->lock);
+
+  return status;
+}
+
+/* Функция сжимает данные группы записей в буфер compress_buffer. Записи,
+   которые не удалось сжать, копируются в буфер без изменений. Для каждой
+   записи функция заполняет размер данных в файле и значение поля pad
+   индекса. Функция должна вызываться при захваченной блокировке write_lock. */
+static void
+hyscan_db_channel_file_compress_records (HyScanDBChannelFilePrivate *priv,
+                                         guint32                     n_records,
+                                         gconstpointer               data,
+                                         const guint32              *sizes,
+                                         guint32                    *stored_sizes,
+                                         guint32                    *pads)
+{
+  HyScanDBCompression compression = hyscan_db_codec_get_compression (priv->codec);
+  GByteArray *buffer = priv->compress_buffer;
+  const guint8 *record_data = data;
+  guint32 i;
+
+  g_byte_array_set_size (buffer, 0);
+
+  for (i = 0; i < n_records; i++)
+    {
+      guint offset = buffer->len;
+      gsize compressed_size = 0;
+
+      g_byte_array_set_size (buffer, offset + sizes[i]);
+
+      /* Сжатые данные должны быть меньше исходных и помещаться в поле pad. */
+      if (sizes[i] > 1)
+        {
+          compressed_size = hyscan_db_codec_compress (priv->codec, record_data, sizes[i],
+                                                      buffer->data + offset,
+                                                      MIN (sizes[i] - 1, INDEX_STORED_SIZE_MASK));
+        }
+
+      if (compressed_size > 0)
+        {
+          stored_sizes[i] = compressed_size;
+          pads[i] = (compression << INDEX_COMPRESSION_SHIFT) | compressed_size;
+        }
+      else
+        {
+          memcpy (buffer->data + offset, record_data, sizes[i]);
+          stored_sizes[i] = sizes[i];
+          pads[i] = 0;
+        }
+
+      g_byte_array_set_size (buffer, offset + stored_sizes[i]);
+
+      priv->compress_in += sizes[i];
+      priv->compress_out += stored_sizes[i];
+      record_data += sizes[i];
+    }
+}
+
+/* Функция записывает группу записей. Данные записей расположены в памяти
+   друг за другом. Записи, попадающие в одну часть данных, записываются в
+   файлы индексов и данных одной операцией для каждого файла. */
+static gboolean
+hyscan_db_channel_file_add_records (HyScanDBChannelFilePrivate *priv,
+                                    guint32                     n_records,
+                                    const gint64               *times,
+                                    gconstpointer               data,
+                                    const guint32              *sizes,
+                                    guint32                    *first_index)
+{
+  HyScanDBChannelFilePart *fpart = NULL;
+  HyScanDBChannelFileIndexRec *rec_indexes;
+  GByteArray *index_data;
+  GArray *new_blocks;
+  const guint8 *group_data = data;
+  const guint32 *stored_sizes = sizes;
+  guint32 *compressed_sizes = NULL;
+  guint32 *pads = NULL;
+
+  guint32 n_written = 0;
+  guint32 written_index = 0;
+
+  gboolean new_part = FALSE;
+  gboolean status = FALSE;
+  guint64 sync_request = 0;
+  guint32 i;
+
+  if (priv->fail)
+    return FALSE;
+
+  if (priv->readonly)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': read only mode", priv->name);
+      return FALSE;
+    }
+
+  /* Время не может быть отрицательным и должно возрастать. */
+  for (i = 0; i < n_records; i++)
+    {
+      if (times[i] < 0)
+        return FALSE;
+
+      if ((i > 0) && (times[i] <= times[i - 1]))
+        {
+          g_warning ("HyScanDBChannelFile: channel '%s': record %u time is less or equal to previous",
+                     priv->name, i);
+          return FALSE;
+        }
+    }
+
+  rec_indexes = g_new (HyScanDBChannelFileIndexRec, n_records);
+  index_data = g_byte_array_new ();
+  new_blocks = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+  g_mutex_lock (&priv->write_lock);
+
+  /* В режиме фиксированного размера записей все записи должны иметь этот размер. */
+  if (priv->record_size > 0)
+    {
+      for (i = 0; i < n_records; i++)
+        {
+          if (sizes[i] != priv->record_size)
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': record %u size %u differs from fixed size %u",
+                         priv->name, i, sizes[i], priv->record_size);
+              goto exit;
+            }
+        }
+    }
+
+  /* Сжимаем данные записей. Дальше записываются сжатые данные. */
+  if ((priv->codec != NULL) && (priv->record_size == 0))
+    {
+      compressed_sizes = g_new (guint32, n_records);
+      pads = g_new (guint32, n_records);
+
+      hyscan_db_channel_file_compress_records (priv, n_records, data, sizes, compressed_sizes, pads);
+
+      group_data = priv->compress_buffer->data;
+      stored_sizes = compressed_sizes;
+    }
+
+  while (n_written < n_records)
+    {
+      guint32 group_index;
+      guint32 n_group;
+      guint64 group_size;
+      guint64 offset;
+      gint64 base_time;
+
+      gconstpointer group_indexes;
+      gsize group_indexes_size;
+
+      gint64 time = times[n_written];
+      guint32 size = stored_sizes[n_written];
+
+      /* Проверяем, что записываемые данные меньше, чем максимальный размер файла. */
+      if (size > priv->max_data_file_size - DATA_FILE_HEADER_SIZE)
+        goto exit;
 
-      /* Удаляем файл индексов. */
-      if (!g_file_delete (fpart->fdi, NULL, NULL))
+      /* Удаляем при необходимости старые части данных. */
+      if (!hyscan_db_channel_file_remove_old_part (priv))
         {
-          g_warning ("HyScanDBChannelFile: channel '%s': can't remove index file", priv->name);
           priv->fail = TRUE;
+          goto exit;
         }
-      g_object_unref (fpart->fdi);
 
-      /* Удаляем файл данных. */
-      if (!g_file_delete (fpart->fdd, NULL, NULL))
+      /* Записанных данных еще нет. */
+      if (priv->n_parts == 0)
         {
-          g_warning ("HyScanDBChannelFile: channel '%s': can't remove data file", priv->name);
-          priv->fail = TRUE;
-        }
-      g_object_unref (fpart->fdd);
+          fpart = hyscan_db_channel_file_create_part (priv, 0);
+          if (fpart == NULL)
+            goto exit;
 
-      /* Уменьшаем общий объём данных на размер удалённой части. */
-      priv->data_size -= (fpart->data_size - DATA_FILE_HEADER_SIZE);
+          new_part = TRUE;
+        }
+      /* Уже есть записанные данные. */
+      else
+        {
+          /* Указатель на последнюю часть данных. Записывающий поток единственный,
+             кто изменяет информацию о частях, поэтому читать её можно без блокировки. */
+          fpart = priv->parts[priv->n_parts - 1];
 
-      g_free (fpart);
+          /* Проверяем, что не превысили максимального числа записей. */
+          if (fpart->end_index == G_MAXUINT32)
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': too many records", priv->name);
+              goto exit;
+            }
 
-      /* Переименовываем файлы частей. */
-      for (i = 0; i < priv->n_parts; i++)
-        {
-          GFile *fd;
-          gchar *new_name;
+          /* Проверяем записываемое время. */
+          if (fpart->end_time >= time)
+            {
+              g_warning ("HyScanDBChannelFile: channel '%s': current time %" G_GINT64_FORMAT ".%" G_GINT64_FORMAT
+                         " is less or equal to previously written %" G_GINT64_FORMAT ".%" G_GINT64_FORMAT,
+                         priv->name,
+                         time / 1000000, time % 1000000,
+                         fpart->end_time / 1000000, fpart->end_time % 1000000);
 
-          fpart = priv->parts[i];
+              goto exit;
+            }
 
-          /* Переименовываем файл индексов. */
-          new_name = g_strdup_printf ("%s.%06d.i", priv->name, i);
-          fd = g_file_set_display_name (fpart->fdi, new_name, NULL, NULL);
-          if (fd == NULL)
+          /* Если при записи данных будет превышен максимальный размер файла или
+             если в текущую часть идёт запись дольше чем интервал_времени_хранения/5 или
+             размер записанных данных станет больше чем размер_сохраняемых_данных/5,
+             создаём новую часть. Новая часть создаётся также, если изменился
+             фиксированный размер записей и если смещение времени записи
+             относительно базового времени блока не помещается в 32 бита. */
+          if ((fpart->data_size + size > priv->max_data_file_size - DATA_FILE_HEADER_SIZE) ||
+              (fpart->record_size != priv->record_size) ||
+              ((fpart->record_size > 0) &&
+               ((fpart->end_index - fpart->begin_index + 1) % FIXED_TIME_RECORDS != 0) &&
+               (time - fpart->base_time > G_MAXUINT32)) ||
+              (g_get_monotonic_time () - fpart->create_time > (priv->save_time / 5)) ||
+              (fpart->data_size + size > (priv->save_size / 5) - DATA_FILE_HEADER_SIZE))
             {
-              g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't rename index file", priv->name, i);
-              priv->fail = TRUE;
+              /* Перед созданием новой части записываем буфер текущей и
+                 при необходимости синхронизируем её файлы с диском. */
+              if (!hyscan_db_channel_file_flush_buffers (priv))
+                goto exit;
+
+              hyscan_db_channel_file_trim_part (priv, fpart);
+
+              if ((priv->durability >= HYSCAN_DB_DURABILITY_SYNC) &&
+                  !hyscan_db_channel_file_sync_part (priv, fpart))
+                goto exit;
+
+              fpart = hyscan_db_channel_file_create_part (priv, fpart->end_index + 1);
+              if (fpart == NULL)
+                goto exit;
+
+              new_part = TRUE;
             }
-          else
+        }
+
+      /* Группа записей, помещающихся в текущую часть. Первая запись группы
+         помещается в часть всегда, остальные записи проверяются так же, как
+         при создании новой части. */
+      group_index = new_part ? fpart->begin_index : fpart->end_index + 1;
+      offset = fpart->data_size;
+      base_time = fpart->base_time;
+
+      g_byte_array_set_size (index_data, 0);
+      g_array_set_size (new_blocks, 0);
+
+      for (n_group = 0; n_written + n_group < n_records; n_group++)
+        {
+          guint32 k = n_written + n_group;
+          guint32 position = group_index + n_group - fpart->begin_index;
+
+          if (n_group > 0)
             {
-              g_object_unref (fpart->fdi);
-              fpart->fdi = fd;
+              if (group_index + n_group == 0)
+                break;
+
+              if ((offset + stored_sizes[k] > priv->max_data_file_size - DATA_FILE_HEADER_SIZE) ||
+                  (offset + stored_sizes[k] > (priv->save_size / 5) - DATA_FILE_HEADER_SIZE))
+                break;
+
+              if ((fpart->record_size > 0) && (position % FIXED_TIME_RECORDS != 0) &&
+                  (times[k] - base_time > G_MAXUINT32))
+                break;
             }
-          g_free (new_name);
 
-          /* Переименовываем файл данных. */
-          new_name = g_strdup_printf ("%s.%06d.d", priv->name, i);
-          fd = g_file_set_display_name (fpart->fdd, new_name, NULL, NULL);
-          if (fd == NULL)
+          /* Для записей фиксированного размера сохраняется только время: базовое
+             время в начале блока и смещение относительно него для каждой записи. */
+          if (fpart->record_size > 0)
             {
-              g_warning ("HyScanDBChannelFile: channel '%s': part %d: can't rename data file", priv->name, i);
-              priv->fail = TRUE;
+              guint32 delta_time;
+
+              if (position % FIXED_TIME_RECORDS == 0)
+                {
+                  gint64 block_time = GINT64_TO_LE (times[k]);
+
+                  base_time = times[k];
+                  g_byte_array_append (index_data, (const guint8 *) &block_time, sizeof (gint64));
+                }
+
+              delta_time = GUINT32_TO_LE (times[k] - base_time);
+              g_byte_array_append (index_data, (const guint8 *) &delta_time, sizeof (guint32));
             }
+
+          /* Для остальных записей в начале блока сохраняются время и смещение
+             данных, далее для каждой записи - смещение времени относительно
+             предыдущей записи, размер и поле pad в виде чисел переменной длины. */
           else
             {
-              g_object_unref (fpart->fdd);
-              fpart->fdd = fd;
+              gint64 prev_time;
+
+              if (position % COMPACT_BLOCK_RECORDS == 0)
+                {
+                  guint64 block_position = fpart->index_size + index_data->len;
+                  gint64 block_time = GINT64_TO_LE (times[k]);
+                  guint64 block_offset = GUINT64_TO_LE (offset);
+
+                  g_byte_array_append (index_data, (const guint8 *) &block_time, sizeof (gint64));
+                  g_byte_array_append (index_data, (const guint8 *) &block_offset, sizeof (guint64));
+                  g_array_append_val (new_blocks, block_position);
+
+                  prev_time = times[k];
+                }
+              else
+                {
+                  prev_time = (k > 0) ? times[k - 1] : fpart->end_time;
+                }
+
+              rec_indexes[k].time = times[k];
+              rec_indexes[k].offset = offset;
+              rec_indexes[k].size = sizes[k];
+              rec_indexes[k].pad = (pads != NULL) ? pads[k] : 0;
+
+              hyscan_db_channel_file_put_varint (index_data, times[k] - prev_time);
+              hyscan_db_channel_file_put_varint (index_data, rec_indexes[k].size);
+              hyscan_db_channel_file_put_varint (index_data, rec_indexes[k].pad);
             }
-          g_free (new_name);
+
+          offset += stored_sizes[k];
         }
-    }
-  return TRUE;
-}
 
-/* Функция чтения индексов. Функция осуществляет поиск индекса в кэше и
-   если не находит его производит чтение из файла.*/
-static HyScanDBChannelFileIndex *
-hyscan_db_channel_file_read_index (HyScanDBChannelFilePrivate *priv,
-                                   guint32                     index)
-{
-  HyScanDBChannelFileIndex *db_index = g_hash_table_lookup (priv->cached_indexes, GUINT_TO_POINTER (index));
+      group_size = offset - fpart->data_size;
 
-  HyScanDBChannelFileIndexRec rec_index;
+      /* Индексы группы в файловом формате. */
+      group_indexes = index_data->data;
+      group_indexes_size = index_data->len;
 
-  goffset offset;
-  gssize iosize;
-  guint i;
+      /* Без отложенной записи записываем индексы и данные сразу в файлы. */
+      if (priv->write_buffer_size == 0)
+        {
+          if (!hyscan_db_channel_file_write_part (priv, fpart,
+                                                  group_indexes, group_indexes_size, fpart->index_size,
+                                                  group_data, group_size, fpart->data_size))
+            goto exit;
+        }
 
-  /* Индекс найден в кэше. */
-  if (db_index != NULL)
-    {
-      /* Индекс уже первый в цепочке. */
-      if (priv->first_cached_index == db_index)
-        return db_index;
+      /* Публикуем записи для читающих потоков. */
+      g_rw_lock_writer_lock (&priv->lock);
 
-      /* "Выдёргиваем" индекс из цепочки. */
-      db_index->prev->next = db_index->next;
+      /* Помещаем индексы и данные в буфер отложенной записи. */
+      if (priv->write_buffer_size > 0)
+        {
+          if (priv->index_buffer->len == 0)
+            {
+              priv->buffer_time = g_get_monotonic_time ();
+              g_cond_signal (&priv->flush_cond);
+            }
 
-      /* Индекс последний в цепочке. */
-      if (priv->last_cached_index == db_index)
-        priv->last_cached_index = db_index->prev;
-      else
-        db_index->next->prev = db_index->prev;
+          g_byte_array_append (priv->index_buffer, group_indexes, group_indexes_size);
+          g_byte_array_append (priv->data_buffer, group_data, group_size);
+        }
 
-      /* Помещаем в начало цепочки. */
-      db_index->prev = NULL;
-      db_index->next = priv->first_cached_index;
-      db_index->next->prev = db_index;
-      priv->first_cached_index = db_index;
+      /* Добавляем индексы в массив загруженных в память индексов. */
+      if ((fpart->index_array != NULL) && (fpart->record_size > 0))
+        g_array_append_vals (fpart->index_array, group_indexes, group_indexes_size);
+      else if (fpart->index_array != NULL)
+        g_array_append_vals (fpart->index_array, &rec_indexes[n_written], n_group);
 
-      return db_index;
-    }
+      /* Смещения новых блоков компактных индексов. */
+      if (new_blocks->len > 0)
+        g_array_append_vals (fpart->compact_blocks, new_blocks->data, new_blocks->len);
 
-  /* Индекс не найден в кэше. */
+      /* Размер данных в этой части и общий объём данных. */
+      fpart->data_size += group_size;
+      priv->data_size += group_size;
+      fpart->last_append_time = g_get_monotonic_time ();
 
-  /* Ищем часть содержащую требуемый индекс. */
-  for (i = 0; i < priv->n_parts; i++)
-    if (index >= priv->parts[i]->begin_index && index <= priv->parts[i]->end_index)
-      break;
+      fpart->end_index = group_index + n_group - 1;
+      fpart->end_time = times[n_written + n_group - 1];
+      fpart->base_time = base_time;
+      fpart->index_size += group_indexes_size;
 
-  /* Такого индекса нет. */
-  if (i == priv->n_parts)
-    return NULL;
+      if (new_part)
+        {
+          fpart->begin_time = time;
+          hyscan_db_channel_file_add_part (priv, fpart);
+          new_part = FALSE;
+        }
 
-  /* Считываем индекс. */
-  iosize = INDEX_RECORD_SIZE;
-  offset = index - priv->parts[i]->begin_index;
-  offset *= iosize;
-  offset += INDEX_FILE_HEADER_SIZE;
+      hyscan_db_channel_file_update_index_map (priv, fpart, FALSE);
+
+      g_rw_lock_writer_unlock (&priv->lock);
+
+      /* Запоминаем индексы в кэше. Компактные индексы декодируются при чтении,
+         поэтому кэш используется и при отображении файла индексов в память.
+         Индексы записей фиксированного размера помещаются в кэш при чтении. */
+      if ((fpart->index_array == NULL) && (fpart->record_size == 0))
+        {
+          for (i = n_written; i < n_written + n_group; i++)
+            {
+              HyScanDBChannelFileIndex db_index;
+
+              hyscan_db_channel_file_set_index (fpart, group_index + (i - n_written), &rec_indexes[i], &db_index);
+              hyscan_db_channel_file_cache_index (priv, &db_index);
+            }
+        }
 
-  if (!g_seekable_seek (G_SEEKABLE (priv->parts[i]->ifdi), offset, G_SEEK_SET, NULL, NULL))
+      if (n_written == 0)
+        written_index = group_index;
+
+      n_written += n_group;
+      group_data += group_size;
+
+      /* Записываем заполненный буфер отложенной записи. */
+      if ((priv->write_buffer_size > 0) &&
+          (priv->index_buffer->len + priv->data_buffer->len >= priv->write_buffer_size))
+        {
+          if (!hyscan_db_channel_file_flush_buffers (priv))
+            goto exit;
+        }
+    }
+
+  /* Если требуется сохранность данных, буфер записывается после каждой записи. */
+  if ((priv->write_buffer_size > 0) && (priv->durability != HYSCAN_DB_DURABILITY_NONE))
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't seek to index", priv->name);
-      priv->fail = TRUE;
-      return NULL;
+      if (!hyscan_db_channel_file_flush_buffers (priv))
+        goto exit;
     }
 
-  if (g_input_stream_read (priv->parts[i]->ifdi, &rec_index, iosize, NULL, NULL) != iosize)
+  /* Заранее создаём файлы следующей части. */
+  hyscan_db_channel_file_request_spare (priv, fpart);
+
+  /* Запрос на синхронизацию файлов с диском. */
+  if (priv->durability >= HYSCAN_DB_DURABILITY_SYNC)
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't read index", priv->name);
-      priv->fail = TRUE;
-      return FALSE;
+      g_mutex_lock (&priv->sync_lock);
+      sync_request = ++priv->sync_request;
+      g_cond_broadcast (&priv->sync_cond);
+      g_mutex_unlock (&priv->sync_lock);
+
+      /* Ожидать синхронизации требуется только в режиме группового подтверждения. */
+      if (priv->durability != HYSCAN_DB_DURABILITY_GROUP_COMMIT)
+        sync_request = 0;
     }
 
-  /* Запоминаем индекс в кэше. */
-  db_index = priv->last_cached_index;
-  db_index->prev->next = NULL;
-  priv->last_cached_index = db_index->prev;
-  g_hash_table_remove (priv->cached_indexes, GUINT_TO_POINTER (db_index->index));
-  g_hash_table_insert (priv->cached_indexes, GUINT_TO_POINTER (index), db_index);
+  /* Индекс первой записанной записи. */
+  if (first_index != NULL)
+    *first_index = written_index;
 
-  db_index->part = priv->parts[i];
-  db_index->index = index;
-  db_index->time = GINT64_FROM_LE (rec_index.time);
-  db_index->offset = GUINT64_FROM_LE (rec_index.offset);
-  db_index->size = GUINT32_FROM_LE (rec_index.size);
+  status = TRUE;
 
-  /* Помещаем в начало цепочки. */
-  db_index->prev = NULL;
-  db_index->next = priv->first_cached_index;
-  db_index->next->prev = db_index;
-  priv->first_cached_index = db_index;
+exit:
+  /* Часть данных не была добавлена в список из-за ошибки. */
+  if (new_part)
+    hyscan_db_channel_file_delete_part (priv, fpart);
 
-  return db_index;
-}
+  g_mutex_unlock (&priv->write_lock);
 
-/* Функция создаёт новый объект HyScanDBChannelFile. */
-HyScanDBChannelFile *
-hyscan_db_channel_file_new (const gchar *path,
-                            const gchar *name,
-                            gboolean     readonly)
-{
-  return g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
-                       "path", path,
-                       "name", name,
-                       "readonly", readonly,
-                       NULL);
-}
+  g_free (rec_indexes);
+  g_free (compressed_sizes);
+  g_free (pads);
+  g_byte_array_unref (index_data);
+  g_array_unref (new_blocks);
 
-/* Функция возвращает дату и время создания канала данных. */
-gint64
-hyscan_db_channel_file_get_ctime (HyScanDBChannelFile *channel)
-{
-  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), 0);
+  /* Ожидаем синхронизации записанных данных с диском. */
+  if (sync_request > 0)
+    {
+      g_mutex_lock (&priv->sync_lock);
+      while ((priv->sync_done < sync_request) && !priv->sync_shutdown && !priv->fail)
+        g_cond_wait (&priv->sync_cond, &priv->sync_lock);
+      g_mutex_unlock (&priv->sync_lock);
 
-  return channel->priv->ctime;
+      status = !priv->fail;
+    }
+
+  return status;
 }
 
-/* Функция возвращает диапазон текущих значений индексов данных. */
+/* Функция записывает новые данные. */
 gboolean
-hyscan_db_channel_file_get_channel_data_range (HyScanDBChannelFile *channel,
-                                               guint32             *first_index,
-                                               guint32             *last_index)
+hyscan_db_channel_file_add_channel_data (HyScanDBChannelFile *channel,
+                                         gint64               time,
+                                         HyScanBuffer        *buffer,
+                                         guint32             *index)
 {
-  HyScanDBChannelFilePrivate *priv;
-  gboolean status = FALSE;
+  gpointer data;
+  guint32 size;
 
   g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
 
-  priv = channel->priv;
+  /* Записываемые данные. */
+  data = hyscan_buffer_get (buffer, NULL, &size);
 
-  if (priv->fail)
-    return FALSE;
+  return hyscan_db_channel_file_add_records (channel->priv, 1, &time, data, &size, index);
+}
 
-  g_mutex_lock (&priv->lock);
+/* Функция записывает группу новых записей. Данные записей расположены
+   в буфере друг за другом. */
+gboolean
+hyscan_db_channel_file_add_channel_data_batch (HyScanDBChannelFile *channel,
+                                               guint32              n_records,
+                                               HyScanBuffer        *buffer,
+                                               const guint32       *sizes,
+                                               const gint64        *times,
+                                               guint32             *first_index)
+{
+  gpointer data;
+  guint32 size;
+  guint64 total_size = 0;
+  guint32 i;
 
-  /* Нет данных. */
-  if (priv->n_parts == 0)
-    goto exit;
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
 
-  if (first_index != NULL)
-    *first_index = priv->parts[0]->begin_index;
-  if (last_index != NULL)
-    *last_index = priv->parts[priv->n_parts - 1]->end_index;
+  if (n_records == 0)
+    return FALSE;
 
-  status = TRUE;
+  /* Записываемые данные. */
+  data = hyscan_buffer_get (buffer, NULL, &size);
 
-exit:
-  g_mutex_unlock (&priv->lock);
+  /* Размер данных должен совпадать с суммой размеров записей. */
+  for (i = 0; i < n_records; i++)
+    total_size += sizes[i];
 
-  return status;
+  if (total_size != size)
+    return FALSE;
+
+  return hyscan_db_channel_file_add_records (channel->priv, n_records, times, data, sizes, first_index);
 }
 
-/* Функция записывает новые данные. */
+/* Функция считывает данные. */
 gboolean
-hyscan_db_channel_file_add_channel_data (HyScanDBChannelFile *channel,
-                                         gint64               time,
+hyscan_db_channel_file_get_channel_data (HyScanDBChannelFile *channel,
+                                         guint32              index,
                                          HyScanBuffer        *buffer,
-                                         guint32             *index)
+                                         gint64              *time)
 {
   HyScanDBChannelFilePrivate *priv;
 
-  HyScanDBChannelFilePart *fpart;
-  HyScanDBChannelFileIndex *db_index;
-  HyScanDBChannelFileIndexRec rec_index;
+  HyScanDBChannelFileIndex db_index;
 
   gpointer data;
   guint32 size;
 
   gboolean status = FALSE;
-  gssize iosize;
 
   g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
 
@@ -1043,236 +6564,188 @@ hyscan_db_channel_file_add_channel_data (HyScanDBChannelFile *channel,
   if (priv->fail)
     return FALSE;
 
-  if (priv->readonly)
-    {
-      g_warning ("HyScanDBChannelFile: channel '%s': read only mode", priv->name);
-      return FALSE;
-    }
-
-  /* Записываемые данные. */
-  data = hyscan_buffer_get (buffer, NULL, &size);
-
-  /* Время не может быть отрицательным. */
-  if (time < 0)
-    return FALSE;
-
-  /* Проверяем, что записываемые данные меньше, чем максимальный размер файла. */
-  if (size > priv->max_data_file_size - DATA_FILE_HEADER_SIZE)
-    return FALSE;
-
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
-  /* Удаляем при необходимости старые части данных. */
-  if (!hyscan_db_channel_file_remove_old_part (priv))
+  /* Упреждающее чтение при последовательном доступе. */
+  if ((priv->readahead_size > 0) && hyscan_db_channel_file_readahead (priv, index, buffer, time))
     {
-      priv->fail = TRUE;
+      status = TRUE;
       goto exit;
     }
 
-  /* Записанных данных еще нет. */
-  if (priv->n_parts == 0)
+  /* Ищем требуемую запись. */
+  if (!hyscan_db_channel_file_read_index (priv, index, &db_index))
+    goto exit;
+
+  /* Считываем данные. */
+  if (!hyscan_buffer_set_data_size (buffer, db_index.data_size))
+    goto exit;
+
+  data = hyscan_buffer_get (buffer, NULL, &size);
+  if (priv->shared_cache != NULL)
     {
-      if (hyscan_db_channel_file_add_part (priv))
-        {
-          fpart = priv->parts[priv->n_parts - 1];
-          fpart->begin_time = time;
-        }
-      else
-        {
-          goto exit;
-        }
+      if (!hyscan_db_channel_file_read_cached_data (priv, &db_index, data))
+        goto exit;
     }
-  /* Уже есть записанные данные. */
   else
     {
-      /* Указатель на последнюю часть данных. */
-      fpart = priv->parts[priv->n_parts - 1];
+      if (!hyscan_db_channel_file_read_record (priv, &db_index, data))
+        goto exit;
+    }
 
-      /* Проверяем, что не превысили максимального числа записей. */
-      if (fpart->end_index == G_MAXUINT32)
-        {
-          g_warning ("HyScanDBChannelFile: channel '%s': too many records", priv->name);
-          goto exit;
-        }
+  /* Метка времени данных. */
+  if (time != NULL)
+    *time = db_index.time;
 
-      /* Проверяем записываемое время. */
-      if (fpart->end_time >= time)
-        {
-          g_warning ("HyScanDBChannelFile: channel '%s': current time %" G_GINT64_FORMAT ".%" G_GINT64_FORMAT
-                     " is less or equal to previously written %" G_GINT64_FORMAT ".%" G_GINT64_FORMAT,
-                     priv->name,
-                     time / 1000000, time % 1000000,
-                     fpart->end_time / 1000000, fpart->end_time % 1000000);
+  status = TRUE;
 
-          goto exit;
-        }
+exit:
+  g_rw_lock_reader_unlock (&priv->lock);
 
-      /* Если при записи данных будет превышен максимальный размер файла или
-         если в текущую часть идёт запись дольше чем интервал_времени_хранения/5 или
-         размер записанных данных станет больше чем размер_сохраняемых_данных/5,
-         создаём новую часть. */
-      if ((fpart->data_size + size > priv->max_data_file_size - DATA_FILE_HEADER_SIZE) ||
-          (g_get_monotonic_time () - fpart->create_time > (priv->save_time / 5)) ||
-          (fpart->data_size + size > (priv->save_size / 5) - DATA_FILE_HEADER_SIZE))
-        {
-          if (hyscan_db_channel_file_add_part (priv))
-            {
-              fpart = priv->parts[priv->n_parts - 1];
-              fpart->begin_time = time;
-            }
-          else
-            {
-              goto exit;
-            }
-        }
-      /* Записываем данные в текущую часть.
-         Увеличиваем счётчик индексов. */
-      else
-        {
-          fpart->end_index += 1;
-        }
-    }
+  return status;
+}
 
-  /* Запоминаем записываемое время. */
-  fpart->last_append_time = g_get_monotonic_time ();
-  fpart->end_time = time;
+/* Функция считывает данные нескольких последовательных записей. Данные
+   последовательных записей одной части считываются одной операцией. */
+gboolean
+hyscan_db_channel_file_get_channel_data_batch (HyScanDBChannelFile *channel,
+                                               guint32              first_index,
+                                               guint32             *n_records,
+                                               HyScanBuffer        *buffer,
+                                               guint32             *sizes,
+                                               gint64              *times)
+{
+  HyScanDBChannelFilePrivate *priv;
 
-  /* Структура нового индекса. */
-  rec_index.time = GINT64_TO_LE (time);
-  rec_index.offset = GUINT64_TO_LE (fpart->data_size);
-  rec_index.size = GUINT32_TO_LE (size);
+  HyScanDBChannelFileIndex *db_indexes;
+  guint32 n_indexes;
+  guint64 total_size;
 
-  /* Записываем индекс. */
-  iosize = INDEX_RECORD_SIZE;
-  if (g_output_stream_write (fpart->ofdi, &rec_index, iosize, NULL, NULL) != iosize)
-    {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't write index", priv->name);
-      priv->fail = TRUE;
-      goto exit;
-    }
+  guint8 *data;
+  guint32 size;
 
-  if (!g_output_stream_flush (fpart->ofdi, NULL, NULL))
-    {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't flush index", priv->name);
-      priv->fail = TRUE;
-      goto exit;
-    }
+  gboolean status = FALSE;
+  guint32 i;
 
-  /* Записываем данные. */
-  iosize = size;
-  if (g_output_stream_write (fpart->ofdd, data, iosize, NULL, NULL) != iosize)
-    {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't write data", priv->name);
-      priv->fail = TRUE;
-      goto exit;
-    }
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
+  g_return_val_if_fail (n_records != NULL, FALSE);
 
-  if (!g_output_stream_flush (fpart->ofdd, NULL, NULL))
+  priv = channel->priv;
+
+  if (priv->fail || (*n_records == 0))
+    return FALSE;
+
+  db_indexes = g_new (HyScanDBChannelFileIndex, *n_records);
+
+  g_rw_lock_reader_lock (&priv->lock);
+
+  /* Ищем требуемые записи. Чтение прекращается на последней записи канала. */
+  total_size = 0;
+  for (n_indexes = 0; n_indexes < *n_records; n_indexes++)
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't flush data", priv->name);
-      priv->fail = TRUE;
-      goto exit;
-    }
+      if (first_index + n_indexes < first_index)
+        break;
+
+      if (!hyscan_db_channel_file_read_index (priv, first_index + n_indexes, &db_indexes[n_indexes]))
+        break;
+
+      /* Общий объём данных ограничен размером буфера. */
+      if (total_size + db_indexes[n_indexes].data_size > G_MAXUINT32)
+        break;
 
-  /* Записанный индекс. */
-  if (index != NULL)
-    *index = fpart->end_index;
+      total_size += db_indexes[n_indexes].data_size;
+    }
 
-  /* Размер данных в этой части и общий объём данных. */
-  fpart->data_size += size;
-  priv->data_size += size;
+  if (n_indexes == 0)
+    goto exit;
 
-  /* Запоминаем индекс в кэше. */
-  db_index = priv->last_cached_index;
-  db_index->prev->next = NULL;
-  priv->last_cached_index = db_index->prev;
-  g_hash_table_remove (priv->cached_indexes, GUINT_TO_POINTER (db_index->index));
-  g_hash_table_insert (priv->cached_indexes, GUINT_TO_POINTER (fpart->end_index), db_index);
+  if (!hyscan_buffer_set_data_size (buffer, total_size))
+    goto exit;
 
-  db_index->part = fpart;
-  db_index->index = fpart->end_index;
-  db_index->time = GINT64_FROM_LE (rec_index.time);
-  db_index->offset = GUINT64_FROM_LE (rec_index.offset);
-  db_index->size = GUINT32_FROM_LE (rec_index.size);
+  data = hyscan_buffer_get (buffer, NULL, &size);
+  if (!hyscan_db_channel_file_read_records (priv, db_indexes, n_indexes, data))
+    goto exit;
 
-  /* Помещаем в начало цепочки. */
-  db_index->prev = NULL;
-  db_index->next = priv->first_cached_index;
-  db_index->next->prev = db_index;
-  priv->first_cached_index = db_index;
+  /* Размеры и метки времени записей. */
+  for (i = 0; i < n_indexes; i++)
+    {
+      if (sizes != NULL)
+        sizes[i] = db_indexes[i].data_size;
+      if (times != NULL)
+        times[i] = db_indexes[i].time;
+    }
 
+  *n_records = n_indexes;
   status = TRUE;
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
+
+  g_free (db_indexes);
 
   return status;
 }
 
-/* Функция считывает данные. */
-gboolean
-hyscan_db_channel_file_get_channel_data (HyScanDBChannelFile *channel,
+/* Функция считывает данные без копирования. Для каналов, в которые ещё
+   производится запись, данные копируются. Сжатые данные распаковываются
+   в отдельный буфер. */
+GBytes *
+hyscan_db_channel_file_map_channel_data (HyScanDBChannelFile *channel,
                                          guint32              index,
-                                         HyScanBuffer        *buffer,
                                          gint64              *time)
 {
   HyScanDBChannelFilePrivate *priv;
 
-  HyScanDBChannelFileIndex *db_index;
-
-  gpointer data;
-  guint32 size;
+  HyScanDBChannelFileIndex db_index;
+  GMappedFile *data_map = NULL;
+  GBytes *bytes = NULL;
 
-  gboolean status = FALSE;
-  gssize iosize;
-
-  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), NULL);
 
   priv = channel->priv;
 
   if (priv->fail)
-    return FALSE;
+    return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Ищем требуемую запись. */
-  db_index = hyscan_db_channel_file_read_index (priv, index);
-
-  /* Такого индекса нет. */
-  if (db_index == NULL)
+  if (!hyscan_db_channel_file_read_index (priv, index, &db_index))
     goto exit;
 
-  /* Позиционируем указатель на запись. */
-  if (!g_seekable_seek (G_SEEKABLE (db_index->part->ifdd), db_index->offset, G_SEEK_SET, NULL, NULL))
+  /* Файлы данных завершённого канала не изменяются, их можно отобразить в память. */
+  if (priv->readonly && (db_index.compression == HYSCAN_DB_COMPRESSION_NONE) && !db_index.part->packed)
+    data_map = hyscan_db_channel_file_map_data (priv, db_index.part);
+
+  if ((data_map != NULL) && (db_index.offset + db_index.size <= g_mapped_file_get_length (data_map)))
     {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't seek to data", priv->name);
-      priv->fail = TRUE;
-      goto exit;
+      const gchar *data = g_mapped_file_get_contents (data_map) + db_index.offset;
+
+      bytes = g_bytes_new_with_free_func (data, db_index.size,
+                                          (GDestroyNotify) g_mapped_file_unref,
+                                          g_mapped_file_ref (data_map));
     }
+  else
+    {
+      gpointer data = g_malloc (db_index.data_size);
 
-  /* Считываем данные. */
-  if (!hyscan_buffer_set_data_size (buffer, db_index->size))
-    goto exit;
+      if (!hyscan_db_channel_file_read_record (priv, &db_index, data))
+        {
+          g_free (data);
+          goto exit;
+        }
 
-  data = hyscan_buffer_get (buffer, NULL, &size);
-  iosize = size;
-  if (g_input_stream_read (db_index->part->ifdd, data, iosize, NULL, NULL) != iosize)
-    {
-      g_warning ("HyScanDBChannelFile: channel '%s': can't read data", priv->name);
-      priv->fail = TRUE;
-      goto exit;
+      bytes = g_bytes_new_take (data, db_index.data_size);
     }
 
   /* Метка времени данных. */
   if (time != NULL)
-    *time = db_index->time;
-
-  status = TRUE;
+    *time = db_index.time;
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
-  return status;
+  return bytes;
 }
 
 /* Функция считывает размер данных. */
@@ -1282,7 +6755,8 @@ hyscan_db_channel_file_get_channel_data_size (HyScanDBChannelFile *channel,
 {
   HyScanDBChannelFilePrivate *priv;
 
-  HyScanDBChannelFileIndex *db_index;
+  HyScanDBChannelFileIndex db_index;
+  gboolean status;
 
   g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
 
@@ -1292,11 +6766,11 @@ hyscan_db_channel_file_get_channel_data_size (HyScanDBChannelFile *channel,
     return FALSE;
 
   /* Ищем требуемую запись. */
-  g_mutex_lock (&priv->lock);
-  db_index = hyscan_db_channel_file_read_index (priv, index);
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
+  status = hyscan_db_channel_file_read_index (priv, index, &db_index);
+  g_rw_lock_reader_unlock (&priv->lock);
 
-  return (db_index == NULL) ? 0 : db_index->size;
+  return status ? db_index.data_size : 0;
 }
 
 /* Функция считывает метку времени данных. */
@@ -1306,7 +6780,8 @@ hyscan_db_channel_file_get_channel_data_time (HyScanDBChannelFile *channel,
 {
   HyScanDBChannelFilePrivate *priv;
 
-  HyScanDBChannelFileIndex *db_index;
+  HyScanDBChannelFileIndex db_index;
+  gboolean status;
 
   g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
 
@@ -1316,11 +6791,11 @@ hyscan_db_channel_file_get_channel_data_time (HyScanDBChannelFile *channel,
     return FALSE;
 
   /* Ищем требуемую запись. */
-  g_mutex_lock (&priv->lock);
-  db_index = hyscan_db_channel_file_read_index (priv, index);
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
+  status = hyscan_db_channel_file_read_index (priv, index, &db_index);
+  g_rw_lock_reader_unlock (&priv->lock);
 
-  return (db_index == NULL) ? -1 : db_index->time;
+  return status ? db_index.time : -1;
 }
 
 /* Функция ищет данные по метке времени. */
@@ -1341,7 +6816,13 @@ hyscan_db_channel_file_find_channel_data (HyScanDBChannelFile *channel,
   guint32 end_index;
   guint32 new_index;
 
-  HyScanDBChannelFileIndex *db_index;
+  HyScanDBChannelFilePart *fpart;
+  guint part;
+
+  gboolean bisection = FALSE;
+  gsize probes = 0;
+
+  HyScanDBChannelFileIndex db_index;
   HyScanDBFindStatus status = HYSCAN_DB_FIND_FAIL;
 
   g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), HYSCAN_DB_FIND_FAIL);
@@ -1351,14 +6832,11 @@ hyscan_db_channel_file_find_channel_data (HyScanDBChannelFile *channel,
   if (priv->fail)
     return HYSCAN_DB_FIND_FAIL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Нет данных. */
   if (priv->n_parts == 0)
-    {
-      g_mutex_unlock (&priv->lock);
-      return HYSCAN_DB_FIND_FAIL;
-    }
+    goto exit;
 
   /* Проверяем границу начала данных. */
   if (time < priv->parts[0]->begin_time)
@@ -1374,11 +6852,36 @@ hyscan_db_channel_file_find_channel_data (HyScanDBChannelFile *channel,
       goto exit;
     }
 
-  begin_time = priv->parts[0]->begin_time;
-  end_time = priv->parts[priv->n_parts - 1]->end_time;
+  /* Ищем часть данных, содержащую метку времени. Такая часть обязательно
+     есть, так как метка времени не больше конечного времени данных. */
+  part = hyscan_db_channel_file_find_part_by_time (priv, time);
+  fpart = priv->parts[part];
+
+  /* Метка времени попала в промежуток между частями данных. Это возможно
+     только для второй и последующих частей. */
+  if (time < fpart->begin_time)
+    {
+      HyScanDBChannelFilePart *prev_part = priv->parts[part - 1];
+
+      if (lindex != NULL)
+        *lindex = prev_part->end_index;
+      if (rindex != NULL)
+        *rindex = fpart->begin_index;
+      if (ltime != NULL)
+        *ltime = prev_part->end_time;
+      if (rtime != NULL)
+        *rtime = fpart->begin_time;
+
+      status = HYSCAN_DB_FIND_OK;
+      goto exit;
+    }
+
+  /* Ищем метку времени внутри найденной части. */
+  begin_time = fpart->begin_time;
+  end_time = fpart->end_time;
 
-  begin_index = priv->parts[0]->begin_index;
-  end_index = priv->parts[priv->n_parts - 1]->end_index;
+  begin_index = fpart->begin_index;
+  end_index = fpart->end_index;
 
   /* В цикле ищем метку времени. */
   while (TRUE)
@@ -1425,34 +6928,136 @@ hyscan_db_channel_file_find_channel_data (HyScanDBChannelFile *channel,
           break;
         }
 
-      /* Делим отрезок. */
-      new_index = begin_index + ((end_index - begin_index) / 2);
-      db_index = hyscan_db_channel_file_read_index (priv, new_index);
-      if (db_index == NULL)
+      /* Делим отрезок пополам. */
+      if (bisection)
+        {
+          new_index = begin_index + ((end_index - begin_index) / 2);
+        }
+
+      /* Оцениваем положение записи по времени. Метки времени строго
+         возрастают, поэтому end_time > time > begin_time. */
+      else
+        {
+          gdouble position;
+
+          position = (gdouble) (time - begin_time) / (gdouble) (end_time - begin_time);
+          new_index = begin_index + (guint32) (position * (end_index - begin_index));
+          new_index = CLAMP (new_index, begin_index + 1, end_index - 1);
+        }
+
+      probes += 1;
+      if (!hyscan_db_channel_file_read_index (priv, new_index, &db_index))
         goto exit;
 
+      /* Если интерполяция сократила интервал менее чем вдвое,
+         следующий шаг выполняем делением пополам. */
+      if (!bisection)
+        {
+          guint32 half = (end_index - begin_index) / 2;
+
+          if (db_index.time <= time)
+            bisection = (end_index - new_index > half);
+          else
+            bisection = (new_index - begin_index > half);
+        }
+      else
+        {
+          bisection = FALSE;
+        }
+
       /* Корректируем границы поиска. */
-      if (db_index->time <= time)
+      if (db_index.time <= time)
         {
           begin_index = new_index;
-          begin_time = db_index->time;
+          begin_time = db_index.time;
         }
 
-      if (db_index->time > time)
+      if (db_index.time > time)
         {
           end_index = new_index;
-          end_time = db_index->time;
+          end_time = db_index.time;
         }
     }
 
   status = HYSCAN_DB_FIND_OK;
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
+
+  /* Статистика поиска. */
+  g_atomic_pointer_add (&priv->find_count, 1);
+  g_atomic_pointer_add (&priv->find_probes, probes);
 
   return status;
 }
 
+/* Функция возвращает статистику поиска данных по метке времени. */
+void
+hyscan_db_channel_file_get_find_stats (HyScanDBChannelFile *channel,
+                                       guint64             *n_finds,
+                                       guint64             *n_probes)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel));
+
+  priv = channel->priv;
+
+  if (n_finds != NULL)
+    *n_finds = (gsize) g_atomic_pointer_get (&priv->find_count);
+  if (n_probes != NULL)
+    *n_probes = (gsize) g_atomic_pointer_get (&priv->find_probes);
+}
+
+/* Функция возвращает статистику обращений канала к общему кэшу. */
+void
+hyscan_db_channel_file_get_cache_stats (HyScanDBChannelFile *channel,
+                                        guint64             *n_hits,
+                                        guint64             *n_misses,
+                                        guint64             *size)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel));
+
+  priv = channel->priv;
+
+  if (priv->shared_cache != NULL)
+    {
+      hyscan_db_cache_get_stats (priv->shared_cache, priv->cache_owner, n_hits, n_misses, size);
+      return;
+    }
+
+  if (n_hits != NULL)
+    *n_hits = 0;
+  if (n_misses != NULL)
+    *n_misses = 0;
+  if (size != NULL)
+    *size = 0;
+}
+
+/* Функция возвращает статистику упреждающего чтения. */
+void
+hyscan_db_channel_file_get_readahead_stats (HyScanDBChannelFile *channel,
+                                            guint64             *n_hits,
+                                            guint64             *n_misses)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel));
+
+  priv = channel->priv;
+
+  g_mutex_lock (&priv->readahead_lock);
+
+  if (n_hits != NULL)
+    *n_hits = priv->readahead_hits;
+  if (n_misses != NULL)
+    *n_misses = priv->readahead_misses;
+
+  g_mutex_unlock (&priv->readahead_lock);
+}
+
 /* Функция устанавливает максимальный размер файла данных. */
 gboolean
 hyscan_db_channel_file_set_channel_chunk_size (HyScanDBChannelFile *channel,
@@ -1476,9 +7081,9 @@ hyscan_db_channel_file_set_channel_chunk_size (HyScanDBChannelFile *channel,
     return FALSE;
 
   /* Устанавливаем новый размер. */
-  g_mutex_lock (&priv->lock);
+  g_mutex_lock (&priv->write_lock);
   priv->max_data_file_size = chunk_size;
-  g_mutex_unlock (&priv->lock);
+  g_mutex_unlock (&priv->write_lock);
 
   return TRUE;
 }
@@ -1506,9 +7111,9 @@ hyscan_db_channel_file_set_channel_save_time (HyScanDBChannelFile *channel,
     return FALSE;
 
   /* Устанавливаем новый интервал времени. */
-  g_mutex_lock (&priv->lock);
+  g_mutex_lock (&priv->write_lock);
   priv->save_time = save_time;
-  g_mutex_unlock (&priv->lock);
+  g_mutex_unlock (&priv->write_lock);
 
   return TRUE;
 }
@@ -1536,13 +7141,185 @@ hyscan_db_channel_file_set_channel_save_size (HyScanDBChannelFile *channel,
     return FALSE;
 
   /* Устанавливаем новый максимальный размер. */
-  g_mutex_lock (&priv->lock);
+  g_mutex_lock (&priv->write_lock);
   priv->save_size = save_size;
-  g_mutex_unlock (&priv->lock);
+  g_mutex_unlock (&priv->write_lock);
+
+  return TRUE;
+}
+
+/* Функция устанавливает режим сохранности записываемых данных. */
+gboolean
+hyscan_db_channel_file_set_channel_durability (HyScanDBChannelFile *channel,
+                                               HyScanDBDurability   durability)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
+
+  priv = channel->priv;
+
+  if (priv->fail)
+    return FALSE;
+
+  /* Проверяем режим сохранности. */
+  if ((durability < HYSCAN_DB_DURABILITY_NONE) || (durability > HYSCAN_DB_DURABILITY_GROUP_COMMIT))
+    return FALSE;
+
+  /* Устанавливаем новый режим. */
+  g_mutex_lock (&priv->write_lock);
+
+  g_mutex_lock (&priv->sync_lock);
+  priv->durability = durability;
+  g_cond_broadcast (&priv->sync_cond);
+  g_mutex_unlock (&priv->sync_lock);
+
+  /* Поток синхронизации файлов с диском. */
+  if (!priv->readonly && (durability >= HYSCAN_DB_DURABILITY_SYNC) && (priv->sync_thread == NULL))
+    priv->sync_thread = g_thread_new ("channel-sync", hyscan_db_channel_file_sync_thread, priv);
+
+  g_mutex_unlock (&priv->write_lock);
+
+  return TRUE;
+}
+
+/* Функция устанавливает алгоритм сжатия записываемых данных. */
+gboolean
+hyscan_db_channel_file_set_channel_compression (HyScanDBChannelFile *channel,
+                                                HyScanDBCompression  compression)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
+
+  priv = channel->priv;
+
+  if (priv->fail)
+    return FALSE;
+
+  /* Проверяем алгоритм сжатия. */
+  if (!hyscan_db_codec_is_supported (compression))
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': unsupported compression %d",
+                 priv->name, compression);
+      return FALSE;
+    }
+
+  /* Устанавливаем новый алгоритм. */
+  g_mutex_lock (&priv->write_lock);
+
+  /* Записи фиксированного размера не сжимаются. */
+  if ((compression != HYSCAN_DB_COMPRESSION_NONE) && (priv->record_size > 0))
+    {
+      g_mutex_unlock (&priv->write_lock);
+      g_warning ("HyScanDBChannelFile: channel '%s': compression is not supported for fixed size records",
+                 priv->name);
+      return FALSE;
+    }
+
+  if (hyscan_db_codec_get_compression (priv->codec) != compression)
+    {
+      hyscan_db_codec_free (priv->codec);
+      priv->codec = hyscan_db_codec_new (compression);
+    }
+
+  g_mutex_unlock (&priv->write_lock);
+
+  return TRUE;
+}
+
+/* Функция устанавливает фиксированный размер записываемых записей. */
+gboolean
+hyscan_db_channel_file_set_channel_record_size (HyScanDBChannelFile *channel,
+                                                guint32              record_size)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_val_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel), FALSE);
+
+  priv = channel->priv;
+
+  if (priv->fail)
+    return FALSE;
+
+  /* Проверяем размер записей. */
+  if (record_size > MAX_FIXED_RECORD_SIZE)
+    {
+      g_warning ("HyScanDBChannelFile: channel '%s': fixed record size %u is too big",
+                 priv->name, record_size);
+      return FALSE;
+    }
+
+  /* Устанавливаем новый размер записей. Новая часть данных будет создана
+     при следующей записи. */
+  g_mutex_lock (&priv->write_lock);
+
+  /* Записи фиксированного размера не сжимаются. */
+  if ((record_size > 0) && (hyscan_db_codec_get_compression (priv->codec) != HYSCAN_DB_COMPRESSION_NONE))
+    {
+      g_mutex_unlock (&priv->write_lock);
+      g_warning ("HyScanDBChannelFile: channel '%s': fixed record size is not supported with compression",
+                 priv->name);
+      return FALSE;
+    }
+
+  priv->record_size = record_size;
+  g_mutex_unlock (&priv->write_lock);
 
   return TRUE;
 }
 
+/* Функция возвращает объём данных, записанных со сжатием, до и после сжатия. */
+void
+hyscan_db_channel_file_get_compression_stats (HyScanDBChannelFile *channel,
+                                              guint64             *n_bytes_in,
+                                              guint64             *n_bytes_out)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel));
+
+  priv = channel->priv;
+
+  g_mutex_lock (&priv->write_lock);
+
+  if (n_bytes_in != NULL)
+    *n_bytes_in = priv->compress_in;
+  if (n_bytes_out != NULL)
+    *n_bytes_out = priv->compress_out;
+
+  g_mutex_unlock (&priv->write_lock);
+}
+
+/* Функция возвращает число сжатых и ожидающих сжатия частей, объём данных
+   сжатых частей до и после сжатия. */
+void
+hyscan_db_channel_file_get_pack_stats (HyScanDBChannelFile *channel,
+                                       guint64             *n_packed,
+                                       guint64             *n_pending,
+                                       guint64             *n_bytes_in,
+                                       guint64             *n_bytes_out)
+{
+  HyScanDBChannelFilePrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_DB_CHANNEL_FILE (channel));
+
+  priv = channel->priv;
+
+  g_mutex_lock (&priv->pack_lock);
+
+  if (n_packed != NULL)
+    *n_packed = priv->n_packed;
+  if (n_pending != NULL)
+    *n_pending = (priv->pack_thread != NULL) ? g_queue_get_length (&priv->pack_queue) : 0;
+  if (n_bytes_in != NULL)
+    *n_bytes_in = priv->pack_in;
+  if (n_bytes_out != NULL)
+    *n_bytes_out = priv->pack_out;
+
+  g_mutex_unlock (&priv->pack_lock);
+}
+
 /* Функция завершает запись данных. */
 void
 hyscan_db_channel_file_finalize_channel (HyScanDBChannelFile *channel)
@@ -1555,8 +7332,21 @@ hyscan_db_channel_file_finalize_channel (HyScanDBChannelFile *channel)
 
   priv = channel->priv;
 
-  /* Закрываем все потоки записи данных. */
-  g_mutex_lock (&priv->lock);
+  /* Записываем данные из буфера отложенной записи, синхронизируем их с диском
+     и закрываем все потоки записи данных. */
+  hyscan_db_channel_file_stop_flush_thread (priv);
+  hyscan_db_channel_file_stop_sync_thread (priv);
+
+  g_mutex_lock (&priv->write_lock);
+
+  if (!priv->readonly)
+    {
+      hyscan_db_channel_file_flush_buffers (priv);
+      if (priv->n_parts > 0)
+        hyscan_db_channel_file_trim_part (priv, priv->parts[priv->n_parts - 1]);
+      if ((priv->durability >= HYSCAN_DB_DURABILITY_SYNC) && (priv->n_parts > 0))
+        hyscan_db_channel_file_sync_part (priv, priv->parts[priv->n_parts - 1]);
+    }
 
   for (i = 0; i < priv->n_parts; i++)
     {
@@ -1564,9 +7354,96 @@ hyscan_db_channel_file_finalize_channel (HyScanDBChannelFile *channel)
       g_clear_object (&priv->parts[i]->ofdd);
     }
 
+  /* Запись в последнюю часть завершена. */
+  if (priv->n_parts > 0)
+    {
+      g_rw_lock_writer_lock (&priv->lock);
+      hyscan_db_channel_file_update_index_map (priv, priv->parts[priv->n_parts - 1], TRUE);
+      g_rw_lock_writer_unlock (&priv->lock);
+    }
+
+  /* Последняя часть сжимается в фоне. */
+  if (!priv->readonly && (priv->n_parts > 0))
+    hyscan_db_channel_file_queue_pack (priv, priv->parts[priv->n_parts - 1]);
+
+  /* Заранее созданная часть больше не понадобится. Создаваемая часть
+     удаляется потоком обслуживания после создания. */
+  if (priv->maint)
+    {
+      g_mutex_lock (&priv->maint_lock);
+
+      if (priv->spare_part != NULL)
+        g_queue_push_tail (&priv->remove_queue, priv->spare_part);
+      priv->spare_part = NULL;
+      priv->spare_number = -1;
+      priv->spare_stale = priv->spare_pending;
+
+      g_mutex_unlock (&priv->maint_lock);
+
+      hyscan_db_channel_file_maint_schedule (priv);
+    }
+
+  /* Файл описания частей с последней частью. */
+  if (!priv->readonly && (priv->n_parts > 0))
+    hyscan_db_channel_file_request_manifest (priv, TRUE);
+
   priv->readonly = TRUE;
 
-  g_mutex_unlock (&priv->lock);
+  g_mutex_unlock (&priv->write_lock);
+}
+
+/* Функция возвращает номер первой части канала name в каталоге path или -1,
+   если частей нет. Если нулевой части нет, номер определяется по наименьшему
+   номеру файла индексов канала в каталоге. */
+gint
+hyscan_db_channel_get_first_part (const gchar *path,
+                                  const gchar *name)
+{
+  const gchar *file_name;
+  gchar *channel_file;
+  gsize name_length;
+  gint64 first_part = -1;
+  gboolean exist;
+  GDir *dir;
+
+  /* Части каналов, из которых не удалялись данные, нумеруются с нуля. */
+  channel_file = g_strdup_printf ("%s%s%s.%06d.i", path, G_DIR_SEPARATOR_S, name, 0);
+  exist = g_file_test (channel_file, G_FILE_TEST_IS_REGULAR);
+  g_free (channel_file);
+
+  if (exist)
+    return 0;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return -1;
+
+  /* Ищем файлы индексов с именами "<name>.XXXXXX.i". */
+  name_length = strlen (name);
+  while ((file_name = g_dir_read_name (dir)) != NULL)
+    {
+      const gchar *number;
+      gchar *end;
+      guint64 part;
+
+      if ((strncmp (file_name, name, name_length) != 0) || (file_name[name_length] != '.'))
+        continue;
+
+      number = file_name + name_length + 1;
+      if (!g_ascii_isdigit (*number))
+        continue;
+
+      part = g_ascii_strtoull (number, &end, 10);
+      if ((g_strcmp0 (end, ".i") != 0) || (part > G_MAXINT32))
+        continue;
+
+      if ((first_part < 0) || ((gint64) part < first_part))
+        first_part = part;
+    }
+
+  g_dir_close (dir);
+
+  return first_part;
 }
 
 /* Функция удаляет все файлы в каталоге path относящиеся к каналу name. */
@@ -1576,10 +7453,13 @@ hyscan_db_channel_remove_channel_files (const gchar *path,
 {
   gboolean status = TRUE;
   gchar *channel_file = NULL;
+  gint first_part;
   gint i;
 
+  first_part = hyscan_db_channel_get_first_part (path, name);
+
   /* Удаляем файлы индексов. */
-  for (i = 0; i < MAX_PARTS; i++)
+  for (i = first_part; (first_part >= 0) && (i - first_part < MAX_PARTS); i++)
     {
       channel_file = g_strdup_printf ("%s%s%s.%06d.i", path, G_DIR_SEPARATOR_S, name, i);
 
@@ -1601,8 +7481,24 @@ hyscan_db_channel_remove_channel_files (const gchar *path,
         return status;
     }
 
+  /* Удаляем файл данных, оставшийся без файла индексов, если удаление
+     старой части было прервано. */
+  if (first_part > 0)
+    {
+      channel_file = g_strdup_printf ("%s%s%s.%06d.d", path, G_DIR_SEPARATOR_S, name, first_part - 1);
+      if (g_file_test (channel_file, G_FILE_TEST_IS_REGULAR) && (g_unlink (channel_file) != 0))
+        {
+          g_warning ("HyScanDBFile: can't remove file %s", channel_file);
+          status = FALSE;
+        }
+      g_free (channel_file);
+
+      if (!status)
+        return status;
+    }
+
   /* Удаляем файлы данных. */
-  for (i = 0; i < MAX_PARTS; i++)
+  for (i = first_part; (first_part >= 0) && (i - first_part < MAX_PARTS); i++)
     {
       channel_file = g_strdup_printf ("%s%s%s.%06d.d", path, G_DIR_SEPARATOR_S, name, i);
 
@@ -1624,5 +7520,27 @@ hyscan_db_channel_remove_channel_files (const gchar *path,
         return status;
     }
 
+  /* Удаляем временные файлы заранее созданной части. */
+  if (!hyscan_db_channel_file_remove_spare_files (path, name))
+    return FALSE;
+
+  /* Удаляем временный файл сжатия части. */
+  channel_file = g_strdup_printf ("%s%s%s.%s", path, G_DIR_SEPARATOR_S, name, PACK_FILE_EXT);
+  if (g_file_test (channel_file, G_FILE_TEST_IS_REGULAR) && (g_unlink (channel_file) != 0))
+    {
+      g_warning ("HyScanDBFile: can't remove file %s", channel_file);
+      status = FALSE;
+    }
+  g_free (channel_file);
+
+  /* Удаляем файл описания частей. */
+  channel_file = g_strdup_printf ("%s%s%s.%s", path, G_DIR_SEPARATOR_S, name, MANIFEST_FILE_EXT);
+  if (g_file_test (channel_file, G_FILE_TEST_IS_REGULAR) && (g_unlink (channel_file) != 0))
+    {
+      g_warning ("HyScanDBFile: can't remove file %s", channel_file);
+      status = FALSE;
+    }
+  g_free (channel_file);
+
   return status;
 }
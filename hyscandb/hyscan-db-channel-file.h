@@ -79,11 +79,29 @@ gboolean   hyscan_db_channel_file_add_channel_data          (HyScanDBChannelFile
                                                              HyScanBuffer        *buffer,
                                                              guint32             *index);
 
+gboolean   hyscan_db_channel_file_add_channel_data_batch    (HyScanDBChannelFile *channel,
+                                                             guint32              n_records,
+                                                             HyScanBuffer        *buffer,
+                                                             const guint32       *sizes,
+                                                             const gint64        *times,
+                                                             guint32             *first_index);
+
 gboolean   hyscan_db_channel_file_get_channel_data          (HyScanDBChannelFile *channel,
                                                              guint32              index,
                                                              HyScanBuffer        *buffer,
                                                              gint64              *time);
 
+gboolean   hyscan_db_channel_file_get_channel_data_batch    (HyScanDBChannelFile *channel,
+                                                             guint32              first_index,
+                                                             guint32             *n_records,
+                                                             HyScanBuffer        *buffer,
+                                                             guint32             *sizes,
+                                                             gint64              *times);
+
+GBytes    *hyscan_db_channel_file_map_channel_data          (HyScanDBChannelFile *channel,
+                                                             guint32              index,
+                                                             gint64              *time);
+
 guint32    hyscan_db_channel_file_get_channel_data_size     (HyScanDBChannelFile *channel,
                                                              guint32              index);
 
@@ -97,6 +115,29 @@ HyScanDBFindStatus hyscan_db_channel_file_find_channel_data (HyScanDBChannelFile
                                                              gint64              *ltime,
                                                              gint64              *rtime);
 
+void       hyscan_db_channel_file_get_find_stats            (HyScanDBChannelFile *channel,
+                                                             guint64             *n_finds,
+                                                             guint64             *n_probes);
+
+void       hyscan_db_channel_file_get_cache_stats           (HyScanDBChannelFile *channel,
+                                                             guint64             *n_hits,
+                                                             guint64             *n_misses,
+                                                             guint64             *size);
+
+void       hyscan_db_channel_file_get_readahead_stats       (HyScanDBChannelFile *channel,
+                                                             guint64             *n_hits,
+                                                             guint64             *n_misses);
+
+void       hyscan_db_channel_file_get_compression_stats     (HyScanDBChannelFile *channel,
+                                                             guint64             *n_bytes_in,
+                                                             guint64             *n_bytes_out);
+
+void       hyscan_db_channel_file_get_pack_stats            (HyScanDBChannelFile *channel,
+                                                             guint64             *n_packed,
+                                                             guint64             *n_pending,
+                                                             guint64             *n_bytes_in,
+                                                             guint64             *n_bytes_out);
+
 gboolean   hyscan_db_channel_file_set_channel_chunk_size    (HyScanDBChannelFile *channel,
                                                              guint64              chunk_size);
 
@@ -106,8 +147,20 @@ gboolean   hyscan_db_channel_file_set_channel_save_time     (HyScanDBChannelFile
 gboolean   hyscan_db_channel_file_set_channel_save_size     (HyScanDBChannelFile *channel,
                                                              guint64              save_size);
 
+gboolean   hyscan_db_channel_file_set_channel_durability    (HyScanDBChannelFile *channel,
+                                                             HyScanDBDurability   durability);
+
+gboolean   hyscan_db_channel_file_set_channel_compression   (HyScanDBChannelFile *channel,
+                                                             HyScanDBCompression  compression);
+
+gboolean   hyscan_db_channel_file_set_channel_record_size   (HyScanDBChannelFile *channel,
+                                                             guint32              record_size);
+
 void       hyscan_db_channel_file_finalize_channel          (HyScanDBChannelFile *channel);
 
+gint       hyscan_db_channel_get_first_part                 (const gchar         *path,
+                                                             const gchar         *name);
+
 gboolean   hyscan_db_channel_remove_channel_files           (const gchar         *path,
                                                              const gchar         *name);
 
@@ -1328,6 +1328,129 @@ exit:
   return status;
 }
 
+static gboolean
+hyscan_db_client_channel_set_durability (HyScanDB           *db,
+                                         gint32              channel_id,
+                                         HyScanDBDurability  durability)
+{
+  HyScanDBClient *dbc = HYSCAN_DB_CLIENT (db);
+  HyScanDBClientPrivate *priv = dbc->priv;
+
+  uRpcData *urpc_data;
+  guint32 exec_status;
+
+  gboolean status = FALSE;
+
+  if (priv->rpc == NULL)
+    return FALSE;
+
+  urpc_data = urpc_client_lock (priv->rpc);
+  if (urpc_data == NULL)
+    hyscan_db_client_lock_error ();
+
+  if (urpc_data_set_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, channel_id) != 0)
+    hyscan_db_client_set_error ("channel_id");
+
+  if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DURABILITY, durability) != 0)
+    hyscan_db_client_set_error ("durability");
+
+  if (urpc_client_exec (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_SET_DURABILITY) != URPC_STATUS_OK)
+    hyscan_db_client_exec_error ();
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, &exec_status) != 0)
+    hyscan_db_client_get_error ("exec_status");
+  if (exec_status != HYSCAN_DB_RPC_STATUS_OK)
+    goto exit;
+
+  status = TRUE;
+
+exit:
+  urpc_client_unlock (priv->rpc);
+  return status;
+}
+
+static gboolean
+hyscan_db_client_channel_set_compression (HyScanDB            *db,
+                                          gint32               channel_id,
+                                          HyScanDBCompression  compression)
+{
+  HyScanDBClient *dbc = HYSCAN_DB_CLIENT (db);
+  HyScanDBClientPrivate *priv = dbc->priv;
+
+  uRpcData *urpc_data;
+  guint32 exec_status;
+
+  gboolean status = FALSE;
+
+  if (priv->rpc == NULL)
+    return FALSE;
+
+  urpc_data = urpc_client_lock (priv->rpc);
+  if (urpc_data == NULL)
+    hyscan_db_client_lock_error ();
+
+  if (urpc_data_set_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, channel_id) != 0)
+    hyscan_db_client_set_error ("channel_id");
+
+  if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_COMPRESSION, compression) != 0)
+    hyscan_db_client_set_error ("compression");
+
+  if (urpc_client_exec (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_SET_COMPRESSION) != URPC_STATUS_OK)
+    hyscan_db_client_exec_error ();
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, &exec_status) != 0)
+    hyscan_db_client_get_error ("exec_status");
+  if (exec_status != HYSCAN_DB_RPC_STATUS_OK)
+    goto exit;
+
+  status = TRUE;
+
+exit:
+  urpc_client_unlock (priv->rpc);
+  return status;
+}
+
+static gboolean
+hyscan_db_client_channel_set_record_size (HyScanDB *db,
+                                          gint32    channel_id,
+                                          guint32   record_size)
+{
+  HyScanDBClient *dbc = HYSCAN_DB_CLIENT (db);
+  HyScanDBClientPrivate *priv = dbc->priv;
+
+  uRpcData *urpc_data;
+  guint32 exec_status;
+
+  gboolean status = FALSE;
+
+  if (priv->rpc == NULL)
+    return FALSE;
+
+  urpc_data = urpc_client_lock (priv->rpc);
+  if (urpc_data == NULL)
+    hyscan_db_client_lock_error ();
+
+  if (urpc_data_set_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, channel_id) != 0)
+    hyscan_db_client_set_error ("channel_id");
+
+  if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_RECORD_SIZE, record_size) != 0)
+    hyscan_db_client_set_error ("record_size");
+
+  if (urpc_client_exec (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_SET_RECORD_SIZE) != URPC_STATUS_OK)
+    hyscan_db_client_exec_error ();
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, &exec_status) != 0)
+    hyscan_db_client_get_error ("exec_status");
+  if (exec_status != HYSCAN_DB_RPC_STATUS_OK)
+    goto exit;
+
+  status = TRUE;
+
+exit:
+  urpc_client_unlock (priv->rpc);
+  return status;
+}
+
 static void
 hyscan_db_client_channel_finalize (HyScanDB *db,
                                    gint32    channel_id)
@@ -1505,6 +1628,144 @@ exit:
   return status;
 }
 
+/* Функция передаёт серверу группу записей, помещающихся в один запрос. */
+static gboolean
+hyscan_db_client_channel_add_data_chunk (HyScanDBClientPrivate *priv,
+                                         gint32                 channel_id,
+                                         guint32                n_records,
+                                         gconstpointer          data,
+                                         guint32                data_size,
+                                         const guint32         *sizes,
+                                         const gint64          *times,
+                                         guint32               *first_index)
+{
+  guint32 rec_sizes[HYSCAN_DB_RPC_MAX_BATCH];
+  gint64 rec_times[HYSCAN_DB_RPC_MAX_BATCH];
+
+  uRpcData *urpc_data;
+  guint32 exec_status;
+  guint32 i;
+
+  gboolean status = FALSE;
+
+  for (i = 0; i < n_records; i++)
+    {
+      rec_sizes[i] = GUINT32_TO_LE (sizes[i]);
+      rec_times[i] = GINT64_TO_LE (times[i]);
+    }
+
+  urpc_data = urpc_client_lock (priv->rpc);
+  if (urpc_data == NULL)
+    hyscan_db_client_lock_error ();
+
+  if (urpc_data_set_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, channel_id) != 0)
+    hyscan_db_client_set_error ("channel_id");
+
+  if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_COUNT, n_records) != 0)
+    hyscan_db_client_set_error ("count");
+
+  if (urpc_data_set (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_SIZES, rec_sizes, n_records * sizeof (guint32)) == NULL)
+    hyscan_db_client_set_error ("sizes");
+
+  if (urpc_data_set (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_TIMES, rec_times, n_records * sizeof (gint64)) == NULL)
+    hyscan_db_client_set_error ("times");
+
+  if (urpc_data_set (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_DATA, data, data_size) == NULL)
+    hyscan_db_client_set_error ("data");
+
+  if (urpc_client_exec (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_ADD_DATA_BATCH) != URPC_STATUS_OK)
+    hyscan_db_client_exec_error ();
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, &exec_status) != 0)
+    hyscan_db_client_get_error ("exec_status");
+  if (exec_status != HYSCAN_DB_RPC_STATUS_OK)
+    goto exit;
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_INDEX, first_index) != 0)
+    hyscan_db_client_get_error ("index");
+
+  status = TRUE;
+
+exit:
+  urpc_client_unlock (priv->rpc);
+  return status;
+}
+
+static gboolean
+hyscan_db_client_channel_add_data_batch (HyScanDB      *db,
+                                         gint32         channel_id,
+                                         guint32        n_records,
+                                         HyScanBuffer  *buffer,
+                                         const guint32 *sizes,
+                                         const gint64  *times,
+                                         guint32       *first_index)
+{
+  HyScanDBClient *dbc = HYSCAN_DB_CLIENT (db);
+  HyScanDBClientPrivate *priv = dbc->priv;
+
+  const guint8 *data;
+  guint32 data_size;
+  guint32 max_size;
+  guint64 total_size = 0;
+
+  guint32 n_sent = 0;
+  guint32 i;
+
+  if (priv->rpc == NULL)
+    return FALSE;
+
+  if (n_records == 0)
+    return FALSE;
+
+  data = hyscan_buffer_get (buffer, NULL, &data_size);
+  if (data == NULL)
+    return FALSE;
+
+  for (i = 0; i < n_records; i++)
+    total_size += sizes[i];
+
+  if (total_size != data_size)
+    return FALSE;
+
+  /* Место для размеров и меток времени записей. */
+  max_size = URPC_MAX_DATA_SIZE - 1024;
+  max_size -= HYSCAN_DB_RPC_MAX_BATCH * (sizeof (guint32) + sizeof (gint64));
+
+  /* Передаём записи группами, помещающимися в один запрос. */
+  while (n_sent < n_records)
+    {
+      guint32 n_chunk;
+      guint32 chunk_size;
+      guint32 index;
+
+      for (n_chunk = 0, chunk_size = 0; n_sent + n_chunk < n_records; n_chunk++)
+        {
+          guint32 size = sizes[n_sent + n_chunk];
+
+          if ((n_chunk == HYSCAN_DB_RPC_MAX_BATCH) || (size > max_size - chunk_size))
+            break;
+
+          chunk_size += size;
+        }
+
+      /* Запись не помещается в запрос. */
+      if (n_chunk == 0)
+        return FALSE;
+
+      if (!hyscan_db_client_channel_add_data_chunk (priv, channel_id, n_chunk, data, chunk_size,
+                                                    sizes + n_sent, times + n_sent, &index))
+        return FALSE;
+
+      if ((n_sent == 0) && (first_index != NULL))
+        *first_index = index;
+
+      n_sent += n_chunk;
+      data += chunk_size;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 hyscan_db_client_channel_get_data (HyScanDB     *db,
                                    gint32        channel_id,
@@ -1570,6 +1831,108 @@ exit:
   return status;
 }
 
+static gboolean
+hyscan_db_client_channel_get_data_batch (HyScanDB     *db,
+                                         gint32        channel_id,
+                                         guint32       first_index,
+                                         guint32      *n_records,
+                                         HyScanBuffer *buffer,
+                                         guint32      *sizes,
+                                         gint64       *times)
+{
+  HyScanDBClient *dbc = HYSCAN_DB_CLIENT (db);
+  HyScanDBClientPrivate *priv = dbc->priv;
+
+  gpointer data;
+  guint32 data_size;
+
+  guint8 *rec_sizes;
+  guint8 *rec_times;
+  guint32 rec_size;
+
+  gpointer dest;
+  guint32 dest_size;
+
+  uRpcData *urpc_data;
+  guint32 exec_status;
+  guint32 count;
+  guint32 i;
+
+  gboolean status = FALSE;
+
+  if (priv->rpc == NULL)
+    return FALSE;
+
+  if (*n_records == 0)
+    return FALSE;
+
+  urpc_data = urpc_client_lock (priv->rpc);
+  if (urpc_data == NULL)
+    hyscan_db_client_lock_error ();
+
+  if (urpc_data_set_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, channel_id) != 0)
+    hyscan_db_client_set_error ("channel_id");
+
+  if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_INDEX, first_index) != 0)
+    hyscan_db_client_set_error ("index");
+
+  count = MIN (*n_records, HYSCAN_DB_RPC_MAX_BATCH);
+  if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_COUNT, count) != 0)
+    hyscan_db_client_set_error ("count");
+
+  if (urpc_client_exec (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_GET_DATA_BATCH) != URPC_STATUS_OK)
+    hyscan_db_client_exec_error ();
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, &exec_status) != 0)
+    hyscan_db_client_get_error ("exec_status");
+  if (exec_status != HYSCAN_DB_RPC_STATUS_OK)
+    goto exit;
+
+  if ((urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_COUNT, &count) != 0) ||
+      (count == 0) || (count > *n_records))
+    hyscan_db_client_get_error ("count");
+
+  rec_sizes = urpc_data_get (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_SIZES, &rec_size);
+  if ((rec_sizes == NULL) || (rec_size != count * sizeof (guint32)))
+    hyscan_db_client_get_error ("sizes");
+
+  rec_times = urpc_data_get (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_TIMES, &rec_size);
+  if ((rec_times == NULL) || (rec_size != count * sizeof (gint64)))
+    hyscan_db_client_get_error ("times");
+
+  data = urpc_data_get (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_DATA, &data_size);
+  if (data == NULL)
+    hyscan_db_client_get_error ("data");
+
+  if (!hyscan_buffer_set_data_size (buffer, data_size))
+    goto exit;
+
+  dest = hyscan_buffer_get (buffer, NULL, &dest_size);
+  memcpy (dest, data, dest_size);
+
+  /* Массивы в буфере RPC могут быть не выровнены. */
+  for (i = 0; i < count; i++)
+    {
+      if (sizes != NULL)
+        {
+          memcpy (&sizes[i], rec_sizes + i * sizeof (guint32), sizeof (guint32));
+          sizes[i] = GUINT32_FROM_LE (sizes[i]);
+        }
+      if (times != NULL)
+        {
+          memcpy (&times[i], rec_times + i * sizeof (gint64), sizeof (gint64));
+          times[i] = GINT64_FROM_LE (times[i]);
+        }
+    }
+
+  *n_records = count;
+  status = TRUE;
+
+exit:
+  urpc_client_unlock (priv->rpc);
+  return status;
+}
+
 static guint32
 hyscan_db_client_channel_get_data_size (HyScanDB     *db,
                                         gint32        channel_id,
@@ -2289,10 +2652,15 @@ hyscan_db_client_interface_init (HyScanDBInterface *iface)
   iface->channel_set_chunk_size = hyscan_db_client_channel_set_chunk_size;
   iface->channel_set_save_time = hyscan_db_client_channel_set_save_time;
   iface->channel_set_save_size = hyscan_db_client_channel_set_save_size;
+  iface->channel_set_durability = hyscan_db_client_channel_set_durability;
+  iface->channel_set_compression = hyscan_db_client_channel_set_compression;
+  iface->channel_set_record_size = hyscan_db_client_channel_set_record_size;
 
   iface->channel_get_data_range = hyscan_db_client_channel_get_data_range;
   iface->channel_add_data = hyscan_db_client_channel_add_data;
+  iface->channel_add_data_batch = hyscan_db_client_channel_add_data_batch;
   iface->channel_get_data = hyscan_db_client_channel_get_data;
+  iface->channel_get_data_batch = hyscan_db_client_channel_get_data_batch;
   iface->channel_get_data_time = hyscan_db_client_channel_get_data_time;
   iface->channel_get_data_size = hyscan_db_client_channel_get_data_size;
   iface->channel_find_data = hyscan_db_client_channel_find_data;
@@ -0,0 +1,260 @@
+/* hyscan-db-codec.c
+ *
+ * Copyright 2015-2020 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanDB.
+ *
+ * HyScanDB is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanDB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanDB имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanDB на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* HyScanDBCodec - сжатие данных записей каналов.
+ *
+ * Объект используется классом HyScanDBChannelFile для сжатия данных
+ * записываемых в канал записей. Сжатие выполняется функцией
+ * hyscan_db_codec_compress, которая использует состояние алгоритма сжатия,
+ * хранящееся в объекте, поэтому одновременно объект может использовать только
+ * один поток. Распаковка данных выполняется функцией hyscan_db_codec_decompress,
+ * не требующей объекта, и может выполняться параллельно из нескольких потоков.
+ * Объект распаковки zlib создаётся один раз для каждого потока и сбрасывается
+ * после распаковки каждой записи.
+ *
+ * Поддерживаются алгоритмы:
+ * - HYSCAN_DB_COMPRESSION_ZLIB - deflate, реализуемый классами GZlibCompressor
+ *   и GZlibDecompressor, доступен всегда;
+ * - HYSCAN_DB_COMPRESSION_LZ4 - LZ4, доступен если библиотека собрана с
+ *   поддержкой LZ4 (HYSCAN_DB_WITH_LZ4).
+ *
+ * Функция hyscan_db_codec_compress возвращает 0, если данные не удалось сжать
+ * так, чтобы они поместились в буфер. Вызывающий код передаёт буфер меньшего,
+ * чем исходные данные, размера и в этом случае записывает данные без сжатия.
+ */
+
+#include "hyscan-db-codec.h"
+
+#include <gio/gio.h>
+
+#ifdef HYSCAN_DB_WITH_LZ4
+#include <lz4.h>
+#endif
+
+#define ZLIB_COMPRESSION_LEVEL 1                       /* Уровень сжатия zlib, приоритет скорости. */
+
+struct _HyScanDBCodec
+{
+  HyScanDBCompression          compression;            /* Алгоритм сжатия. */
+  GConverter                  *compressor;             /* Объект сжатия zlib. */
+};
+
+/* Объект распаковки zlib текущего потока. */
+static GPrivate hyscan_db_codec_zlib_decompressor = G_PRIVATE_INIT (g_object_unref);
+
+/* Функция выполняет преобразование данных целиком. */
+static gsize
+hyscan_db_codec_convert (GConverter    *converter,
+                         gconstpointer  data,
+                         gsize          size,
+                         gpointer       buffer,
+                         gsize          buffer_size)
+{
+  const guint8 *input = data;
+  guint8 *output = buffer;
+  gsize total_read = 0;
+  gsize total_written = 0;
+
+  if (buffer_size == 0)
+    return 0;
+
+  while (TRUE)
+    {
+      GConverterResult result;
+      gsize bytes_read;
+      gsize bytes_written;
+
+      result = g_converter_convert (converter,
+                                    input + total_read, size - total_read,
+                                    output + total_written, buffer_size - total_written,
+                                    G_CONVERTER_INPUT_AT_END,
+                                    &bytes_read, &bytes_written, NULL);
+
+      if (result == G_CONVERTER_ERROR)
+        return 0;
+
+      total_read += bytes_read;
+      total_written += bytes_written;
+
+      if (result == G_CONVERTER_FINISHED)
+        break;
+
+      /* Буфер заполнен, но преобразование не завершено - данные
+         не помещаются в буфер. */
+      if (total_written == buffer_size)
+        return 0;
+
+      /* Преобразование не продвигается. */
+      if ((bytes_read == 0) && (bytes_written == 0))
+        return 0;
+    }
+
+  return total_written;
+}
+
+/* Функция проверяет, поддерживается ли алгоритм сжатия. */
+gboolean
+hyscan_db_codec_is_supported (HyScanDBCompression compression)
+{
+  switch (compression)
+    {
+    case HYSCAN_DB_COMPRESSION_NONE:
+    case HYSCAN_DB_COMPRESSION_ZLIB:
+      return TRUE;
+
+#ifdef HYSCAN_DB_WITH_LZ4
+    case HYSCAN_DB_COMPRESSION_LZ4:
+      return TRUE;
+#endif
+
+    default:
+      return FALSE;
+    }
+}
+
+/* Функция создаёт объект сжатия данных. Для алгоритма HYSCAN_DB_COMPRESSION_NONE
+   и неподдерживаемых алгоритмов функция возвращает NULL. */
+HyScanDBCodec *
+hyscan_db_codec_new (HyScanDBCompression compression)
+{
+  HyScanDBCodec *codec;
+
+  if ((compression == HYSCAN_DB_COMPRESSION_NONE) || !hyscan_db_codec_is_supported (compression))
+    return NULL;
+
+  codec = g_new0 (HyScanDBCodec, 1);
+  codec->compression = compression;
+
+  if (compression == HYSCAN_DB_COMPRESSION_ZLIB)
+    {
+      codec->compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW,
+                                                              ZLIB_COMPRESSION_LEVEL));
+    }
+
+  return codec;
+}
+
+/* Функция освобождает объект сжатия данных. */
+void
+hyscan_db_codec_free (HyScanDBCodec *codec)
+{
+  if (codec == NULL)
+    return;
+
+  g_clear_object (&codec->compressor);
+  g_free (codec);
+}
+
+/* Функция возвращает алгоритм сжатия. */
+HyScanDBCompression
+hyscan_db_codec_get_compression (HyScanDBCodec *codec)
+{
+  return (codec != NULL) ? codec->compression : HYSCAN_DB_COMPRESSION_NONE;
+}
+
+/* Функция сжимает данные и возвращает размер сжатых данных или 0, если
+   сжатые данные не помещаются в буфер. */
+gsize
+hyscan_db_codec_compress (HyScanDBCodec *codec,
+                          gconstpointer  data,
+                          gsize          size,
+                          gpointer       buffer,
+                          gsize          buffer_size)
+{
+  gsize compressed_size = 0;
+
+  if ((size == 0) || (buffer_size == 0))
+    return 0;
+
+  if (codec->compression == HYSCAN_DB_COMPRESSION_ZLIB)
+    {
+      compressed_size = hyscan_db_codec_convert (codec->compressor, data, size, buffer, buffer_size);
+      g_converter_reset (codec->compressor);
+    }
+
+#ifdef HYSCAN_DB_WITH_LZ4
+  else if (codec->compression == HYSCAN_DB_COMPRESSION_LZ4)
+    {
+      gint lz4_size;
+
+      if ((size > LZ4_MAX_INPUT_SIZE) || (buffer_size > G_MAXINT))
+        return 0;
+
+      lz4_size = LZ4_compress_default (data, buffer, size, buffer_size);
+      compressed_size = (lz4_size > 0) ? lz4_size : 0;
+    }
+#endif
+
+  return compressed_size;
+}
+
+/* Функция распаковывает данные. Размер буфера должен совпадать с размером
+   распакованных данных. */
+gboolean
+hyscan_db_codec_decompress (HyScanDBCompression  compression,
+                            gconstpointer        data,
+                            gsize                size,
+                            gpointer             buffer,
+                            gsize                buffer_size)
+{
+  if (compression == HYSCAN_DB_COMPRESSION_ZLIB)
+    {
+      GConverter *decompressor;
+      gsize decompressed_size;
+
+      decompressor = g_private_get (&hyscan_db_codec_zlib_decompressor);
+      if (decompressor == NULL)
+        {
+          decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+          g_private_set (&hyscan_db_codec_zlib_decompressor, decompressor);
+        }
+
+      decompressed_size = hyscan_db_codec_convert (decompressor, data, size, buffer, buffer_size);
+      g_converter_reset (decompressor);
+
+      return (decompressed_size == buffer_size);
+    }
+
+#ifdef HYSCAN_DB_WITH_LZ4
+  if (compression == HYSCAN_DB_COMPRESSION_LZ4)
+    {
+      if ((size > G_MAXINT) || (buffer_size > G_MAXINT))
+        return FALSE;
+
+      return (LZ4_decompress_safe (data, buffer, size, buffer_size) == (gint) buffer_size);
+    }
+#endif
+
+  return FALSE;
+}
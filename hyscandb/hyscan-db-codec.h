@@ -0,0 +1,66 @@
+/* hyscan-db-codec.h
+ *
+ * Copyright 2015-2020 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanDB.
+ *
+ * HyScanDB is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanDB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanDB имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanDB на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+#ifndef __HYSCAN_DB_CODEC_H__
+#define __HYSCAN_DB_CODEC_H__
+
+#include "hyscan-db.h"
+
+G_BEGIN_DECLS
+
+typedef struct _HyScanDBCodec HyScanDBCodec;
+
+gboolean       hyscan_db_codec_is_supported    (HyScanDBCompression  compression);
+
+HyScanDBCodec *hyscan_db_codec_new             (HyScanDBCompression  compression);
+
+void           hyscan_db_codec_free            (HyScanDBCodec       *codec);
+
+HyScanDBCompression hyscan_db_codec_get_compression (HyScanDBCodec  *codec);
+
+gsize          hyscan_db_codec_compress        (HyScanDBCodec       *codec,
+                                                gconstpointer        data,
+                                                gsize                size,
+                                                gpointer             buffer,
+                                                gsize                buffer_size);
+
+gboolean       hyscan_db_codec_decompress      (HyScanDBCompression  compression,
+                                                gconstpointer        data,
+                                                gsize                size,
+                                                gpointer             buffer,
+                                                gsize                buffer_size);
+
+G_END_DECLS
+
+#endif /* __HYSCAN_DB_CODEC_H__ */
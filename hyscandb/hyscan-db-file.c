@@ -41,6 +41,7 @@
 #include "hyscan-db-file.h"
 #include "hyscan-db-channel-file.h"
 #include "hyscan-db-param-file.h"
+#include "hyscan-db-cache.h"
 
 #include <glib/gstdio.h>
 #include <gio/gio.h>
@@ -73,7 +74,19 @@
 enum
 {
   PROP_O,
-  PROP_PATH
+  PROP_PATH,
+  PROP_MMAP_INDEX,
+  PROP_WRITE_BUFFER_SIZE,
+  PROP_WRITE_BUFFER_TIME,
+  PROP_INDEX_CACHE_SIZE,
+  PROP_MEMORY_INDEX,
+  PROP_MEMORY_INDEX_PREFETCH,
+  PROP_IO_URING,
+  PROP_READ_AHEAD,
+  PROP_CACHE_SIZE,
+  PROP_PACK_COMPRESSION,
+  PROP_PREALLOCATE_SIZE,
+  PROP_MAX_OPEN_PARTS
 };
 
 /* Стуктура файла - метки проекта и галса. */
@@ -114,7 +127,7 @@ typedef struct
 /* Информация о канале данных. */
 typedef struct
 {
-  gint                 ref_count;              /* Число ссылок на объект. */
+  volatile gint        ref_count;              /* Число ссылок на объект. */
   guint                mod_count;              /* Номер изменения объекта. */
 
   gchar               *project_name;           /* Название проекта. */
@@ -159,6 +172,19 @@ struct _HyScanDBFilePrivate
   gchar               *path;                   /* Путь к каталогу с проектами. */
   guint                mod_count;              /* Номер изменения объекта. */
 
+  gboolean             mmap_index;             /* Отображать файлы индексов каналов в память. */
+  guint                write_buffer_size;      /* Размер буфера отложенной записи каналов. */
+  gint64               write_buffer_time;      /* Время нахождения данных в буфере отложенной записи. */
+  guint                index_cache_size;       /* Число кэшируемых индексов каналов. */
+  gboolean             memory_index;           /* Загружать все индексы каналов в память. */
+  gboolean             memory_index_prefetch;  /* Загружать индексы каналов в память фоновым потоком. */
+  gboolean             io_uring;               /* Использовать io_uring для работы с данными каналов. */
+  guint                read_ahead;             /* Число записей упреждающего чтения данных каналов. */
+  HyScanDBCache       *cache;                  /* Общий кэш данных и индексов каналов. */
+  guint                pack_compression;       /* Алгоритм фонового сжатия завершённых частей каналов. */
+  guint64              preallocate_size;       /* Максимальный размер области выделения места в файлах каналов. */
+  guint                max_open_parts;         /* Максимальное число частей канала с открытыми файлами. */
+
   gchar               *flock_name;             /* Имя файла блокировки. */
 #ifdef G_OS_UNIX
   FILE                *flock;                  /* Дескриптор файла блокировки. */
@@ -173,7 +199,7 @@ struct _HyScanDBFilePrivate
   GHashTable          *channels;               /* Список открытых каналов данных. */
   GHashTable          *params;                 /* Список открытых групп параметров. */
 
-  GMutex               lock;                   /* Блокировка многопоточного доступа. */
+  GRWLock              lock;                   /* Блокировка доступа к спискам открытых объектов. */
 };
 
 static void            hyscan_db_file_interface_init           (HyScanDBInterface     *iface);
@@ -194,6 +220,10 @@ static void            hyscan_db_remove_param_info             (gpointer
 
 static gint32          hyscan_db_file_create_id                (HyScanDBFilePrivate   *priv);
 
+static HyScanDBFileChannelInfo *hyscan_db_file_channel_info_ref (HyScanDBFilePrivate   *priv,
+                                                                 gint32                 channel_id,
+                                                                 gboolean               writable);
+
 static gboolean        hyscan_db_check_project_by_object_name  (gpointer               key,
                                                                 gpointer               value,
                                                                 gpointer               data);
@@ -210,6 +240,9 @@ static gboolean        hyscan_db_check_param_by_object_name    (gpointer
 static gboolean        hyscan_db_file_id_test                  (const gchar           *path,
                                                                 guint32                magic,
                                                                 gint64                *ctime);
+static gboolean        hyscan_db_channel_is_first_part         (const gchar           *path,
+                                                                const gchar           *name,
+                                                                const gchar           *file_suffix);
 static gboolean        hyscan_db_channel_test                  (const gchar           *path,
                                                                 const gchar           *name);
 
@@ -234,6 +267,67 @@ hyscan_db_file_class_init (HyScanDBFileClass *klass)
   g_object_class_install_property (object_class, PROP_PATH,
                                    g_param_spec_string ("path", "Path", "Path to projects", NULL,
                                                         G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_MMAP_INDEX,
+                                   g_param_spec_boolean ("mmap-index", "MMapIndex", "Map channel index files into memory", FALSE,
+                                                         G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_WRITE_BUFFER_SIZE,
+                                   g_param_spec_uint ("write-buffer-size", "WriteBufferSize", "Channel write-behind buffer size",
+                                                      0, G_MAXINT32, 0,
+                                                      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT));
+
+  g_object_class_install_property (object_class, PROP_WRITE_BUFFER_TIME,
+                                   g_param_spec_int64 ("write-buffer-time", "WriteBufferTime", "Channel write-behind buffer time limit",
+                                                       0, G_MAXINT64, 100000,
+                                                       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT));
+
+  g_object_class_install_property (object_class, PROP_INDEX_CACHE_SIZE,
+                                   g_param_spec_uint ("index-cache-size", "IndexCacheSize", "Number of cached channel indexes",
+                                                      0, 16 * 1024 * 1024, 2048,
+                                                      G_PARAM_WRITABLE | G_PARAM_CONSTRUCT));
+
+  g_object_class_install_property (object_class, PROP_MEMORY_INDEX,
+                                   g_param_spec_boolean ("memory-index", "MemoryIndex", "Load all channel indexes into memory", FALSE,
+                                                         G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_MEMORY_INDEX_PREFETCH,
+                                   g_param_spec_boolean ("memory-index-prefetch", "MemoryIndexPrefetch",
+                                                         "Load channel indexes into memory in background", FALSE,
+                                                         G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_IO_URING,
+                                   g_param_spec_boolean ("io-uring", "IOURing", "Use io_uring for channel data I/O", FALSE,
+                                                         G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_READ_AHEAD,
+                                   g_param_spec_uint ("read-ahead", "ReadAhead", "Number of channel records read ahead",
+                                                      0, 65536, 0,
+                                                      G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_CACHE_SIZE,
+                                   g_param_spec_uint64 ("cache-size", "CacheSize", "Shared channel cache size in bytes",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_PACK_COMPRESSION,
+                                   g_param_spec_uint ("pack-compression", "PackCompression",
+                                                      "Background compression of completed channel parts",
+                                                      HYSCAN_DB_COMPRESSION_NONE, HYSCAN_DB_COMPRESSION_LZ4,
+                                                      HYSCAN_DB_COMPRESSION_NONE,
+                                                      G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_PREALLOCATE_SIZE,
+                                   g_param_spec_uint64 ("preallocate-size", "PreallocateSize",
+                                                        "Maximum size of preallocated channel file extents",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_WRITABLE));
+
+  g_object_class_install_property (object_class, PROP_MAX_OPEN_PARTS,
+                                   g_param_spec_uint ("max-open-parts", "MaxOpenParts",
+                                                      "Maximum number of channel parts with open files",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_WRITABLE));
 }
 
 static void
@@ -257,6 +351,56 @@ hyscan_db_file_set_property (GObject      *object,
       priv->path = g_value_dup_string (value);
       break;
 
+    case PROP_MMAP_INDEX:
+      priv->mmap_index = g_value_get_boolean (value);
+      break;
+
+    case PROP_WRITE_BUFFER_SIZE:
+      priv->write_buffer_size = g_value_get_uint (value);
+      break;
+
+    case PROP_WRITE_BUFFER_TIME:
+      priv->write_buffer_time = g_value_get_int64 (value);
+      break;
+
+    case PROP_INDEX_CACHE_SIZE:
+      priv->index_cache_size = g_value_get_uint (value);
+      break;
+
+    case PROP_MEMORY_INDEX:
+      priv->memory_index = g_value_get_boolean (value);
+      break;
+
+    case PROP_MEMORY_INDEX_PREFETCH:
+      priv->memory_index_prefetch = g_value_get_boolean (value);
+      break;
+
+    case PROP_IO_URING:
+      priv->io_uring = g_value_get_boolean (value);
+      break;
+
+    case PROP_READ_AHEAD:
+      priv->read_ahead = g_value_get_uint (value);
+      break;
+
+    case PROP_CACHE_SIZE:
+      g_clear_object (&priv->cache);
+      if (g_value_get_uint64 (value) > 0)
+        priv->cache = hyscan_db_cache_new (g_value_get_uint64 (value));
+      break;
+
+    case PROP_PACK_COMPRESSION:
+      priv->pack_compression = g_value_get_uint (value);
+      break;
+
+    case PROP_PREALLOCATE_SIZE:
+      priv->preallocate_size = g_value_get_uint64 (value);
+      break;
+
+    case PROP_MAX_OPEN_PARTS:
+      priv->max_open_parts = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -280,7 +424,7 @@ hyscan_db_file_object_constructed (GObject *object)
   priv->channels = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, hyscan_db_remove_channel_info);
   priv->params = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, hyscan_db_remove_param_info);
 
-  g_mutex_init (&priv->lock);
+  g_rw_lock_init (&priv->lock);
 
   priv->flock_name = g_build_filename (priv->path, DB_LOCK_FILE, NULL);
 
@@ -348,7 +492,9 @@ hyscan_db_file_object_finalize (GObject *object)
   g_hash_table_destroy (priv->tracks);
   g_hash_table_destroy (priv->projects);
 
-  g_mutex_clear (&priv->lock);
+  g_clear_object (&priv->cache);
+
+  g_rw_lock_clear (&priv->lock);
 
 #ifdef G_OS_UNIX
   if (priv->flocked)
@@ -449,8 +595,7 @@ hyscan_db_remove_channel_info (gpointer value)
 {
   HyScanDBFileChannelInfo *channel_info = value;
 
-  channel_info->ref_count -= 1;
-  if (channel_info->ref_count > 0)
+  if (!g_atomic_int_dec_and_test (&channel_info->ref_count))
     return;
 
   g_object_unref (channel_info->channel);
@@ -513,6 +658,33 @@ hyscan_db_file_create_id (HyScanDBFilePrivate *priv)
   return id;
 }
 
+/* Функция ищет канал данных в списке открытых и увеличивает число ссылок на
+   его описание. Это позволяет выполнять операции ввода/вывода без блокировки
+   списков открытых объектов. После завершения работы с каналом необходимо
+   вызвать функцию hyscan_db_remove_channel_info. Если writable = TRUE,
+   дескриптор должен иметь права на запись данных. */
+static HyScanDBFileChannelInfo *
+hyscan_db_file_channel_info_ref (HyScanDBFilePrivate *priv,
+                                 gint32               channel_id,
+                                 gboolean             writable)
+{
+  HyScanDBFileChannelInfo *channel_info;
+
+  g_rw_lock_reader_lock (&priv->lock);
+
+  /* Ищем канал данных в списке открытых. */
+  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
+  if ((channel_info != NULL) && writable && (channel_info->wid != channel_id))
+    channel_info = NULL;
+
+  if (channel_info != NULL)
+    g_atomic_int_inc (&channel_info->ref_count);
+
+  g_rw_lock_reader_unlock (&priv->lock);
+
+  return channel_info;
+}
+
 /* Вспомогательная функция поиска открытых проектов по имени проекта. */
 static gboolean
 hyscan_db_check_project_by_object_name (gpointer key,
@@ -629,6 +801,36 @@ exit:
   return status;
 }
 
+/* Функция проверяет, что file_suffix ("XXXXXX.i") - окончание имени файла
+   индексов первой части канала name: нулевой или части, перед которой нет
+   других частей. */
+static gboolean
+hyscan_db_channel_is_first_part (const gchar *path,
+                                 const gchar *name,
+                                 const gchar *file_suffix)
+{
+  gchar *prev_file;
+  gboolean prev_exist;
+  guint64 part;
+  gchar *end;
+
+  if ((file_suffix == NULL) || !g_ascii_isdigit (file_suffix[0]))
+    return FALSE;
+
+  part = g_ascii_strtoull (file_suffix, &end, 10);
+  if ((g_strcmp0 (end, ".i") != 0) || (part > G_MAXINT32))
+    return FALSE;
+
+  if (part == 0)
+    return TRUE;
+
+  prev_file = g_strdup_printf ("%s%s%s.%06d.i", path, G_DIR_SEPARATOR_S, name, (gint) part - 1);
+  prev_exist = g_file_test (prev_file, G_FILE_TEST_IS_REGULAR);
+  g_free (prev_file);
+
+  return !prev_exist;
+}
+
 /* Функция проверяет, что галс в каталоге path содержит канал name. */
 static gboolean
 hyscan_db_channel_test (const gchar *path,
@@ -636,15 +838,21 @@ hyscan_db_channel_test (const gchar *path,
 {
   gboolean status = TRUE;
   gchar *channel_file = NULL;
+  gint first_part;
 
-  /* Проверяем наличие файла name.000000.d */
-  channel_file = g_strdup_printf ("%s%s%s.000000.d", path, G_DIR_SEPARATOR_S, name);
+  /* Номер первой части канала, после удаления старых частей он не равен нулю. */
+  first_part = hyscan_db_channel_get_first_part (path, name);
+  if (first_part < 0)
+    return FALSE;
+
+  /* Проверяем наличие файла name.XXXXXX.d */
+  channel_file = g_strdup_printf ("%s%s%s.%06d.d", path, G_DIR_SEPARATOR_S, name, first_part);
   if (!g_file_test (channel_file, G_FILE_TEST_IS_REGULAR))
     status = FALSE;
   g_free (channel_file);
 
-  /* Проверяем наличие файла name.000000.i */
-  channel_file = g_strdup_printf ("%s%s%s.000000.i", path, G_DIR_SEPARATOR_S, name);
+  /* Проверяем наличие файла name.XXXXXX.i */
+  channel_file = g_strdup_printf ("%s%s%s.%06d.i", path, G_DIR_SEPARATOR_S, name, first_part);
   if (!g_file_test (channel_file, G_FILE_TEST_IS_REGULAR))
     status = FALSE;
   g_free (channel_file);
@@ -800,7 +1008,7 @@ hyscan_db_file_get_mod_count (HyScanDB *db,
   if (!priv->flocked)
     return 0;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   if (id == 0)
     {
@@ -837,7 +1045,7 @@ hyscan_db_file_get_mod_count (HyScanDB *db,
     }
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   return mod_count;
 }
@@ -862,7 +1070,7 @@ hyscan_db_file_is_exist (HyScanDB    *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Проверяем существование проекта. */
   project_path = g_build_filename (priv->path, project_name, NULL);
@@ -901,7 +1109,7 @@ hyscan_db_file_is_exist (HyScanDB    *db,
     exist = TRUE;
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
   g_free (project_path);
   g_free (track_path);
 
@@ -931,7 +1139,7 @@ hyscan_db_file_project_list (HyScanDB *db)
 
   projects = g_array_new (TRUE, TRUE, sizeof (gchar *));
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Проверяем все найденые каталоги - содержат они проект или нет. */
   while ((project_name = g_dir_read_name (db_dir)) != NULL)
@@ -952,7 +1160,7 @@ hyscan_db_file_project_list (HyScanDB *db)
       g_array_append_val (projects, project_name);
     }
 
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   g_dir_close (db_dir);
 
@@ -985,7 +1193,7 @@ hyscan_db_file_project_open (HyScanDB    *db,
   if (!priv->flocked)
     return -1;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Генерация нового идентификатора открываемого объекта. */
   nid = hyscan_db_file_create_id (priv);
@@ -1033,7 +1241,7 @@ hyscan_db_file_project_open (HyScanDB    *db,
   g_hash_table_insert (priv->projects, GINT_TO_POINTER (id), project_info);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   g_free (project_path);
 
@@ -1066,7 +1274,7 @@ hyscan_db_file_project_create (HyScanDB    *db,
   if (!hyscan_db_file_check_name (project_name, FALSE))
     return -1;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   ctime = g_get_real_time () / G_USEC_PER_SEC;
   id.magic = GUINT32_TO_LE (PROJECT_FILE_MAGIC);
@@ -1113,7 +1321,7 @@ hyscan_db_file_project_create (HyScanDB    *db,
   status = TRUE;
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   g_free (project_schema_file);
   g_free (project_param_file);
@@ -1148,7 +1356,7 @@ hyscan_db_file_project_remove (HyScanDB    *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   object_info.project_name = project_name;
   object_info.track_name = "*";
@@ -1208,7 +1416,7 @@ hyscan_db_file_project_remove (HyScanDB    *db,
   g_atomic_int_inc (&priv->mod_count);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   g_free (project_path);
 
@@ -1229,14 +1437,14 @@ hyscan_db_file_project_get_ctime (HyScanDB *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Ищем проект в списке открытых. */
   project_info = g_hash_table_lookup (priv->projects, GINT_TO_POINTER (project_id));
   if (project_info != NULL)
     ctime = g_date_time_new_from_unix_local (project_info->ctime);
 
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   return ctime;
 }
@@ -1258,7 +1466,7 @@ hyscan_db_file_track_list (HyScanDB *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   tracks = g_array_new (TRUE, TRUE, sizeof (gchar *));
 
@@ -1295,7 +1503,7 @@ hyscan_db_file_track_list (HyScanDB *db,
   g_dir_close (db_dir);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   if (tracks->len == 0)
     {
@@ -1396,9 +1604,9 @@ hyscan_db_file_track_open (HyScanDB    *db,
   if (!priv->flocked)
     return -1;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
   id = hyscan_db_file_open_track_int (db, project_id, track_name, TRUE);
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return id;
 }
@@ -1433,7 +1641,7 @@ hyscan_db_file_track_create (HyScanDB    *db,
   if (!hyscan_db_file_check_name (track_name, FALSE))
     return -1;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем проект в списке открытых. */
   project_info = g_hash_table_lookup (priv->projects, GINT_TO_POINTER (project_id));
@@ -1498,7 +1706,7 @@ hyscan_db_file_track_create (HyScanDB    *db,
   g_atomic_int_inc (&project_info->mod_count);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   g_clear_object (&params);
 
@@ -1531,7 +1739,7 @@ hyscan_db_file_track_remove (HyScanDB    *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем проект в списке открытых. */
   project_info = g_hash_table_lookup (priv->projects, GINT_TO_POINTER (project_id));
@@ -1586,7 +1794,7 @@ hyscan_db_file_track_remove (HyScanDB    *db,
   g_atomic_int_inc (&project_info->mod_count);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   g_free (track_path);
 
@@ -1607,14 +1815,14 @@ hyscan_db_file_track_get_ctime (HyScanDB *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Ищем галс в списке открытых. */
   track_info = g_hash_table_lookup (priv->tracks, GINT_TO_POINTER (track_id));
   if (track_info != NULL)
     ctime = g_date_time_new_from_unix_local (track_info->ctime);
 
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   return ctime;
 }
@@ -1639,7 +1847,7 @@ hyscan_db_file_channel_list (HyScanDB *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   channels = g_array_new (TRUE, TRUE, sizeof (gchar *));
 
@@ -1655,7 +1863,8 @@ hyscan_db_file_channel_list (HyScanDB *db,
       goto exit;
     }
 
-  /* Проверяем все найденые файлы на совпадение с именем name.000000.d */
+  /* Проверяем все найденые файлы на совпадение с именем файла индексов
+     первой части канала name.XXXXXX.i */
   while ((file_name = g_dir_read_name (db_dir)) != NULL)
     {
       gchar **splited_channel_name;
@@ -1667,7 +1876,7 @@ hyscan_db_file_channel_list (HyScanDB *db,
         continue;
 
       /* Если совпадение найдено проверяем, что существует канал с именем name. */
-      if (g_strcmp0 (splited_channel_name[1], "000000.d") == 0)
+      if (hyscan_db_channel_is_first_part (track_info->path, splited_channel_name[0], splited_channel_name[1]))
         status = hyscan_db_channel_test (track_info->path, splited_channel_name[0]);
       else
         status = FALSE;
@@ -1717,7 +1926,7 @@ hyscan_db_file_channel_list (HyScanDB *db,
   g_dir_close (db_dir);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   if (channels->len == 0)
     {
@@ -1746,7 +1955,7 @@ hyscan_db_file_open_channel_int (HyScanDB    *db,
   HyScanDBFileChannelInfo *channel_info;
   HyScanDBFileObjectInfo object_info;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем галс в списке открытых. */
   track_info = g_hash_table_lookup (priv->tracks, GINT_TO_POINTER (track_id));
@@ -1774,7 +1983,7 @@ hyscan_db_file_open_channel_int (HyScanDB    *db,
     {
       if (readonly)
         {
-          channel_info->ref_count += 1;
+          g_atomic_int_inc (&channel_info->ref_count);
           id = nid;
         }
       else
@@ -1815,9 +2024,23 @@ hyscan_db_file_open_channel_int (HyScanDB    *db,
       channel_info->track_name = g_strdup (track_info->track_name);
       channel_info->channel_name = g_strdup (channel_name);
       channel_info->path = g_strdup (track_info->path);
-      channel_info->channel = hyscan_db_channel_file_new (channel_info->path,
-                                                          channel_info->channel_name,
-                                                          readonly);
+      channel_info->channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                                            "path", channel_info->path,
+                                            "name", channel_info->channel_name,
+                                            "readonly", readonly,
+                                            "mmap-index", priv->mmap_index,
+                                            "write-buffer-size", priv->write_buffer_size,
+                                            "write-buffer-time", priv->write_buffer_time,
+                                            "index-cache-size", (priv->cache == NULL) ? priv->index_cache_size : 0,
+                                            "memory-index", priv->memory_index,
+                                            "memory-index-prefetch", priv->memory_index_prefetch,
+                                            "io-uring", priv->io_uring,
+                                            "read-ahead", priv->read_ahead,
+                                            "cache", priv->cache,
+                                            "pack-compression", priv->pack_compression,
+                                            "preallocate-size", priv->preallocate_size,
+                                            "max-open-parts", priv->max_open_parts,
+                                            NULL);
       channel_info->ctime = hyscan_db_channel_file_get_ctime (channel_info->channel);
       if (readonly)
         {
@@ -1869,7 +2092,7 @@ hyscan_db_file_open_channel_int (HyScanDB    *db,
   g_hash_table_insert (priv->channels, GINT_TO_POINTER (id), channel_info);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return id;
 }
@@ -1935,7 +2158,7 @@ hyscan_db_file_channel_remove (HyScanDB    *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем галс в списке открытых. */
   track_info = g_hash_table_lookup (priv->tracks, GINT_TO_POINTER (track_id));
@@ -1988,7 +2211,7 @@ hyscan_db_file_channel_remove (HyScanDB    *db,
   g_atomic_int_inc (&track_info->mod_count);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return status;
 }
@@ -2007,14 +2230,14 @@ hyscan_db_file_channel_get_ctime (HyScanDB *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Ищем канал данных в списке открытых. */
   channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
   if (channel_info != NULL)
     ctime = g_date_time_new_from_unix_local (channel_info->ctime);
 
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   return ctime;
 }
@@ -2034,7 +2257,7 @@ hyscan_db_file_channel_finalize (HyScanDB *db,
   if (!priv->flocked)
     return;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем канал данных в списке открытых. */
   channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
@@ -2051,11 +2274,23 @@ hyscan_db_file_channel_finalize (HyScanDB *db,
       if (param_info != NULL)
         param_info->channel_object_wid = -1;
 
-      hyscan_db_channel_file_finalize_channel (channel_info->channel);
       channel_info->wid = -1;
+      g_atomic_int_inc (&channel_info->ref_count);
     }
+  else
+    {
+      channel_info = NULL;
+    }
+
+  g_rw_lock_writer_unlock (&priv->lock);
 
-  g_mutex_unlock (&priv->lock);
+  /* Завершение записи включает сброс буферов на диск и ожидание потока
+     обслуживания канала, поэтому выполняется без блокировки списков. */
+  if (channel_info != NULL)
+    {
+      hyscan_db_channel_file_finalize_channel (channel_info->channel);
+      hyscan_db_remove_channel_info (channel_info);
+    }
 }
 
 /* Функция возвращает режим доступа к каналу данных. */
@@ -2072,7 +2307,7 @@ hyscan_db_file_channel_is_writable (HyScanDB *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_reader_lock (&priv->lock);
 
   /* Ищем канал данных в списке открытых. */
   channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
@@ -2081,7 +2316,7 @@ hyscan_db_file_channel_is_writable (HyScanDB *db,
   if ((channel_info != NULL) && (channel_info->wid > 0))
     writable = TRUE;
 
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_reader_unlock (&priv->lock);
 
   return writable;
 }
@@ -2101,14 +2336,14 @@ hyscan_db_file_channel_set_chunk_size (HyScanDB *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
-
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    status = hyscan_db_channel_file_set_channel_chunk_size (channel_info->channel, chunk_size);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
+
+  status = hyscan_db_channel_file_set_channel_chunk_size (channel_info->channel, chunk_size);
 
-  g_mutex_unlock (&priv->lock);
+  hyscan_db_remove_channel_info (channel_info);
 
   return status;
 }
@@ -2128,14 +2363,14 @@ hyscan_db_file_channel_set_save_time (HyScanDB *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
-
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    status = hyscan_db_channel_file_set_channel_save_time (channel_info->channel, save_time);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
 
-  g_mutex_unlock (&priv->lock);
+  status = hyscan_db_channel_file_set_channel_save_time (channel_info->channel, save_time);
+
+  hyscan_db_remove_channel_info (channel_info);
 
   return status;
 }
@@ -2155,14 +2390,95 @@ hyscan_db_file_channel_set_save_size (HyScanDB *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  /* Ищем канал данных в списке открытых. */
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
+
+  status = hyscan_db_channel_file_set_channel_save_size (channel_info->channel, save_size);
+
+  hyscan_db_remove_channel_info (channel_info);
+
+  return status;
+}
+
+/* Функция устанавливает режим сохранности записываемых данных. */
+static gboolean
+hyscan_db_file_channel_set_durability (HyScanDB           *db,
+                                       gint32              channel_id,
+                                       HyScanDBDurability  durability)
+{
+  HyScanDBFile *dbf = HYSCAN_DB_FILE (db);
+  HyScanDBFilePrivate *priv = dbf->priv;
+
+  HyScanDBFileChannelInfo *channel_info;
+  gboolean status = FALSE;
+
+  if (!priv->flocked)
+    return FALSE;
 
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    status = hyscan_db_channel_file_set_channel_save_size (channel_info->channel, save_size);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
 
-  g_mutex_unlock (&priv->lock);
+  status = hyscan_db_channel_file_set_channel_durability (channel_info->channel, durability);
+
+  hyscan_db_remove_channel_info (channel_info);
+
+  return status;
+}
+
+/* Функция устанавливает алгоритм сжатия записываемых данных. */
+static gboolean
+hyscan_db_file_channel_set_compression (HyScanDB            *db,
+                                        gint32               channel_id,
+                                        HyScanDBCompression  compression)
+{
+  HyScanDBFile *dbf = HYSCAN_DB_FILE (db);
+  HyScanDBFilePrivate *priv = dbf->priv;
+
+  HyScanDBFileChannelInfo *channel_info;
+  gboolean status = FALSE;
+
+  if (!priv->flocked)
+    return FALSE;
+
+  /* Ищем канал данных в списке открытых. */
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
+
+  status = hyscan_db_channel_file_set_channel_compression (channel_info->channel, compression);
+
+  hyscan_db_remove_channel_info (channel_info);
+
+  return status;
+}
+
+/* Функция устанавливает фиксированный размер записываемых записей. */
+static gboolean
+hyscan_db_file_channel_set_record_size (HyScanDB *db,
+                                        gint32    channel_id,
+                                        guint32   record_size)
+{
+  HyScanDBFile *dbf = HYSCAN_DB_FILE (db);
+  HyScanDBFilePrivate *priv = dbf->priv;
+
+  HyScanDBFileChannelInfo *channel_info;
+  gboolean status = FALSE;
+
+  if (!priv->flocked)
+    return FALSE;
+
+  /* Ищем канал данных в списке открытых. */
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
+
+  status = hyscan_db_channel_file_set_channel_record_size (channel_info->channel, record_size);
+
+  hyscan_db_remove_channel_info (channel_info);
 
   return status;
 }
@@ -2183,14 +2499,14 @@ hyscan_db_file_channel_get_data_range (HyScanDB *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
-
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    status = hyscan_db_channel_file_get_channel_data_range (channel_info->channel, first_index, last_index);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
+
+  status = hyscan_db_channel_file_get_channel_data_range (channel_info->channel, first_index, last_index);
 
-  g_mutex_unlock (&priv->lock);
+  hyscan_db_remove_channel_info (channel_info);
 
   return status;
 }
@@ -2212,18 +2528,50 @@ hyscan_db_file_channel_add_data (HyScanDB     *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  /* Ищем канал данных в списке открытых для записи. */
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, TRUE);
+  if (channel_info == NULL)
+    return FALSE;
+
+  status = hyscan_db_channel_file_add_channel_data (channel_info->channel, time, buffer, index);
+  if (status)
+    g_atomic_int_inc (&channel_info->mod_count);
+
+  hyscan_db_remove_channel_info (channel_info);
+
+  return status;
+}
+
+/* Функция записывает группу новых записей. */
+static gboolean
+hyscan_db_file_channel_add_data_batch (HyScanDB      *db,
+                                       gint32         channel_id,
+                                       guint32        n_records,
+                                       HyScanBuffer  *buffer,
+                                       const guint32 *sizes,
+                                       const gint64  *times,
+                                       guint32       *first_index)
+{
+  HyScanDBFile *dbf = HYSCAN_DB_FILE (db);
+  HyScanDBFilePrivate *priv = dbf->priv;
+
+  HyScanDBFileChannelInfo *channel_info;
+  gboolean status = FALSE;
+
+  if (!priv->flocked)
+    return FALSE;
+
+  /* Ищем канал данных в списке открытых для записи. */
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, TRUE);
+  if (channel_info == NULL)
+    return FALSE;
 
-  /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL && channel_info->wid == channel_id)
-    {
-      status = hyscan_db_channel_file_add_channel_data (channel_info->channel, time, buffer, index);
-      if (status)
-        g_atomic_int_inc (&channel_info->mod_count);
-    }
+  status = hyscan_db_channel_file_add_channel_data_batch (channel_info->channel, n_records,
+                                                          buffer, sizes, times, first_index);
+  if (status)
+    g_atomic_int_inc (&channel_info->mod_count);
 
-  g_mutex_unlock (&priv->lock);
+  hyscan_db_remove_channel_info (channel_info);
 
   return status;
 }
@@ -2245,18 +2593,78 @@ hyscan_db_file_channel_get_data (HyScanDB     *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  /* Ищем канал данных в списке открытых. */
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
+
+  status = hyscan_db_channel_file_get_channel_data (channel_info->channel, index, buffer, time);
+
+  hyscan_db_remove_channel_info (channel_info);
+
+  return status;
+}
+
+/* Функция считывает данные нескольких последовательных записей. */
+static gboolean
+hyscan_db_file_channel_get_data_batch (HyScanDB     *db,
+                                       gint32        channel_id,
+                                       guint32       first_index,
+                                       guint32      *n_records,
+                                       HyScanBuffer *buffer,
+                                       guint32      *sizes,
+                                       gint64       *times)
+{
+  HyScanDBFile *dbf = HYSCAN_DB_FILE (db);
+  HyScanDBFilePrivate *priv = dbf->priv;
+
+  HyScanDBFileChannelInfo *channel_info;
+  gboolean status = FALSE;
+
+  if (!priv->flocked)
+    return FALSE;
 
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    status = hyscan_db_channel_file_get_channel_data (channel_info->channel, index, buffer, time);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return FALSE;
 
-  g_mutex_unlock (&priv->lock);
+  status = hyscan_db_channel_file_get_channel_data_batch (channel_info->channel, first_index, n_records,
+                                                          buffer, sizes, times);
+
+  hyscan_db_remove_channel_info (channel_info);
 
   return status;
 }
 
+/* Функция считывает данные без копирования. */
+static GBytes *
+hyscan_db_file_channel_map_data (HyScanDB *db,
+                                 gint32    channel_id,
+                                 guint32   index,
+                                 gint64   *time)
+{
+  HyScanDBFile *dbf = HYSCAN_DB_FILE (db);
+  HyScanDBFilePrivate *priv = dbf->priv;
+
+  HyScanDBFileChannelInfo *channel_info;
+  GBytes *bytes;
+
+  if (!priv->flocked)
+    return NULL;
+
+  /* Ищем канал данных в списке открытых. */
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return NULL;
+
+  bytes = hyscan_db_channel_file_map_channel_data (channel_info->channel, index, time);
+
+  hyscan_db_remove_channel_info (channel_info);
+
+  return bytes;
+}
+
 /* Функция считывает размер данных. */
 static guint32
 hyscan_db_file_channel_get_data_size (HyScanDB     *db,
@@ -2272,14 +2680,14 @@ hyscan_db_file_channel_get_data_size (HyScanDB     *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
-
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    data_size = hyscan_db_channel_file_get_channel_data_size (channel_info->channel, index);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return 0;
+
+  data_size = hyscan_db_channel_file_get_channel_data_size (channel_info->channel, index);
 
-  g_mutex_unlock (&priv->lock);
+  hyscan_db_remove_channel_info (channel_info);
 
   return data_size;
 }
@@ -2299,14 +2707,14 @@ hyscan_db_file_channel_get_data_time (HyScanDB     *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
-
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    data_time = hyscan_db_channel_file_get_channel_data_time (channel_info->channel, index);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return -1;
 
-  g_mutex_unlock (&priv->lock);
+  data_time = hyscan_db_channel_file_get_channel_data_time (channel_info->channel, index);
+
+  hyscan_db_remove_channel_info (channel_info);
 
   return data_time;
 }
@@ -2330,14 +2738,14 @@ hyscan_db_file_channel_find_data (HyScanDB *db,
   if (!priv->flocked)
     return HYSCAN_DB_FIND_FAIL;
 
-  g_mutex_lock (&priv->lock);
-
   /* Ищем канал данных в списке открытых. */
-  channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
-  if (channel_info != NULL)
-    status = hyscan_db_channel_file_find_channel_data (channel_info->channel, time, lindex, rindex, ltime, rtime);
+  channel_info = hyscan_db_file_channel_info_ref (priv, channel_id, FALSE);
+  if (channel_info == NULL)
+    return HYSCAN_DB_FIND_FAIL;
+
+  status = hyscan_db_channel_file_find_channel_data (channel_info->channel, time, lindex, rindex, ltime, rtime);
 
-  g_mutex_unlock (&priv->lock);
+  hyscan_db_remove_channel_info (channel_info);
 
   return status;
 }
@@ -2356,14 +2764,14 @@ hyscan_db_file_project_param_list (HyScanDB *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем проект в списке открытых. */
   project_info = g_hash_table_lookup (priv->projects, GINT_TO_POINTER (project_id));
   if (project_info != NULL)
     list = hyscan_db_file_get_directory_param_list (project_info->param_path);
 
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return list;
 }
@@ -2392,7 +2800,7 @@ hyscan_db_file_project_param_open (HyScanDB    *db,
   if (!hyscan_db_file_check_name (group_name, FALSE))
     return id;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем проект в списке открытых. */
   project_info = g_hash_table_lookup (priv->projects, GINT_TO_POINTER (project_id));
@@ -2445,7 +2853,7 @@ hyscan_db_file_project_param_open (HyScanDB    *db,
   g_hash_table_insert (priv->params, GINT_TO_POINTER (id), param_info);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
   g_free (param_file);
   g_free (schema_file);
 
@@ -2473,7 +2881,7 @@ hyscan_db_file_project_param_remove (HyScanDB    *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем проект в списке открытых. */
   project_info = g_hash_table_lookup (priv->projects, GINT_TO_POINTER (project_id));
@@ -2510,7 +2918,7 @@ hyscan_db_file_project_param_remove (HyScanDB    *db,
   status = TRUE;
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
   g_free (param_file);
 
   return status;
@@ -2537,7 +2945,7 @@ hyscan_db_file_track_param_open (HyScanDB    *db,
   if (!priv->flocked)
     return -1;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем галс в списке открытых. */
   track_info = g_hash_table_lookup (priv->tracks, GINT_TO_POINTER (track_id));
@@ -2602,7 +3010,7 @@ hyscan_db_file_track_param_open (HyScanDB    *db,
   g_hash_table_insert (priv->params, GINT_TO_POINTER (id), param_info);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return id;
 }
@@ -2628,7 +3036,7 @@ hyscan_db_file_channel_param_open (HyScanDB    *db,
   if (!priv->flocked)
     return -1;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем канал данных в списке открытых. */
   channel_info = g_hash_table_lookup (priv->channels, GINT_TO_POINTER (channel_id));
@@ -2693,7 +3101,7 @@ hyscan_db_file_channel_param_open (HyScanDB    *db,
   g_hash_table_insert (priv->params, GINT_TO_POINTER (id), param_info);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return id;
 }
@@ -2712,14 +3120,14 @@ hyscan_db_file_param_object_list (HyScanDB *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем группу параметров в списке открытых. */
   param_info = g_hash_table_lookup (priv->params, GINT_TO_POINTER (param_id));
   if (param_info != NULL)
     list = hyscan_db_param_file_object_list (param_info->param);
 
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return list;
 }
@@ -2744,7 +3152,7 @@ hyscan_db_file_param_object_create (HyScanDB    *db,
   if (!hyscan_db_file_check_name (object_name, TRUE))
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем группу параметров в списке открытых. */
   param_info = g_hash_table_lookup (priv->params, GINT_TO_POINTER (param_id));
@@ -2760,7 +3168,7 @@ hyscan_db_file_param_object_create (HyScanDB    *db,
     g_atomic_int_inc (&param_info->mod_count);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return status;
 }
@@ -2780,7 +3188,7 @@ hyscan_db_file_param_object_remove (HyScanDB    *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем группу параметров в списке открытых. */
   param_info = g_hash_table_lookup (priv->params, GINT_TO_POINTER (param_id));
@@ -2796,7 +3204,7 @@ hyscan_db_file_param_object_remove (HyScanDB    *db,
     g_atomic_int_inc (&param_info->mod_count);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return status;
 }
@@ -2816,7 +3224,7 @@ hyscan_db_file_param_object_get_schema (HyScanDB    *db,
   if (!priv->flocked)
     return NULL;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем группу параметров в списке открытых. */
   param_info = g_hash_table_lookup (priv->params, GINT_TO_POINTER (param_id));
@@ -2843,7 +3251,7 @@ hyscan_db_file_param_object_get_schema (HyScanDB    *db,
     g_object_ref (schema);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return schema;
 }
@@ -2863,7 +3271,7 @@ hyscan_db_file_param_set (HyScanDB        *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем группу параметров в списке открытых. */
   param_info = g_hash_table_lookup (priv->params, GINT_TO_POINTER (param_id));
@@ -2906,7 +3314,7 @@ hyscan_db_file_param_set (HyScanDB        *db,
     g_atomic_int_inc (&param_info->mod_count);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return status;
 }
@@ -2926,7 +3334,7 @@ hyscan_db_file_param_get (HyScanDB        *db,
   if (!priv->flocked)
     return FALSE;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   /* Ищем группу параметров в списке открытых. */
   param_info = g_hash_table_lookup (priv->params, GINT_TO_POINTER (param_id));
@@ -2951,7 +3359,7 @@ hyscan_db_file_param_get (HyScanDB        *db,
   status = hyscan_db_param_file_get (param_info->param, object_name, param_list);
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 
   return status;
 }
@@ -3119,7 +3527,7 @@ hyscan_db_file_close (HyScanDB *db,
   if (!priv->flocked)
     return;
 
-  g_mutex_lock (&priv->lock);
+  g_rw_lock_writer_lock (&priv->lock);
 
   if (hyscan_db_file_project_close (priv, id))
     goto exit;
@@ -3134,7 +3542,7 @@ hyscan_db_file_close (HyScanDB *db,
     goto exit;
 
 exit:
-  g_mutex_unlock (&priv->lock);
+  g_rw_lock_writer_unlock (&priv->lock);
 }
 
 HyScanDBFile *
@@ -3184,10 +3592,16 @@ hyscan_db_file_interface_init (HyScanDBInterface *iface)
   iface->channel_set_chunk_size = hyscan_db_file_channel_set_chunk_size;
   iface->channel_set_save_time = hyscan_db_file_channel_set_save_time;
   iface->channel_set_save_size = hyscan_db_file_channel_set_save_size;
+  iface->channel_set_durability = hyscan_db_file_channel_set_durability;
+  iface->channel_set_compression = hyscan_db_file_channel_set_compression;
+  iface->channel_set_record_size = hyscan_db_file_channel_set_record_size;
 
   iface->channel_get_data_range = hyscan_db_file_channel_get_data_range;
   iface->channel_add_data = hyscan_db_file_channel_add_data;
   iface->channel_get_data = hyscan_db_file_channel_get_data;
+  iface->channel_add_data_batch = hyscan_db_file_channel_add_data_batch;
+  iface->channel_get_data_batch = hyscan_db_file_channel_get_data_batch;
+  iface->channel_map_data = hyscan_db_file_channel_map_data;
   iface->channel_get_data_size = hyscan_db_file_channel_get_data_size;
   iface->channel_get_data_time = hyscan_db_file_channel_get_data_time;
   iface->channel_find_data = hyscan_db_file_channel_find_data;
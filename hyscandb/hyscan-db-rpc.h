@@ -37,11 +37,12 @@
 
 #include <urpc-types.h>
 
-#define HYSCAN_DB_RPC_VERSION          20170200
+#define HYSCAN_DB_RPC_VERSION          20170700
 #define HYSCAN_DB_RPC_STATUS_OK        1
 #define HYSCAN_DB_RPC_STATUS_FAIL      0
 
 #define HYSCAN_DB_RPC_MAX_PARAMS       1024
+#define HYSCAN_DB_RPC_MAX_BATCH        256
 
 #define HYSCAN_DB_RPC_TYPE_NULL        1
 #define HYSCAN_DB_RPC_TYPE_BOOLEAN     2
@@ -92,7 +93,13 @@ enum
   HYSCAN_DB_RPC_PROC_PARAM_OBJECT_GET_SCHEMA,
   HYSCAN_DB_RPC_PROC_PARAM_SET,
   HYSCAN_DB_RPC_PROC_PARAM_GET,
-  HYSCAN_DB_RPC_PROC_CLOSE
+  HYSCAN_DB_RPC_PROC_CLOSE,
+
+  HYSCAN_DB_RPC_PROC_CHANNEL_SET_DURABILITY,
+  HYSCAN_DB_RPC_PROC_CHANNEL_SET_COMPRESSION,
+  HYSCAN_DB_RPC_PROC_CHANNEL_SET_RECORD_SIZE,
+  HYSCAN_DB_RPC_PROC_CHANNEL_ADD_DATA_BATCH,
+  HYSCAN_DB_RPC_PROC_CHANNEL_GET_DATA_BATCH
 };
 
 enum
@@ -147,7 +154,15 @@ enum
   HYSCAN_DB_RPC_PARAM_PARAM_TYPE0,
   HYSCAN_DB_RPC_PARAM_PARAM_TYPE1 = HYSCAN_DB_RPC_PARAM_PARAM_TYPE0 + HYSCAN_DB_RPC_MAX_PARAMS,
   HYSCAN_DB_RPC_PARAM_PARAM_VALUE0,
-  HYSCAN_DB_RPC_PARAM_PARAM_VALUE1 = HYSCAN_DB_RPC_PARAM_PARAM_VALUE0 + HYSCAN_DB_RPC_MAX_PARAMS
+  HYSCAN_DB_RPC_PARAM_PARAM_VALUE1 = HYSCAN_DB_RPC_PARAM_PARAM_VALUE0 + HYSCAN_DB_RPC_MAX_PARAMS,
+
+  HYSCAN_DB_RPC_PARAM_DURABILITY,
+  HYSCAN_DB_RPC_PARAM_COMPRESSION,
+  HYSCAN_DB_RPC_PARAM_RECORD_SIZE,
+
+  HYSCAN_DB_RPC_PARAM_DATA_COUNT,
+  HYSCAN_DB_RPC_PARAM_DATA_SIZES,
+  HYSCAN_DB_RPC_PARAM_DATA_TIMES
 };
 
 #endif /* __HYSCAN_DB_RPC_H__ */
@@ -52,6 +52,7 @@
 #include "hyscan-db-rpc.h"
 
 #include <urpc-server.h>
+#include <string.h>
 
 #define hyscan_db_server_get_error(p)      do { \
                                              g_warning ("HyScanDBServer: %s: can't get '%s' value", __FUNCTION__, p); \
@@ -1012,6 +1013,84 @@ exit:
   return 0;
 }
 
+static gint
+hyscan_db_server_rpc_proc_channel_set_durability (uRpcData *urpc_data,
+                                                  void     *thread_data,
+                                                  void     *session_data,
+                                                  void     *proc_data)
+{
+  HyScanDBServerPrivate *priv = proc_data;
+  guint32 rpc_status = HYSCAN_DB_RPC_STATUS_FAIL;
+
+  gint32 channel_id;
+  guint32 durability;
+
+  if (urpc_data_get_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, &channel_id) != 0)
+    hyscan_db_server_get_error ("channel_id");
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DURABILITY, &durability) != 0)
+    hyscan_db_server_get_error ("durability");
+
+  if (hyscan_db_channel_set_durability (priv->db, channel_id, durability))
+    rpc_status = HYSCAN_DB_RPC_STATUS_OK;
+
+exit:
+  urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, rpc_status);
+  return 0;
+}
+
+static gint
+hyscan_db_server_rpc_proc_channel_set_compression (uRpcData *urpc_data,
+                                                   void     *thread_data,
+                                                   void     *session_data,
+                                                   void     *proc_data)
+{
+  HyScanDBServerPrivate *priv = proc_data;
+  guint32 rpc_status = HYSCAN_DB_RPC_STATUS_FAIL;
+
+  gint32 channel_id;
+  guint32 compression;
+
+  if (urpc_data_get_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, &channel_id) != 0)
+    hyscan_db_server_get_error ("channel_id");
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_COMPRESSION, &compression) != 0)
+    hyscan_db_server_get_error ("compression");
+
+  if (hyscan_db_channel_set_compression (priv->db, channel_id, compression))
+    rpc_status = HYSCAN_DB_RPC_STATUS_OK;
+
+exit:
+  urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, rpc_status);
+  return 0;
+}
+
+static gint
+hyscan_db_server_rpc_proc_channel_set_record_size (uRpcData *urpc_data,
+                                                   void     *thread_data,
+                                                   void     *session_data,
+                                                   void     *proc_data)
+{
+  HyScanDBServerPrivate *priv = proc_data;
+  guint32 rpc_status = HYSCAN_DB_RPC_STATUS_FAIL;
+
+  gint32 channel_id;
+  guint32 record_size;
+
+  if (urpc_data_get_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, &channel_id) != 0)
+    hyscan_db_server_get_error ("channel_id");
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_RECORD_SIZE, &record_size) != 0)
+    hyscan_db_server_get_error ("record_size");
+
+  if (hyscan_db_channel_set_record_size (priv->db, channel_id, record_size))
+    rpc_status = HYSCAN_DB_RPC_STATUS_OK;
+
+exit:
+  urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, rpc_status);
+  return 0;
+}
+
 static gint
 hyscan_db_server_rpc_proc_channel_get_data_range (uRpcData *urpc_data,
                                                   void     *thread_data,
@@ -1087,6 +1166,73 @@ exit:
   return 0;
 }
 
+static gint
+hyscan_db_server_rpc_proc_channel_add_data_batch (uRpcData *urpc_data,
+                                                  void     *thread_data,
+                                                  void     *session_data,
+                                                  void     *proc_data)
+{
+  HyScanDBServerPrivate *priv = proc_data;
+  guint32 rpc_status = HYSCAN_DB_RPC_STATUS_FAIL;
+
+  HyScanBuffer *buffer;
+  gpointer data;
+  guint32 size;
+
+  guint8 *rec_sizes;
+  guint8 *rec_times;
+  guint32 sizes[HYSCAN_DB_RPC_MAX_BATCH];
+  gint64 times[HYSCAN_DB_RPC_MAX_BATCH];
+
+  gint32 channel_id;
+  guint32 n_records;
+  guint32 index;
+  guint32 i;
+
+  if (urpc_data_get_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, &channel_id) != 0)
+    hyscan_db_server_get_error ("channel_id");
+
+  if ((urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_COUNT, &n_records) != 0) ||
+      (n_records == 0) || (n_records > HYSCAN_DB_RPC_MAX_BATCH))
+    hyscan_db_server_get_error ("count");
+
+  rec_sizes = urpc_data_get (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_SIZES, &size);
+  if ((rec_sizes == NULL) || (size != n_records * sizeof (guint32)))
+    hyscan_db_server_get_error ("sizes");
+
+  rec_times = urpc_data_get (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_TIMES, &size);
+  if ((rec_times == NULL) || (size != n_records * sizeof (gint64)))
+    hyscan_db_server_get_error ("times");
+
+  data = urpc_data_get (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_DATA, &size);
+  if (data == NULL)
+    hyscan_db_server_get_error ("data");
+
+  /* Массивы в буфере RPC могут быть не выровнены. */
+  for (i = 0; i < n_records; i++)
+    {
+      memcpy (&sizes[i], rec_sizes + i * sizeof (guint32), sizeof (guint32));
+      memcpy (&times[i], rec_times + i * sizeof (gint64), sizeof (gint64));
+      sizes[i] = GUINT32_FROM_LE (sizes[i]);
+      times[i] = GINT64_FROM_LE (times[i]);
+    }
+
+  buffer = ((HyScanDBServerThreadPrivate *)thread_data)->buffer;
+  hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, size);
+
+  if (hyscan_db_channel_add_data_batch (priv->db, channel_id, n_records, buffer, sizes, times, &index))
+    {
+      if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_INDEX, index) != 0)
+        hyscan_db_server_set_error ("index");
+
+      rpc_status = HYSCAN_DB_RPC_STATUS_OK;
+    }
+
+exit:
+  urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, rpc_status);
+  return 0;
+}
+
 static gint
 hyscan_db_server_rpc_proc_channel_get_data (uRpcData *urpc_data,
                                             void     *thread_data,
@@ -1135,6 +1281,93 @@ exit:
   return 0;
 }
 
+static gint
+hyscan_db_server_rpc_proc_channel_get_data_batch (uRpcData *urpc_data,
+                                                  void     *thread_data,
+                                                  void     *session_data,
+                                                  void     *proc_data)
+{
+  HyScanDBServerPrivate *priv = proc_data;
+  guint32 rpc_status = HYSCAN_DB_RPC_STATUS_FAIL;
+
+  HyScanBuffer *buffer;
+  gpointer data;
+  guint32 size;
+  guint32 data_size;
+
+  guint32 sizes[HYSCAN_DB_RPC_MAX_BATCH];
+  gint64 times[HYSCAN_DB_RPC_MAX_BATCH];
+
+  gint32 channel_id;
+  guint32 first_index;
+  guint32 n_records;
+  guint32 i;
+
+  if (urpc_data_get_int32 (urpc_data, HYSCAN_DB_RPC_PARAM_CHANNEL_ID, &channel_id) != 0)
+    hyscan_db_server_get_error ("channel_id");
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_INDEX, &first_index) != 0)
+    hyscan_db_server_get_error ("index");
+
+  if (urpc_data_get_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_COUNT, &n_records) != 0)
+    hyscan_db_server_get_error ("count");
+
+  /* Место для размеров и меток времени записей. */
+  size = URPC_MAX_DATA_SIZE - 1024;
+  size -= HYSCAN_DB_RPC_MAX_BATCH * (sizeof (guint32) + sizeof (gint64));
+
+  /* Выбираем число записей, данные которых помещаются в ответ. */
+  n_records = MIN (n_records, HYSCAN_DB_RPC_MAX_BATCH);
+  for (i = 0, data_size = 0; i < n_records; i++)
+    {
+      guint32 record_size = hyscan_db_channel_get_data_size (priv->db, channel_id, first_index + i);
+
+      if (record_size > size - data_size)
+        break;
+
+      data_size += record_size;
+    }
+
+  n_records = i;
+  if (n_records == 0)
+    goto exit;
+
+  data = urpc_data_set (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_DATA, NULL, size);
+  if (data == NULL)
+    hyscan_db_server_set_error ("data");
+
+  buffer = ((HyScanDBServerThreadPrivate *)thread_data)->buffer;
+  hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, size);
+
+  if (hyscan_db_channel_get_data_batch (priv->db, channel_id, first_index, &n_records, buffer, sizes, times))
+    {
+      if (hyscan_buffer_get (buffer, NULL, &size) != NULL)
+        if (urpc_data_set (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_DATA, NULL, size) == NULL )
+          hyscan_db_server_set_error ("data-size");
+
+      for (i = 0; i < n_records; i++)
+        {
+          sizes[i] = GUINT32_TO_LE (sizes[i]);
+          times[i] = GINT64_TO_LE (times[i]);
+        }
+
+      if (urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_COUNT, n_records) != 0)
+        hyscan_db_server_set_error ("count");
+
+      if (urpc_data_set (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_SIZES, sizes, n_records * sizeof (guint32)) == NULL)
+        hyscan_db_server_set_error ("sizes");
+
+      if (urpc_data_set (urpc_data, HYSCAN_DB_RPC_PARAM_DATA_TIMES, times, n_records * sizeof (gint64)) == NULL)
+        hyscan_db_server_set_error ("times");
+
+      rpc_status = HYSCAN_DB_RPC_STATUS_OK;
+    }
+
+exit:
+  urpc_data_set_uint32 (urpc_data, HYSCAN_DB_RPC_PARAM_STATUS, rpc_status);
+  return 0;
+}
+
 static gint
 hyscan_db_server_rpc_proc_channel_get_data_size (uRpcData *urpc_data,
                                                  void     *thread_data,
@@ -1908,6 +2141,21 @@ hyscan_db_server_start (HyScanDBServer *server)
   if (status != 0)
     goto fail;
 
+  status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_SET_DURABILITY,
+                                     hyscan_db_server_rpc_proc_channel_set_durability, priv);
+  if (status != 0)
+    goto fail;
+
+  status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_SET_COMPRESSION,
+                                     hyscan_db_server_rpc_proc_channel_set_compression, priv);
+  if (status != 0)
+    goto fail;
+
+  status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_SET_RECORD_SIZE,
+                                     hyscan_db_server_rpc_proc_channel_set_record_size, priv);
+  if (status != 0)
+    goto fail;
+
   status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_GET_DATA_RANGE,
                                      hyscan_db_server_rpc_proc_channel_get_data_range, priv);
   if (status != 0)
@@ -1918,11 +2166,21 @@ hyscan_db_server_start (HyScanDBServer *server)
   if (status != 0)
     goto fail;
 
+  status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_ADD_DATA_BATCH,
+                                     hyscan_db_server_rpc_proc_channel_add_data_batch, priv);
+  if (status != 0)
+    goto fail;
+
   status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_GET_DATA,
                                      hyscan_db_server_rpc_proc_channel_get_data, priv);
   if (status != 0)
     goto fail;
 
+  status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_GET_DATA_BATCH,
+                                     hyscan_db_server_rpc_proc_channel_get_data_batch, priv);
+  if (status != 0)
+    goto fail;
+
   status = urpc_server_add_callback (priv->rpc, HYSCAN_DB_RPC_PROC_CHANNEL_GET_DATA_SIZE,
                                      hyscan_db_server_rpc_proc_channel_get_data_size, priv);
   if (status != 0)
@@ -0,0 +1,379 @@
+/* hyscan-db-uring.c
+ *
+ * Copyright 2015-2020 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanDB.
+ *
+ * HyScanDB is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanDB is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanDB имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanDB на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* HyScanDBUring - очередь асинхронных операций ввода/вывода io_uring.
+ *
+ * Объект используется классом HyScanDBChannelFile для одновременной передачи
+ * ядру нескольких операций чтения или записи по заданным смещениям в файлах.
+ * Операции помещаются в очередь функциями hyscan_db_uring_read и
+ * hyscan_db_uring_write и выполняются функцией hyscan_db_uring_submit, которая
+ * передаёт их ядру одним системным вызовом и ожидает завершения всех операций.
+ * Если очередь заполнена, накопленные операции выполняются при помещении в
+ * очередь следующей. Результат всех операций возвращает функция
+ * hyscan_db_uring_submit.
+ *
+ * Частично выполненные и прерванные операции завершаются функциями pread и
+ * pwrite. Если при ожидании завершения операций возникла ошибка кольца, все
+ * переданные ядру операции отменяются и функция hyscan_db_uring_submit
+ * возвращает управление только после их завершения, поэтому после её вызова
+ * буферы операций можно освобождать. После ошибки кольца объект непригоден для
+ * дальнейшего использования. Объект не обеспечивает синхронизацию доступа,
+ * одновременно его может использовать только один поток.
+ *
+ * Поддержка io_uring включается при сборке определением HYSCAN_DB_WITH_IO_URING.
+ * Без неё, а также если ядро не поддерживает io_uring, функция
+ * hyscan_db_uring_new возвращает %NULL и вызывающий код должен использовать
+ * обычные функции ввода/вывода.
+ */
+
+#include "hyscan-db-uring.h"
+
+#ifdef HYSCAN_DB_WITH_IO_URING
+
+#include <liburing.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define MAX_IO_SIZE            (1024*1024*1024)        /* Максимальный размер одной операции. */
+
+/* Операция ввода/вывода. */
+typedef struct
+{
+  gint                         fd;                     /* Дескриптор файла. */
+  guint8                      *data;                   /* Буфер данных. */
+  gsize                        size;                   /* Размер данных. */
+  guint64                      offset;                 /* Смещение в файле. */
+  gboolean                     write;                  /* Признак операции записи. */
+} HyScanDBUringOp;
+
+struct _HyScanDBUring
+{
+  struct io_uring              ring;                   /* Кольцо io_uring. */
+  HyScanDBUringOp             *ops;                    /* Операции в очереди. */
+  guint                        depth;                  /* Размер очереди. */
+  guint                        n_ops;                  /* Число операций в очереди. */
+  gboolean                     status;                 /* Результат выполнения операций. */
+  gboolean                     fail;                   /* Признак ошибки кольца. */
+};
+
+/* Функция выполняет оставшуюся часть операции функциями pread или pwrite. */
+static gboolean
+hyscan_db_uring_complete (HyScanDBUringOp *op,
+                          gsize            done)
+{
+  guint8 *data = op->data + done;
+  gsize size = op->size - done;
+  guint64 offset = op->offset + done;
+
+  while (size > 0)
+    {
+      gssize iosize;
+
+      if (op->write)
+        iosize = pwrite (op->fd, data, size, offset);
+      else
+        iosize = pread (op->fd, data, size, offset);
+
+      if ((iosize < 0) && (errno == EINTR))
+        continue;
+      if (iosize <= 0)
+        return FALSE;
+
+      data += iosize;
+      size -= iosize;
+      offset += iosize;
+    }
+
+  return TRUE;
+}
+
+/* Функция отменяет операции очереди. Элементы отмены не связаны с
+   операциями очереди. Функция возвращает TRUE, если ядру переданы все
+   подготовленные элементы, включая операции, не переданные ранее. */
+static gboolean
+hyscan_db_uring_cancel (HyScanDBUring *uring)
+{
+  guint i;
+
+  for (i = 0; i < uring->n_ops; i++)
+    {
+      struct io_uring_sqe *sqe = io_uring_get_sqe (&uring->ring);
+
+      if ((sqe == NULL) && (io_uring_submit (&uring->ring) >= 0))
+        sqe = io_uring_get_sqe (&uring->ring);
+      if (sqe == NULL)
+        return FALSE;
+
+      io_uring_prep_cancel (sqe, &uring->ops[i], 0);
+      io_uring_sqe_set_data (sqe, NULL);
+    }
+
+  return (io_uring_submit (&uring->ring) >= 0);
+}
+
+/* Функция помещает операцию в очередь. */
+static void
+hyscan_db_uring_queue (HyScanDBUring *uring,
+                       gint           fd,
+                       guint8        *data,
+                       gsize          size,
+                       guint64        offset,
+                       gboolean       write)
+{
+  while (size > 0)
+    {
+      HyScanDBUringOp *op;
+      gsize iosize = MIN (size, MAX_IO_SIZE);
+
+      /* Очередь заполнена, выполняем накопленные операции. */
+      if ((uring->n_ops == uring->depth) && !hyscan_db_uring_submit (uring))
+        uring->status = FALSE;
+
+      op = &uring->ops[uring->n_ops++];
+      op->fd = fd;
+      op->data = data;
+      op->size = iosize;
+      op->offset = offset;
+      op->write = write;
+
+      data += iosize;
+      size -= iosize;
+      offset += iosize;
+    }
+}
+
+/* Функция создаёт очередь операций заданного размера. */
+HyScanDBUring *
+hyscan_db_uring_new (guint depth)
+{
+  HyScanDBUring *uring;
+
+  g_return_val_if_fail (depth > 0, NULL);
+
+  uring = g_new0 (HyScanDBUring, 1);
+  if (io_uring_queue_init (depth, &uring->ring, 0) < 0)
+    {
+      g_free (uring);
+      return NULL;
+    }
+
+  uring->ops = g_new (HyScanDBUringOp, depth);
+  uring->depth = depth;
+  uring->status = TRUE;
+
+  return uring;
+}
+
+/* Функция освобождает очередь операций. */
+void
+hyscan_db_uring_free (HyScanDBUring *uring)
+{
+  if (uring == NULL)
+    return;
+
+  io_uring_queue_exit (&uring->ring);
+  g_free (uring->ops);
+  g_free (uring);
+}
+
+/* Функция помещает в очередь операцию чтения. */
+void
+hyscan_db_uring_read (HyScanDBUring *uring,
+                      gint           fd,
+                      gpointer       buffer,
+                      gsize          size,
+                      guint64        offset)
+{
+  hyscan_db_uring_queue (uring, fd, buffer, size, offset, FALSE);
+}
+
+/* Функция помещает в очередь операцию записи. */
+void
+hyscan_db_uring_write (HyScanDBUring *uring,
+                       gint           fd,
+                       gconstpointer  buffer,
+                       gsize          size,
+                       guint64        offset)
+{
+  hyscan_db_uring_queue (uring, fd, (guint8 *) buffer, size, offset, TRUE);
+}
+
+/* Функция выполняет операции из очереди и ожидает их завершения. Функция
+   возвращает результат всех операций, помещённых в очередь после предыдущего
+   вызова. */
+gboolean
+hyscan_db_uring_submit (HyScanDBUring *uring)
+{
+  gboolean cancelled = FALSE;
+  gboolean status;
+  guint n_submitted = 0;
+  guint n_completed = 0;
+  guint i;
+
+  /* После ошибки кольца в нём могут остаться невыполненные операции. */
+  if (uring->fail)
+    {
+      uring->n_ops = 0;
+      return FALSE;
+    }
+
+  /* Подготавливаем операции. Очередь не превышает размера кольца, поэтому
+     свободные элементы в нём есть всегда. */
+  for (i = 0; i < uring->n_ops; i++)
+    {
+      HyScanDBUringOp *op = &uring->ops[i];
+      struct io_uring_sqe *sqe = io_uring_get_sqe (&uring->ring);
+
+      if (op->write)
+        io_uring_prep_write (sqe, op->fd, op->data, op->size, op->offset);
+      else
+        io_uring_prep_read (sqe, op->fd, op->data, op->size, op->offset);
+
+      io_uring_sqe_set_data (sqe, op);
+    }
+
+  /* Передаём операции ядру. */
+  while (n_submitted < uring->n_ops)
+    {
+      gint ret = io_uring_submit (&uring->ring);
+
+      if ((ret == -EINTR) || (ret == -EAGAIN) || (ret == -EBUSY))
+        continue;
+
+      if (ret < 0)
+        {
+          uring->fail = TRUE;
+          break;
+        }
+
+      n_submitted += ret;
+    }
+
+  /* Ожидаем завершения переданных операций. Ядро может обращаться к буферам
+     операций до их завершения, поэтому при ошибке кольца операции отменяются
+     и ожидание продолжается. */
+  while (n_completed < n_submitted)
+    {
+      struct io_uring_cqe *cqe;
+      HyScanDBUringOp *op;
+      gint ret;
+
+      ret = io_uring_wait_cqe (&uring->ring, &cqe);
+      if ((ret == -EINTR) || (ret == -EAGAIN))
+        continue;
+
+      /* Отменяем операции и ожидаем их завершения. Операции, не переданные
+         ядру ранее, передаются вместе с элементами отмены. Повторная ошибка
+         означает, что кольцо неработоспособно и ожидать завершения нечего. */
+      if (ret < 0)
+        {
+          if (cancelled)
+            break;
+
+          if (hyscan_db_uring_cancel (uring))
+            n_submitted = uring->n_ops;
+
+          uring->fail = TRUE;
+          cancelled = TRUE;
+          continue;
+        }
+
+      op = io_uring_cqe_get_data (cqe);
+      ret = cqe->res;
+      io_uring_cqe_seen (&uring->ring, cqe);
+
+      /* Завершение операции отмены. */
+      if (op == NULL)
+        continue;
+
+      n_completed += 1;
+
+      /* Прерванная операция выполняется повторно. */
+      if ((ret == -EINTR) || (ret == -EAGAIN))
+        ret = 0;
+
+      if (ret < 0)
+        uring->status = FALSE;
+      else if (((gsize) ret < op->size) && !hyscan_db_uring_complete (op, ret))
+        uring->status = FALSE;
+    }
+
+  status = uring->status && !uring->fail;
+
+  uring->n_ops = 0;
+  uring->status = TRUE;
+
+  return status;
+}
+
+#else /* HYSCAN_DB_WITH_IO_URING */
+
+HyScanDBUring *
+hyscan_db_uring_new (guint depth)
+{
+  return NULL;
+}
+
+void
+hyscan_db_uring_free (HyScanDBUring *uring)
+{
+}
+
+void
+hyscan_db_uring_read (HyScanDBUring *uring,
+                      gint           fd,
+                      gpointer       buffer,
+                      gsize          size,
+                      guint64        offset)
+{
+  g_return_if_reached ();
+}
+
+void
+hyscan_db_uring_write (HyScanDBUring *uring,
+                       gint           fd,
+                       gconstpointer  buffer,
+                       gsize          size,
+                       guint64        offset)
+{
+  g_return_if_reached ();
+}
+
+gboolean
+hyscan_db_uring_submit (HyScanDBUring *uring)
+{
+  g_return_val_if_reached (FALSE);
+}
+
+#endif /* HYSCAN_DB_WITH_IO_URING */
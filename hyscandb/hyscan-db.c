@@ -78,10 +78,15 @@
  *   -# открытие группы параметров - #hyscan_db_channel_param_open
  * - работа с данными
  *   -# запись данных - #hyscan_db_channel_add_data
+ *   -# запись нескольких записей - #hyscan_db_channel_add_data_batch
  *   -# чтение данных - #hyscan_db_channel_get_data
+ *   -# чтение нескольких последовательных записей - #hyscan_db_channel_get_data_batch
+ *   -# чтение данных без копирования - #hyscan_db_channel_map_data
  *   -# чтение размера данных - #hyscan_db_channel_get_data_size
  *   -# чтение метки времени данных - #hyscan_db_channel_get_data_time
  *   -# поиск данных по времени - #hyscan_db_channel_find_data
+ *   -# асинхронное чтение данных - #hyscan_db_channel_get_data_async
+ *   -# асинхронный поиск данных по времени - #hyscan_db_channel_find_data_async
  *   -# получение диапазона доступных данных - #hyscan_db_channel_get_data_range
  * - работа с параметрами
  *   -# получение списка объектов в группе параметров - #hyscan_db_param_object_list
@@ -164,6 +169,39 @@
  * превышения лимитов хранения (данные хранятся дольше или данных записано
  * больше), но не наоборот.
  *
+ * Гарантии сохранности записанных данных при сбое питания или аварийном
+ * завершении программы задаются функцией #hyscan_db_channel_set_durability.
+ * По умолчанию используется режим %HYSCAN_DB_DURABILITY_NONE, при котором
+ * система хранения может накапливать данные в памяти и не синхронизирует
+ * файлы с диском. В режиме %HYSCAN_DB_DURABILITY_FLUSH каждая запись
+ * передаётся операционной системе. В режиме %HYSCAN_DB_DURABILITY_SYNC файлы
+ * дополнительно периодически синхронизируются с диском, а в режиме
+ * %HYSCAN_DB_DURABILITY_GROUP_COMMIT функция записи завершается только после
+ * синхронизации, которая выполняется сразу для группы записей.
+ *
+ * Для уменьшения объёма хранимых данных можно включить сжатие записей функцией
+ * #hyscan_db_channel_set_compression. Каждая запись сжимается независимо от
+ * других, что сохраняет возможность произвольного доступа к данным по индексу.
+ * Записи, которые не удалось сжать, хранятся без изменений. Сжатие прозрачно
+ * для клиента - функции чтения всегда возвращают исходные данные.
+ *
+ * Функции #hyscan_db_channel_get_data_async и #hyscan_db_channel_find_data_async
+ * реализованы на уровне интерфейса: они вызывают синхронные функции чтения и
+ * поиска в отдельном пуле из HYSCAN_DB_ASYNC_THREADS рабочих потоков
+ * библиотеки, не занимая общий пул потоков GIO. Собственной асинхронной
+ * реализации у систем хранения нет: HyScanDBFile не использует отдельный пул
+ * ввода-вывода, а HyScanDBClient не передаёт запросы серверу конвейером -
+ * асинхронные запросы клиента выполняются через одно соединение по очереди.
+ *
+ * Для каналов с записями одинакового небольшого размера, например навигационных
+ * данных, функцией #hyscan_db_channel_set_record_size можно задать фиксированный
+ * размер записей. В этом режиме для каждой записи хранится только метка
+ * времени в компактном виде, а положение данных вычисляется по индексу, что
+ * значительно уменьшает объём служебной информации. Записи фиксированного
+ * размера не сжимаются, поэтому этот режим нельзя включить для канала с
+ * заданным функцией #hyscan_db_channel_set_compression алгоритмом сжатия, и
+ * наоборот.
+ *
  * Основной объём информации записывается в каналы данных. Каналы данных
  * спроектированы таким образом, чтобы одновременно с хранением информации
  * хранить метку времени. Не допускается запись данных с меткой времени
@@ -194,6 +232,34 @@
 #include "hyscan-db.h"
 #include <string.h>
 
+#define HYSCAN_DB_ASYNC_THREADS 4              /* Число рабочих потоков асинхронных операций. */
+
+/* Параметры и результат асинхронного чтения данных. */
+typedef struct
+{
+  gint32               channel_id;             /* Идентификатор канала данных. */
+  guint32              index;                  /* Индекс считываемых данных. */
+  gint64               time;                   /* Метка времени считанных данных. */
+} HyScanDBGetDataTask;
+
+/* Параметры и результат асинхронного поиска данных. */
+typedef struct
+{
+  gint32               channel_id;             /* Идентификатор канала данных. */
+  gint64               time;                   /* Искомый момент времени. */
+  guint32              lindex;                 /* "Левый" индекс данных. */
+  guint32              rindex;                 /* "Правый" индекс данных. */
+  gint64               ltime;                  /* "Левая" метка времени данных. */
+  gint64               rtime;                  /* "Правая" метка времени данных. */
+} HyScanDBFindDataTask;
+
+/* Асинхронная операция в пуле рабочих потоков. */
+typedef struct
+{
+  GTask               *task;                   /* Задача. */
+  GTaskThreadFunc      func;                   /* Функция выполнения задачи. */
+} HyScanDBAsyncJob;
+
 G_DEFINE_INTERFACE (HyScanDB, hyscan_db, G_TYPE_OBJECT);
 
 static void
@@ -1010,6 +1076,92 @@ hyscan_db_channel_set_save_size (HyScanDB *db,
   return FALSE;
 }
 
+/**
+ * hyscan_db_channel_set_durability:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @durability: режим сохранности данных #HyScanDBDurability
+ *
+ * Функция задаёт режим сохранности записываемых в канал данных. Подробнее
+ * об этом можно прочитать в описании интерфейса #HyScanDB.
+ *
+ * Returns: %TRUE - если режим сохранности данных изменён, иначе %FALSE.
+ */
+gboolean
+hyscan_db_channel_set_durability (HyScanDB           *db,
+                                  gint32              channel_id,
+                                  HyScanDBDurability  durability)
+{
+  HyScanDBInterface *iface;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), FALSE);
+
+  iface = HYSCAN_DB_GET_IFACE (db);
+  if (iface->channel_set_durability != NULL)
+    return iface->channel_set_durability (db, channel_id, durability);
+
+  return FALSE;
+}
+
+/**
+ * hyscan_db_channel_set_compression:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @compression: алгоритм сжатия данных #HyScanDBCompression
+ *
+ * Функция задаёт алгоритм сжатия записываемых в канал данных. Алгоритм
+ * применяется к записям, добавленным после вызова функции. Сжатие нельзя
+ * включить для канала с фиксированным размером записей. Подробнее об
+ * этом можно прочитать в описании интерфейса #HyScanDB.
+ *
+ * Returns: %TRUE - если алгоритм сжатия данных изменён, иначе %FALSE.
+ */
+gboolean
+hyscan_db_channel_set_compression (HyScanDB            *db,
+                                   gint32               channel_id,
+                                   HyScanDBCompression  compression)
+{
+  HyScanDBInterface *iface;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), FALSE);
+
+  iface = HYSCAN_DB_GET_IFACE (db);
+  if (iface->channel_set_compression != NULL)
+    return iface->channel_set_compression (db, channel_id, compression);
+
+  return FALSE;
+}
+
+/**
+ * hyscan_db_channel_set_record_size:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @record_size: фиксированный размер записей или 0
+ *
+ * Функция задаёт фиксированный размер записываемых в канал записей. После
+ * вызова функции в канал можно записывать только данные указанного размера.
+ * Значение 0 отключает режим фиксированного размера записей. Фиксированный
+ * размер нельзя задать для канала со сжатием записей. Подробнее об
+ * этом можно прочитать в описании интерфейса #HyScanDB.
+ *
+ * Returns: %TRUE - если размер записей изменён, иначе %FALSE.
+ */
+gboolean
+hyscan_db_channel_set_record_size (HyScanDB *db,
+                                   gint32    channel_id,
+                                   guint32   record_size)
+{
+  HyScanDBInterface *iface;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), FALSE);
+
+  iface = HYSCAN_DB_GET_IFACE (db);
+  if (iface->channel_set_record_size != NULL)
+    return iface->channel_set_record_size (db, channel_id, record_size);
+
+  return FALSE;
+}
+
 /**
  * hyscan_db_channel_get_data_range:
  * @db: указатель на #HyScanDB
@@ -1070,6 +1222,93 @@ hyscan_db_channel_add_data (HyScanDB     *db,
   return FALSE;
 }
 
+/**
+ * hyscan_db_channel_add_data_batch:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @n_records: число записей
+ * @buffer: буфер с данными записей
+ * @sizes: (array length=n_records): размеры записей
+ * @times: (array length=n_records): метки времени записей в микросекундах
+ * @first_index: (out) (nullable): индекс первой записи
+ *
+ * Функция записывает в канал несколько новых записей. Данные записей
+ * располагаются в буфере друг за другом, их размеры задаются в массиве
+ * sizes. Сумма размеров записей должна быть равна размеру данных в буфере.
+ * Метки времени записей должны возрастать.
+ *
+ * Записи получают последовательные индексы, начиная с first_index.
+ *
+ * Запись группы не является атомарной. Если реализация не поддерживает
+ * пакетную запись, записи передаются по одной, а при работе через сервер
+ * группа передаётся несколькими запросами. Поэтому при ошибке часть записей
+ * из начала группы может оказаться уже записанной. Такие записи имеют
+ * последовательные индексы, начиная с first_index, который устанавливается,
+ * если была записана хотя бы одна запись. Число записанных записей можно
+ * определить по индексу последней записи канала, см.
+ * #hyscan_db_channel_get_data_range. Если не было записано ни одной записи,
+ * first_index не изменяется.
+ *
+ * Returns: %TRUE - если все записи успешно записаны, иначе %FALSE.
+ */
+gboolean
+hyscan_db_channel_add_data_batch (HyScanDB      *db,
+                                  gint32         channel_id,
+                                  guint32        n_records,
+                                  HyScanBuffer  *buffer,
+                                  const guint32 *sizes,
+                                  const gint64  *times,
+                                  guint32       *first_index)
+{
+  HyScanDBInterface *iface;
+  HyScanBuffer *record;
+  guint8 *data;
+  guint32 size;
+  guint64 total_size = 0;
+  gboolean status = TRUE;
+  guint32 i;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), FALSE);
+
+  if (n_records == 0)
+    return FALSE;
+
+  iface = HYSCAN_DB_GET_IFACE (db);
+  if (iface->channel_add_data_batch != NULL)
+    return iface->channel_add_data_batch (db, channel_id, n_records, buffer, sizes, times, first_index);
+
+  /* Пакетная запись не поддерживается, записываем записи по одной. */
+  if (iface->channel_add_data == NULL)
+    return FALSE;
+
+  data = hyscan_buffer_get (buffer, NULL, &size);
+
+  for (i = 0; i < n_records; i++)
+    total_size += sizes[i];
+
+  if (total_size != size)
+    return FALSE;
+
+  record = hyscan_buffer_new ();
+
+  for (i = 0; (i < n_records) && status; i++)
+    {
+      guint32 index;
+
+      hyscan_buffer_wrap (record, HYSCAN_DATA_BLOB, data, sizes[i]);
+      status = iface->channel_add_data (db, channel_id, times[i], record, &index);
+
+      if (status && (i == 0) && (first_index != NULL))
+        *first_index = index;
+
+      data += sizes[i];
+    }
+
+  g_object_unref (record);
+
+  return status;
+}
+
 /**
  * hyscan_db_channel_get_data:
  * @db: указатель на #HyScanDB
@@ -1100,6 +1339,165 @@ hyscan_db_channel_get_data (HyScanDB     *db,
   return FALSE;
 }
 
+/**
+ * hyscan_db_channel_get_data_batch:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @first_index: индекс первой считываемой записи
+ * @n_records: (inout): число запрашиваемых записей / число считанных записей
+ * @buffer: буфер данных
+ * @sizes: (out) (array length=n_records) (nullable): размеры считанных записей
+ * @times: (out) (array length=n_records) (nullable): метки времени считанных записей
+ *
+ * Функция считывает данные нескольких последовательных записей, начиная с
+ * индекса first_index. Данные записей помещаются в буфер друг за другом,
+ * размеры и метки времени записей - в массивы sizes и times, которые
+ * должны содержать не менее n_records элементов.
+ *
+ * Функция может считать меньше записей, чем запрошено, например при
+ * достижении конца данных или при ограничении объёма передаваемых
+ * данных. Число считанных записей возвращается в n_records.
+ *
+ * Returns: %TRUE - если считана хотя бы одна запись, иначе %FALSE.
+ */
+gboolean
+hyscan_db_channel_get_data_batch (HyScanDB     *db,
+                                  gint32        channel_id,
+                                  guint32       first_index,
+                                  guint32      *n_records,
+                                  HyScanBuffer *buffer,
+                                  guint32      *sizes,
+                                  gint64       *times)
+{
+  HyScanDBInterface *iface;
+  HyScanBuffer *record;
+  guint32 *record_sizes;
+  guint64 total_size;
+  guint32 n_read;
+  guint8 *dest;
+  guint8 *data;
+  guint32 size;
+  guint32 i;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), FALSE);
+  g_return_val_if_fail (n_records != NULL, FALSE);
+
+  iface = HYSCAN_DB_GET_IFACE (db);
+  if (iface->channel_get_data_batch != NULL)
+    return iface->channel_get_data_batch (db, channel_id, first_index, n_records, buffer, sizes, times);
+
+  /* Пакетное чтение не поддерживается, считываем записи по одной. */
+  if ((iface->channel_get_data == NULL) || (iface->channel_get_data_size == NULL))
+    return FALSE;
+
+  /* Определяем размеры записей и общий объём данных. */
+  record_sizes = g_new (guint32, MAX (*n_records, 1));
+  for (i = 0, total_size = 0; i < *n_records; i++)
+    {
+      record_sizes[i] = iface->channel_get_data_size (db, channel_id, first_index + i);
+      if ((record_sizes[i] == 0) || (total_size + record_sizes[i] > G_MAXUINT32))
+        break;
+
+      total_size += record_sizes[i];
+    }
+
+  n_read = i;
+  if ((n_read == 0) || !hyscan_buffer_set_data_size (buffer, total_size))
+    {
+      g_free (record_sizes);
+      return FALSE;
+    }
+
+  /* Считываем записи непосредственно в буфер пользователя. */
+  dest = data = hyscan_buffer_get (buffer, NULL, &size);
+  record = hyscan_buffer_new ();
+
+  for (i = 0; i < n_read; i++)
+    {
+      guint32 record_size;
+      gint64 record_time;
+
+      hyscan_buffer_wrap (record, HYSCAN_DATA_BLOB, data, record_sizes[i]);
+      if (!iface->channel_get_data (db, channel_id, first_index + i, record, &record_time))
+        break;
+
+      if ((hyscan_buffer_get (record, NULL, &record_size) == NULL) || (record_size != record_sizes[i]))
+        break;
+
+      if (sizes != NULL)
+        sizes[i] = record_size;
+      if (times != NULL)
+        times[i] = record_time;
+
+      data += record_size;
+    }
+
+  g_object_unref (record);
+  g_free (record_sizes);
+
+  if (i == 0)
+    return FALSE;
+
+  /* Если часть записей считать не удалось, данные в буфере сокращаются. */
+  if (i < n_read)
+    hyscan_buffer_set_data_size (buffer, data - dest);
+
+  *n_records = i;
+
+  return TRUE;
+}
+
+/**
+ * hyscan_db_channel_map_data:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @index: индекс считываемых данных
+ * @time: (out) (nullable): метка времени считанных данных
+ *
+ * Функция считывает записанные данные по номеру индекса без копирования.
+ *
+ * Если система хранения поддерживает прямой доступ к данным завершённых
+ * каналов, возвращаемый объект ссылается на область отображённого в память
+ * файла. Данные доступны до освобождения объекта функцией g_bytes_unref,
+ * в том числе после закрытия канала данных. В остальных случаях данные
+ * копируются.
+ *
+ * Returns: (transfer full) (nullable): Данные или %NULL. Для удаления #g_bytes_unref.
+ */
+GBytes *
+hyscan_db_channel_map_data (HyScanDB *db,
+                            gint32    channel_id,
+                            guint32   index,
+                            gint64   *time)
+{
+  HyScanDBInterface *iface;
+  HyScanBuffer *buffer;
+  GBytes *bytes = NULL;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), NULL);
+
+  iface = HYSCAN_DB_GET_IFACE (db);
+  if (iface->channel_map_data != NULL)
+    return iface->channel_map_data (db, channel_id, index, time);
+
+  /* Прямой доступ не поддерживается, копируем данные. */
+  if (iface->channel_get_data == NULL)
+    return NULL;
+
+  buffer = hyscan_buffer_new ();
+  if (iface->channel_get_data (db, channel_id, index, buffer, time))
+    {
+      gpointer data;
+      guint32 size;
+
+      data = hyscan_buffer_get (buffer, NULL, &size);
+      bytes = g_bytes_new (data, size);
+    }
+  g_object_unref (buffer);
+
+  return bytes;
+}
+
 /**
  * hyscan_db_channel_get_data_size:
  * @db: указатель на #HyScanDB
@@ -1194,6 +1592,261 @@ hyscan_db_channel_find_data (HyScanDB *db,
   return HYSCAN_DB_FIND_FAIL;
 }
 
+/* Функция выполняет асинхронную операцию в рабочем потоке пула. */
+static void
+hyscan_db_async_job_func (gpointer data,
+                          gpointer user_data)
+{
+  HyScanDBAsyncJob *job = data;
+  GTask *task = job->task;
+
+  job->func (task, g_task_get_source_object (task), g_task_get_task_data (task), g_task_get_cancellable (task));
+
+  g_object_unref (task);
+  g_free (job);
+}
+
+/* Функция выполняет задачу в пуле рабочих потоков асинхронных операций.
+   Пул создаётся при первом обращении и ограничен HYSCAN_DB_ASYNC_THREADS
+   потоками, чтобы блокирующие операции чтения не занимали общий пул
+   потоков GIO, используемый остальным приложением. */
+static void
+hyscan_db_async_run (GTask           *task,
+                     GTaskThreadFunc  func)
+{
+  static gsize pool = 0;
+  HyScanDBAsyncJob *job;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *new_pool;
+
+      new_pool = g_thread_pool_new (hyscan_db_async_job_func, NULL, HYSCAN_DB_ASYNC_THREADS, FALSE, NULL);
+      g_once_init_leave (&pool, (gsize) new_pool);
+    }
+
+  job = g_new (HyScanDBAsyncJob, 1);
+  job->task = g_object_ref (task);
+  job->func = func;
+
+  g_thread_pool_push ((GThreadPool *) pool, job, NULL);
+}
+
+/* Функция чтения данных в рабочем потоке. */
+static void
+hyscan_db_channel_get_data_thread (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+  HyScanDBGetDataTask *data = task_data;
+  GBytes *bytes;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  bytes = hyscan_db_channel_map_data (source_object, data->channel_id, data->index, &data->time);
+  if (bytes == NULL)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                               "can't read data %u from channel %d", data->index, data->channel_id);
+      return;
+    }
+
+  g_task_return_pointer (task, bytes, (GDestroyNotify) g_bytes_unref);
+}
+
+/* Функция поиска данных в рабочем потоке. */
+static void
+hyscan_db_channel_find_data_thread (GTask        *task,
+                                    gpointer      source_object,
+                                    gpointer      task_data,
+                                    GCancellable *cancellable)
+{
+  HyScanDBFindDataTask *data = task_data;
+  HyScanDBFindStatus status;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  status = hyscan_db_channel_find_data (source_object, data->channel_id, data->time,
+                                        &data->lindex, &data->rindex, &data->ltime, &data->rtime);
+
+  g_task_return_int (task, status);
+}
+
+/**
+ * hyscan_db_channel_get_data_async:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @index: индекс считываемых данных
+ * @cancellable: (nullable): объект #GCancellable
+ * @callback: функция, вызываемая по завершении чтения
+ * @user_data: пользовательские данные для функции callback
+ *
+ * Функция асинхронно считывает записанные данные по номеру индекса.
+ *
+ * Чтение выполняется синхронной функцией #hyscan_db_channel_map_data в
+ * пуле рабочих потоков библиотеки, поэтому несколько запросов могут
+ * выполняться одновременно. Одновременность ограничена реализацией системы
+ * хранения: запросы к серверу через #HyScanDBClient выполняются по
+ * одному. Функция callback вызывается в
+ * основном цикле текущего потока (#GMainContext), из которого была
+ * вызвана эта функция. Результат чтения возвращает функция
+ * #hyscan_db_channel_get_data_finish.
+ */
+void
+hyscan_db_channel_get_data_async (HyScanDB            *db,
+                                  gint32               channel_id,
+                                  guint32              index,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  HyScanDBGetDataTask *data;
+  GTask *task;
+
+  g_return_if_fail (HYSCAN_IS_DB (db));
+
+  data = g_new0 (HyScanDBGetDataTask, 1);
+  data->channel_id = channel_id;
+  data->index = index;
+
+  task = g_task_new (db, cancellable, callback, user_data);
+  g_task_set_source_tag (task, hyscan_db_channel_get_data_async);
+  g_task_set_task_data (task, data, g_free);
+  hyscan_db_async_run (task, hyscan_db_channel_get_data_thread);
+  g_object_unref (task);
+}
+
+/**
+ * hyscan_db_channel_get_data_finish:
+ * @db: указатель на #HyScanDB
+ * @result: результат асинхронной операции
+ * @time: (out) (nullable): метка времени считанных данных
+ * @error: (nullable): указатель на #GError
+ *
+ * Функция завершает асинхронное чтение данных, начатое функцией
+ * #hyscan_db_channel_get_data_async. Данные возвращаются так же, как
+ * функцией #hyscan_db_channel_map_data.
+ *
+ * Returns: (transfer full) (nullable): Данные или %NULL. Для удаления #g_bytes_unref.
+ */
+GBytes *
+hyscan_db_channel_get_data_finish (HyScanDB      *db,
+                                   GAsyncResult  *result,
+                                   gint64        *time,
+                                   GError       **error)
+{
+  HyScanDBGetDataTask *data;
+  GBytes *bytes;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, db), NULL);
+
+  data = g_task_get_task_data (G_TASK (result));
+  bytes = g_task_propagate_pointer (G_TASK (result), error);
+
+  if ((bytes != NULL) && (time != NULL))
+    *time = data->time;
+
+  return bytes;
+}
+
+/**
+ * hyscan_db_channel_find_data_async:
+ * @db: указатель на #HyScanDB
+ * @channel_id: идентификатор канала данных
+ * @time: искомый момент времени
+ * @cancellable: (nullable): объект #GCancellable
+ * @callback: функция, вызываемая по завершении поиска
+ * @user_data: пользовательские данные для функции callback
+ *
+ * Функция асинхронно ищет индекс данных для указанного момента времени.
+ * Поиск выполняется в рабочем потоке аналогично функции
+ * #hyscan_db_channel_get_data_async. Результат поиска возвращает функция
+ * #hyscan_db_channel_find_data_finish.
+ */
+void
+hyscan_db_channel_find_data_async (HyScanDB            *db,
+                                   gint32               channel_id,
+                                   gint64               time,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data)
+{
+  HyScanDBFindDataTask *data;
+  GTask *task;
+
+  g_return_if_fail (HYSCAN_IS_DB (db));
+
+  data = g_new0 (HyScanDBFindDataTask, 1);
+  data->channel_id = channel_id;
+  data->time = time;
+
+  task = g_task_new (db, cancellable, callback, user_data);
+  g_task_set_source_tag (task, hyscan_db_channel_find_data_async);
+  g_task_set_task_data (task, data, g_free);
+  hyscan_db_async_run (task, hyscan_db_channel_find_data_thread);
+  g_object_unref (task);
+}
+
+/**
+ * hyscan_db_channel_find_data_finish:
+ * @db: указатель на #HyScanDB
+ * @result: результат асинхронной операции
+ * @lindex: (out) (nullable): "левый" индекс данных
+ * @rindex: (out) (nullable): "правый" индекс данных
+ * @ltime: (out) (nullable): "левая" метка времени данных
+ * @rtime: (out) (nullable): "правая" метка времени данных
+ * @error: (nullable): указатель на #GError
+ *
+ * Функция завершает асинхронный поиск данных, начатый функцией
+ * #hyscan_db_channel_find_data_async. Значения индексов и меток времени
+ * аналогичны возвращаемым функцией #hyscan_db_channel_find_data.
+ *
+ * Returns: Статус поиска индекса данных.
+ */
+HyScanDBFindStatus
+hyscan_db_channel_find_data_finish (HyScanDB      *db,
+                                    GAsyncResult  *result,
+                                    guint32       *lindex,
+                                    guint32       *rindex,
+                                    gint64        *ltime,
+                                    gint64        *rtime,
+                                    GError       **error)
+{
+  HyScanDBFindDataTask *data;
+  HyScanDBFindStatus status;
+  GError *task_error = NULL;
+
+  g_return_val_if_fail (HYSCAN_IS_DB (db), HYSCAN_DB_FIND_FAIL);
+  g_return_val_if_fail (g_task_is_valid (result, db), HYSCAN_DB_FIND_FAIL);
+
+  data = g_task_get_task_data (G_TASK (result));
+  status = g_task_propagate_int (G_TASK (result), &task_error);
+
+  if (task_error != NULL)
+    {
+      g_propagate_error (error, task_error);
+      return HYSCAN_DB_FIND_FAIL;
+    }
+
+  if (status == HYSCAN_DB_FIND_OK)
+    {
+      if (lindex != NULL)
+        *lindex = data->lindex;
+      if (rindex != NULL)
+        *rindex = data->rindex;
+      if (ltime != NULL)
+        *ltime = data->ltime;
+      if (rtime != NULL)
+        *rtime = data->rtime;
+    }
+
+  return status;
+}
+
 /**
  * hyscan_db_param_object_list:
  * @db: указатель на #HyScanDB
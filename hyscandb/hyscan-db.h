@@ -38,6 +38,7 @@
 #include <hyscan-buffer.h>
 #include <hyscan-param-list.h>
 #include <hyscan-data-schema.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -58,6 +59,38 @@ typedef enum
   HYSCAN_DB_FIND_GREATER     = 3
 } HyScanDBFindStatus;
 
+/**
+ * HyScanDBDurability:
+ * @HYSCAN_DB_DURABILITY_NONE: записанные данные передаются операционной системе без дополнительных гарантий
+ * @HYSCAN_DB_DURABILITY_FLUSH: каждая запись передаётся операционной системе до завершения функции записи
+ * @HYSCAN_DB_DURABILITY_SYNC: каждая запись передаётся операционной системе, файлы периодически синхронизируются с диском
+ * @HYSCAN_DB_DURABILITY_GROUP_COMMIT: функция записи завершается после синхронизации файлов с диском, синхронизация выполняется фоновым потоком сразу для группы записей
+ *
+ * Режим сохранности записываемых данных.
+ */
+typedef enum
+{
+  HYSCAN_DB_DURABILITY_NONE          = 0,
+  HYSCAN_DB_DURABILITY_FLUSH         = 1,
+  HYSCAN_DB_DURABILITY_SYNC          = 2,
+  HYSCAN_DB_DURABILITY_GROUP_COMMIT  = 3
+} HyScanDBDurability;
+
+/**
+ * HyScanDBCompression:
+ * @HYSCAN_DB_COMPRESSION_NONE: данные записываются без сжатия
+ * @HYSCAN_DB_COMPRESSION_ZLIB: данные сжимаются алгоритмом deflate (zlib)
+ * @HYSCAN_DB_COMPRESSION_LZ4: данные сжимаются алгоритмом LZ4
+ *
+ * Алгоритм сжатия записываемых данных.
+ */
+typedef enum
+{
+  HYSCAN_DB_COMPRESSION_NONE         = 0,
+  HYSCAN_DB_COMPRESSION_ZLIB         = 1,
+  HYSCAN_DB_COMPRESSION_LZ4          = 2
+} HyScanDBCompression;
+
 #define HYSCAN_TYPE_DB            (hyscan_db_get_type ())
 #define HYSCAN_DB(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HYSCAN_TYPE_DB, HyScanDB))
 #define HYSCAN_IS_DB(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HYSCAN_TYPE_DB))
@@ -170,6 +203,18 @@ struct _HyScanDBInterface
                                                                 gint32                 channel_id,
                                                                 guint64                save_size);
 
+  gboolean             (*channel_set_durability)               (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                HyScanDBDurability     durability);
+
+  gboolean             (*channel_set_compression)              (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                HyScanDBCompression    compression);
+
+  gboolean             (*channel_set_record_size)              (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                record_size);
+
   gboolean             (*channel_get_data_range)               (HyScanDB              *db,
                                                                 gint32                 channel_id,
                                                                 guint32               *first_index,
@@ -181,12 +226,33 @@ struct _HyScanDBInterface
                                                                 HyScanBuffer          *buffer,
                                                                 guint32               *index);
 
+  gboolean             (*channel_add_data_batch)               (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                n_records,
+                                                                HyScanBuffer          *buffer,
+                                                                const guint32         *sizes,
+                                                                const gint64          *times,
+                                                                guint32               *first_index);
+
   gboolean             (*channel_get_data)                     (HyScanDB              *db,
                                                                 gint32                 channel_id,
                                                                 guint32                index,
                                                                 HyScanBuffer          *buffer,
                                                                 gint64                *time);
 
+  gboolean             (*channel_get_data_batch)               (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                first_index,
+                                                                guint32               *n_records,
+                                                                HyScanBuffer          *buffer,
+                                                                guint32               *sizes,
+                                                                gint64                *times);
+
+  GBytes *             (*channel_map_data)                     (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                index,
+                                                                gint64                *time);
+
   guint32              (*channel_get_data_size)                (HyScanDB              *db,
                                                                 gint32                 channel_id,
                                                                 guint32                index);
@@ -366,6 +432,21 @@ gboolean               hyscan_db_channel_set_save_size         (HyScanDB
                                                                 gint32                 channel_id,
                                                                 guint64                save_size);
 
+HYSCAN_API
+gboolean               hyscan_db_channel_set_durability        (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                HyScanDBDurability     durability);
+
+HYSCAN_API
+gboolean               hyscan_db_channel_set_compression       (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                HyScanDBCompression    compression);
+
+HYSCAN_API
+gboolean               hyscan_db_channel_set_record_size       (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                record_size);
+
 HYSCAN_API
 gboolean               hyscan_db_channel_get_data_range        (HyScanDB              *db,
                                                                 gint32                 channel_id,
@@ -379,6 +460,15 @@ gboolean               hyscan_db_channel_add_data              (HyScanDB
                                                                 HyScanBuffer          *buffer,
                                                                 guint32               *index);
 
+HYSCAN_API
+gboolean               hyscan_db_channel_add_data_batch        (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                n_records,
+                                                                HyScanBuffer          *buffer,
+                                                                const guint32         *sizes,
+                                                                const gint64          *times,
+                                                                guint32               *first_index);
+
 HYSCAN_API
 gboolean               hyscan_db_channel_get_data              (HyScanDB              *db,
                                                                 gint32                 channel_id,
@@ -386,6 +476,21 @@ gboolean               hyscan_db_channel_get_data              (HyScanDB
                                                                 HyScanBuffer          *buffer,
                                                                 gint64                *time);
 
+HYSCAN_API
+gboolean               hyscan_db_channel_get_data_batch        (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                first_index,
+                                                                guint32               *n_records,
+                                                                HyScanBuffer          *buffer,
+                                                                guint32               *sizes,
+                                                                gint64                *times);
+
+HYSCAN_API
+GBytes *               hyscan_db_channel_map_data              (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                index,
+                                                                gint64                *time);
+
 HYSCAN_API
 guint32                hyscan_db_channel_get_data_size         (HyScanDB              *db,
                                                                 gint32                 channel_id,
@@ -405,6 +510,37 @@ HyScanDBFindStatus     hyscan_db_channel_find_data             (HyScanDB
                                                                 gint64                *ltime,
                                                                 gint64                *rtime);
 
+HYSCAN_API
+void                   hyscan_db_channel_get_data_async        (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                guint32                index,
+                                                                GCancellable          *cancellable,
+                                                                GAsyncReadyCallback    callback,
+                                                                gpointer               user_data);
+
+HYSCAN_API
+GBytes *               hyscan_db_channel_get_data_finish       (HyScanDB              *db,
+                                                                GAsyncResult          *result,
+                                                                gint64                *time,
+                                                                GError               **error);
+
+HYSCAN_API
+void                   hyscan_db_channel_find_data_async       (HyScanDB              *db,
+                                                                gint32                 channel_id,
+                                                                gint64                 time,
+                                                                GCancellable          *cancellable,
+                                                                GAsyncReadyCallback    callback,
+                                                                gpointer               user_data);
+
+HYSCAN_API
+HyScanDBFindStatus     hyscan_db_channel_find_data_finish      (HyScanDB              *db,
+                                                                GAsyncResult          *result,
+                                                                guint32               *lindex,
+                                                                guint32               *rindex,
+                                                                gint64                *ltime,
+                                                                gint64                *rtime,
+                                                                GError               **error);
+
 HYSCAN_API
 gchar **               hyscan_db_param_object_list             (HyScanDB              *db,
                                                                 gint32                 param_id);
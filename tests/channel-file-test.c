@@ -33,9 +33,522 @@
  */
 
 #include "hyscan-db-channel-file.h"
+#include "hyscan-db-cache.h"
+#include "hyscan-db-codec.h"
 #include <glib/gprintf.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <string.h>
 
 #define DATA_PATTERNS 16
+#define BATCH_RECORDS 64
+#define PACK_CLOSE_TIME 0.5
+#define CODEC_SIZES 64
+#define CODEC_MAX_SIZE (1024 * 1024)
+#define MMAP_RECORDS 100000
+#define MMAP_RECORD_SIZE 64
+#define VAR_RECORD_MAX_SIZE 512
+#define COMPACT_RECORDS 20000
+#define LEGACY_RECORDS 100
+#define FIND_RECORDS 30000
+#define PREALLOC_RECORDS 20000
+#define PREALLOC_MAX_PARTS 64
+#define LRU_RECORDS 60000
+#define LRU_MAX_OPEN_PARTS 2
+#define LRU_THREADS 4
+#define LRU_READS 5000
+#define BUFFERED_RECORDS 10000
+#define BUFFERED_SIZE (256 * 1024)
+#define DURABILITY_RECORDS 400
+#define MEMORY_RECORDS 20000
+
+/* Функция открывает канал заново и сверяет число записей, метки времени
+ * и контрольные суммы данных с ожидаемыми. */
+static gboolean
+check_channel (const gchar  *name,
+               guint32       n_records,
+               const gint64 *times64,
+               guint32       data_size)
+{
+  HyScanDBChannelFile *channel;
+  HyScanBuffer *buffer;
+  guint32 first_index, last_index;
+  gboolean status = TRUE;
+  guint32 i, j;
+
+  channel = hyscan_db_channel_file_new (".", name, TRUE);
+  buffer = hyscan_buffer_new ();
+
+  if (!hyscan_db_channel_file_get_channel_data_range (channel, &first_index, &last_index) ||
+      (first_index != 0) || (last_index != n_records - 1))
+    {
+      g_warning ("data range mismatch");
+      status = FALSE;
+    }
+
+  for (i = 0; status && (i < n_records); i++)
+    {
+      const guchar *data;
+      guint32 size;
+      gint64 time64;
+      guint32 hash = 0;
+
+      if (!hyscan_db_channel_file_get_channel_data (channel, i, buffer, &time64))
+        {
+          g_warning ("hyscan_db_channel_get failed");
+          status = FALSE;
+          break;
+        }
+
+      data = hyscan_buffer_get_data (buffer, &size);
+      if (size != data_size)
+        {
+          g_warning ("data size mismatch");
+          status = FALSE;
+          break;
+        }
+
+      if (times64[i] != time64)
+        {
+          g_warning ("time mismatch");
+          status = FALSE;
+          break;
+        }
+
+      for (j = 4; j < data_size; j++)
+        hash = 33 * hash + data[j];
+
+      if (*(const guint32*) data != hash)
+        {
+          g_warning ("data hash mismatch");
+          status = FALSE;
+        }
+    }
+
+  g_object_unref (buffer);
+  g_object_unref (channel);
+
+  return status;
+}
+
+/* Обработчик сообщений библиотеки, подсчитывающий сообщения об устаревшем
+ * файле описания частей. */
+static void
+count_stale_manifest (const gchar    *log_domain,
+                      GLogLevelFlags  log_level,
+                      const gchar    *message,
+                      gpointer        user_data)
+{
+  guint *n_stale = user_data;
+
+  if (strstr (message, "manifest file is out of date") != NULL)
+    *n_stale += 1;
+}
+
+/* Функция сверяет записи, считанные через отображение файлов индексов,
+ * с записями, считанными из файлов, и с ожидаемыми данными. */
+static gboolean
+compare_channels (HyScanDBChannelFile *mmap_channel,
+                  HyScanDBChannelFile *file_channel,
+                  guint32              n_records)
+{
+  HyScanBuffer *mmap_buffer;
+  HyScanBuffer *file_buffer;
+  guint8 expected[MMAP_RECORD_SIZE];
+  guint32 first_index, last_index;
+  gboolean status = TRUE;
+  guint32 i, j;
+
+  mmap_buffer = hyscan_buffer_new ();
+  file_buffer = hyscan_buffer_new ();
+
+  if (!hyscan_db_channel_file_get_channel_data_range (mmap_channel, &first_index, &last_index) ||
+      (first_index != 0) || (last_index != n_records - 1))
+    {
+      g_warning ("mmap data range mismatch");
+      status = FALSE;
+    }
+
+  for (i = 0; status && (i < n_records); i++)
+    {
+      const guint8 *mmap_data, *file_data;
+      guint32 mmap_size, file_size;
+      gint64 mmap_time, file_time;
+      guint32 lindex, rindex;
+
+      if (!hyscan_db_channel_file_get_channel_data (mmap_channel, i, mmap_buffer, &mmap_time) ||
+          !hyscan_db_channel_file_get_channel_data (file_channel, i, file_buffer, &file_time))
+        {
+          g_warning ("record %u read failed", i);
+          status = FALSE;
+          break;
+        }
+
+      for (j = 0; j < MMAP_RECORD_SIZE; j++)
+        expected[j] = (guint8) (i + j);
+
+      mmap_data = hyscan_buffer_get_data (mmap_buffer, &mmap_size);
+      file_data = hyscan_buffer_get_data (file_buffer, &file_size);
+      if ((mmap_size != MMAP_RECORD_SIZE) || (file_size != MMAP_RECORD_SIZE) ||
+          (memcmp (mmap_data, expected, MMAP_RECORD_SIZE) != 0) ||
+          (memcmp (file_data, expected, MMAP_RECORD_SIZE) != 0))
+        {
+          g_warning ("record %u data mismatch", i);
+          status = FALSE;
+          break;
+        }
+
+      if ((mmap_time != file_time) || (mmap_time != 10 * (i + 1)) ||
+          (hyscan_db_channel_file_get_channel_data_size (mmap_channel, i) != MMAP_RECORD_SIZE) ||
+          (hyscan_db_channel_file_get_channel_data_time (mmap_channel, i) != mmap_time))
+        {
+          g_warning ("record %u time or size mismatch", i);
+          status = FALSE;
+          break;
+        }
+
+      /* Поиск между записями использует индексы из отображения. */
+      if (i + 1 < n_records)
+        {
+          if ((hyscan_db_channel_file_find_channel_data (mmap_channel, mmap_time + 5,
+                                                         &lindex, &rindex, NULL, NULL) != HYSCAN_DB_FIND_OK) ||
+              (lindex != i) || (rindex != i + 1))
+            {
+              g_warning ("record %u find mismatch", i);
+              status = FALSE;
+            }
+        }
+      else
+        {
+          if (hyscan_db_channel_file_find_channel_data (mmap_channel, mmap_time + 5,
+                                                        &lindex, &rindex, NULL, NULL) != HYSCAN_DB_FIND_GREATER)
+            {
+              g_warning ("record %u find mismatch", i);
+              status = FALSE;
+            }
+        }
+    }
+
+  g_object_unref (mmap_buffer);
+  g_object_unref (file_buffer);
+
+  return status;
+}
+
+/* Функция возвращает размер записи с заданным индексом для проверок
+ * с записями разного размера. */
+static guint32
+var_record_size (guint32 index)
+{
+  return 1 + (index * 37) % VAR_RECORD_MAX_SIZE;
+}
+
+/* Функция заполняет данные записи с заданным индексом. */
+static void
+fill_var_record (guint8  *data,
+                 guint32  index)
+{
+  guint32 size = var_record_size (index);
+  guint32 i;
+
+  for (i = 0; i < size; i++)
+    data[i] = (guint8) (7 * index + i);
+}
+
+/* Функция записывает в канал записи разного размера с индексами, начиная
+ * с first_index, и заданными метками времени. */
+static void
+write_var_records (HyScanDBChannelFile *channel,
+                   guint32              first_index,
+                   guint32              n_records,
+                   const gint64        *times)
+{
+  HyScanBuffer *buffer;
+  guint8 data[VAR_RECORD_MAX_SIZE];
+  guint32 index;
+  guint32 i;
+
+  buffer = hyscan_buffer_new ();
+
+  for (i = first_index; i < first_index + n_records; i++)
+    {
+      fill_var_record (data, i);
+      hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, var_record_size (i));
+      if (!hyscan_db_channel_file_add_channel_data (channel, times[i], buffer, &index))
+        g_error ("hyscan_db_channel_add failed");
+      if (index != i)
+        g_error ("index mismatch %u != %u", index, i);
+    }
+
+  g_object_unref (buffer);
+}
+
+/* Функция сверяет записи разного размера в диапазоне индексов с ожидаемыми. */
+static gboolean
+check_var_records (HyScanDBChannelFile *channel,
+                   guint32              first_index,
+                   guint32              n_records,
+                   const gint64        *times)
+{
+  HyScanBuffer *buffer;
+  guint8 expected[VAR_RECORD_MAX_SIZE];
+  gboolean status = TRUE;
+  guint32 i;
+
+  buffer = hyscan_buffer_new ();
+
+  for (i = first_index; status && (i < first_index + n_records); i++)
+    {
+      const guint8 *data;
+      guint32 size;
+      gint64 time;
+
+      if (!hyscan_db_channel_file_get_channel_data (channel, i, buffer, &time))
+        {
+          g_warning ("record %u read failed", i);
+          status = FALSE;
+          break;
+        }
+
+      fill_var_record (expected, i);
+      data = hyscan_buffer_get_data (buffer, &size);
+      if ((size != var_record_size (i)) || (memcmp (data, expected, size) != 0))
+        {
+          g_warning ("record %u data mismatch", i);
+          status = FALSE;
+        }
+
+      if ((time != times[i]) ||
+          (hyscan_db_channel_file_get_channel_data_time (channel, i) != times[i]) ||
+          (hyscan_db_channel_file_get_channel_data_size (channel, i) != var_record_size (i)))
+        {
+          g_warning ("record %u time or size mismatch", i);
+          status = FALSE;
+        }
+    }
+
+  g_object_unref (buffer);
+
+  return status;
+}
+
+/* Функция открывает канал с записями разного размера заново и сверяет
+ * диапазон индексов и записи с ожидаемыми. */
+static gboolean
+check_channel_var (const gchar  *name,
+                   guint32       n_records,
+                   const gint64 *times)
+{
+  HyScanDBChannelFile *channel;
+  guint32 first_index, last_index;
+  gboolean status = TRUE;
+
+  channel = hyscan_db_channel_file_new (".", name, TRUE);
+
+  if (!hyscan_db_channel_file_get_channel_data_range (channel, &first_index, &last_index) ||
+      (first_index != 0) || (last_index != n_records - 1))
+    {
+      g_warning ("data range mismatch");
+      status = FALSE;
+    }
+
+  if (status)
+    status = check_var_records (channel, 0, n_records, times);
+
+  g_object_unref (channel);
+
+  return status;
+}
+
+/* Функция ищет запись по метке времени в массиве меток времени делением
+ * пополам, результат должен совпадать с hyscan_db_channel_file_find_channel_data. */
+static HyScanDBFindStatus
+find_reference (const gint64 *times,
+                guint32       n_records,
+                gint64        time,
+                guint32      *lindex,
+                guint32      *rindex)
+{
+  guint32 begin, end;
+
+  if (time < times[0])
+    return HYSCAN_DB_FIND_LESS;
+  if (time > times[n_records - 1])
+    return HYSCAN_DB_FIND_GREATER;
+
+  /* Первая запись с меткой времени не меньше искомой. */
+  for (begin = 0, end = n_records - 1; begin < end; )
+    {
+      guint32 middle = begin + (end - begin) / 2;
+
+      if (times[middle] < time)
+        begin = middle + 1;
+      else
+        end = middle;
+    }
+
+  *rindex = begin;
+  *lindex = (times[begin] == time) ? begin : begin - 1;
+
+  return HYSCAN_DB_FIND_OK;
+}
+
+/* Функция сверяет результаты поиска записей по точным меткам времени,
+ * меткам между записями и за границами данных с ожидаемыми. */
+static gboolean
+check_find (HyScanDBChannelFile *channel,
+            const gint64        *times,
+            guint32              n_records)
+{
+  guint32 i, j;
+
+  for (i = 0; i < n_records; i++)
+    {
+      gint64 find_times[4];
+
+      find_times[0] = times[i];
+      find_times[1] = times[i] - 1;
+      find_times[2] = times[i] + 1;
+      find_times[3] = (i + 1 < n_records) ? times[i] + (times[i + 1] - times[i]) / 2 : times[i] + 1000;
+
+      for (j = 0; j < G_N_ELEMENTS (find_times); j++)
+        {
+          HyScanDBFindStatus status, expected;
+          guint32 lindex = 0, rindex = 0;
+          guint32 elindex = 0, erindex = 0;
+          gint64 ltime = 0, rtime = 0;
+
+          expected = find_reference (times, n_records, find_times[j], &elindex, &erindex);
+          status = hyscan_db_channel_file_find_channel_data (channel, find_times[j],
+                                                             &lindex, &rindex, &ltime, &rtime);
+          if (status != expected)
+            {
+              g_warning ("find %" G_GINT64_FORMAT ": status %d, expected %d", find_times[j], status, expected);
+              return FALSE;
+            }
+
+          if (status != HYSCAN_DB_FIND_OK)
+            continue;
+
+          if ((lindex != elindex) || (rindex != erindex) ||
+              (ltime != times[elindex]) || (rtime != times[erindex]))
+            {
+              g_warning ("find %" G_GINT64_FORMAT ": found %u-%u, expected %u-%u",
+                         find_times[j], lindex, rindex, elindex, erindex);
+              return FALSE;
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+/* Обработчик сообщений библиотеки, подсчитывающий сообщения об отключении
+ * предварительного выделения места. */
+static void
+count_preallocate_fail (const gchar    *log_domain,
+                        GLogLevelFlags  log_level,
+                        const gchar    *message,
+                        gpointer        user_data)
+{
+  guint *n_fails = user_data;
+
+  if (strstr (message, "can't preallocate file space") != NULL)
+    *n_fails += 1;
+}
+
+/* Функция возвращает видимые размеры и размеры выделенного места файлов
+ * частей канала с заданным расширением и число найденных частей. */
+static guint
+stat_parts (const gchar *name,
+            const gchar *ext,
+            guint64     *sizes,
+            guint64     *allocs,
+            guint        max_parts)
+{
+  guint n_parts;
+
+  for (n_parts = 0; n_parts < max_parts; n_parts++)
+    {
+      GStatBuf stat_buf;
+      gchar *file_name;
+      gint status;
+
+      file_name = g_strdup_printf ("%s.%06d.%s", name, n_parts, ext);
+      status = g_stat (file_name, &stat_buf);
+      g_free (file_name);
+
+      if (status != 0)
+        break;
+
+      sizes[n_parts] = stat_buf.st_size;
+      allocs[n_parts] = (guint64) stat_buf.st_blocks * 512;
+    }
+
+  return n_parts;
+}
+
+/* Параметры потока случайного чтения записей. */
+typedef struct
+{
+  HyScanDBChannelFile *channel;
+  const gint64        *times;
+  guint32              n_records;
+} RandomReader;
+
+/* Поток случайного чтения записей разного размера. */
+static gpointer
+random_reader (gpointer data)
+{
+  RandomReader *reader = data;
+  guint i;
+
+  for (i = 0; i < LRU_READS; i++)
+    {
+      guint32 index = g_random_int_range (0, reader->n_records);
+
+      if (!check_var_records (reader->channel, index, 1, reader->times))
+        return GINT_TO_POINTER (FALSE);
+    }
+
+  return GINT_TO_POINTER (TRUE);
+}
+
+/* Функция возвращает число открытых процессом дескрипторов файлов канала
+ * или -1, если их нельзя подсчитать. */
+static gint
+count_open_files (const gchar *name)
+{
+  const gchar *fd_name;
+  gchar *prefix;
+  GDir *dir;
+  gint n_files = 0;
+
+  dir = g_dir_open ("/proc/self/fd", 0, NULL);
+  if (dir == NULL)
+    return -1;
+
+  prefix = g_strdup_printf ("/%s.", name);
+
+  while ((fd_name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *fd_path;
+      gchar *link;
+
+      fd_path = g_build_filename ("/proc/self/fd", fd_name, NULL);
+      link = g_file_read_link (fd_path, NULL);
+      if ((link != NULL) && (strstr (link, prefix) != NULL))
+        n_files += 1;
+
+      g_free (link);
+      g_free (fd_path);
+    }
+
+  g_free (prefix);
+  g_dir_close (dir);
+
+  return n_files;
+}
 
 int
 main (int argc, char **argv)
@@ -56,6 +569,20 @@ main (int argc, char **argv)
   guint64 max_file_size = 1024 * 1024 * 1024;
   guint32 data_size = 64 * 1024;
   guint32 total_records = 1000;
+  gboolean mmap_index = FALSE;
+  guint32 write_buffer_size = 0;
+  gboolean memory_index = FALSE;
+  gboolean io_uring = FALSE;
+  guint32 read_ahead = 0;
+  guint32 cache_size = 0;
+  HyScanDBCache *cache = NULL;
+  gchar *compression_name = NULL;
+  HyScanDBCompression compression = HYSCAN_DB_COMPRESSION_NONE;
+  gchar *pack_compression_name = NULL;
+  HyScanDBCompression pack_compression = HYSCAN_DB_COMPRESSION_NONE;
+  gboolean fixed_size = FALSE;
+  guint32 preallocate_size = 0;
+  guint32 max_open_parts = 0;
 
   GTimer *cur_timer;
   GTimer *all_timer;
@@ -73,6 +600,17 @@ main (int argc, char **argv)
         {"file-size", 'f', 0, G_OPTION_ARG_INT64, &max_file_size, "Maximum data file size", NULL},
         {"data-size", 'd', 0, G_OPTION_ARG_INT, &data_size, "Data record size", NULL},
         {"records", 'r', 0, G_OPTION_ARG_INT, &total_records, "Total records number", NULL},
+        {"mmap-index", 'm', 0, G_OPTION_ARG_NONE, &mmap_index, "Map index files into memory", NULL},
+        {"write-buffer", 'b', 0, G_OPTION_ARG_INT, &write_buffer_size, "Write-behind buffer size", NULL},
+        {"memory-index", 'i', 0, G_OPTION_ARG_NONE, &memory_index, "Load all indexes into memory", NULL},
+        {"io-uring", 'u', 0, G_OPTION_ARG_NONE, &io_uring, "Use io_uring for data I/O", NULL},
+        {"read-ahead", 'a', 0, G_OPTION_ARG_INT, &read_ahead, "Number of records read ahead", NULL},
+        {"cache-size", 'c', 0, G_OPTION_ARG_INT, &cache_size, "Shared cache size, Mb", NULL},
+        {"compression", 'z', 0, G_OPTION_ARG_STRING, &compression_name, "Data compression (zlib, lz4)", NULL},
+        {"pack-compression", 'p', 0, G_OPTION_ARG_STRING, &pack_compression_name, "Completed parts compression (zlib, lz4)", NULL},
+        {"fixed-size", 'x', 0, G_OPTION_ARG_NONE, &fixed_size, "Fixed record size mode", NULL},
+        {"preallocate", 'l', 0, G_OPTION_ARG_INT, &preallocate_size, "Maximum preallocated extent size, Mb", NULL},
+        {"max-open-parts", 'o', 0, G_OPTION_ARG_INT, &max_open_parts, "Maximum number of parts with open files", NULL},
         {NULL }
       };
 
@@ -94,6 +632,25 @@ main (int argc, char **argv)
 
     g_option_context_free (context);
 
+    if (g_strcmp0 (compression_name, "zlib") == 0)
+      compression = HYSCAN_DB_COMPRESSION_ZLIB;
+    else if (g_strcmp0 (compression_name, "lz4") == 0)
+      compression = HYSCAN_DB_COMPRESSION_LZ4;
+    else if (compression_name != NULL)
+      {
+        g_print ("unknown compression %s\n", compression_name);
+        return -1;
+      }
+
+    if (g_strcmp0 (pack_compression_name, "zlib") == 0)
+      pack_compression = HYSCAN_DB_COMPRESSION_ZLIB;
+    else if (g_strcmp0 (pack_compression_name, "lz4") == 0)
+      pack_compression = HYSCAN_DB_COMPRESSION_LZ4;
+    else if (pack_compression_name != NULL)
+      {
+        g_print ("unknown pack compression %s\n", pack_compression_name);
+        return -1;
+      }
   }
 
   /* Название канала с данными. */
@@ -112,11 +669,26 @@ main (int argc, char **argv)
   /* Хранение данных. */
   HyScanDBChannelFile *channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
                                                "path", ".", "name",
-                                               channel_name, NULL);
+                                               channel_name, "mmap-index",
+                                               mmap_index, "write-buffer-size",
+                                               write_buffer_size, "memory-index",
+                                               memory_index, "io-uring",
+                                               io_uring, "pack-compression",
+                                               pack_compression, "preallocate-size",
+                                               (guint64) preallocate_size * 1024 * 1024, NULL);
 
   /* Максимальный размер файла с данными. */
   hyscan_db_channel_file_set_channel_chunk_size (channel, max_file_size);
 
+  /* Сжатие данных. */
+  if ((compression != HYSCAN_DB_COMPRESSION_NONE) &&
+      !hyscan_db_channel_file_set_channel_compression (channel, compression))
+    g_error ("compression %s isn't supported", compression_name);
+
+  /* Фиксированный размер записей. */
+  if (fixed_size && !hyscan_db_channel_file_set_channel_record_size (channel, data_size))
+    g_error ("fixed record size %d isn't supported", data_size);
+
   time64 = g_random_int ();
 
   /* Генерируем шаблоны для записи. */
@@ -125,10 +697,14 @@ main (int argc, char **argv)
 
       guint32 hash = 0;
 
-      /* Генерируем случайные данные и считаем их контрольную сумму. */
+      /* Генерируем случайные данные и считаем их контрольную сумму. При
+         сжатии данные похожи на медленно меняющийся сигнал с шумом. */
       for (j = 4; j < data_size; j++)
         {
-          datap[i][j] = g_random_int ();
+          if ((compression != HYSCAN_DB_COMPRESSION_NONE) || (pack_compression != HYSCAN_DB_COMPRESSION_NONE))
+            datap[i][j] = ((j / 256) & 0x3f) + g_random_int_range (0, 4);
+          else
+            datap[i][j] = g_random_int ();
           hash = 33 * hash + (guchar) datap[i][j];
         }
 
@@ -173,9 +749,51 @@ main (int argc, char **argv)
       all_cnts += 1;
     }
 
+  g_printf ("Write speed: %.3lf mb/s\n",
+            (data_size * (total_records / g_timer_elapsed (all_timer, NULL))) / (1024 * 1024));
+
+  if (compression != HYSCAN_DB_COMPRESSION_NONE)
+    {
+      guint64 n_bytes_in, n_bytes_out;
+
+      hyscan_db_channel_file_get_compression_stats (channel, &n_bytes_in, &n_bytes_out);
+      g_printf ("Compression: %" G_GUINT64_FORMAT " -> %" G_GUINT64_FORMAT " bytes, ratio %.3lf\n",
+                n_bytes_in, n_bytes_out, (gdouble) n_bytes_in / MAX (n_bytes_out, 1));
+    }
+
+  /* Ожидаем завершения фонового сжатия частей. */
+  if (pack_compression != HYSCAN_DB_COMPRESSION_NONE)
+    {
+      guint64 n_packed, n_pending, n_bytes_in, n_bytes_out;
+
+      hyscan_db_channel_file_finalize_channel (channel);
+
+      g_timer_start (cur_timer);
+      do
+        {
+          g_usleep (10000);
+          hyscan_db_channel_file_get_pack_stats (channel, &n_packed, &n_pending, &n_bytes_in, &n_bytes_out);
+        }
+      while (n_pending > 0);
+
+      g_printf ("Packed %" G_GUINT64_FORMAT " parts in %.3lf s: %" G_GUINT64_FORMAT " -> %" G_GUINT64_FORMAT " bytes, ratio %.3lf\n",
+                n_packed, g_timer_elapsed (cur_timer, NULL),
+                n_bytes_in, n_bytes_out, (gdouble) n_bytes_in / MAX (n_bytes_out, 1));
+    }
+
   g_object_unref (channel);
+
+  if (cache_size > 0)
+    cache = hyscan_db_cache_new ((guint64) cache_size * 1024 * 1024);
+
   channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
-                          "path", ".", "name", channel_name, NULL);
+                          "path", ".", "name", channel_name,
+                          "mmap-index", mmap_index,
+                          "memory-index", memory_index,
+                          "io-uring", io_uring,
+                          "read-ahead", read_ahead,
+                          "max-open-parts", max_open_parts,
+                          "cache", cache, NULL);
 
   if (!hyscan_db_channel_file_get_channel_data_range (channel, &first_index, &last_index))
     g_error ("First index = unknown, last index = unknown");
@@ -226,6 +844,66 @@ main (int argc, char **argv)
       all_cnts += 1;
     }
 
+  if (read_ahead > 0)
+    {
+      guint64 n_hits, n_misses;
+
+      hyscan_db_channel_file_get_readahead_stats (channel, &n_hits, &n_misses);
+      g_printf ("Read-ahead hits: %" G_GUINT64_FORMAT ", misses: %" G_GUINT64_FORMAT "\n", n_hits, n_misses);
+    }
+
+  g_printf ("Batch read, %d records per batch\n", BATCH_RECORDS);
+
+  g_timer_start (all_timer);
+
+  /* Считываем данные пакетами и проверяем контрольную сумму. */
+  {
+    HyScanBuffer *batch_buffer = hyscan_buffer_new ();
+    guint32 sizes[BATCH_RECORDS];
+    gint64 times[BATCH_RECORDS];
+
+    i = first_index;
+    while (i <= last_index)
+      {
+        guint32 n_records = MIN (BATCH_RECORDS, last_index - i + 1);
+        const gchar *batch_data;
+        guint32 batch_size;
+
+        if (!hyscan_db_channel_file_get_channel_data_batch (channel, i, &n_records, batch_buffer, sizes, times))
+          g_error ("hyscan_db_channel_get_batch failed");
+
+        batch_data = hyscan_buffer_get (batch_buffer, NULL, &batch_size);
+        if (batch_size != n_records * data_size)
+          g_warning ("batch size mismatch");
+
+        for (k = 0; k < n_records; k++)
+          {
+            guint32 hash = 0;
+
+            /* Проверяем размер данных и метку времени. */
+            if (sizes[k] != data_size)
+              g_warning ("data size mismatch");
+            if (times64[i + k] != times[k])
+              g_warning ("time mismatch");
+
+            /* Проверяем контрольную сумму. */
+            for (j = 4; j < data_size; j++)
+              hash = 33 * hash + (guchar) batch_data[j];
+            if (*(guint32*) batch_data != hash)
+              g_warning("data hash mismatch");
+
+            batch_data += data_size;
+          }
+
+        i += n_records;
+      }
+
+    g_printf ("Batch read speed: %.3lf mb/s\n",
+              (data_size * ((last_index - first_index + 1) / g_timer_elapsed (all_timer, NULL))) / (1024 * 1024));
+
+    g_object_unref (batch_buffer);
+  }
+
   g_printf ("Random read, range from %d to %d\n", first_index, last_index);
 
   g_random_set_seed (time (NULL));
@@ -274,6 +952,15 @@ main (int argc, char **argv)
       all_cnts += 1;
     }
 
+  if (cache != NULL)
+    {
+      guint64 n_hits, n_misses, size;
+
+      hyscan_db_channel_file_get_cache_stats (channel, &n_hits, &n_misses, &size);
+      g_printf ("Cache hits: %" G_GUINT64_FORMAT ", misses: %" G_GUINT64_FORMAT ", size: %" G_GUINT64_FORMAT "\n",
+                n_hits, n_misses, size);
+    }
+
   g_printf ("Finding records by time, one by one\n");
 
   /* Последовательно ищем записи по времени. */
@@ -413,13 +1100,1232 @@ main (int argc, char **argv)
         }
     }
 
-  g_object_unref (buffer);
+  /* Среднее число индексов, прочитанных при поиске. */
+  {
+    guint64 n_finds;
+    guint64 n_probes;
+
+    hyscan_db_channel_file_get_find_stats (channel, &n_finds, &n_probes);
+    if (n_finds > 0)
+      g_printf ("Index probes per find: %.2lf\n", (gdouble) n_probes / n_finds);
+  }
+
   g_object_unref (channel);
+  g_clear_object (&cache);
+
+  /* Проверяем открытие канала по файлу описания частей. */
+  {
+    gchar *manifest_file;
+    gchar *manifest_data;
+    gsize manifest_size;
+    guint32 n_records;
+
+    manifest_file = g_strdup_printf ("%s.manifest", channel_name);
+    if (!g_file_get_contents (manifest_file, &manifest_data, &manifest_size, NULL))
+      g_error ("can't read manifest file %s", manifest_file);
+
+    g_printf ("Reopening channel with valid manifest\n");
+    if (!check_channel (channel_name, total_records, times64, data_size))
+      g_error ("reopen with valid manifest failed");
+
+    /* Испорченный файл описания должен отбрасываться с полным
+       сканированием файлов частей. */
+    g_printf ("Reopening channel with corrupted manifest\n");
+    manifest_data[manifest_size / 2] ^= 0x5a;
+    if (!g_file_set_contents (manifest_file, manifest_data, manifest_size, NULL))
+      g_error ("can't write manifest file %s", manifest_file);
+    manifest_data[manifest_size / 2] ^= 0x5a;
+
+    if (!check_channel (channel_name, total_records, times64, data_size))
+      g_error ("reopen with corrupted manifest failed");
+
+    /* Перезаписываем канал с меньшим числом записей и другими метками
+       времени и возвращаем файл описания от прежнего канала. */
+    g_printf ("Reopening channel with stale manifest\n");
+    if (!hyscan_db_channel_remove_channel_files (".", channel_name))
+      g_error ("can't remove channel %s", channel_name);
+
+    n_records = MAX (total_records / 2, 1);
+    channel = hyscan_db_channel_file_new (".", channel_name, FALSE);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, max_file_size);
+    for (i = 0; i < n_records; i++)
+      {
+        times64[i] += 1;
+
+        hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, datap[(i + 1) % DATA_PATTERNS], data_size);
+        if (!hyscan_db_channel_file_add_channel_data (channel, times64[i], buffer, NULL))
+          g_error ("hyscan_db_channel_add failed");
+      }
+    g_object_unref (channel);
+
+    if (!g_file_set_contents (manifest_file, manifest_data, manifest_size, NULL))
+      g_error ("can't write manifest file %s", manifest_file);
+
+    if (!check_channel (channel_name, n_records, times64, data_size))
+      g_error ("reopen with stale manifest failed");
+
+    g_free (manifest_data);
+    g_free (manifest_file);
+  }
+
+  /* Проверяем заранее созданные части при смене частей и повторном открытии. */
+  {
+    gchar *spare_name;
+    gchar *spare_files[2];
+    gint64 *spare_times;
+    guint32 n_records;
+    gint first_part;
+    gint last_part;
+    GFileInfo *finfo;
+    GFile *file;
+
+    g_printf ("Checking spare parts across rollover and reopen\n");
+
+    spare_name = g_strdup_printf ("%s-spare", channel_name);
+    n_records = MAX ((4 * 1024 * 1024) / data_size, 4);
+    spare_times = g_new (gint64, n_records);
+
+    hyscan_db_channel_remove_channel_files (".", spare_name);
+
+    channel = hyscan_db_channel_file_new (".", spare_name, FALSE);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+    for (i = 0; i < n_records; i++)
+      {
+        spare_times[i] = 1000 * (i + 1);
+
+        hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, datap[i % DATA_PATTERNS], data_size);
+        if (!hyscan_db_channel_file_add_channel_data (channel, spare_times[i], buffer, NULL))
+          g_error ("hyscan_db_channel_add failed");
+      }
+    g_object_unref (channel);
+
+    /* Неиспользованная заранее созданная часть удаляется при завершении записи. */
+    first_part = hyscan_db_channel_get_first_part (".", spare_name);
+    if (first_part < 0)
+      g_error ("channel %s has no parts", spare_name);
+
+    for (last_part = first_part; ; last_part++)
+      {
+        gchar *index_file = g_strdup_printf ("%s.%06d.i", spare_name, last_part + 1);
+        gboolean exists = g_file_test (index_file, G_FILE_TEST_EXISTS);
+
+        g_free (index_file);
+        if (!exists)
+          break;
+      }
+
+    if (last_part == first_part)
+      g_error ("channel %s has no part rollover", spare_name);
+
+    spare_files[0] = g_strdup_printf ("%s.%06d.i", spare_name, last_part);
+    file = g_file_new_for_path (spare_files[0]);
+    finfo = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    if ((finfo == NULL) || (g_file_info_get_size (finfo) == 0))
+      g_error ("unused spare part of channel %s is left", spare_name);
+    g_object_unref (finfo);
+    g_object_unref (file);
+    g_free (spare_files[0]);
+
+    /* Временные файлы заранее созданной части не остаются после закрытия. */
+    spare_files[0] = g_strdup_printf ("%s.spare.i", spare_name);
+    spare_files[1] = g_strdup_printf ("%s.spare.d", spare_name);
+    for (j = 0; j < 2; j++)
+      {
+        if (g_file_test (spare_files[j], G_FILE_TEST_EXISTS))
+          g_error ("file %s is left after channel close", spare_files[j]);
+
+        /* Временные файлы, оставшиеся после аварийного завершения записи. */
+        if (!g_file_set_contents (spare_files[j], "", 0, NULL))
+          g_error ("can't create file %s", spare_files[j]);
+        g_free (spare_files[j]);
+      }
+
+    /* Пустые файлы части, оставшиеся после аварийного завершения записи. */
+    spare_files[0] = g_strdup_printf ("%s.%06d.i", spare_name, last_part + 1);
+    spare_files[1] = g_strdup_printf ("%s.%06d.d", spare_name, last_part + 1);
+    for (j = 0; j < 2; j++)
+      if (!g_file_set_contents (spare_files[j], "", 0, NULL))
+        g_error ("can't create file %s", spare_files[j]);
+
+    if (!check_channel (spare_name, n_records, spare_times, data_size))
+      g_error ("reopen with spare part failed");
+
+    /* То же без файла описания частей. */
+    {
+      gchar *manifest_file = g_strdup_printf ("%s.manifest", spare_name);
+
+      g_unlink (manifest_file);
+      g_free (manifest_file);
+    }
+
+    if (!check_channel (spare_name, n_records, spare_times, data_size))
+      g_error ("reopen with spare part and without manifest failed");
+
+    /* Файлы заранее созданной части удаляются вместе с каналом. */
+    if (!hyscan_db_channel_remove_channel_files (".", spare_name))
+      g_error ("can't remove channel %s", spare_name);
+
+    for (j = 0; j < 2; j++)
+      {
+        if (g_file_test (spare_files[j], G_FILE_TEST_EXISTS))
+          g_error ("file %s is left after channel removal", spare_files[j]);
+        g_free (spare_files[j]);
+      }
+
+    for (j = 0; j < 2; j++)
+      {
+        gchar *spare_file = g_strdup_printf ("%s.spare.%c", spare_name, (j == 0) ? 'i' : 'd');
+
+        if (g_file_test (spare_file, G_FILE_TEST_EXISTS))
+          g_error ("file %s is left after channel removal", spare_file);
+        g_free (spare_file);
+      }
+
+    if (hyscan_db_channel_get_first_part (".", spare_name) >= 0)
+      g_error ("channel %s is left after removal", spare_name);
+
+    g_free (spare_times);
+    g_free (spare_name);
+  }
+
+  /* Проверяем, что сжатие записей и фиксированный размер записей не
+     включаются одновременно. */
+  {
+    gchar *fixed_name;
+
+    g_printf ("Checking compression with fixed size records\n");
+
+    fixed_name = g_strdup_printf ("%s-fixed", channel_name);
+    hyscan_db_channel_remove_channel_files (".", fixed_name);
+
+    channel = hyscan_db_channel_file_new (".", fixed_name, FALSE);
+
+    if (!hyscan_db_channel_file_set_channel_record_size (channel, 16))
+      g_error ("can't set fixed record size");
+    if (hyscan_db_channel_file_set_channel_compression (channel, HYSCAN_DB_COMPRESSION_ZLIB))
+      g_error ("compression is enabled for fixed size records");
+
+    if (!hyscan_db_channel_file_set_channel_record_size (channel, 0))
+      g_error ("can't reset fixed record size");
+    if (hyscan_db_channel_file_set_channel_compression (channel, HYSCAN_DB_COMPRESSION_ZLIB) &&
+        hyscan_db_channel_file_set_channel_record_size (channel, 16))
+      {
+        g_error ("fixed record size is enabled with compression");
+      }
+
+    /* После отключения сжатия фиксированный размер задаётся. */
+    if (!hyscan_db_channel_file_set_channel_compression (channel, HYSCAN_DB_COMPRESSION_NONE) ||
+        !hyscan_db_channel_file_set_channel_record_size (channel, 16))
+      {
+        g_error ("can't set fixed record size without compression");
+      }
+
+    g_object_unref (channel);
+
+    if (!hyscan_db_channel_remove_channel_files (".", fixed_name))
+      g_error ("can't remove channel %s", fixed_name);
+
+    g_free (fixed_name);
+  }
+
+  /* Проверяем, что после удаления старых частей канал открывается по файлу
+     описания частей без сканирования их файлов. */
+  {
+    gchar *retention_name;
+    gint64 *retention_times;
+    guint32 n_records;
+    guint n_stale = 0;
+    guint handler;
+
+    g_printf ("Checking manifest after old parts removal\n");
+
+    retention_name = g_strdup_printf ("%s-retention", channel_name);
+    n_records = MAX ((16 * 1024 * 1024) / data_size, 16);
+    retention_times = g_new (gint64, n_records);
+
+    hyscan_db_channel_remove_channel_files (".", retention_name);
+
+    channel = hyscan_db_channel_file_new (".", retention_name, FALSE);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+    hyscan_db_channel_file_set_channel_save_size (channel, 4 * 1024 * 1024);
+    for (i = 0; i < n_records; i++)
+      {
+        retention_times[i] = 1000 * (i + 1);
+
+        hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, datap[i % DATA_PATTERNS], data_size);
+        if (!hyscan_db_channel_file_add_channel_data (channel, retention_times[i], buffer, NULL))
+          g_error ("hyscan_db_channel_add failed");
+      }
+    g_object_unref (channel);
+
+    if (hyscan_db_channel_get_first_part (".", retention_name) <= 0)
+      g_error ("channel %s has no removed parts", retention_name);
+
+    handler = g_log_set_handler ("HyScanDB", G_LOG_LEVEL_INFO, count_stale_manifest, &n_stale);
+
+    channel = hyscan_db_channel_file_new (".", retention_name, TRUE);
+    if (!hyscan_db_channel_file_get_channel_data_range (channel, &first_index, &last_index) ||
+        (first_index == 0) || (last_index != n_records - 1))
+      {
+        g_error ("data range mismatch after old parts removal");
+      }
+
+    for (i = first_index; i <= last_index; i++)
+      {
+        const guchar *rdata;
+        guint32 size;
+        guint32 hash = 0;
+
+        if (!hyscan_db_channel_file_get_channel_data (channel, i, buffer, &time64))
+          g_error ("hyscan_db_channel_get failed");
+
+        rdata = hyscan_buffer_get_data (buffer, &size);
+        if ((size != data_size) || (time64 != retention_times[i]))
+          g_error ("record %u mismatch after old parts removal", i);
+
+        for (j = 4; j < data_size; j++)
+          hash = 33 * hash + rdata[j];
+        if (*(const guint32*) rdata != hash)
+          g_error ("record %u hash mismatch after old parts removal", i);
+      }
+    g_object_unref (channel);
+
+    g_log_remove_handler ("HyScanDB", handler);
+
+    if (n_stale != 0)
+      g_error ("manifest of channel %s is out of date after old parts removal", retention_name);
+
+    if (!hyscan_db_channel_remove_channel_files (".", retention_name))
+      g_error ("can't remove channel %s", retention_name);
+
+    g_free (retention_times);
+    g_free (retention_name);
+  }
+
+  /* Проверяем, что освобождение канала не ожидает фонового сжатия частей,
+     а несжатые части сжимаются при следующем открытии канала. */
+  {
+    gchar *pack_name;
+    gint64 *pack_times;
+    guint64 n_packed, n_pending, n_bytes_in, n_bytes_out;
+    guint64 n_close_pending;
+    guint32 n_records;
+    gdouble close_time;
+
+    g_printf ("Checking channel close with pending pack\n");
+
+    pack_name = g_strdup_printf ("%s-pack", channel_name);
+    n_records = MAX ((64 * 1024 * 1024) / data_size, 64);
+    pack_times = g_new (gint64, n_records);
+
+    hyscan_db_channel_remove_channel_files (".", pack_name);
+
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", pack_name,
+                            "pack-compression", HYSCAN_DB_COMPRESSION_ZLIB, NULL);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+    for (i = 0; i < n_records; i++)
+      {
+        pack_times[i] = 1000 * (i + 1);
+
+        hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, datap[i % DATA_PATTERNS], data_size);
+        if (!hyscan_db_channel_file_add_channel_data (channel, pack_times[i], buffer, NULL))
+          g_error ("hyscan_db_channel_add failed");
+      }
+
+    hyscan_db_channel_file_get_pack_stats (channel, &n_packed, &n_close_pending, &n_bytes_in, &n_bytes_out);
+
+    g_timer_start (cur_timer);
+    g_object_unref (channel);
+    close_time = g_timer_elapsed (cur_timer, NULL);
+
+    g_printf ("Close time with %" G_GUINT64_FORMAT " parts pending pack: %.3lf s\n", n_close_pending, close_time);
+    if (close_time > PACK_CLOSE_TIME)
+      g_error ("channel close waits for pending pack");
+
+    /* Несжатые части сжимаются в канале, открытом только для чтения. */
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", pack_name, "readonly", TRUE,
+                            "pack-compression", HYSCAN_DB_COMPRESSION_ZLIB, NULL);
+
+    g_timer_start (cur_timer);
+    do
+      {
+        g_usleep (10000);
+        hyscan_db_channel_file_get_pack_stats (channel, &n_packed, &n_pending, &n_bytes_in, &n_bytes_out);
+      }
+    while ((n_pending > 0) && (g_timer_elapsed (cur_timer, NULL) < 60.0));
+
+    if ((n_pending > 0) || ((n_close_pending > 0) && (n_packed == 0)))
+      g_error ("raw parts are not packed on reopen");
+
+    g_object_unref (channel);
+
+    if (!check_channel (pack_name, n_records, pack_times, data_size))
+      g_error ("reopen after pack failed");
+
+    if (!hyscan_db_channel_remove_channel_files (".", pack_name))
+      g_error ("can't remove channel %s", pack_name);
+
+    g_free (pack_times);
+    g_free (pack_name);
+  }
+
+  /* Проверяем, что записи, считанные через отображение файлов индексов
+     в память, совпадают с записями, считанными из файлов. Индексов активной
+     части достаточно для пересоздания её отображения. */
+  {
+    HyScanDBChannelFile *file_channel;
+    guint8 record[MMAP_RECORD_SIZE];
+    gchar *mmap_name;
+
+    g_printf ("Checking mmap index reads against file reads\n");
+
+    mmap_name = g_strdup_printf ("%s-mmap", channel_name);
+    hyscan_db_channel_remove_channel_files (".", mmap_name);
+
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", mmap_name, "mmap-index", TRUE, NULL);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 4 * 1024 * 1024);
+    for (i = 0; i < MMAP_RECORDS; i++)
+      {
+        for (j = 0; j < MMAP_RECORD_SIZE; j++)
+          record[j] = (guint8) (i + j);
+
+        hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, record, MMAP_RECORD_SIZE);
+        if (!hyscan_db_channel_file_add_channel_data (channel, 10 * (i + 1), buffer, NULL))
+          g_error ("hyscan_db_channel_add failed");
+      }
+
+    /* Записывающий канал читает индексы активной части из отображения. */
+    file_channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                                 "path", ".", "name", mmap_name, "readonly", TRUE, NULL);
+    if (!compare_channels (channel, file_channel, MMAP_RECORDS))
+      g_error ("mmap index reads of active channel mismatch");
+
+    g_object_unref (channel);
+    g_object_unref (file_channel);
+
+    /* Завершённые части отображаются целиком. */
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", mmap_name, "readonly", TRUE, "mmap-index", TRUE, NULL);
+    file_channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                                 "path", ".", "name", mmap_name, "readonly", TRUE, NULL);
+    if (!compare_channels (channel, file_channel, MMAP_RECORDS))
+      g_error ("mmap index reads of finalized channel mismatch");
+
+    g_object_unref (channel);
+    g_object_unref (file_channel);
+
+    if (!hyscan_db_channel_remove_channel_files (".", mmap_name))
+      g_error ("can't remove channel %s", mmap_name);
+
+    g_free (mmap_name);
+  }
+
+  /* Проверяем сжатие и распаковку данных случайного размера, в том числе
+     несжимаемых. Распаковка должна выполняться в буфер точного размера. */
+  {
+    HyScanDBCompression compressions[] = { HYSCAN_DB_COMPRESSION_ZLIB, HYSCAN_DB_COMPRESSION_LZ4 };
+    guint8 *raw_data;
+    guint8 *packed_data;
+    guint8 *unpacked_data;
+    gsize packed_buffer_size;
+
+    g_printf ("Checking data compression round-trip\n");
+
+    packed_buffer_size = 2 * CODEC_MAX_SIZE + 1024;
+    raw_data = g_malloc (CODEC_MAX_SIZE);
+    packed_data = g_malloc (packed_buffer_size);
+    unpacked_data = g_malloc (CODEC_MAX_SIZE);
+
+    for (i = 0; i < G_N_ELEMENTS (compressions); i++)
+      {
+        HyScanDBCodec *codec;
+
+        if (!hyscan_db_codec_is_supported (compressions[i]))
+          continue;
+
+        codec = hyscan_db_codec_new (compressions[i]);
+
+        for (j = 0; j < CODEC_SIZES; j++)
+          {
+            gboolean random_data = (j % 2) == 0;
+            gsize raw_size;
+            gsize packed_size;
+
+            /* Граничные и случайные размеры данных. */
+            if (j < 4)
+              raw_size = j / 2 + 1;
+            else if (j < 6)
+              raw_size = CODEC_MAX_SIZE;
+            else
+              raw_size = g_random_int_range (1, CODEC_MAX_SIZE + 1);
+
+            /* Случайные данные не сжимаются, шаблонные - сжимаются. */
+            for (k = 0; k < raw_size; k++)
+              raw_data[k] = random_data ? g_random_int () : datap[k / data_size % DATA_PATTERNS][k % data_size];
+
+            packed_size = hyscan_db_codec_compress (codec, raw_data, raw_size, packed_data, packed_buffer_size);
+            if (packed_size == 0)
+              g_error ("can't compress %" G_GSIZE_FORMAT " bytes", raw_size);
+
+            /* Несжимаемые данные не помещаются в буфер меньше исходных данных. */
+            if (random_data && (raw_size > 64) &&
+                (hyscan_db_codec_compress (codec, raw_data, raw_size, packed_data, raw_size - 1) != 0))
+              {
+                g_error ("incompressible data of %" G_GSIZE_FORMAT " bytes are compressed", raw_size);
+              }
+
+            /* Сжатие в недостаточный буфер не должно портить объект сжатия. */
+            packed_size = hyscan_db_codec_compress (codec, raw_data, raw_size, packed_data, packed_buffer_size);
+            if (packed_size == 0)
+              g_error ("can't compress %" G_GSIZE_FORMAT " bytes", raw_size);
+
+            memset (unpacked_data, 0, raw_size);
+            if (!hyscan_db_codec_decompress (compressions[i], packed_data, packed_size, unpacked_data, raw_size))
+              g_error ("can't decompress %" G_GSIZE_FORMAT " bytes", raw_size);
+            if (memcmp (raw_data, unpacked_data, raw_size) != 0)
+              g_error ("decompressed data of %" G_GSIZE_FORMAT " bytes mismatch", raw_size);
+
+            /* Распаковка в буфер меньшего размера завершается ошибкой. */
+            if (hyscan_db_codec_decompress (compressions[i], packed_data, packed_size, unpacked_data, raw_size - 1))
+              g_error ("data of %" G_GSIZE_FORMAT " bytes are decompressed into smaller buffer", raw_size);
+          }
+
+        hyscan_db_codec_free (codec);
+      }
+
+    g_free (raw_data);
+    g_free (packed_data);
+    g_free (unpacked_data);
+  }
+
+  /* Проверяем компактный формат файлов индексов: записи разного размера с
+     неравномерными метками времени, в том числе с большими разрывами,
+     пересекают границы блоков индексов и частей. Канал открывается без файла
+     описания частей, чтобы файлы индексов были просмотрены целиком. Части
+     версии 1701 должны открываться. */
+  {
+    HyScanDBChannelFile *legacy_channel;
+    gchar *compact_name;
+    gchar *legacy_name;
+    gchar *file_name;
+    gint64 *compact_times;
+    guint64 index_size;
+    GByteArray *index_data;
+    GByteArray *data_data;
+    gint part;
+
+    g_printf ("Checking compact index round-trip\n");
+
+    compact_name = g_strdup_printf ("%s-compact", channel_name);
+    compact_times = g_new (gint64, COMPACT_RECORDS);
+
+    for (i = 0, time64 = 1; i < COMPACT_RECORDS; i++)
+      {
+        compact_times[i] = time64;
+
+        if (i % 97 == 0)
+          time64 += G_GINT64_CONSTANT (1) << 40;
+        else if (i % 5 == 0)
+          time64 += 1;
+        else
+          time64 += 100 + i % 13;
+      }
+
+    hyscan_db_channel_remove_channel_files (".", compact_name);
+
+    channel = hyscan_db_channel_file_new (".", compact_name, FALSE);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+
+    /* Первая половина записей записывается по одной, вторая - группами,
+       не совпадающими с блоками индексов. */
+    write_var_records (channel, 0, COMPACT_RECORDS / 2, compact_times);
+    for (i = COMPACT_RECORDS / 2; i < COMPACT_RECORDS; i += k)
+      {
+        guint32 sizes[BATCH_RECORDS];
+        guint8 *batch_data;
+        guint32 batch_size;
+        guint32 first;
+
+        k = MIN (BATCH_RECORDS - 7, COMPACT_RECORDS - i);
+        batch_data = g_malloc (k * VAR_RECORD_MAX_SIZE);
+        for (j = 0, batch_size = 0; j < k; j++)
+          {
+            sizes[j] = var_record_size (i + j);
+            fill_var_record (batch_data + batch_size, i + j);
+            batch_size += sizes[j];
+          }
+
+        hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, batch_data, batch_size);
+        if (!hyscan_db_channel_file_add_channel_data_batch (channel, k, buffer, sizes,
+                                                            compact_times + i, &first) ||
+            (first != i))
+          {
+            g_error ("hyscan_db_channel_add_batch failed");
+          }
+
+        g_free (batch_data);
+      }
+
+    if (!check_var_records (channel, 0, COMPACT_RECORDS, compact_times))
+      g_error ("compact index reads of active channel mismatch");
+
+    g_object_unref (channel);
+
+    file_name = g_strdup_printf ("%s.manifest", compact_name);
+    g_unlink (file_name);
+    g_free (file_name);
+
+    channel = hyscan_db_channel_file_new (".", compact_name, TRUE);
+    if (!hyscan_db_channel_file_get_channel_data_range (channel, &first_index, &last_index) ||
+        (first_index != 0) || (last_index != COMPACT_RECORDS - 1))
+      {
+        g_error ("compact index data range mismatch");
+      }
+    if (!check_var_records (channel, 0, COMPACT_RECORDS, compact_times))
+      g_error ("compact index reads after reopen mismatch");
+    g_object_unref (channel);
+
+    /* Индекс записи в компактном формате много меньше 24 байт. */
+    for (part = 0, index_size = 0; ; part++)
+      {
+        GStatBuf stat_buf;
+
+        file_name = g_strdup_printf ("%s.%06d.i", compact_name, part);
+        if (g_stat (file_name, &stat_buf) != 0)
+          {
+            g_free (file_name);
+            break;
+          }
+
+        index_size += stat_buf.st_size;
+        g_free (file_name);
+      }
+
+    if (part < 2)
+      g_error ("compact index channel has only %d parts", part);
+
+    g_printf ("Compact index: %" G_GUINT64_FORMAT " bytes for %d records in %d parts\n",
+              index_size, COMPACT_RECORDS, part);
+    if (index_size > (guint64) COMPACT_RECORDS * 12)
+      g_error ("compact index is too large");
+
+    if (!hyscan_db_channel_remove_channel_files (".", compact_name))
+      g_error ("can't remove channel %s", compact_name);
+
+    /* Часть версии 1701: заголовок файла (идентификатор, версия, время
+       создания), номер первого индекса и индексы по 24 байта. */
+    legacy_name = g_strdup_printf ("%s-legacy", channel_name);
+    hyscan_db_channel_remove_channel_files (".", legacy_name);
+
+    index_data = g_byte_array_new ();
+    data_data = g_byte_array_new ();
+
+    {
+      guint32 magic, version, begin_index;
+      gint64 ctime;
+
+      magic = GUINT32_TO_LE (0x58495348);
+      version = GUINT32_TO_LE (0x31303731);
+      ctime = GINT64_TO_LE (g_get_real_time ());
+      begin_index = 0;
+
+      g_byte_array_append (index_data, (guint8 *) &magic, sizeof (magic));
+      g_byte_array_append (index_data, (guint8 *) &version, sizeof (version));
+      g_byte_array_append (index_data, (guint8 *) &ctime, sizeof (ctime));
+      g_byte_array_append (index_data, (guint8 *) &begin_index, sizeof (begin_index));
+
+      magic = GUINT32_TO_LE (0x54445348);
+      g_byte_array_append (data_data, (guint8 *) &magic, sizeof (magic));
+      g_byte_array_append (data_data, (guint8 *) &version, sizeof (version));
+      g_byte_array_append (data_data, (guint8 *) &ctime, sizeof (ctime));
+    }
+
+    for (i = 0; i < LEGACY_RECORDS; i++)
+      {
+        guint8 record[VAR_RECORD_MAX_SIZE];
+        gint64 rec_time = GINT64_TO_LE (compact_times[i]);
+        guint64 rec_offset = GUINT64_TO_LE (data_data->len);
+        guint32 rec_size = GUINT32_TO_LE (var_record_size (i));
+        guint32 rec_pad = 0;
+
+        g_byte_array_append (index_data, (guint8 *) &rec_time, sizeof (rec_time));
+        g_byte_array_append (index_data, (guint8 *) &rec_offset, sizeof (rec_offset));
+        g_byte_array_append (index_data, (guint8 *) &rec_size, sizeof (rec_size));
+        g_byte_array_append (index_data, (guint8 *) &rec_pad, sizeof (rec_pad));
+
+        fill_var_record (record, i);
+        g_byte_array_append (data_data, record, var_record_size (i));
+      }
+
+    file_name = g_strdup_printf ("%s.000000.i", legacy_name);
+    if (!g_file_set_contents (file_name, (gchar *) index_data->data, index_data->len, NULL))
+      g_error ("can't write %s", file_name);
+    g_free (file_name);
+
+    file_name = g_strdup_printf ("%s.000000.d", legacy_name);
+    if (!g_file_set_contents (file_name, (gchar *) data_data->data, data_data->len, NULL))
+      g_error ("can't write %s", file_name);
+    g_free (file_name);
+
+    legacy_channel = hyscan_db_channel_file_new (".", legacy_name, TRUE);
+    if (!hyscan_db_channel_file_get_channel_data_range (legacy_channel, &first_index, &last_index) ||
+        (first_index != 0) || (last_index != LEGACY_RECORDS - 1))
+      {
+        g_error ("legacy channel data range mismatch");
+      }
+    if (!check_var_records (legacy_channel, 0, LEGACY_RECORDS, compact_times))
+      g_error ("legacy channel reads mismatch");
+    g_object_unref (legacy_channel);
+
+    if (!hyscan_db_channel_remove_channel_files (".", legacy_name))
+      g_error ("can't remove channel %s", legacy_name);
+
+    g_byte_array_unref (index_data);
+    g_byte_array_unref (data_data);
+    g_free (compact_times);
+    g_free (compact_name);
+    g_free (legacy_name);
+  }
+
+  /* Проверяем границы поиска записей по времени при неравномерных метках
+     времени: равномерные участки, квадратичный рост интервала, пачки
+     записей с большими разрывами и случайные интервалы. Оценка положения
+     записи по времени должна давать тот же результат, что и деление пополам. */
+  {
+    gchar *find_name;
+    gint64 *find_times;
+    guint64 n_finds, n_probes;
+
+    g_printf ("Checking find boundaries with non-uniform times\n");
+
+    find_name = g_strdup_printf ("%s-find", channel_name);
+    find_times = g_new (gint64, FIND_RECORDS);
+
+    for (i = 0, time64 = 1000000; i < FIND_RECORDS; i++)
+      {
+        find_times[i] = time64;
+
+        switch ((i / 1000) % 4)
+          {
+          case 0:
+            time64 += 100;
+            break;
+
+          case 1:
+            time64 += 1 + (gint64) (i % 1000) * (i % 1000);
+            break;
+
+          case 2:
+            time64 += (i % 50 == 0) ? G_GINT64_CONSTANT (1000000000) : 1;
+            break;
+
+          default:
+            time64 += g_random_int_range (1, 10000);
+            break;
+          }
+      }
+
+    hyscan_db_channel_remove_channel_files (".", find_name);
+
+    channel = hyscan_db_channel_file_new (".", find_name, FALSE);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+    write_var_records (channel, 0, FIND_RECORDS, find_times);
+
+    if (!check_find (channel, find_times, FIND_RECORDS))
+      g_error ("find mismatch in active channel");
+
+    hyscan_db_channel_file_get_find_stats (channel, &n_finds, &n_probes);
+    if (n_finds > 0)
+      g_printf ("Index probes per find: %.2lf\n", (gdouble) n_probes / n_finds);
+
+    g_object_unref (channel);
+
+    channel = hyscan_db_channel_file_new (".", find_name, TRUE);
+    if (!check_find (channel, find_times, FIND_RECORDS))
+      g_error ("find mismatch after reopen");
+    g_object_unref (channel);
+
+    if (!hyscan_db_channel_remove_channel_files (".", find_name))
+      g_error ("can't remove channel %s", find_name);
+
+    g_free (find_times);
+    g_free (find_name);
+  }
+
+  /* Проверяем предварительное выделение места в файлах частей: видимый
+     размер файлов не должен включать выделенное место, данные должны
+     считываться, а неиспользованное место завершённых частей должно
+     освобождаться. */
+  {
+    gchar *prealloc_name;
+    gint64 *prealloc_times;
+    guint64 sizes[PREALLOC_MAX_PARTS];
+    guint64 allocs[PREALLOC_MAX_PARTS];
+    guint64 total_size;
+    guint64 expected_size;
+    guint n_fails = 0;
+    guint n_parts;
+    guint handler;
+
+    g_printf ("Checking file preallocation\n");
+
+    prealloc_name = g_strdup_printf ("%s-prealloc", channel_name);
+    prealloc_times = g_new (gint64, PREALLOC_RECORDS);
+    for (i = 0; i < PREALLOC_RECORDS; i++)
+      prealloc_times[i] = 100 * (i + 1);
+
+    hyscan_db_channel_remove_channel_files (".", prealloc_name);
+
+    handler = g_log_set_handler ("HyScanDB", G_LOG_LEVEL_INFO, count_preallocate_fail, &n_fails);
+
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", prealloc_name,
+                            "preallocate-size", (guint64) 8 * 1024 * 1024, NULL);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+    write_var_records (channel, 0, PREALLOC_RECORDS, prealloc_times);
+
+    /* Видимый размер файлов данных равен заголовкам и записанным данным. */
+    n_parts = stat_parts (prealloc_name, "d", sizes, allocs, PREALLOC_MAX_PARTS);
+    if ((n_parts < 2) || (n_parts == PREALLOC_MAX_PARTS))
+      g_error ("preallocated channel has %u parts", n_parts);
+
+    for (i = 0, expected_size = 0; i < PREALLOC_RECORDS; i++)
+      expected_size += var_record_size (i);
+    for (i = 0, total_size = 0; i < n_parts; i++)
+      total_size += sizes[i] - 16;              /* Заголовок файла данных. */
+    if (total_size != expected_size)
+      g_error ("preallocated data files size %" G_GUINT64_FORMAT " != %" G_GUINT64_FORMAT,
+               total_size, expected_size);
+
+    /* Место выделено в активной части и освобождено в завершённых. */
+    if (n_fails == 0)
+      {
+        if (allocs[n_parts - 1] <= sizes[n_parts - 1])
+          g_error ("no space preallocated in active part");
+
+        for (i = 0; i < n_parts - 1; i++)
+          if (allocs[i] > sizes[i] + 512 * 1024)
+            g_error ("preallocated space of part %u is not trimmed", i);
+      }
+
+    /* Читающий канал не видит выделенное место. */
+    {
+      HyScanDBChannelFile *reader;
+
+      reader = hyscan_db_channel_file_new (".", prealloc_name, TRUE);
+      if (!hyscan_db_channel_file_get_channel_data_range (reader, &first_index, &last_index) ||
+          (first_index != 0) || (last_index != PREALLOC_RECORDS - 1))
+        {
+          g_error ("preallocated channel data range mismatch");
+        }
+      if (!check_var_records (reader, 0, PREALLOC_RECORDS, prealloc_times))
+        g_error ("preallocated channel reads mismatch");
+      g_object_unref (reader);
+    }
+
+    hyscan_db_channel_file_finalize_channel (channel);
+    g_object_unref (channel);
+
+    g_log_remove_handler ("HyScanDB", handler);
+
+    /* После завершения записи выделенное место освобождено во всех частях. */
+    n_parts = stat_parts (prealloc_name, "d", sizes, allocs, PREALLOC_MAX_PARTS);
+    for (i = 0; (n_fails == 0) && (i < n_parts); i++)
+      if (allocs[i] > sizes[i] + 512 * 1024)
+        g_error ("preallocated space of data file %u is not trimmed", i);
+
+    n_parts = stat_parts (prealloc_name, "i", sizes, allocs, PREALLOC_MAX_PARTS);
+    for (i = 0; (n_fails == 0) && (i < n_parts); i++)
+      if (allocs[i] > sizes[i] + 64 * 1024)
+        g_error ("preallocated space of index file %u is not trimmed", i);
+
+    if (!check_channel_var (prealloc_name, PREALLOC_RECORDS, prealloc_times))
+      g_error ("reopen of preallocated channel failed");
+
+    if (!hyscan_db_channel_remove_channel_files (".", prealloc_name))
+      g_error ("can't remove channel %s", prealloc_name);
+
+    g_free (prealloc_times);
+    g_free (prealloc_name);
+  }
+
+  /* Проверяем ограничение числа частей с открытыми дескрипторами файлов:
+     несколько потоков случайно читают записи канала из многих частей,
+     дескрипторы должны открываться при обращении и закрываться при
+     превышении max-open-parts, а данные - считываться без ошибок. */
+  {
+    RandomReader reader;
+    GThread *threads[LRU_THREADS];
+    gchar *lru_name;
+    gint64 *lru_times;
+    gboolean status = TRUE;
+    gint n_files;
+
+    g_printf ("Checking reads with limited open parts\n");
+
+    lru_name = g_strdup_printf ("%s-lru", channel_name);
+    lru_times = g_new (gint64, LRU_RECORDS);
+    for (i = 0; i < LRU_RECORDS; i++)
+      lru_times[i] = 100 * (i + 1);
+
+    hyscan_db_channel_remove_channel_files (".", lru_name);
+
+    channel = hyscan_db_channel_file_new (".", lru_name, FALSE);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+    write_var_records (channel, 0, LRU_RECORDS, lru_times);
+    g_object_unref (channel);
+
+    if (hyscan_db_channel_get_first_part (".", lru_name) != 0)
+      g_error ("channel %s has no parts", lru_name);
+
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", lru_name, "readonly", TRUE,
+                            "max-open-parts", LRU_MAX_OPEN_PARTS, NULL);
+
+    /* Файлы частей открываются при первом обращении к ним. */
+    n_files = count_open_files (lru_name);
+    if (n_files > 2 * (LRU_MAX_OPEN_PARTS + 1))
+      g_error ("%d part files are open before reading", n_files);
+
+    reader.channel = channel;
+    reader.times = lru_times;
+    reader.n_records = LRU_RECORDS;
+
+    for (i = 0; i < LRU_THREADS; i++)
+      threads[i] = g_thread_new ("random-reader", random_reader, &reader);
+    for (i = 0; i < LRU_THREADS; i++)
+      status = GPOINTER_TO_INT (g_thread_join (threads[i])) && status;
+
+    if (!status)
+      g_error ("reads with limited open parts mismatch");
+
+    /* Последовательное чтение всех записей после случайного. */
+    if (!check_var_records (channel, 0, LRU_RECORDS, lru_times))
+      g_error ("sequential reads with limited open parts mismatch");
+
+    n_files = count_open_files (lru_name);
+    g_printf ("Part files open after reading: %d\n", n_files);
+    if (n_files > 2 * (LRU_MAX_OPEN_PARTS + 1))
+      g_error ("%d part files are open with max-open-parts %d", n_files, LRU_MAX_OPEN_PARTS);
+
+    g_object_unref (channel);
+
+    if (!hyscan_db_channel_remove_channel_files (".", lru_name))
+      g_error ("can't remove channel %s", lru_name);
+
+    g_free (lru_times);
+    g_free (lru_name);
+  }
+
+  /* Проверяем чтение записей, находящихся в буфере отложенной записи:
+     каждая запись считывается сразу после добавления, в том числе пакетом
+     вместе с уже записанными в файл записями. Буфер должен записываться в
+     файлы по объёму, по времени и при завершении записи. */
+  {
+    gchar *buffered_name;
+    gint64 *buffered_times;
+    gchar *data_file;
+    GStatBuf stat_buf;
+    HyScanBuffer *batch_buffer;
+    guint64 written_size;
+
+    g_printf ("Checking reads from write-behind buffer\n");
+
+    buffered_name = g_strdup_printf ("%s-buffered", channel_name);
+    buffered_times = g_new (gint64, BUFFERED_RECORDS);
+    for (i = 0; i < BUFFERED_RECORDS; i++)
+      buffered_times[i] = 100 * (i + 1);
+
+    data_file = g_strdup_printf ("%s.000000.d", buffered_name);
+    batch_buffer = hyscan_buffer_new ();
+
+    hyscan_db_channel_remove_channel_files (".", buffered_name);
+
+    /* Буфер записывается только по объёму. */
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", buffered_name,
+                            "write-buffer-size", BUFFERED_SIZE,
+                            "write-buffer-time", (gint64) 0, NULL);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+
+    for (i = 0, written_size = 0; i < BUFFERED_RECORDS; i++)
+      {
+        guint32 lindex, rindex;
+
+        write_var_records (channel, i, 1, buffered_times);
+        written_size += var_record_size (i);
+
+        if (!check_var_records (channel, i, 1, buffered_times))
+          g_error ("buffered record %u mismatch", i);
+
+        if ((hyscan_db_channel_file_find_channel_data (channel, buffered_times[i],
+                                                       &lindex, &rindex, NULL, NULL) != HYSCAN_DB_FIND_OK) ||
+            (lindex != i) || (rindex != i))
+          {
+            g_error ("buffered record %u find mismatch", i);
+          }
+
+        /* Пакет из записанных в файл и буферизованных записей. */
+        if (i % 100 == 99)
+          {
+            guint32 sizes[BATCH_RECORDS];
+            gint64 times[BATCH_RECORDS];
+            guint32 n_records = BATCH_RECORDS;
+            guint32 first = i + 1 - BATCH_RECORDS;
+            const guint8 *batch_data;
+            guint8 expected[VAR_RECORD_MAX_SIZE];
+
+            if (!hyscan_db_channel_file_get_channel_data_batch (channel, first, &n_records,
+                                                                batch_buffer, sizes, times) ||
+                (n_records != BATCH_RECORDS))
+              {
+                g_error ("buffered batch %u read failed", first);
+              }
+
+            batch_data = hyscan_buffer_get_data (batch_buffer, NULL);
+            for (j = 0; j < n_records; j++)
+              {
+                fill_var_record (expected, first + j);
+                if ((sizes[j] != var_record_size (first + j)) || (times[j] != buffered_times[first + j]) ||
+                    (memcmp (batch_data, expected, sizes[j]) != 0))
+                  {
+                    g_error ("buffered batch record %u mismatch", first + j);
+                  }
+                batch_data += sizes[j];
+              }
+          }
+
+        /* Пока объём данных меньше размера буфера, в файл они не записываются. */
+        if (written_size < BUFFERED_SIZE / 2)
+          {
+            if ((g_stat (data_file, &stat_buf) != 0) || (stat_buf.st_size != 16))
+              g_error ("buffered data are written before buffer is full");
+          }
+      }
+
+    g_object_unref (channel);
+
+    if (!check_channel_var (buffered_name, BUFFERED_RECORDS, buffered_times))
+      g_error ("reopen of buffered channel failed");
+
+    /* Буфер записывается по времени. */
+    if (!hyscan_db_channel_remove_channel_files (".", buffered_name))
+      g_error ("can't remove channel %s", buffered_name);
+
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", buffered_name,
+                            "write-buffer-size", BUFFERED_SIZE,
+                            "write-buffer-time", (gint64) 50000, NULL);
+
+    write_var_records (channel, 0, 10, buffered_times);
+    for (i = 0, written_size = 0; i < 10; i++)
+      written_size += var_record_size (i);
+
+    g_timer_start (cur_timer);
+    do
+      {
+        g_usleep (10000);
+        if (g_stat (data_file, &stat_buf) != 0)
+          g_error ("can't stat %s", data_file);
+      }
+    while (((guint64) stat_buf.st_size != 16 + written_size) && (g_timer_elapsed (cur_timer, NULL) < 10.0));
+
+    if ((guint64) stat_buf.st_size != 16 + written_size)
+      g_error ("buffered data are not written by time");
+
+    if (!check_var_records (channel, 0, 10, buffered_times))
+      g_error ("buffered records mismatch after time flush");
+
+    g_object_unref (channel);
+
+    if (!hyscan_db_channel_remove_channel_files (".", buffered_name))
+      g_error ("can't remove channel %s", buffered_name);
+
+    g_object_unref (batch_buffer);
+    g_free (data_file);
+    g_free (buffered_times);
+    g_free (buffered_name);
+  }
+
+  /* Проверяем режимы сохранности данных. При включенном буфере отложенной
+     записи в режиме HYSCAN_DB_DURABILITY_NONE данные остаются в буфере, в
+     остальных режимах каждая запись должна оказаться в файле до завершения
+     функции записи, включая записи, накопленные в буфере до смены режима. */
+  {
+    HyScanDBDurability durabilities[] = { HYSCAN_DB_DURABILITY_NONE,
+                                          HYSCAN_DB_DURABILITY_FLUSH,
+                                          HYSCAN_DB_DURABILITY_SYNC,
+                                          HYSCAN_DB_DURABILITY_GROUP_COMMIT };
+    gchar *durability_name;
+    gint64 *durability_times;
+    gchar *data_file;
+
+    g_printf ("Checking durability modes\n");
+
+    durability_name = g_strdup_printf ("%s-durability", channel_name);
+    durability_times = g_new (gint64, DURABILITY_RECORDS);
+    for (i = 0; i < DURABILITY_RECORDS; i++)
+      durability_times[i] = 100 * (i + 1);
+
+    data_file = g_strdup_printf ("%s.000000.d", durability_name);
+
+    for (k = 0; k < G_N_ELEMENTS (durabilities); k++)
+      {
+        guint64 written_size = 0;
+        GStatBuf stat_buf;
+
+        hyscan_db_channel_remove_channel_files (".", durability_name);
+
+        channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                                "path", ".", "name", durability_name,
+                                "write-buffer-size", BUFFERED_SIZE,
+                                "write-buffer-time", (gint64) 0, NULL);
+
+        if (hyscan_db_channel_file_set_channel_durability (channel, HYSCAN_DB_DURABILITY_GROUP_COMMIT + 1))
+          g_error ("invalid durability mode is accepted");
+
+        /* Первая половина записей буферизуется, затем устанавливается
+           проверяемый режим. */
+        write_var_records (channel, 0, DURABILITY_RECORDS / 2, durability_times);
+        for (i = 0; i < DURABILITY_RECORDS / 2; i++)
+          written_size += var_record_size (i);
+
+        if ((g_stat (data_file, &stat_buf) != 0) || (stat_buf.st_size != 16))
+          g_error ("buffered data are written in default durability mode");
+
+        if (!hyscan_db_channel_file_set_channel_durability (channel, durabilities[k]))
+          g_error ("can't set durability mode %d", durabilities[k]);
+
+        for (i = DURABILITY_RECORDS / 2; i < DURABILITY_RECORDS; i++)
+          {
+            guint64 expected_size;
+
+            write_var_records (channel, i, 1, durability_times);
+            written_size += var_record_size (i);
+
+            if (g_stat (data_file, &stat_buf) != 0)
+              g_error ("can't stat %s", data_file);
+
+            expected_size = (durabilities[k] == HYSCAN_DB_DURABILITY_NONE) ? 16 : 16 + written_size;
+            if ((guint64) stat_buf.st_size != expected_size)
+              g_error ("durability mode %d: data file size %" G_GUINT64_FORMAT " != %" G_GUINT64_FORMAT,
+                       durabilities[k], (guint64) stat_buf.st_size, expected_size);
+          }
+
+        if (!check_var_records (channel, 0, DURABILITY_RECORDS, durability_times))
+          g_error ("durability mode %d: reads mismatch", durabilities[k]);
+
+        g_object_unref (channel);
+
+        if (!check_channel_var (durability_name, DURABILITY_RECORDS, durability_times))
+          g_error ("durability mode %d: reopen failed", durabilities[k]);
+      }
+
+    if (!hyscan_db_channel_remove_channel_files (".", durability_name))
+      g_error ("can't remove channel %s", durability_name);
+
+    g_free (data_file);
+    g_free (durability_times);
+    g_free (durability_name);
+  }
+
+  /* Проверяем режим загрузки всех индексов в память: индексы новых записей
+     должны добавляться в массивы при записи, а при повторном открытии, в
+     том числе с фоновой загрузкой, чтение и поиск должны давать те же
+     результаты, что и без загрузки индексов. */
+  {
+    gchar *memory_name;
+    gint64 *memory_times;
+    gboolean prefetch;
+
+    g_printf ("Checking in-memory index\n");
+
+    memory_name = g_strdup_printf ("%s-memory", channel_name);
+    memory_times = g_new (gint64, MEMORY_RECORDS);
+    for (i = 0, time64 = 1000; i < MEMORY_RECORDS; i++)
+      {
+        memory_times[i] = time64;
+        time64 += (i % 100 == 99) ? 1000000 : 10 + i % 7;
+      }
+
+    hyscan_db_channel_remove_channel_files (".", memory_name);
+
+    /* Записываем половину записей, затем дописываем остальные в канал,
+       открытый с загрузкой индексов, проверяя каждую новую запись. */
+    channel = hyscan_db_channel_file_new (".", memory_name, FALSE);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+    write_var_records (channel, 0, MEMORY_RECORDS / 2, memory_times);
+    g_object_unref (channel);
+
+    channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                            "path", ".", "name", memory_name, "memory-index", TRUE, NULL);
+    hyscan_db_channel_file_set_channel_chunk_size (channel, 1024 * 1024);
+
+    if (!check_var_records (channel, 0, MEMORY_RECORDS / 2, memory_times))
+      g_error ("in-memory index reads mismatch after open");
+
+    for (i = MEMORY_RECORDS / 2; i < MEMORY_RECORDS; i++)
+      {
+        guint32 lindex, rindex;
+
+        write_var_records (channel, i, 1, memory_times);
+
+        if (!check_var_records (channel, i, 1, memory_times))
+          g_error ("in-memory index record %u mismatch", i);
+
+        if ((hyscan_db_channel_file_find_channel_data (channel, memory_times[i] - 1,
+                                                       &lindex, &rindex, NULL, NULL) != HYSCAN_DB_FIND_OK) ||
+            (lindex != i - 1) || (rindex != i))
+          {
+            g_error ("in-memory index record %u find mismatch", i);
+          }
+      }
+
+    if (!check_find (channel, memory_times, MEMORY_RECORDS))
+      g_error ("in-memory index find mismatch in active channel");
+
+    g_object_unref (channel);
+
+    /* Чтение и поиск сразу после открытия, в том числе во время фоновой
+       загрузки индексов. */
+    for (prefetch = FALSE; prefetch <= TRUE; prefetch++)
+      {
+        channel = g_object_new (HYSCAN_TYPE_DB_CHANNEL_FILE,
+                                "path", ".", "name", memory_name, "readonly", TRUE,
+                                "memory-index", TRUE, "memory-index-prefetch", prefetch, NULL);
+
+        if (!hyscan_db_channel_file_get_channel_data_range (channel, &first_index, &last_index) ||
+            (first_index != 0) || (last_index != MEMORY_RECORDS - 1))
+          {
+            g_error ("in-memory index data range mismatch");
+          }
+
+        if (!check_find (channel, memory_times, MEMORY_RECORDS))
+          g_error ("in-memory index find mismatch, prefetch %d", prefetch);
+        if (!check_var_records (channel, 0, MEMORY_RECORDS, memory_times))
+          g_error ("in-memory index reads mismatch, prefetch %d", prefetch);
+
+        g_object_unref (channel);
+      }
+
+    if (!hyscan_db_channel_remove_channel_files (".", memory_name))
+      g_error ("can't remove channel %s", memory_name);
+
+    g_free (memory_times);
+    g_free (memory_name);
+  }
+
+  g_object_unref (buffer);
 
   g_free (times64);
   for (i = 0; i < DATA_PATTERNS; i++)
     g_free (datap[i]);
   g_free (data);
+  g_free (compression_name);
+  g_free (pack_compression_name);
 
   g_timer_destroy (cur_timer);
   g_timer_destroy (all_timer);
@@ -46,6 +46,31 @@
 #define STRING_VALUE(value)  (g_strdup_printf ("%d", 2 * value))
 #define ENUM_VALUE(value)    (((2 * value) % 5) + 1)
 
+#define RECORD_SIZE          (64 * 1024)
+#define RECORD_TIME(index)   (1000 * ((gint64) (index) + 1))
+
+#define ROTATED_CHANNEL      "RotatedChannel"
+#define ROTATED_CHUNK_SIZE   (1024 * 1024)
+#define ROTATED_SAVE_SIZE    (2 * 1024 * 1024)
+#define ROTATED_RECORDS      128
+
+#define BATCH_CHANNEL        "BatchChannel"
+#define BATCH_CHUNK_SIZE     (1024 * 1024)
+#define BATCH_RECORDS        12
+#define BATCH_COUNT          4
+#define PARTIAL_CHANNEL      "PartialChannel"
+
+#define ASYNC_CHANNEL        "AsyncChannel"
+#define ASYNC_RECORDS        32
+
+/* Асинхронный запрос чтения или поиска записи. */
+typedef struct
+{
+  guint32              index;                  /* Индекс записи. */
+  gint64               time;                   /* Метка времени для поиска. */
+  guint               *n_pending;              /* Число незавершённых запросов. */
+} AsyncRequest;
+
 /* Функция сверяет два списка строк в произвольном порядке. */
 void
 check_list (gchar  *error_prefix,
@@ -291,6 +316,139 @@ check_parameters (HyScanDB *db,
   g_free (orig_svalue);
 }
 
+/* Функция заполняет данные записи с указанным индексом. */
+void
+fill_record (guint8  *data,
+             guint32  index)
+{
+  guint32 n;
+
+  for (n = 0; n < RECORD_SIZE; n++)
+    data[n] = (guint8) (index + n / 256);
+}
+
+/* Функция сверяет данные и метки времени записей канала в диапазоне индексов. */
+void
+check_records (HyScanDB *db,
+               gchar    *error_prefix,
+               gint32    channel_id,
+               guint32   first_index,
+               guint32   last_index)
+{
+  HyScanBuffer *buffer;
+  guint8 *data;
+  guint32 index;
+
+  buffer = hyscan_buffer_new ();
+  data = g_malloc (RECORD_SIZE);
+
+  for (index = first_index; index <= last_index; index++)
+    {
+      gconstpointer record;
+      guint32 size;
+      gint64 time;
+
+      if (!hyscan_db_channel_get_data (db, channel_id, index, buffer, &time))
+        g_error ("%s: can't read record %u", error_prefix, index);
+
+      fill_record (data, index);
+      record = hyscan_buffer_get_data (buffer, &size);
+      if ((time != RECORD_TIME (index)) || (size != RECORD_SIZE) || (memcmp (record, data, RECORD_SIZE) != 0))
+        g_error ("%s: record %u mismatch", error_prefix, index);
+    }
+
+  g_object_unref (buffer);
+  g_free (data);
+}
+
+/* Функция завершает асинхронное чтение записи и сверяет её данные. */
+void
+get_data_ready (GObject      *source,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  AsyncRequest *request = user_data;
+  GError *error = NULL;
+  GBytes *bytes;
+  guint8 *data;
+  gint64 time;
+
+  bytes = hyscan_db_channel_get_data_finish (HYSCAN_DB (source), result, &time, &error);
+  if (bytes == NULL)
+    g_error ("get_data_async (%u): %s", request->index, (error != NULL) ? error->message : "no data");
+
+  data = g_malloc (RECORD_SIZE);
+  fill_record (data, request->index);
+  if ((time != RECORD_TIME (request->index)) ||
+      (g_bytes_get_size (bytes) != RECORD_SIZE) ||
+      (memcmp (g_bytes_get_data (bytes, NULL), data, RECORD_SIZE) != 0))
+    {
+      g_error ("get_data_async (%u): record mismatch", request->index);
+    }
+
+  g_free (data);
+  g_bytes_unref (bytes);
+
+  *request->n_pending -= 1;
+}
+
+/* Функция завершает асинхронный поиск записи и сверяет найденные индексы
+   и метки времени. Метка времени поиска совпадает с меткой времени записи
+   или находится между ней и следующей записью. */
+void
+find_data_ready (GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  AsyncRequest *request = user_data;
+  HyScanDBFindStatus status;
+  GError *error = NULL;
+  guint32 lindex, rindex;
+  gint64 ltime, rtime;
+  guint32 next_index;
+
+  status = hyscan_db_channel_find_data_finish (HYSCAN_DB (source), result,
+                                               &lindex, &rindex, &ltime, &rtime, &error);
+  if (error != NULL)
+    g_error ("find_data_async (%" G_GINT64_FORMAT "): %s", request->time, error->message);
+
+  next_index = request->index;
+  if (request->time != RECORD_TIME (request->index))
+    next_index += 1;
+
+  if ((status != HYSCAN_DB_FIND_OK) ||
+      (lindex != request->index) || (rindex != next_index) ||
+      (ltime != RECORD_TIME (lindex)) || (rtime != RECORD_TIME (rindex)))
+    {
+      g_error ("find_data_async (%" G_GINT64_FORMAT "): wrong result", request->time);
+    }
+
+  *request->n_pending -= 1;
+}
+
+/* Функция проверяет, что в каталоге галса не осталось файлов канала данных. */
+void
+check_channel_files (gchar       *error_prefix,
+                     const gchar *path,
+                     const gchar *channel_name)
+{
+  const gchar *name;
+  gchar *prefix;
+  GDir *dir;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    g_error ("%s: can't open directory '%s'", error_prefix, path);
+
+  prefix = g_strdup_printf ("%s.", channel_name);
+  while ((name = g_dir_read_name (dir)) != NULL)
+    if (g_str_has_prefix (name, prefix))
+      g_error ("%s: file '%s' is left", error_prefix, name);
+
+  g_free (prefix);
+  g_dir_close (dir);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1365,6 +1523,333 @@ main (int argc, char **argv)
           g_free (error_prefix);
         }
 
+  /* Тесты смены частей канала данных с ограничением объёма. */
+  g_message (" ");
+  g_message ("checking channel parts rotation");
+  {
+    guint32 first_index, last_index;
+    guint32 rotated_index;
+    gchar **list;
+    gint32 nid;
+
+    nid = hyscan_db_channel_create (db, track_id[0][0], ROTATED_CHANNEL, NULL);
+    if (nid < 0)
+      g_error ("can't create '%s.%s.%s'", projects[0], tracks[0], ROTATED_CHANNEL);
+
+    if (!hyscan_db_channel_set_chunk_size (db, nid, ROTATED_CHUNK_SIZE) ||
+        !hyscan_db_channel_set_save_size (db, nid, ROTATED_SAVE_SIZE))
+      {
+        g_error ("can't set '%s.%s.%s' parts size", projects[0], tracks[0], ROTATED_CHANNEL);
+      }
+
+    g_message ("writing rotated channel data");
+    {
+      HyScanBuffer *buffer = hyscan_buffer_new ();
+      guint8 *data = g_malloc (RECORD_SIZE);
+
+      for (l = 0; l < ROTATED_RECORDS; l++)
+        {
+          fill_record (data, l);
+          hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, RECORD_SIZE);
+          if (!hyscan_db_channel_add_data (db, nid, RECORD_TIME (l), buffer, NULL))
+            g_error ("can't add data to '%s.%s.%s'", projects[0], tracks[0], ROTATED_CHANNEL);
+        }
+
+      g_object_unref (buffer);
+      g_free (data);
+    }
+
+    /* Старые части удалены, оставшиеся записи доступны. */
+    g_message ("checking rotated channel content");
+    if (!hyscan_db_channel_get_data_range (db, nid, &first_index, &last_index))
+      g_error ("can't get '%s.%s.%s' data range", projects[0], tracks[0], ROTATED_CHANNEL);
+    if ((first_index == 0) || (last_index != ROTATED_RECORDS - 1))
+      g_error ("'%s.%s.%s' wrong data range", projects[0], tracks[0], ROTATED_CHANNEL);
+
+    check_records (db, "check_records ('" ROTATED_CHANNEL "')", nid, first_index, last_index);
+    rotated_index = first_index;
+
+    hyscan_db_channel_finalize (db, nid);
+    hyscan_db_close (db, nid);
+
+    g_message ("re-opening rotated channel");
+    nid = hyscan_db_channel_open (db, track_id[0][0], ROTATED_CHANNEL);
+    if (nid < 0)
+      g_error ("can't open '%s.%s.%s'", projects[0], tracks[0], ROTATED_CHANNEL);
+
+    if (!hyscan_db_channel_get_data_range (db, nid, &first_index, &last_index))
+      g_error ("can't get '%s.%s.%s' data range", projects[0], tracks[0], ROTATED_CHANNEL);
+    if ((first_index != rotated_index) || (last_index != ROTATED_RECORDS - 1))
+      g_error ("'%s.%s.%s' wrong data range", projects[0], tracks[0], ROTATED_CHANNEL);
+
+    check_records (db, "check_records ('" ROTATED_CHANNEL "')", nid, first_index, last_index);
+    hyscan_db_close (db, nid);
+
+    g_message ("checking rotated channel in channels list");
+    list = hyscan_db_channel_list (db, track_id[0][0]);
+    if ((list == NULL) || !g_strv_contains ((const gchar * const *) list, ROTATED_CHANNEL))
+      g_error ("'%s.%s.%s' is not listed", projects[0], tracks[0], ROTATED_CHANNEL);
+    g_strfreev (list);
+
+    g_message ("removing rotated channel");
+    if (!hyscan_db_channel_remove (db, track_id[0][0], ROTATED_CHANNEL))
+      g_error ("can't remove '%s.%s.%s'", projects[0], tracks[0], ROTATED_CHANNEL);
+
+    list = hyscan_db_channel_list (db, track_id[0][0]);
+    if ((list != NULL) && g_strv_contains ((const gchar * const *) list, ROTATED_CHANNEL))
+      g_error ("'%s.%s.%s' is still listed", projects[0], tracks[0], ROTATED_CHANNEL);
+    g_strfreev (list);
+
+    /* Файлы частей канала удалены. */
+    if (g_str_has_prefix (db_uri, "file://"))
+      {
+        gchar *track_path;
+
+        track_path = g_build_filename (db_uri + strlen ("file://"), projects[0], tracks[0], NULL);
+        check_channel_files ("check_channel_files ('" ROTATED_CHANNEL "')", track_path, ROTATED_CHANNEL);
+        g_free (track_path);
+      }
+  }
+
+  /* Тесты записи групп записей. Группы записей пересекают границы частей. */
+  g_message (" ");
+  g_message ("checking channel batch write");
+  {
+    HyScanBuffer *buffer;
+    guint32 sizes[BATCH_RECORDS];
+    gint64 times[BATCH_RECORDS];
+    guint32 first_index, last_index;
+    guint32 n_records;
+    guint8 *data;
+    gint32 nid;
+
+    nid = hyscan_db_channel_create (db, track_id[0][0], BATCH_CHANNEL, NULL);
+    if (nid < 0)
+      g_error ("can't create '%s.%s.%s'", projects[0], tracks[0], BATCH_CHANNEL);
+
+    if (!hyscan_db_channel_set_chunk_size (db, nid, BATCH_CHUNK_SIZE))
+      g_error ("can't set '%s.%s.%s' chunk size", projects[0], tracks[0], BATCH_CHANNEL);
+
+    buffer = hyscan_buffer_new ();
+    data = g_malloc (BATCH_RECORDS * RECORD_SIZE);
+
+    for (l = 0; l < BATCH_COUNT; l++)
+      {
+        for (m = 0; m < BATCH_RECORDS; m++)
+          {
+            fill_record (data + m * RECORD_SIZE, l * BATCH_RECORDS + m);
+            sizes[m] = RECORD_SIZE;
+            times[m] = RECORD_TIME (l * BATCH_RECORDS + m);
+          }
+
+        hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, BATCH_RECORDS * RECORD_SIZE);
+        if (!hyscan_db_channel_add_data_batch (db, nid, BATCH_RECORDS, buffer, sizes, times, &first_index))
+          g_error ("can't add data batch to '%s.%s.%s'", projects[0], tracks[0], BATCH_CHANNEL);
+        if (first_index != (guint32) (l * BATCH_RECORDS))
+          g_error ("'%s.%s.%s' wrong batch index", projects[0], tracks[0], BATCH_CHANNEL);
+      }
+
+    hyscan_db_channel_finalize (db, nid);
+
+    g_message ("checking channel batch content");
+    if (!hyscan_db_channel_get_data_range (db, nid, &first_index, &last_index))
+      g_error ("can't get '%s.%s.%s' data range", projects[0], tracks[0], BATCH_CHANNEL);
+    if ((first_index != 0) || (last_index != BATCH_COUNT * BATCH_RECORDS - 1))
+      g_error ("'%s.%s.%s' wrong data range", projects[0], tracks[0], BATCH_CHANNEL);
+
+    check_records (db, "check_records ('" BATCH_CHANNEL "')", nid, first_index, last_index);
+
+    /* Считываем записи группами, смещёнными относительно записанных. */
+    for (l = BATCH_RECORDS / 2; l <= (gint) last_index; l += n_records)
+      {
+        const guint8 *rdata;
+        guint32 size;
+
+        n_records = BATCH_RECORDS;
+        if (!hyscan_db_channel_get_data_batch (db, nid, l, &n_records, buffer, sizes, times))
+          g_error ("can't read data batch from '%s.%s.%s'", projects[0], tracks[0], BATCH_CHANNEL);
+
+        rdata = hyscan_buffer_get_data (buffer, &size);
+        for (m = 0; m < (gint) n_records; m++)
+          {
+            fill_record (data, l + m);
+            if ((sizes[m] != RECORD_SIZE) || (times[m] != RECORD_TIME (l + m)) ||
+                (memcmp (rdata, data, RECORD_SIZE) != 0))
+              {
+                g_error ("'%s.%s.%s' batch record %d mismatch", projects[0], tracks[0], BATCH_CHANNEL, l + m);
+              }
+            rdata += RECORD_SIZE;
+          }
+
+        if (size != n_records * RECORD_SIZE)
+          g_error ("'%s.%s.%s' wrong batch size", projects[0], tracks[0], BATCH_CHANNEL);
+      }
+
+    g_object_unref (buffer);
+    g_free (data);
+
+    hyscan_db_close (db, nid);
+    if (!hyscan_db_channel_remove (db, track_id[0][0], BATCH_CHANNEL))
+      g_error ("can't remove '%s.%s.%s'", projects[0], tracks[0], BATCH_CHANNEL);
+  }
+
+  /* Тесты ошибочной записи группы записей. Метки времени в середине группы
+   * не возрастают, записанной может оказаться только начальная часть группы. */
+  g_message (" ");
+  g_message ("checking channel partial batch write");
+  {
+    HyScanBuffer *buffer;
+    guint32 sizes[BATCH_RECORDS];
+    gint64 times[BATCH_RECORDS];
+    guint32 first_index, last_index;
+    guint32 batch_index;
+    guint8 *data;
+    gint32 nid;
+
+    nid = hyscan_db_channel_create (db, track_id[0][0], PARTIAL_CHANNEL, NULL);
+    if (nid < 0)
+      g_error ("can't create '%s.%s.%s'", projects[0], tracks[0], PARTIAL_CHANNEL);
+
+    buffer = hyscan_buffer_new ();
+    data = g_malloc (BATCH_RECORDS * RECORD_SIZE);
+
+    /* Корректная группа записей. */
+    for (m = 0; m < BATCH_RECORDS; m++)
+      {
+        fill_record (data + m * RECORD_SIZE, m);
+        sizes[m] = RECORD_SIZE;
+        times[m] = RECORD_TIME (m);
+      }
+
+    hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, BATCH_RECORDS * RECORD_SIZE);
+    if (!hyscan_db_channel_add_data_batch (db, nid, BATCH_RECORDS, buffer, sizes, times, &batch_index))
+      g_error ("can't add data batch to '%s.%s.%s'", projects[0], tracks[0], PARTIAL_CHANNEL);
+    if (batch_index != 0)
+      g_error ("'%s.%s.%s' wrong batch index", projects[0], tracks[0], PARTIAL_CHANNEL);
+
+    /* Группа с повторяющейся меткой времени в середине. */
+    for (m = 0; m < BATCH_RECORDS; m++)
+      {
+        fill_record (data + m * RECORD_SIZE, BATCH_RECORDS + m);
+        times[m] = RECORD_TIME (BATCH_RECORDS + m);
+      }
+    times[BATCH_RECORDS / 2] = times[BATCH_RECORDS / 2 - 1];
+
+    batch_index = G_MAXUINT32;
+    hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, BATCH_RECORDS * RECORD_SIZE);
+    if (hyscan_db_channel_add_data_batch (db, nid, BATCH_RECORDS, buffer, sizes, times, &batch_index))
+      g_error ("'%s.%s.%s' invalid batch accepted", projects[0], tracks[0], PARTIAL_CHANNEL);
+
+    /* Записанные записи образуют начало группы до ошибочной записи. */
+    if (!hyscan_db_channel_get_data_range (db, nid, &first_index, &last_index))
+      g_error ("can't get '%s.%s.%s' data range", projects[0], tracks[0], PARTIAL_CHANNEL);
+    if ((first_index != 0) ||
+        (last_index < BATCH_RECORDS - 1) ||
+        (last_index > BATCH_RECORDS + BATCH_RECORDS / 2 - 1))
+      {
+        g_error ("'%s.%s.%s' wrong data range", projects[0], tracks[0], PARTIAL_CHANNEL);
+      }
+
+    if (last_index >= BATCH_RECORDS)
+      {
+        if (batch_index != BATCH_RECORDS)
+          g_error ("'%s.%s.%s' wrong partial batch index", projects[0], tracks[0], PARTIAL_CHANNEL);
+      }
+    else
+      {
+        if (batch_index != G_MAXUINT32)
+          g_error ("'%s.%s.%s' batch index set without data", projects[0], tracks[0], PARTIAL_CHANNEL);
+      }
+
+    check_records (db, "check_records ('" PARTIAL_CHANNEL "')", nid, first_index, last_index);
+
+    /* После ошибки запись продолжается со следующего индекса. */
+    fill_record (data, last_index + 1);
+    hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, RECORD_SIZE);
+    if (!hyscan_db_channel_add_data (db, nid, RECORD_TIME (last_index + 1), buffer, &batch_index))
+      g_error ("can't add data to '%s.%s.%s'", projects[0], tracks[0], PARTIAL_CHANNEL);
+    if (batch_index != last_index + 1)
+      g_error ("'%s.%s.%s' wrong index after partial batch", projects[0], tracks[0], PARTIAL_CHANNEL);
+
+    check_records (db, "check_records ('" PARTIAL_CHANNEL "')", nid, first_index, last_index + 1);
+
+    g_object_unref (buffer);
+    g_free (data);
+
+    hyscan_db_close (db, nid);
+    if (!hyscan_db_channel_remove (db, track_id[0][0], PARTIAL_CHANNEL))
+      g_error ("can't remove '%s.%s.%s'", projects[0], tracks[0], PARTIAL_CHANNEL);
+  }
+
+  /* Тесты асинхронного чтения и поиска данных. */
+  g_message (" ");
+  g_message ("checking asynchronous data access");
+  {
+    AsyncRequest *requests;
+    guint n_requests = 0;
+    guint n_pending = 0;
+    gint32 nid;
+
+    nid = hyscan_db_channel_create (db, track_id[0][0], ASYNC_CHANNEL, NULL);
+    if (nid < 0)
+      g_error ("can't create '%s.%s.%s'", projects[0], tracks[0], ASYNC_CHANNEL);
+
+    {
+      HyScanBuffer *buffer = hyscan_buffer_new ();
+      guint8 *data = g_malloc (RECORD_SIZE);
+
+      for (l = 0; l < ASYNC_RECORDS; l++)
+        {
+          fill_record (data, l);
+          hyscan_buffer_wrap (buffer, HYSCAN_DATA_BLOB, data, RECORD_SIZE);
+          if (!hyscan_db_channel_add_data (db, nid, RECORD_TIME (l), buffer, NULL))
+            g_error ("can't add data to '%s.%s.%s'", projects[0], tracks[0], ASYNC_CHANNEL);
+        }
+
+      g_object_unref (buffer);
+      g_free (data);
+    }
+
+    /* Все запросы выполняются одновременно. */
+    requests = g_new0 (AsyncRequest, 3 * ASYNC_RECORDS);
+    for (l = 0; l < ASYNC_RECORDS; l++)
+      {
+        AsyncRequest *request;
+
+        request = &requests[n_requests++];
+        request->index = l;
+        request->n_pending = &n_pending;
+        n_pending += 1;
+        hyscan_db_channel_get_data_async (db, nid, l, NULL, get_data_ready, request);
+
+        request = &requests[n_requests++];
+        request->index = l;
+        request->time = RECORD_TIME (l);
+        request->n_pending = &n_pending;
+        n_pending += 1;
+        hyscan_db_channel_find_data_async (db, nid, request->time, NULL, find_data_ready, request);
+
+        if (l == ASYNC_RECORDS - 1)
+          continue;
+
+        request = &requests[n_requests++];
+        request->index = l;
+        request->time = RECORD_TIME (l) + 500;
+        request->n_pending = &n_pending;
+        n_pending += 1;
+        hyscan_db_channel_find_data_async (db, nid, request->time, NULL, find_data_ready, request);
+      }
+
+    while (n_pending > 0)
+      g_main_context_iteration (NULL, TRUE);
+
+    g_free (requests);
+
+    hyscan_db_close (db, nid);
+    if (!hyscan_db_channel_remove (db, track_id[0][0], ASYNC_CHANNEL))
+      g_error ("can't remove '%s.%s.%s'", projects[0], tracks[0], ASYNC_CHANNEL);
+  }
+
   /* Тесты удаления объектов. */
   g_message (" ");
   g_message ("removing objects");